@@ -0,0 +1,14 @@
+#version 450
+// Position-only stream; must transform exactly like shader.vert so the main
+// pass can depth test with EQUAL.
+layout(location = 0) in vec3 inPosition;
+layout(set = 0, binding = 1) uniform MVP {
+    mat4 uMVP;
+};
+layout(push_constant) uniform Draw {
+    mat4 uModel;
+};
+invariant gl_Position;
+void main() {
+    gl_Position = uMVP * (uModel * vec4(inPosition, 1.0));
+}
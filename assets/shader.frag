@@ -1,8 +1,82 @@
 #version 450
 layout(location = 0) in vec3 fragColor;
 layout(location = 1) in vec2 fragUV;
+layout(location = 2) in vec3 fragViewPos;
 layout(location = 0) out vec4 outColor;
 layout(set = 0, binding = 0) uniform sampler2D texSampler;
+// Clustered lights, see LightGrid.h.
+layout(set = 1, binding = 0) uniform LightGridParams {
+    mat4 uView;
+    uvec4 uGrid;   // tiles x, tiles y, slices, light count
+    vec4 uSlice;   // slice = log(depth) * x + y; tile size in pixels (zw)
+    vec4 uAmbient;
+};
+struct PointLight {
+    vec4 positionRadius;   // view space
+    vec4 colorIntensity;
+};
+layout(std430, set = 1, binding = 1) readonly buffer Lights {
+    PointLight lights[];
+};
+layout(std430, set = 1, binding = 2) readonly buffer Clusters {
+    uvec2 clusters[];      // offset, count into lightIndices
+};
+layout(std430, set = 1, binding = 3) readonly buffer LightIndices {
+    uint lightIndices[];
+};
+// Sun shadows, see ShadowCascades.h.
+layout(set = 2, binding = 0) uniform ShadowParams {
+    mat4 uViewToShadow[4];
+    vec4 uCascadeEnd;      // view depth where each cascade ends
+    vec4 uTexelWorld;      // world size of a shadow texel per cascade
+    vec4 uSunDirection;    // view space, towards the sun; w intensity
+    vec4 uSunColor;        // w: one texel in texture coordinates
+};
+layout(set = 2, binding = 1) uniform sampler2DArrayShadow shadowMap;
+
+float sun_shadow(vec3 viewPos, vec3 normal) {
+    float depth = -viewPos.z;
+    uint cascade = 0u;
+    while (cascade < 4u && depth > uCascadeEnd[cascade]) ++cascade;
+    if (cascade == 4u) return 1.0;
+    // Push the lookup off the surface by about a texel against acne.
+    vec3 offsetPos = viewPos + normal * (1.5 * uTexelWorld[cascade]);
+    vec4 coord = uViewToShadow[cascade] * vec4(offsetPos, 1.0);
+    vec2 uv = coord.xy * 0.5 + 0.5;
+    // 3x3 taps of the hardware-filtered comparison. The map has one level, so
+    // explicit zero gradients are exact and safe in divergent control flow.
+    float lit = 0.0;
+    for (int y = -1; y <= 1; ++y) {
+        for (int x = -1; x <= 1; ++x) {
+            lit += textureGrad(shadowMap, vec4(uv + vec2(x, y) * uSunColor.w, float(cascade), coord.z), vec2(0.0), vec2(0.0));
+        }
+    }
+    return lit / 9.0;
+}
+
 void main() {
-    outColor = texture(texSampler, fragUV) * vec4(fragColor, 1.0);
-} 
\ No newline at end of file
+    vec4 albedo = texture(texSampler, fragUV) * vec4(fragColor, 1.0);
+    // Meshes have no normals yet; shade with the face normal, facing the eye.
+    vec3 normal = normalize(cross(dFdx(fragViewPos), dFdy(fragViewPos)));
+    if (dot(normal, fragViewPos) > 0.0) normal = -normal;
+    uint slice = uint(clamp(floor(log(-fragViewPos.z) * uSlice.x + uSlice.y), 0.0, float(uGrid.z - 1u)));
+    uvec2 tile = min(uvec2(gl_FragCoord.xy / uSlice.zw), uGrid.xy - 1u);
+    uvec2 range = clusters[(slice * uGrid.y + tile.y) * uGrid.x + tile.x];
+    vec3 light = uAmbient.rgb;
+    if (uSunDirection.w > 0.0) {
+        float lambert = max(dot(normal, uSunDirection.xyz), 0.0);
+        if (lambert > 0.0) light += uSunColor.rgb * (uSunDirection.w * lambert * sun_shadow(fragViewPos, normal));
+    }
+    for (uint i = range.x; i < range.x + range.y; ++i) {
+        PointLight l = lights[lightIndices[i]];
+        vec3 toLight = l.positionRadius.xyz - fragViewPos;
+        float distance2 = max(dot(toLight, toLight), 1e-4);
+        // Inverse square falloff, windowed to reach zero at the radius.
+        float ratio2 = distance2 / (l.positionRadius.w * l.positionRadius.w);
+        float window = clamp(1.0 - ratio2 * ratio2, 0.0, 1.0);
+        float attenuation = window * window / distance2;
+        float lambert = max(dot(normal, toLight * inversesqrt(distance2)), 0.0);
+        light += l.colorIntensity.rgb * (l.colorIntensity.w * attenuation * lambert);
+    }
+    outColor = vec4(albedo.rgb * light, albedo.a);
+}
@@ -1,14 +1,31 @@
 #version 450
-layout(location = 0) in vec2 inPosition;
+layout(location = 0) in vec3 inPosition;
 layout(location = 1) in vec3 inColor;
 layout(location = 2) in vec2 inUV;
 layout(location = 0) out vec3 fragColor;
 layout(location = 1) out vec2 fragUV;
+layout(location = 2) out vec3 fragViewPos;
+// uMVP is the camera's view-projection; the draw's model matrix is pushed
+// by the render queue.
 layout(set = 0, binding = 1) uniform MVP {
     mat4 uMVP;
 };
+layout(push_constant) uniform Draw {
+    mat4 uModel;
+};
+// See LightGrid.h.
+layout(set = 1, binding = 0) uniform LightGridParams {
+    mat4 uView;
+    uvec4 uGrid;
+    vec4 uSlice;
+    vec4 uAmbient;
+};
+invariant gl_Position;
 void main() {
-    gl_Position = uMVP * vec4(inPosition, 0.0, 1.0);
+    // Same expression as depth_prepass.vert, so the EQUAL depth test holds.
+    gl_Position = uMVP * (uModel * vec4(inPosition, 1.0));
     fragColor = inColor;
     fragUV = inUV;
-} 
\ No newline at end of file
+    // Clusters are assigned in view space, so lights see the world position.
+    fragViewPos = (uView * (uModel * vec4(inPosition, 1.0))).xyz;
+}
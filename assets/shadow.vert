@@ -0,0 +1,10 @@
+#version 450
+// Shadow cascade depth; the caster's position stream in the cascade's light space.
+layout(location = 0) in vec3 inPosition;
+layout(push_constant) uniform Cascade {
+    mat4 uModel;
+    mat4 uLightViewProj;
+};
+void main() {
+    gl_Position = uLightViewProj * (uModel * vec4(inPosition, 1.0));
+}
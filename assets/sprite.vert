@@ -0,0 +1,18 @@
+#version 450
+// One instance per quad; corners come from the vertex index of a 4-vertex strip.
+layout(location = 0) in vec4 inRect;  // x, y, width, height in pixels
+layout(location = 1) in vec4 inUV;    // u0, v0, u1, v1
+layout(location = 2) in vec4 inColor;
+layout(location = 0) out vec4 fragColor;
+layout(location = 1) out vec2 fragUV;
+layout(push_constant) uniform Screen {
+    vec2 scale;
+    vec2 offset;
+};
+void main() {
+    vec2 corner = vec2(gl_VertexIndex & 1, gl_VertexIndex >> 1);
+    vec2 position = inRect.xy + corner * inRect.zw;
+    gl_Position = vec4(position * scale + offset, 0.0, 1.0);
+    fragColor = inColor;
+    fragUV = mix(inUV.xy, inUV.zw, corner);
+}
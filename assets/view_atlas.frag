@@ -0,0 +1,9 @@
+#version 450
+// Unlit albedo; the scene's lights and shadows are fitted to the main camera.
+layout(location = 0) in vec3 fragColor;
+layout(location = 1) in vec2 fragUV;
+layout(location = 0) out vec4 outColor;
+layout(set = 0, binding = 0) uniform sampler2D texSampler;
+void main() {
+    outColor = texture(texSampler, fragUV) * vec4(fragColor, 1.0);
+}
@@ -0,0 +1,17 @@
+#version 450
+// One view of a ViewAtlas; the draw's model matrix and the tile's
+// view-projection are push constants.
+layout(location = 0) in vec3 inPosition;
+layout(location = 1) in vec3 inColor;
+layout(location = 2) in vec2 inUV;
+layout(location = 0) out vec3 fragColor;
+layout(location = 1) out vec2 fragUV;
+layout(push_constant) uniform View {
+    mat4 uModel;
+    mat4 uViewProj;
+};
+void main() {
+    gl_Position = uViewProj * (uModel * vec4(inPosition, 1.0));
+    fragColor = inColor;
+    fragUV = inUV;
+}
@@ -0,0 +1,107 @@
+// Characters per millisecond for skinned playback: Animator::update (clip
+// sampling and palettes, over the JobSystem) and CPU deformation of every
+// instance (morph targets, then skinning), for the imported clip and its
+// compressed form.
+//
+//   animation_bench [characters] [frames] [file.glb]
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+#include "AnimationCooker.h"
+#include "Animator.h"
+#include "GLTFImporter.h"
+#include "JobSystem.h"
+#include "Skinning.h"
+
+namespace {
+using Clock = std::chrono::steady_clock;
+
+constexpr float frame_dt = 1.0f / 60.0f;
+constexpr uint32_t warmup_frames = 10;
+
+struct Timing {
+    double update_ms = 0.0;
+    double skin_ms = 0.0;
+};
+
+double elapsed_ms(Clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+// morphed holds one entry per instance when the mesh has morph targets.
+void skin_all(Animator& animator, const SkinnedMeshData& mesh, std::vector<MorphedVertices>& morphed) {
+    JobSystem::shared().parallel_for(animator.size(), 4, [&](size_t begin, size_t end) {
+        thread_local std::vector<Vertex> skinned;
+        thread_local MorphedVertices unused;
+        skinned.resize(mesh.vertices.size());
+        for (size_t i = begin; i < end; ++i) {
+            const uint32_t index = static_cast<uint32_t>(i);
+            const bool morphs = !morphed.empty();
+            deform_skinned_mesh(mesh.vertices.data(), mesh.weights.data(), mesh.vertices.size(), mesh.morphs,
+                                morphs ? animator.morph_weights(index) : nullptr, morphs ? morphed[i] : unused,
+                                animator.palette(index), skinned.data());
+        }
+    });
+}
+
+template <typename Clip>
+Timing run(const SkinnedMeshData& mesh, const Clip* clip, float duration, uint32_t characters, uint32_t frames) {
+    Animator animator;
+    // Spread start times so instances do not sample the same keys.
+    std::vector<MorphedVertices> morphed(mesh.morphs.empty() ? 0 : characters);
+    for (uint32_t i = 0; i < characters; ++i) {
+        uint32_t index = animator.add(mesh.skeleton, clip, duration * static_cast<float>(i) / static_cast<float>(characters));
+        if (!mesh.morphs.empty()) animator.set_morph_weights(index, mesh.morphs.default_weights);
+    }
+    for (uint32_t f = 0; f < warmup_frames; ++f) {
+        animator.update(frame_dt);
+        skin_all(animator, mesh, morphed);
+    }
+    Timing timing;
+    for (uint32_t f = 0; f < frames; ++f) {
+        auto start = Clock::now();
+        animator.update(frame_dt);
+        timing.update_ms += elapsed_ms(start);
+        start = Clock::now();
+        skin_all(animator, mesh, morphed);
+        timing.skin_ms += elapsed_ms(start);
+    }
+    timing.update_ms /= frames;
+    timing.skin_ms /= frames;
+    return timing;
+}
+
+void report(const char* label, const Timing& timing, uint32_t characters) {
+    double total = timing.update_ms + timing.skin_ms;
+    std::printf("%-10s update %8.3f ms  skin %8.3f ms  total %8.3f ms/frame  %8.1f characters/ms\n", label,
+                timing.update_ms, timing.skin_ms, total, total > 0.0 ? characters / total : 0.0);
+}
+}
+
+int main(int argc, char** argv) {
+    const uint32_t characters = argc > 1 ? static_cast<uint32_t>(std::strtoul(argv[1], nullptr, 10)) : 1000;
+    const uint32_t frames = argc > 2 ? static_cast<uint32_t>(std::strtoul(argv[2], nullptr, 10)) : 100;
+    const std::string file = argc > 3 ? argv[3] : ENGINE_ASSET_DIR "/human_figure2.glb";
+    if (characters == 0 || frames == 0) {
+        std::fprintf(stderr, "usage: animation_bench [characters] [frames] [file.glb]\n");
+        return 1;
+    }
+
+    SkinnedMeshData mesh;
+    if (!GLTFImporter::load_skinned_mesh(file, mesh) || mesh.clips.empty()) {
+        std::fprintf(stderr, "animation_bench: no skinned mesh with a clip in %s\n", file.c_str());
+        return 1;
+    }
+    const AnimationClip& clip = mesh.clips.front();
+    const CompressedClip compressed = AnimationCooker::compress(mesh.skeleton, clip);
+
+    std::printf("%s: %u joints, %zu vertices, %u morph targets, clip '%s' %.2f s, %zu bytes compressed\n", file.c_str(),
+                mesh.skeleton.joint_count(), mesh.vertices.size(), mesh.morphs.target_count(), clip.name.c_str(), clip.duration,
+                compressed.byte_size());
+    std::printf("%u characters, %u frames, %u threads\n", characters, frames, JobSystem::shared().thread_count());
+    report("clip", run(mesh, &clip, clip.duration, characters, frames), characters);
+    report("compressed", run(mesh, &compressed, compressed.duration, characters, frames), characters);
+    return 0;
+}
@@ -0,0 +1,61 @@
+// Cost of the profiler's CPU track: frames of nested scopes recorded with the
+// profiler enabled and disabled, plus heap allocations per frame once its
+// frame ring is warm (counted when built with -DENGINE_COUNT_ALLOCATIONS=ON).
+// The GPU track only adds vkCmdWriteTimestamp calls and is not measured.
+//
+//   profiler_bench [frames] [scopes per frame]
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include "AllocationCounter.h"
+#include "Profiler.h"
+
+namespace {
+using Clock = std::chrono::steady_clock;
+
+// Scope names of a draw_frame() with its nested passes.
+constexpr const char* scope_names[] = {"frame", "wait_fence", "acquire", "record", "cull", "shadows", "opaque", "submit"};
+
+// One outer scope with the rest nested one level below it, like draw_frame().
+void record_frame(Profiler& profiler, uint32_t scopes) {
+    profiler.begin_frame();
+    Profiler::CpuScope frame(profiler, scope_names[0]);
+    for (uint32_t i = 1; i < scopes; ++i) {
+        Profiler::CpuScope scope(profiler, scope_names[i % std::size(scope_names)]);
+    }
+}
+
+double run_ns_per_frame(Profiler& profiler, uint64_t frames, uint32_t scopes) {
+    auto start = Clock::now();
+    for (uint64_t f = 0; f < frames; ++f) record_frame(profiler, scopes);
+    return std::chrono::duration<double, std::nano>(Clock::now() - start).count() / static_cast<double>(frames);
+}
+}
+
+int main(int argc, char** argv) {
+    uint64_t frames = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 200000;
+    uint32_t scopes = argc > 2 ? static_cast<uint32_t>(std::strtoul(argv[2], nullptr, 10)) : 8;
+    if (frames == 0 || scopes == 0 || scopes > Profiler::max_cpu_scopes) {
+        std::fprintf(stderr, "usage: profiler_bench [frames] [scopes per frame, 1..%u]\n", Profiler::max_cpu_scopes);
+        return 1;
+    }
+
+    Profiler profiler;
+    // Fills the ring once so every frame below reuses a slot.
+    for (size_t f = 0; f < Profiler::max_frames; ++f) record_frame(profiler, scopes);
+    uint64_t allocationsBefore = heap_allocation_count();
+    double enabledNs = run_ns_per_frame(profiler, frames, scopes);
+    uint64_t allocations = heap_allocation_count() - allocationsBefore;
+    profiler.set_enabled(false);
+    double disabledNs = run_ns_per_frame(profiler, frames, scopes);
+
+    std::printf("%llu frames, %u scopes each\n", static_cast<unsigned long long>(frames), scopes);
+    std::printf("  enabled   %8.1f ns/frame\n", enabledNs);
+    std::printf("  disabled  %8.1f ns/frame\n", disabledNs);
+    std::printf("  overhead  %8.1f ns/scope\n", (enabledNs - disabledNs) / scopes);
+    if (heap_allocations_counted)
+        std::printf("  heap allocations %.3f/frame\n", static_cast<double>(allocations) / static_cast<double>(frames));
+    else
+        std::printf("  heap allocations not counted (configure with -DENGINE_COUNT_ALLOCATIONS=ON)\n");
+    return 0;
+}
@@ -0,0 +1,115 @@
+// Rays per second against a mesh's TriangleBvh: primary rays of a camera
+// looking at the mesh, traced one at a time and as 4-ray packets across the
+// JobSystem. Packet hits are checked against the single-ray results.
+//
+//   ray_bench [resolution] [repeats] [file.glb]
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+#include "Bvh.h"
+#include "Camera.h"
+#include "GLTFImporter.h"
+#include "JobSystem.h"
+
+namespace {
+using Clock = std::chrono::steady_clock;
+
+// Rows per batch; a row of a 512 image is a few hundred microseconds.
+constexpr size_t row_batch = 4;
+
+double elapsed_ms(Clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+void trace_single(const TriangleBvh& bvh, const std::vector<Ray>& rays, uint32_t resolution, std::vector<RayHit>& hits) {
+    JobSystem::shared().parallel_for(resolution, row_batch, [&](size_t begin, size_t end) {
+        for (size_t i = begin * resolution; i < end * resolution; ++i) {
+            hits[i] = RayHit{};
+            bvh.intersect(rays[i], hits[i]);
+        }
+    });
+}
+
+// Packets of four horizontally adjacent pixels; resolution is a multiple of 4.
+void trace_packets(const TriangleBvh& bvh, const std::vector<Ray>& rays, uint32_t resolution, std::vector<RayHit>& hits) {
+    JobSystem::shared().parallel_for(resolution, row_batch, [&](size_t begin, size_t end) {
+        for (size_t i = begin * resolution; i < end * resolution; i += 4) {
+            RayPacket packet;
+            for (uint32_t lane = 0; lane < 4; ++lane) packet.set(lane, rays[i + lane]);
+            bvh.intersect(packet, &hits[i]);
+        }
+    });
+}
+
+template <typename Trace>
+double mrays_per_second(Trace trace, size_t rayCount, uint32_t repeats) {
+    trace();
+    auto start = Clock::now();
+    for (uint32_t r = 0; r < repeats; ++r) trace();
+    double ms = elapsed_ms(start);
+    return ms > 0.0 ? static_cast<double>(rayCount) * repeats / (ms * 1000.0) : 0.0;
+}
+}
+
+int main(int argc, char** argv) {
+    uint32_t resolution = argc > 1 ? static_cast<uint32_t>(std::strtoul(argv[1], nullptr, 10)) : 512;
+    const uint32_t repeats = argc > 2 ? static_cast<uint32_t>(std::strtoul(argv[2], nullptr, 10)) : 10;
+    const std::string file = argc > 3 ? argv[3] : ENGINE_ASSET_DIR "/human_figure2.glb";
+    resolution = resolution / 4 * 4;
+    if (resolution == 0 || repeats == 0) {
+        std::fprintf(stderr, "usage: ray_bench [resolution] [repeats] [file.glb]\n");
+        return 1;
+    }
+
+    std::vector<Vertex> vertices;
+    std::vector<uint32_t> indices;
+    if (!GLTFImporter::load_mesh(file, vertices, indices) || indices.empty()) {
+        std::fprintf(stderr, "ray_bench: no mesh in %s\n", file.c_str());
+        return 1;
+    }
+    auto buildStart = Clock::now();
+    TriangleBvh bvh(vertices, indices.data(), indices.size());
+    double buildMs = elapsed_ms(buildStart);
+
+    // Frame the mesh's bounds from the front.
+    const Aabb& bounds = bvh.bounds();
+    glm::vec3 center = (bounds.min + bounds.max) * 0.5f;
+    float radius = glm::length(bounds.max - bounds.min) * 0.5f;
+    Camera camera;
+    camera.set_perspective(glm::radians(50.0f), 1.0f, radius * 0.1f, radius * 10.0f);
+    camera.set_position(center + glm::vec3(0.0f, 0.0f, radius * 2.5f));
+    camera.set_look_at(center);
+    camera.set_up(glm::vec3(0, 1, 0));
+    std::vector<Ray> rays(static_cast<size_t>(resolution) * resolution);
+    for (uint32_t y = 0; y < resolution; ++y) {
+        for (uint32_t x = 0; x < resolution; ++x) {
+            float ndcX = (x + 0.5f) / resolution * 2.0f - 1.0f;
+            float ndcY = (y + 0.5f) / resolution * 2.0f - 1.0f;
+            rays[static_cast<size_t>(y) * resolution + x] = camera.ray(ndcX, ndcY);
+        }
+    }
+
+    std::vector<RayHit> single(rays.size()), packets(rays.size());
+    double singleRate = mrays_per_second([&] { trace_single(bvh, rays, resolution, single); }, rays.size(), repeats);
+    double packetRate = mrays_per_second([&] { trace_packets(bvh, rays, resolution, packets); }, rays.size(), repeats);
+    size_t hitCount = 0, mismatches = 0;
+    for (size_t i = 0; i < rays.size(); ++i) {
+        hitCount += single[i].hit();
+        if (single[i].triangle != packets[i].triangle) ++mismatches;
+    }
+
+    std::printf("%s: %zu triangles, BVH %zu nodes, %zu bytes, built in %.2f ms\n", file.c_str(), bvh.triangle_count(),
+                bvh.nodes().size(), bvh.byte_size(), buildMs);
+    std::printf("%ux%u primary rays, %.1f%% hit, %u repeats, %u threads\n", resolution, resolution,
+                100.0 * hitCount / rays.size(), repeats, JobSystem::shared().thread_count());
+    std::printf("single  %8.2f Mrays/s\npackets %8.2f Mrays/s\n", singleRate, packetRate);
+    if (mismatches > 0) {
+        std::fprintf(stderr, "ray_bench: %zu packet hits differ from single rays\n", mismatches);
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,13 @@
+#pragma once
+#include <cstdint>
+
+// Global operator new calls in the process so far, from any thread. Only
+// counted when built with -DENGINE_COUNT_ALLOCATIONS=ON, which replaces the
+// global allocation functions; otherwise always 0.
+uint64_t heap_allocation_count();
+
+#if ENGINE_COUNT_ALLOCATIONS
+inline constexpr bool heap_allocations_counted = true;
+#else
+inline constexpr bool heap_allocations_counted = false;
+#endif
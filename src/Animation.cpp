@@ -0,0 +1,114 @@
+#include "Animation.h"
+#include <algorithm>
+
+namespace {
+// Key before time and the blend factor towards the next one.
+void find_key(const std::vector<float>& times, float time, size_t& key, float& alpha) {
+    if (times.size() < 2 || time <= times.front()) {
+        key = 0;
+        alpha = 0.0f;
+        return;
+    }
+    if (time >= times.back()) {
+        key = times.size() - 1;
+        alpha = 0.0f;
+        return;
+    }
+    key = static_cast<size_t>(std::upper_bound(times.begin(), times.end(), time) - times.begin()) - 1;
+    float span = times[key + 1] - times[key];
+    alpha = span > 0.0f ? (time - times[key]) / span : 0.0f;
+}
+
+template<int N>
+glm::vec4 load(const float* p) {
+    glm::vec4 v(0.0f);
+    for (int i = 0; i < N; ++i) v[i] = p[i];
+    return v;
+}
+
+// Value of a channel with N components per key, before any rotation fix-up.
+template<int N>
+glm::vec4 interpolate(const AnimationChannel& channel, float time) {
+    size_t key;
+    float alpha;
+    find_key(channel.times, time, key, alpha);
+    const float* values = channel.values.data();
+    if (channel.interpolation == AnimationChannel::Interpolation::cubic) {
+        // Keys are (in-tangent, value, out-tangent) triplets.
+        const size_t stride = 3 * N;
+        glm::vec4 p0 = load<N>(values + key * stride + N);
+        if (alpha == 0.0f) return p0;
+        float dt = channel.times[key + 1] - channel.times[key];
+        glm::vec4 m0 = load<N>(values + key * stride + 2 * N) * dt;
+        glm::vec4 p1 = load<N>(values + (key + 1) * stride + N);
+        glm::vec4 m1 = load<N>(values + (key + 1) * stride) * dt;
+        float t = alpha, t2 = t * t, t3 = t2 * t;
+        return (2 * t3 - 3 * t2 + 1) * p0 + (t3 - 2 * t2 + t) * m0 + (-2 * t3 + 3 * t2) * p1 + (t3 - t2) * m1;
+    }
+    glm::vec4 p0 = load<N>(values + key * N);
+    if (alpha == 0.0f || channel.interpolation == AnimationChannel::Interpolation::step) return p0;
+    glm::vec4 p1 = load<N>(values + (key + 1) * N);
+    if (N == 4 && glm::dot(p0, p1) < 0.0f) p1 = -p1; // shortest arc
+    return p0 + (p1 - p0) * alpha;
+}
+}
+
+glm::vec4 AnimationChannel::evaluate(float time) const {
+    if (times.empty()) return path == Path::scale ? glm::vec4(1.0f) : glm::vec4(0.0f, 0.0f, 0.0f, path == Path::rotation ? 1.0f : 0.0f);
+    if (path != Path::rotation) return interpolate<3>(*this, time);
+    // Normalized lerp; keys are close enough that slerp isn't worth it.
+    glm::vec4 q = interpolate<4>(*this, time);
+    float length = glm::length(q);
+    return length > 0.0f ? q / length : glm::vec4(0.0f, 0.0f, 0.0f, 1.0f);
+}
+
+void MorphWeightChannel::evaluate(float time, float* weights, uint32_t count) const {
+    if (empty()) return;
+    count = std::min(count, target_count);
+    size_t key;
+    float alpha;
+    find_key(times, time, key, alpha);
+    const float* v = values.data();
+    if (interpolation == AnimationChannel::Interpolation::cubic) {
+        const size_t stride = 3 * target_count;
+        const float* p0 = v + key * stride + target_count;
+        if (alpha == 0.0f) {
+            std::copy(p0, p0 + count, weights);
+            return;
+        }
+        float dt = times[key + 1] - times[key];
+        const float* m0 = v + key * stride + 2 * target_count;
+        const float* p1 = v + (key + 1) * stride + target_count;
+        const float* m1 = v + (key + 1) * stride;
+        float t = alpha, t2 = t * t, t3 = t2 * t;
+        float h00 = 2 * t3 - 3 * t2 + 1, h10 = (t3 - 2 * t2 + t) * dt, h01 = -2 * t3 + 3 * t2, h11 = (t3 - t2) * dt;
+        for (uint32_t i = 0; i < count; ++i) weights[i] = h00 * p0[i] + h10 * m0[i] + h01 * p1[i] + h11 * m1[i];
+        return;
+    }
+    const float* p0 = v + key * target_count;
+    if (alpha == 0.0f || interpolation == AnimationChannel::Interpolation::step) {
+        std::copy(p0, p0 + count, weights);
+        return;
+    }
+    const float* p1 = p0 + target_count;
+    for (uint32_t i = 0; i < count; ++i) weights[i] = p0[i] + (p1[i] - p0[i]) * alpha;
+}
+
+void AnimationClip::sample(float time, JointPose* pose) const {
+    for (const AnimationChannel& channel : channels) {
+        if (channel.times.empty()) continue;
+        JointPose& joint = pose[channel.joint];
+        glm::vec4 value = channel.evaluate(time);
+        switch (channel.path) {
+        case AnimationChannel::Path::translation:
+            joint.translation = glm::vec3(value);
+            break;
+        case AnimationChannel::Path::scale:
+            joint.scale = glm::vec3(value);
+            break;
+        case AnimationChannel::Path::rotation:
+            joint.rotation = glm::quat(value.w, value.x, value.y, value.z);
+            break;
+        }
+    }
+}
@@ -0,0 +1,76 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+// Local transform of one joint.
+struct JointPose {
+    glm::vec3 translation{0.0f};
+    glm::quat rotation{1.0f, 0.0f, 0.0f, 0.0f};
+    glm::vec3 scale{1.0f};
+};
+
+// Joint hierarchy of a skin. Joints are ordered so parents precede their
+// children, which lets the palette be built in a single forward pass.
+struct Skeleton {
+    std::vector<std::string> names;
+    // Parent joint, or -1 for roots.
+    std::vector<int32_t> parents;
+    // Transform of the non-joint nodes above each root (identity elsewhere).
+    std::vector<glm::mat4> root_bases;
+    std::vector<glm::mat4> inverse_bind;
+    std::vector<JointPose> rest_pose;
+
+    uint32_t joint_count() const { return static_cast<uint32_t>(parents.size()); }
+};
+
+// Up to four joint influences per vertex; weights sum to one.
+struct SkinWeights {
+    uint16_t joints[4] = {0, 0, 0, 0};
+    float weights[4] = {1.0f, 0.0f, 0.0f, 0.0f};
+};
+
+// Keyframes driving one property of one joint. values hold 3 (translation,
+// scale) or 4 (rotation, xyzw) floats per key; cubic splines store in-tangent,
+// value and out-tangent per key.
+struct AnimationChannel {
+    enum class Path : uint8_t { translation, rotation, scale };
+    enum class Interpolation : uint8_t { step, linear, cubic };
+
+    uint32_t joint = 0;
+    Path path = Path::translation;
+    Interpolation interpolation = Interpolation::linear;
+    std::vector<float> times;
+    std::vector<float> values;
+
+    // Value at time as xyz(w); rotations come back normalized.
+    glm::vec4 evaluate(float time) const;
+    uint32_t components() const { return path == Path::rotation ? 4 : 3; }
+};
+
+// Morph target weights of the animated mesh. values hold target_count
+// floats per key; cubic splines store in-tangent, value and out-tangent blocks.
+struct MorphWeightChannel {
+    AnimationChannel::Interpolation interpolation = AnimationChannel::Interpolation::linear;
+    uint32_t target_count = 0;
+    std::vector<float> times;
+    std::vector<float> values;
+
+    bool empty() const { return times.empty() || target_count == 0; }
+    // Writes the first count weights (at most target_count) at time.
+    void evaluate(float time, float* weights, uint32_t count) const;
+};
+
+struct AnimationClip {
+    std::string name;
+    float duration = 0.0f;
+    std::vector<AnimationChannel> channels;
+    // Empty when the clip doesn't animate morph targets.
+    MorphWeightChannel morph_weights;
+
+    // Overwrites the animated properties of pose (joint_count entries) with
+    // their values at time; other joints keep what pose already holds.
+    void sample(float time, JointPose* pose) const;
+};
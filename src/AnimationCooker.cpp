@@ -0,0 +1,257 @@
+#include "AnimationCooker.h"
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+#include <stdexcept>
+#include <string>
+
+namespace {
+using Path = AnimationChannel::Path;
+
+constexpr float max16 = 65535.0f;
+// Worst-case rotation error of smallest-three with 15 bits per component.
+constexpr float rotation_quantization = 1e-4f;
+// Times a track's reduction tolerance is halved before it keeps every key,
+// and cubic resample rate doublings before a bound counts as unreachable.
+constexpr int max_tightening = 6;
+constexpr int max_resample_doublings = 4;
+
+struct SourceTrack {
+    const AnimationChannel* channel = nullptr;
+    std::vector<float> times;
+    std::vector<glm::vec4> values;
+};
+
+struct ReducedTrack {
+    CompressedTrack track;
+    const SourceTrack* source = nullptr;
+    std::vector<uint16_t> times;
+    std::vector<uint16_t> words;
+};
+
+// Rotation angle between two unit quaternions, or largest component
+// difference for translation and scale.
+float value_error(Path path, const glm::vec4& a, const glm::vec4& b) {
+    if (path == Path::rotation) {
+        glm::vec4 c = glm::dot(a, b) < 0.0f ? -b : b;
+        return 4.0f * std::atan2(glm::length(a - c), glm::length(a + c));
+    }
+    glm::vec4 d = glm::abs(a - b);
+    return std::max({d.x, d.y, d.z});
+}
+
+// Mirrors the runtime: component-wise lerp, normalized lerp for rotations.
+glm::vec4 lerp_value(Path path, const glm::vec4& a, glm::vec4 b, float alpha) {
+    if (path != Path::rotation) return a + (b - a) * alpha;
+    if (glm::dot(a, b) < 0.0f) b = -b;
+    return glm::normalize(a + (b - a) * alpha);
+}
+
+float error_bound(Path path, const AnimationCompressionSettings& settings) {
+    switch (path) {
+    case Path::translation: return settings.translation_error;
+    case Path::rotation: return settings.rotation_error;
+    case Path::scale: return settings.scale_error;
+    }
+    return 0.0f;
+}
+
+glm::vec4 rest_value(const Skeleton& skeleton, uint32_t joint, Path path) {
+    const JointPose& rest = skeleton.rest_pose[joint];
+    switch (path) {
+    case Path::translation: return glm::vec4(rest.translation, 0.0f);
+    case Path::rotation: return glm::vec4(rest.rotation.x, rest.rotation.y, rest.rotation.z, rest.rotation.w);
+    case Path::scale: return glm::vec4(rest.scale, 0.0f);
+    }
+    return glm::vec4(0.0f);
+}
+
+SourceTrack gather_source(const AnimationChannel& channel, float sampleRate) {
+    SourceTrack source;
+    source.channel = &channel;
+    if (channel.interpolation == AnimationChannel::Interpolation::cubic && channel.times.size() > 1) {
+        float start = channel.times.front(), end = channel.times.back();
+        size_t count = static_cast<size_t>(std::ceil((end - start) * sampleRate)) + 1;
+        for (size_t i = 0; i < count; ++i) {
+            source.times.push_back(i + 1 == count ? end : start + static_cast<float>(i) / sampleRate);
+        }
+    } else {
+        source.times = channel.times;
+    }
+    source.values.reserve(source.times.size());
+    for (float t : source.times) source.values.push_back(channel.evaluate(t));
+    return source;
+}
+
+// Indices of the source keys to keep.
+std::vector<size_t> reduce_keys(const SourceTrack& source, float tolerance) {
+    const size_t n = source.times.size();
+    const Path path = source.channel->path;
+    const auto& v = source.values;
+
+    bool constant = true;
+    for (size_t k = 1; k < n && constant; ++k) constant = value_error(path, v[0], v[k]) <= tolerance;
+    if (constant) return {0};
+
+    std::vector<size_t> kept{0};
+    if (source.channel->interpolation == AnimationChannel::Interpolation::step) {
+        // Only the changes matter.
+        for (size_t k = 1; k < n; ++k) {
+            if (value_error(path, v[kept.back()], v[k]) > tolerance) kept.push_back(k);
+        }
+        return kept;
+    }
+    auto fits = [&](size_t a, size_t b) {
+        float span = source.times[b] - source.times[a];
+        for (size_t k = a + 1; k < b; ++k) {
+            float alpha = span > 0.0f ? (source.times[k] - source.times[a]) / span : 0.0f;
+            if (value_error(path, lerp_value(path, v[a], v[b], alpha), v[k]) > tolerance) return false;
+        }
+        return true;
+    };
+    // Greedy: stretch each segment as far as the curve stays within tolerance.
+    size_t a = 0;
+    while (a + 1 < n) {
+        size_t b = a + 1;
+        while (b + 1 < n && fits(a, b + 1)) ++b;
+        kept.push_back(b);
+        a = b;
+    }
+    return kept;
+}
+
+// tightening scales the key reduction tolerance; zero keeps every key.
+ReducedTrack reduce_track(const SourceTrack& source, float duration, const AnimationCompressionSettings& settings,
+                          float tightening) {
+    const AnimationChannel& channel = *source.channel;
+    ReducedTrack reduced;
+    reduced.source = &source;
+    reduced.track.joint = static_cast<uint16_t>(channel.joint);
+    reduced.track.path = channel.path;
+    reduced.track.step = channel.interpolation == AnimationChannel::Interpolation::step;
+
+    glm::vec3 lo(0.0f), hi(0.0f);
+    if (channel.path != Path::rotation) {
+        lo = hi = glm::vec3(source.values[0]);
+        for (const glm::vec4& value : source.values) {
+            lo = glm::min(lo, glm::vec3(value));
+            hi = glm::max(hi, glm::vec3(value));
+        }
+    }
+    glm::vec3 extent = hi - lo;
+
+    // Leave room in the bound for the quantization applied afterwards.
+    float bound = error_bound(channel.path, settings);
+    float quantization = channel.path == Path::rotation ? rotation_quantization
+                                                        : std::max({extent.x, extent.y, extent.z}) / max16 * 0.5f;
+    std::vector<size_t> kept = reduce_keys(source, std::max(bound - quantization, 0.0f) * tightening);
+
+    for (int c = 0; c < 3; ++c) {
+        reduced.track.range_min[c] = lo[c];
+        reduced.track.range_extent[c] = extent[c];
+    }
+    for (size_t k : kept) {
+        // Same mapping as CompressedClip::sample. Step keys round down so a
+        // change never happens later than in the source.
+        float units = duration > 0.0f ? std::clamp(source.times[k] / duration, 0.0f, 1.0f) * max16 : 0.0f;
+        auto time = static_cast<uint16_t>(reduced.track.step ? std::floor(units) : std::round(units));
+        if (!reduced.times.empty() && time <= reduced.times.back()) continue;
+        reduced.times.push_back(time);
+
+        const glm::vec4& value = source.values[k];
+        uint16_t words[3];
+        if (channel.path == Path::rotation) {
+            encode_smallest_three(glm::quat(value.w, value.x, value.y, value.z), words);
+        } else {
+            for (int c = 0; c < 3; ++c) {
+                float unit = extent[c] > 0.0f ? (value[c] - lo[c]) / extent[c] : 0.0f;
+                words[c] = static_cast<uint16_t>(std::lround(std::clamp(unit, 0.0f, 1.0f) * max16));
+            }
+        }
+        reduced.words.insert(reduced.words.end(), words, words + 3);
+    }
+    reduced.track.key_count = static_cast<uint32_t>(reduced.times.size());
+    return reduced;
+}
+
+// Largest deviation of the cooked track from the source, at every source key
+// and halfway between keys.
+float measure_track(const ReducedTrack& reduced, float duration) {
+    CompressedClip clip;
+    clip.duration = duration;
+    clip.tracks.push_back(reduced.track);
+    clip.tracks[0].first_key = 0;
+    clip.times = reduced.times;
+    clip.words = reduced.words;
+    const SourceTrack& source = *reduced.source;
+    float maxError = 0.0f;
+    auto measure = [&](float time) {
+        maxError = std::max(maxError, value_error(source.channel->path, clip.evaluate(0, time), source.channel->evaluate(time)));
+    };
+    for (size_t k = 0; k < source.times.size(); ++k) {
+        measure(source.times[k]);
+        if (k + 1 < source.times.size()) measure(0.5f * (source.times[k] + source.times[k + 1]));
+    }
+    return maxError;
+}
+
+// Reduces with the full tolerance first and tightens it while the measured
+// error exceeds the bound. Cubic tracks that still miss it with every key
+// kept are resampled at a higher rate; source is replaced in that case.
+ReducedTrack cook_track(SourceTrack& source, float duration, const AnimationCompressionSettings& settings) {
+    const AnimationChannel& channel = *source.channel;
+    const float bound = error_bound(channel.path, settings);
+    float sampleRate = settings.cubic_sample_rate;
+    for (int doubling = 0;; ++doubling) {
+        float tightening = 1.0f;
+        for (int attempt = 0; attempt <= max_tightening + 1; ++attempt) {
+            ReducedTrack reduced = reduce_track(source, duration, settings, tightening);
+            reduced.track.max_error = measure_track(reduced, duration);
+            if (reduced.track.max_error <= bound) return reduced;
+            if (tightening == 0.0f) break;
+            tightening = attempt < max_tightening ? tightening * 0.5f : 0.0f;
+        }
+        if (channel.interpolation != AnimationChannel::Interpolation::cubic || doubling == max_resample_doublings) break;
+        sampleRate *= 2.0f;
+        source = gather_source(channel, sampleRate);
+    }
+    // Every key is kept, so what remains is quantization: the track's range
+    // or the clip's duration is too wide for 16 bits at this bound.
+    throw std::runtime_error("AnimationCooker: joint " + std::to_string(channel.joint) +
+                             " track exceeds its error bound even with every key kept");
+}
+}
+
+CompressedClip AnimationCooker::compress(const Skeleton& skeleton, const AnimationClip& clip,
+                                         const AnimationCompressionSettings& settings) {
+    std::vector<SourceTrack> sources;
+    sources.reserve(clip.channels.size());
+    for (const AnimationChannel& channel : clip.channels) {
+        if (channel.times.empty() || channel.joint >= skeleton.joint_count()) continue;
+        SourceTrack source = gather_source(channel, settings.cubic_sample_rate);
+        glm::vec4 rest = rest_value(skeleton, channel.joint, channel.path);
+        float bound = error_bound(channel.path, settings);
+        bool atRest = std::all_of(source.values.begin(), source.values.end(), [&](const glm::vec4& value) {
+            return value_error(channel.path, value, rest) <= bound;
+        });
+        if (!atRest) sources.push_back(std::move(source));
+    }
+    std::vector<ReducedTrack> reduced;
+    reduced.reserve(sources.size());
+    for (SourceTrack& source : sources) reduced.push_back(cook_track(source, clip.duration, settings));
+    std::stable_sort(reduced.begin(), reduced.end(), [](const ReducedTrack& a, const ReducedTrack& b) {
+        return a.track.joint != b.track.joint ? a.track.joint < b.track.joint : a.track.path < b.track.path;
+    });
+
+    CompressedClip out;
+    out.name = clip.name;
+    out.duration = clip.duration;
+    out.morph_weights = clip.morph_weights;
+    for (ReducedTrack& track : reduced) {
+        track.track.first_key = static_cast<uint32_t>(out.times.size());
+        out.times.insert(out.times.end(), track.times.begin(), track.times.end());
+        out.words.insert(out.words.end(), track.words.begin(), track.words.end());
+        out.tracks.push_back(track.track);
+    }
+    return out;
+}
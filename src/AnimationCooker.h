@@ -0,0 +1,29 @@
+#pragma once
+#include "Animation.h"
+#include "CompressedClip.h"
+
+// Error bounds per track type. The cooked clip stays within them at every
+// source key (and, for cubic channels, at every resampled point).
+struct AnimationCompressionSettings {
+    float translation_error = 0.0005f;
+    // Radians.
+    float rotation_error = 0.0005f;
+    float scale_error = 0.0005f;
+    // Cubic splines are resampled at this rate (keys per second) before
+    // reduction, since the runtime only interpolates linearly.
+    float cubic_sample_rate = 30.0f;
+};
+
+// Offline processing of imported clips into the compact runtime format.
+class AnimationCooker {
+public:
+    // Drops tracks that never leave the skeleton's rest pose (the Animator
+    // starts every sample from it) and every key that linear interpolation of
+    // its neighbours reproduces within the bound, collapses constant tracks to
+    // one key, then quantizes what remains. Each track records the error
+    // actually measured; a track that exceeds its bound is reduced again with
+    // a tighter tolerance, down to keeping every key (cubic tracks are then
+    // resampled more densely). Throws std::runtime_error if it still does.
+    static CompressedClip compress(const Skeleton& skeleton, const AnimationClip& clip,
+                                   const AnimationCompressionSettings& settings = {});
+};
@@ -0,0 +1,80 @@
+#include "Animator.h"
+#include <algorithm>
+#include <cmath>
+#include "JobSystem.h"
+#include "Skinning.h"
+
+namespace {
+// Instances per batch; each one is a few microseconds of sampling and matrix work.
+constexpr size_t animation_batch = 8;
+}
+
+uint32_t Animator::add(const Skeleton& skeleton, const AnimationClip* clip, float startTime) {
+    Instance instance;
+    instance.skeleton = &skeleton;
+    instance.clip = clip;
+    instance.time = startTime;
+    instance.palette_offset = static_cast<uint32_t>(palettes_.size());
+    palettes_.resize(palettes_.size() + skeleton.joint_count(), glm::mat4(1.0f));
+    instances_.push_back(instance);
+    cursors_.emplace_back();
+    return static_cast<uint32_t>(instances_.size() - 1);
+}
+
+uint32_t Animator::add(const Skeleton& skeleton, const CompressedClip* clip, float startTime) {
+    uint32_t index = add(skeleton, static_cast<const AnimationClip*>(nullptr), startTime);
+    instances_[index].compressed = clip;
+    return index;
+}
+
+void Animator::clear() {
+    instances_.clear();
+    cursors_.clear();
+    palettes_.clear();
+    weights_.clear();
+}
+
+void Animator::set_morph_weights(uint32_t index, const std::vector<float>& weights) {
+    Instance& instance = instances_[index];
+    if (instance.weight_count == 0) {
+        instance.weight_offset = static_cast<uint32_t>(weights_.size());
+        instance.weight_count = static_cast<uint32_t>(weights.size());
+        weights_.resize(weights_.size() + weights.size(), 0.0f);
+    }
+    std::copy_n(weights.begin(), std::min<size_t>(weights.size(), instance.weight_count), weights_.begin() + instance.weight_offset);
+}
+
+void Animator::update(float dt) {
+    JobSystem::shared().parallel_for(instances_.size(), animation_batch, [&](size_t begin, size_t end) {
+        // Per-thread scratch, reused across batches and frames.
+        thread_local std::vector<JointPose> pose;
+        thread_local std::vector<glm::mat4> globals;
+        for (size_t i = begin; i < end; ++i) {
+            Instance& instance = instances_[i];
+            const Skeleton& skeleton = *instance.skeleton;
+            pose.assign(skeleton.rest_pose.begin(), skeleton.rest_pose.end());
+            globals.resize(skeleton.joint_count());
+            if (instance.clip || instance.compressed) {
+                instance.time += dt * instance.speed;
+                float duration = instance.clip ? instance.clip->duration : instance.compressed->duration;
+                if (duration > 0.0f && instance.loop) {
+                    instance.time = std::fmod(instance.time, duration);
+                    if (instance.time < 0.0f) instance.time += duration;
+                } else {
+                    // Played backwards, a one-shot clip holds its first frame.
+                    instance.time = std::clamp(instance.time, 0.0f, duration);
+                }
+                const MorphWeightChannel* morphWeights;
+                if (instance.clip) {
+                    instance.clip->sample(instance.time, pose.data());
+                    morphWeights = &instance.clip->morph_weights;
+                } else {
+                    instance.compressed->sample(instance.time, pose.data(), &cursors_[i]);
+                    morphWeights = &instance.compressed->morph_weights;
+                }
+                if (instance.weight_count > 0) morphWeights->evaluate(instance.time, weights_.data() + instance.weight_offset, instance.weight_count);
+            }
+            compute_skin_palette(skeleton, pose.data(), globals.data(), palettes_.data() + instance.palette_offset);
+        }
+    });
+}
@@ -0,0 +1,52 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+#include <glm/glm.hpp>
+#include "Animation.h"
+#include "CompressedClip.h"
+
+// Plays clips on many skeleton instances. update() advances every instance,
+// samples its clip and rebuilds its skinning palette, with instances spread
+// over the shared JobSystem. Palettes of all instances sit back to back in one
+// array, ready to hand to skin_vertices() or to upload as a whole.
+class Animator {
+public:
+    struct Instance {
+        const Skeleton* skeleton = nullptr;
+        // Null holds the rest pose. At most one of clip and compressed is set.
+        const AnimationClip* clip = nullptr;
+        const CompressedClip* compressed = nullptr;
+        float time = 0.0f;
+        float speed = 1.0f;
+        bool loop = true;
+        uint32_t palette_offset = 0;
+        // Range in the morph weight array; empty until set_morph_weights.
+        uint32_t weight_offset = 0;
+        uint32_t weight_count = 0;
+    };
+
+    // skeleton and clip must outlive the animator.
+    uint32_t add(const Skeleton& skeleton, const AnimationClip* clip = nullptr, float startTime = 0.0f);
+    uint32_t add(const Skeleton& skeleton, const CompressedClip* clip, float startTime = 0.0f);
+    void clear();
+    Instance& instance(uint32_t index) { return instances_[index]; }
+    size_t size() const { return instances_.size(); }
+
+    // Gives an instance morph target weights (first call sizes them). The
+    // clip overwrites them on update when it animates weights; otherwise they
+    // keep whatever is written through morph_weights().
+    void set_morph_weights(uint32_t index, const std::vector<float>& weights);
+    float* morph_weights(uint32_t index) { return weights_.data() + instances_[index].weight_offset; }
+
+    void update(float dt);
+
+    const std::vector<glm::mat4>& palettes() const { return palettes_; }
+    const glm::mat4* palette(uint32_t index) const { return palettes_.data() + instances_[index].palette_offset; }
+
+private:
+    std::vector<Instance> instances_;
+    // Parallel to instances_; key positions for compressed clips.
+    std::vector<ClipCursor> cursors_;
+    std::vector<glm::mat4> palettes_;
+    std::vector<float> weights_;
+};
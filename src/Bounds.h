@@ -0,0 +1,39 @@
+#pragma once
+#include <cfloat>
+#include <glm/glm.hpp>
+
+// Axis-aligned bounding box. Default constructed boxes are empty and become
+// valid after the first expand().
+struct Aabb {
+    glm::vec3 min{FLT_MAX};
+    glm::vec3 max{-FLT_MAX};
+
+    bool valid() const { return min.x <= max.x && min.y <= max.y && min.z <= max.z; }
+    glm::vec3 center() const { return (min + max) * 0.5f; }
+    glm::vec3 extent() const { return (max - min) * 0.5f; }
+
+    void expand(const glm::vec3& p) {
+        min = glm::min(min, p);
+        max = glm::max(max, p);
+    }
+    void expand(const Aabb& other) {
+        if (!other.valid()) return;
+        min = glm::min(min, other.min);
+        max = glm::max(max, other.max);
+    }
+
+    // Bounds of this box after an affine transform (Arvo's method).
+    Aabb transformed(const glm::mat4& m) const {
+        if (!valid()) return *this;
+        glm::vec3 c = glm::vec3(m * glm::vec4(center(), 1.0f));
+        glm::vec3 e = extent();
+        glm::vec3 r;
+        for (int i = 0; i < 3; ++i) {
+            r[i] = glm::abs(m[0][i]) * e.x + glm::abs(m[1][i]) * e.y + glm::abs(m[2][i]) * e.z;
+        }
+        Aabb out;
+        out.min = c - r;
+        out.max = c + r;
+        return out;
+    }
+};
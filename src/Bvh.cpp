@@ -0,0 +1,405 @@
+#include "Bvh.h"
+#include <algorithm>
+#include <cmath>
+#include "JobSystem.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || defined(_M_AMD64)
+#include <emmintrin.h>
+#define BVH_USE_SSE 1
+#endif
+
+namespace {
+constexpr uint32_t bin_count = 16;
+// Ranges this small are handed to one job each; above it the top of the
+// tree is split serially so the jobs have something to share.
+constexpr uint32_t parallel_subtree_size = 4096;
+// Keeps traversal stacks at a fixed size.
+constexpr uint32_t max_depth = 60;
+constexpr uint32_t stack_size = 64;
+// SAH cost of visiting a node, relative to testing one primitive.
+constexpr float traversal_cost = 1.0f;
+
+float half_area(const Aabb& box) {
+    glm::vec3 d = box.max - box.min;
+    return d.x * d.y + d.y * d.z + d.z * d.x;
+}
+
+struct Subtree {
+    uint32_t node;
+    uint32_t begin, end;
+    uint32_t depth;
+};
+
+class Builder {
+public:
+    Builder(const std::vector<Aabb>& bounds, uint32_t maxLeafSize, std::vector<uint32_t>& order)
+        : bounds_(bounds), max_leaf_size_(maxLeafSize), order_(order) {
+        centroids_.resize(bounds.size());
+        for (size_t i = 0; i < bounds.size(); ++i) centroids_[i] = bounds[i].center();
+    }
+
+    // Builds [begin, end) into nodes[node]. With deferred set, ranges of up to
+    // parallel_subtree_size primitives are recorded there instead of built.
+    void build(std::vector<BvhNode>& nodes, uint32_t node, uint32_t begin, uint32_t end, uint32_t depth,
+               std::vector<Subtree>* deferred) const {
+        Aabb box;
+        for (uint32_t i = begin; i < end; ++i) box.expand(bounds_[order_[i]]);
+        nodes[node].min = box.min;
+        nodes[node].max = box.max;
+        if (deferred && end - begin <= parallel_subtree_size) {
+            deferred->push_back({node, begin, end, depth});
+            return;
+        }
+        uint32_t mid = depth < max_depth ? split(box, begin, end) : begin;
+        if (mid == begin) {
+            nodes[node].first = begin;
+            nodes[node].count = end - begin;
+            return;
+        }
+        uint32_t left = static_cast<uint32_t>(nodes.size());
+        nodes.resize(nodes.size() + 2);
+        nodes[node].first = left;
+        nodes[node].count = 0;
+        build(nodes, left, begin, mid, depth + 1, deferred);
+        build(nodes, left + 1, mid, end, depth + 1, deferred);
+    }
+
+private:
+    // Partitions [begin, end) at the cheapest binned SAH plane and returns the
+    // split point, or begin when a leaf is cheaper.
+    uint32_t split(const Aabb& box, uint32_t begin, uint32_t end) const {
+        uint32_t count = end - begin;
+        if (count <= 1) return begin;
+        Aabb centroidBox;
+        for (uint32_t i = begin; i < end; ++i) centroidBox.expand(centroids_[order_[i]]);
+        glm::vec3 size = centroidBox.max - centroidBox.min;
+
+        float bestCost = FLT_MAX;
+        int bestAxis = -1;
+        uint32_t bestBin = 0;
+        for (int axis = 0; axis < 3; ++axis) {
+            if (size[axis] <= 0.0f) continue;
+            Aabb binBox[bin_count];
+            uint32_t binCount[bin_count] = {};
+            float scale = bin_count / size[axis];
+            for (uint32_t i = begin; i < end; ++i) {
+                uint32_t b = bin_of(centroids_[order_[i]][axis], centroidBox.min[axis], scale);
+                binBox[b].expand(bounds_[order_[i]]);
+                ++binCount[b];
+            }
+            // Sweep from the right to get the cost of every right side, then
+            // from the left to combine.
+            float rightArea[bin_count];
+            uint32_t rightCount[bin_count];
+            Aabb acc;
+            uint32_t n = 0;
+            for (uint32_t b = bin_count - 1; b > 0; --b) {
+                acc.expand(binBox[b]);
+                n += binCount[b];
+                rightArea[b] = acc.valid() ? half_area(acc) : 0.0f;
+                rightCount[b] = n;
+            }
+            acc = Aabb{};
+            n = 0;
+            for (uint32_t b = 1; b < bin_count; ++b) {
+                acc.expand(binBox[b - 1]);
+                n += binCount[b - 1];
+                if (n == 0 || rightCount[b] == 0) continue;
+                float cost = half_area(acc) * n + rightArea[b] * rightCount[b];
+                if (cost < bestCost) {
+                    bestCost = cost;
+                    bestAxis = axis;
+                    bestBin = b;
+                }
+            }
+        }
+
+        float area = half_area(box);
+        float leafCost = static_cast<float>(count);
+        float splitCost = bestAxis >= 0 && area > 0.0f ? traversal_cost + bestCost / area : FLT_MAX;
+        if (splitCost >= leafCost && count <= max_leaf_size_) return begin;
+
+        uint32_t* first = order_.data() + begin;
+        uint32_t* last = order_.data() + end;
+        uint32_t* middle = first;
+        if (bestAxis >= 0) {
+            float scale = bin_count / size[bestAxis];
+            float lo = centroidBox.min[bestAxis];
+            middle = std::partition(first, last, [&](uint32_t p) {
+                return bin_of(centroids_[p][bestAxis], lo, scale) < bestBin;
+            });
+        }
+        if (middle == first || middle == last) {
+            // Coincident centroids: any split is as good as another.
+            middle = first + count / 2;
+        }
+        return static_cast<uint32_t>(middle - order_.data());
+    }
+
+    static uint32_t bin_of(float c, float lo, float scale) {
+        return std::min(static_cast<uint32_t>((c - lo) * scale), bin_count - 1);
+    }
+
+    const std::vector<Aabb>& bounds_;
+    std::vector<glm::vec3> centroids_;
+    uint32_t max_leaf_size_;
+    std::vector<uint32_t>& order_;
+};
+
+glm::vec3 position(const Vertex& v) {
+    return glm::vec3(v.pos[0], v.pos[1], v.pos[2]);
+}
+}
+
+glm::vec3 ray_inverse_direction(const glm::vec3& direction) {
+    glm::vec3 inv;
+    for (int i = 0; i < 3; ++i) {
+        float d = direction[i];
+        inv[i] = 1.0f / (std::abs(d) > 1e-20f ? d : std::copysign(1e-20f, d));
+    }
+    return inv;
+}
+
+float intersect_node(const BvhNode& node, const glm::vec3& origin, const glm::vec3& invDir, float tMax) {
+    glm::vec3 t0 = (node.min - origin) * invDir;
+    glm::vec3 t1 = (node.max - origin) * invDir;
+    glm::vec3 lo = glm::min(t0, t1);
+    glm::vec3 hi = glm::max(t0, t1);
+    float enter = std::max(std::max(lo.x, lo.y), std::max(lo.z, 0.0f));
+    float exit = std::min(std::min(hi.x, hi.y), std::min(hi.z, tMax));
+    return enter <= exit ? enter : FLT_MAX;
+}
+
+void build_bvh(const std::vector<Aabb>& bounds, uint32_t maxLeafSize, std::vector<BvhNode>& nodes,
+               std::vector<uint32_t>& order) {
+    nodes.clear();
+    order.resize(bounds.size());
+    for (uint32_t i = 0; i < order.size(); ++i) order[i] = i;
+    if (bounds.empty()) return;
+
+    Builder builder(bounds, maxLeafSize, order);
+    nodes.resize(1);
+    std::vector<Subtree> subtrees;
+    builder.build(nodes, 0, 0, static_cast<uint32_t>(bounds.size()), 0, &subtrees);
+
+    // Subtrees touch disjoint ranges of order; each builds into its own node
+    // array, rooted at 0, which is spliced in below.
+    std::vector<std::vector<BvhNode>> local(subtrees.size());
+    JobSystem::shared().parallel_for(subtrees.size(), 1, [&](size_t begin, size_t end) {
+        for (size_t s = begin; s < end; ++s) {
+            local[s].reserve(2 * (subtrees[s].end - subtrees[s].begin) / std::max(maxLeafSize, 1u) + 1);
+            local[s].resize(1);
+            builder.build(local[s], 0, subtrees[s].begin, subtrees[s].end, subtrees[s].depth, nullptr);
+        }
+    });
+    for (size_t s = 0; s < subtrees.size(); ++s) {
+        // Local node i > 0 lands at base + i - 1; the root replaces the placeholder.
+        uint32_t base = static_cast<uint32_t>(nodes.size());
+        for (size_t i = 0; i < local[s].size(); ++i) {
+            BvhNode node = local[s][i];
+            if (!node.leaf()) node.first += base - 1;
+            if (i == 0) {
+                nodes[subtrees[s].node] = node;
+            } else {
+                nodes.push_back(node);
+            }
+        }
+    }
+}
+
+void RayPacket::set(uint32_t lane, const Ray& ray) {
+    for (int a = 0; a < 3; ++a) {
+        origin[a][lane] = ray.origin[a];
+        direction[a][lane] = ray.direction[a];
+    }
+    t_max[lane] = ray.t_max;
+}
+
+Ray RayPacket::ray(uint32_t lane) const {
+    Ray ray;
+    ray.origin = {origin[0][lane], origin[1][lane], origin[2][lane]};
+    ray.direction = {direction[0][lane], direction[1][lane], direction[2][lane]};
+    ray.t_max = t_max[lane];
+    return ray;
+}
+
+TriangleBvh::TriangleBvh(const std::vector<Vertex>& vertices, const uint32_t* indices, size_t indexCount) {
+    size_t triangleCount = indexCount / 3;
+    std::vector<Aabb> bounds(triangleCount);
+    for (size_t t = 0; t < triangleCount; ++t) {
+        for (int k = 0; k < 3; ++k) bounds[t].expand(position(vertices[indices[t * 3 + k]]));
+    }
+    std::vector<uint32_t> order;
+    build_bvh(bounds, 4, nodes_, order);
+
+    triangles_.resize(triangleCount);
+    for (size_t i = 0; i < triangleCount; ++i) {
+        const uint32_t* tri = indices + order[i] * 3;
+        glm::vec3 v0 = position(vertices[tri[0]]);
+        triangles_[i] = {v0, position(vertices[tri[1]]) - v0, position(vertices[tri[2]]) - v0, order[i]};
+    }
+    if (!nodes_.empty()) {
+        bounds_.min = nodes_[0].min;
+        bounds_.max = nodes_[0].max;
+    }
+}
+
+bool TriangleBvh::intersect(const Ray& ray, RayHit& hit) const {
+    if (nodes_.empty()) return false;
+    glm::vec3 invDir = ray_inverse_direction(ray.direction);
+    float tMax = std::min(ray.t_max, hit.t);
+    if (intersect_node(nodes_[0], ray.origin, invDir, tMax) == FLT_MAX) return false;
+
+    bool found = false;
+    uint32_t stack[stack_size];
+    uint32_t top = 0;
+    uint32_t index = 0;
+    for (;;) {
+        const BvhNode& node = nodes_[index];
+        if (node.leaf()) {
+            for (uint32_t i = node.first; i < node.first + node.count; ++i) {
+                // Moller-Trumbore.
+                const Triangle& tri = triangles_[i];
+                glm::vec3 p = glm::cross(ray.direction, tri.e2);
+                float det = glm::dot(tri.e1, p);
+                if (std::abs(det) < 1e-12f) continue;
+                float invDet = 1.0f / det;
+                glm::vec3 s = ray.origin - tri.v0;
+                float u = glm::dot(s, p) * invDet;
+                if (u < 0.0f || u > 1.0f) continue;
+                glm::vec3 q = glm::cross(s, tri.e1);
+                float v = glm::dot(ray.direction, q) * invDet;
+                if (v < 0.0f || u + v > 1.0f) continue;
+                float t = glm::dot(tri.e2, q) * invDet;
+                if (t <= 0.0f || t >= tMax) continue;
+                tMax = t;
+                hit.t = t;
+                hit.u = u;
+                hit.v = v;
+                hit.triangle = tri.index;
+                found = true;
+            }
+        } else {
+            float tLeft = intersect_node(nodes_[node.first], ray.origin, invDir, tMax);
+            float tRight = intersect_node(nodes_[node.first + 1], ray.origin, invDir, tMax);
+            uint32_t nearChild = node.first, farChild = node.first + 1;
+            if (tRight < tLeft) {
+                std::swap(tLeft, tRight);
+                std::swap(nearChild, farChild);
+            }
+            if (tLeft != FLT_MAX) {
+                if (tRight != FLT_MAX) stack[top++] = farChild;
+                index = nearChild;
+                continue;
+            }
+        }
+        // Pop, skipping nodes that a closer hit found since has ruled out.
+        for (;;) {
+            if (top == 0) return found;
+            index = stack[--top];
+            if (intersect_node(nodes_[index], ray.origin, invDir, tMax) != FLT_MAX) break;
+        }
+    }
+}
+
+void TriangleBvh::intersect(const RayPacket& packet, RayHit hits[4]) const {
+#if BVH_USE_SSE
+    if (nodes_.empty()) return;
+    __m128 origin[3], dir[3], invDir[3];
+    glm::vec3 dirSum(0.0f);
+    for (int a = 0; a < 3; ++a) {
+        origin[a] = _mm_load_ps(packet.origin[a]);
+        dir[a] = _mm_load_ps(packet.direction[a]);
+        dirSum[a] = packet.direction[a][0] + packet.direction[a][1] + packet.direction[a][2] + packet.direction[a][3];
+    }
+    alignas(16) float inv[3][4];
+    for (int l = 0; l < 4; ++l) {
+        glm::vec3 laneInv = ray_inverse_direction(packet.ray(l).direction);
+        for (int a = 0; a < 3; ++a) inv[a][l] = laneInv[a];
+    }
+    for (int a = 0; a < 3; ++a) invDir[a] = _mm_load_ps(inv[a]);
+    alignas(16) float tMaxLanes[4];
+    for (int l = 0; l < 4; ++l) tMaxLanes[l] = std::min(packet.t_max[l], hits[l].t);
+    __m128 tMax = _mm_load_ps(tMaxLanes);
+    // Inactive lanes never pass the slab test.
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 one = _mm_set1_ps(1.0f);
+
+    auto slab = [&](const BvhNode& node) {
+        __m128 enter = zero, exit = tMax;
+        for (int a = 0; a < 3; ++a) {
+            __m128 t0 = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(node.min[a]), origin[a]), invDir[a]);
+            __m128 t1 = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(node.max[a]), origin[a]), invDir[a]);
+            enter = _mm_max_ps(enter, _mm_min_ps(t0, t1));
+            exit = _mm_min_ps(exit, _mm_max_ps(t0, t1));
+        }
+        return _mm_movemask_ps(_mm_cmple_ps(enter, exit)) & _mm_movemask_ps(_mm_cmpgt_ps(tMax, zero));
+    };
+
+    uint32_t stack[stack_size];
+    uint32_t top = 0;
+    stack[top++] = 0;
+    while (top > 0) {
+        const BvhNode& node = nodes_[stack[--top]];
+        if (!slab(node)) continue;
+        if (!node.leaf()) {
+            // Descend first into the child nearer along the packet's mean direction.
+            glm::vec3 leftCenter = nodes_[node.first].min + nodes_[node.first].max;
+            glm::vec3 rightCenter = nodes_[node.first + 1].min + nodes_[node.first + 1].max;
+            bool leftFirst = glm::dot(leftCenter - rightCenter, dirSum) <= 0.0f;
+            stack[top++] = leftFirst ? node.first + 1 : node.first;
+            stack[top++] = leftFirst ? node.first : node.first + 1;
+            continue;
+        }
+        for (uint32_t i = node.first; i < node.first + node.count; ++i) {
+            const Triangle& tri = triangles_[i];
+            __m128 e1[3], e2[3], s[3], p[3], q[3];
+            for (int a = 0; a < 3; ++a) {
+                e1[a] = _mm_set1_ps(tri.e1[a]);
+                e2[a] = _mm_set1_ps(tri.e2[a]);
+                s[a] = _mm_sub_ps(origin[a], _mm_set1_ps(tri.v0[a]));
+            }
+            auto cross = [](const __m128* x, const __m128* y, __m128* out) {
+                out[0] = _mm_sub_ps(_mm_mul_ps(x[1], y[2]), _mm_mul_ps(x[2], y[1]));
+                out[1] = _mm_sub_ps(_mm_mul_ps(x[2], y[0]), _mm_mul_ps(x[0], y[2]));
+                out[2] = _mm_sub_ps(_mm_mul_ps(x[0], y[1]), _mm_mul_ps(x[1], y[0]));
+            };
+            auto dot = [](const __m128* x, const __m128* y) {
+                return _mm_add_ps(_mm_add_ps(_mm_mul_ps(x[0], y[0]), _mm_mul_ps(x[1], y[1])), _mm_mul_ps(x[2], y[2]));
+            };
+            cross(dir, e2, p);
+            __m128 det = dot(e1, p);
+            __m128 invDet = _mm_div_ps(one, det);
+            __m128 u = _mm_mul_ps(dot(s, p), invDet);
+            cross(s, e1, q);
+            __m128 v = _mm_mul_ps(dot(dir, q), invDet);
+            __m128 t = _mm_mul_ps(dot(e2, q), invDet);
+            __m128 absDet = _mm_andnot_ps(_mm_set1_ps(-0.0f), det);
+            __m128 mask = _mm_cmpge_ps(absDet, _mm_set1_ps(1e-12f));
+            mask = _mm_and_ps(mask, _mm_cmpge_ps(u, zero));
+            mask = _mm_and_ps(mask, _mm_cmpge_ps(v, zero));
+            mask = _mm_and_ps(mask, _mm_cmple_ps(_mm_add_ps(u, v), one));
+            mask = _mm_and_ps(mask, _mm_cmpgt_ps(t, zero));
+            mask = _mm_and_ps(mask, _mm_cmplt_ps(t, tMax));
+            int lanes = _mm_movemask_ps(mask);
+            if (!lanes) continue;
+            tMax = _mm_or_ps(_mm_and_ps(mask, t), _mm_andnot_ps(mask, tMax));
+            alignas(16) float tv[4], uv[4], vv[4];
+            _mm_store_ps(tv, t);
+            _mm_store_ps(uv, u);
+            _mm_store_ps(vv, v);
+            for (int l = 0; l < 4; ++l) {
+                if (!(lanes & (1 << l))) continue;
+                hits[l].t = tv[l];
+                hits[l].u = uv[l];
+                hits[l].v = vv[l];
+                hits[l].triangle = tri.index;
+            }
+        }
+    }
+#else
+    for (uint32_t l = 0; l < 4; ++l) {
+        if (packet.t_max[l] > 0.0f) intersect(packet.ray(l), hits[l]);
+    }
+#endif
+}
@@ -0,0 +1,86 @@
+#pragma once
+#include <cfloat>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include <glm/glm.hpp>
+#include "Bounds.h"
+#include "Ray.h"
+#include "Vertex.h"
+
+struct RayHit {
+    float t = FLT_MAX;
+    // Barycentrics of the hit on the triangle (weights of its 2nd and 3rd vertex).
+    float u = 0.0f, v = 0.0f;
+    // Index of the triangle in the source index buffer, or UINT32_MAX on a miss.
+    uint32_t triangle = UINT32_MAX;
+    // Instance in a SceneBvh, UINT32_MAX for a TriangleBvh query.
+    uint32_t instance = UINT32_MAX;
+
+    bool hit() const { return triangle != UINT32_MAX; }
+};
+
+// Four rays in SoA layout, traversed together. Coherent rays (camera rays
+// through neighbouring pixels, picking) share most nodes, so each node test
+// costs one SIMD slab test instead of four.
+struct RayPacket {
+    alignas(16) float origin[3][4];
+    alignas(16) float direction[3][4];
+    alignas(16) float t_max[4];
+
+    void set(uint32_t lane, const Ray& ray);
+    Ray ray(uint32_t lane) const;
+};
+
+// 32-byte node. Interior nodes have count 0 and their children at first and
+// first + 1; leaves cover primitives [first, first + count) of the build order.
+struct BvhNode {
+    glm::vec3 min;
+    uint32_t first;
+    glm::vec3 max;
+    uint32_t count;
+
+    bool leaf() const { return count > 0; }
+};
+
+// Binned SAH build over primitive bounds. nodes[0] is the root; order maps
+// leaf ranges back to primitives. Subtrees below the top levels are built on
+// the shared JobSystem.
+void build_bvh(const std::vector<Aabb>& bounds, uint32_t maxLeafSize, std::vector<BvhNode>& nodes,
+               std::vector<uint32_t>& order);
+
+// Reciprocal of a ray direction with zero components nudged off zero, so
+// slab tests stay finite.
+glm::vec3 ray_inverse_direction(const glm::vec3& direction);
+// Entry distance of a ray into node's box within [0, tMax], or FLT_MAX on a miss.
+float intersect_node(const BvhNode& node, const glm::vec3& origin, const glm::vec3& invDir, float tMax);
+
+// Triangle BVH of one mesh in object space (the bottom level). Triangles are
+// copied in leaf order so leaves read contiguous memory.
+class TriangleBvh {
+public:
+    TriangleBvh() = default;
+    // Indexes the first indexCount indices (e.g. LOD 0 of a cooked mesh).
+    TriangleBvh(const std::vector<Vertex>& vertices, const uint32_t* indices, size_t indexCount);
+
+    // Closest hit with t < ray.t_max (and < hit.t). Returns whether it improved hit.
+    bool intersect(const Ray& ray, RayHit& hit) const;
+    // Per-lane closest hits; lanes with t_max <= 0 are inactive.
+    void intersect(const RayPacket& packet, RayHit hits[4]) const;
+
+    const Aabb& bounds() const { return bounds_; }
+    size_t triangle_count() const { return triangles_.size(); }
+    const std::vector<BvhNode>& nodes() const { return nodes_; }
+    size_t byte_size() const { return nodes_.size() * sizeof(BvhNode) + triangles_.size() * sizeof(Triangle); }
+
+private:
+    // Pre-subtracted edges for Moller-Trumbore.
+    struct Triangle {
+        glm::vec3 v0, e1, e2;
+        uint32_t index;
+    };
+
+    std::vector<BvhNode> nodes_;
+    std::vector<Triangle> triangles_;
+    Aabb bounds_;
+};
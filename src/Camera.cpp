@@ -54,4 +54,15 @@ glm::mat4 Camera::get_projection_matrix() const {
 
 glm::mat4 Camera::get_view_projection_matrix() const {
     return get_projection_matrix() * get_view_matrix();
-} 
\ No newline at end of file
+} 
+
+Ray Camera::ray(float ndcX, float ndcY) const {
+    glm::mat4 inverse = glm::inverse(get_view_projection_matrix());
+    glm::vec4 nearPoint = inverse * glm::vec4(ndcX, ndcY, 0.0f, 1.0f);
+    glm::vec4 farPoint = inverse * glm::vec4(ndcX, ndcY, 1.0f, 1.0f);
+    Ray result;
+    result.origin = glm::vec3(nearPoint) / nearPoint.w;
+    result.direction = glm::vec3(farPoint) / farPoint.w - result.origin;
+    result.t_max = 1.0f;
+    return result;
+}
@@ -2,6 +2,7 @@
 #pragma once
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
+#include "Ray.h"
 
 class Camera {
 public:
@@ -16,9 +17,17 @@ public:
     void set_look_at(const glm::vec3& target);
     void set_up(const glm::vec3& up);
 
+    const glm::vec3& get_position() const { return position_; }
+    const glm::vec3& get_look_at() const { return look_at_; }
+    // Clip plane distances of the active projection.
+    float near_plane() const { return projection_type_ == ProjectionType::Perspective ? near_z_ : ortho_near_z_; }
+    float far_plane() const { return projection_type_ == ProjectionType::Perspective ? far_z_ : ortho_far_z_; }
     glm::mat4 get_view_matrix() const;
     glm::mat4 get_projection_matrix() const;
     glm::mat4 get_view_projection_matrix() const;
+    // Ray from the near to the far plane through a point in normalized device
+    // coordinates (Vulkan convention: y points down). t_max is 1 at the far plane.
+    Ray ray(float ndcX, float ndcY) const;
 
 private:
     ProjectionType projection_type_ = ProjectionType::Perspective;
@@ -0,0 +1,137 @@
+#include "CellArchive.h"
+#include <cstring>
+#include <fstream>
+
+namespace {
+constexpr uint32_t cell_magic = 0x4c4c4543; // "CELL"
+constexpr uint32_t cell_version = 1;
+
+template<typename T>
+void write_pod(std::ofstream& out, const T& value) {
+    out.write(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+
+template<typename T>
+void write_array(std::ofstream& out, const std::vector<T>& values) {
+    out.write(reinterpret_cast<const char*>(values.data()), static_cast<std::streamsize>(values.size() * sizeof(T)));
+}
+
+// Bounds-checked cursor over the file contents; a failed read sets ok to
+// false and leaves the output untouched.
+struct Reader {
+    const uint8_t* data;
+    size_t size;
+    size_t offset = 0;
+    bool ok = true;
+
+    template<typename T>
+    T read() {
+        T value{};
+        if (size - offset < sizeof(T)) {
+            ok = false;
+            return value;
+        }
+        std::memcpy(&value, data + offset, sizeof(T));
+        offset += sizeof(T);
+        return value;
+    }
+
+    template<typename T>
+    void read_array(std::vector<T>& values, uint64_t count) {
+        // Validate against the remaining bytes before allocating, so a
+        // corrupt count cannot ask for gigabytes.
+        if (count > (size - offset) / sizeof(T)) {
+            ok = false;
+            return;
+        }
+        values.resize(count);
+        std::memcpy(values.data(), data + offset, count * sizeof(T));
+        offset += count * sizeof(T);
+    }
+};
+}
+
+bool CellArchive::save(const std::string& path) const {
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    if (!out) return false;
+    write_pod(out, cell_magic);
+    write_pod(out, cell_version);
+    write_pod(out, static_cast<uint32_t>(meshes.size()));
+    write_pod(out, static_cast<uint32_t>(textures.size()));
+    write_pod(out, static_cast<uint32_t>(nodes.size()));
+    for (const CookedMesh& mesh : meshes) {
+        write_pod(out, static_cast<uint32_t>(mesh.vertices.size()));
+        write_pod(out, static_cast<uint32_t>(mesh.indices.size()));
+        write_pod(out, static_cast<uint32_t>(mesh.lods.size()));
+        write_array(out, mesh.vertices);
+        write_array(out, mesh.indices);
+        write_array(out, mesh.lods);
+    }
+    for (const CellTexture& texture : textures) {
+        write_pod(out, texture.width);
+        write_pod(out, texture.height);
+        write_array(out, texture.pixels);
+    }
+    write_array(out, nodes);
+    return static_cast<bool>(out);
+}
+
+bool CellArchive::load(const std::string& path) {
+    meshes.clear();
+    textures.clear();
+    nodes.clear();
+    std::ifstream file(path, std::ios::ate | std::ios::binary);
+    if (!file) return false;
+    std::vector<uint8_t> bytes(static_cast<size_t>(file.tellg()));
+    file.seekg(0);
+    file.read(reinterpret_cast<char*>(bytes.data()), static_cast<std::streamsize>(bytes.size()));
+    if (!file) return false;
+
+    Reader reader{bytes.data(), bytes.size()};
+    if (reader.read<uint32_t>() != cell_magic || reader.read<uint32_t>() != cell_version) return false;
+    uint32_t meshCount = reader.read<uint32_t>();
+    uint32_t textureCount = reader.read<uint32_t>();
+    uint32_t nodeCount = reader.read<uint32_t>();
+    for (uint32_t m = 0; m < meshCount && reader.ok; ++m) {
+        CookedMesh& mesh = meshes.emplace_back();
+        uint32_t vertexCount = reader.read<uint32_t>();
+        uint32_t indexCount = reader.read<uint32_t>();
+        uint32_t lodCount = reader.read<uint32_t>();
+        reader.read_array(mesh.vertices, vertexCount);
+        reader.read_array(mesh.indices, indexCount);
+        reader.read_array(mesh.lods, lodCount);
+        for (const MeshLod& lod : mesh.lods) {
+            if (static_cast<uint64_t>(lod.first_index) + lod.index_count > indexCount) reader.ok = false;
+        }
+        for (uint32_t index : mesh.indices) {
+            if (index >= vertexCount) reader.ok = false;
+        }
+        if (mesh.lods.empty()) reader.ok = false;
+    }
+    for (uint32_t t = 0; t < textureCount && reader.ok; ++t) {
+        CellTexture& texture = textures.emplace_back();
+        texture.width = reader.read<uint32_t>();
+        texture.height = reader.read<uint32_t>();
+        reader.read_array(texture.pixels, static_cast<uint64_t>(texture.width) * texture.height * 4);
+    }
+    if (reader.ok) reader.read_array(nodes, nodeCount);
+    for (size_t n = 0; n < nodes.size() && reader.ok; ++n) {
+        if (nodes[n].parent >= static_cast<int32_t>(n) || nodes[n].mesh >= static_cast<int32_t>(meshes.size())) reader.ok = false;
+    }
+    if (!reader.ok) {
+        meshes.clear();
+        textures.clear();
+        nodes.clear();
+    }
+    return reader.ok;
+}
+
+size_t CellArchive::byte_size() const {
+    size_t bytes = nodes.size() * sizeof(CellNode);
+    for (const CookedMesh& mesh : meshes) {
+        bytes += mesh.vertices.size() * sizeof(Vertex) + mesh.indices.size() * sizeof(uint32_t) +
+                 mesh.lods.size() * sizeof(MeshLod);
+    }
+    for (const CellTexture& texture : textures) bytes += texture.pixels.size();
+    return bytes;
+}
@@ -0,0 +1,42 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <glm/glm.hpp>
+#include "MeshCooker.h"
+
+// RGBA8 image carried by a cell.
+struct CellTexture {
+    uint32_t width = 0;
+    uint32_t height = 0;
+    std::vector<uint8_t> pixels;
+};
+
+// Scene node of a cell. Transforms are relative to the parent node, or to the
+// world for top-level nodes; parents come before their children.
+struct CellNode {
+    int32_t parent = -1;
+    // Into CellArchive::meshes, or -1 for a pure transform node.
+    int32_t mesh = -1;
+    uint32_t pipeline = 0;
+    uint32_t material = 0;
+    glm::vec3 position{0.0f};
+    glm::vec3 rotation{0.0f};
+    glm::vec3 scale{1.0f};
+};
+
+// Everything that lives in one spatial cell of a streamed world, in a flat
+// binary file that loads with a handful of bulk reads: cooked meshes (with
+// their LOD chains), textures and the node hierarchy placing them.
+struct CellArchive {
+    std::vector<CookedMesh> meshes;
+    std::vector<CellTexture> textures;
+    std::vector<CellNode> nodes;
+
+    // Both return false on I/O errors; load also rejects malformed files.
+    bool save(const std::string& path) const;
+    bool load(const std::string& path);
+    bool empty() const { return meshes.empty() && textures.empty() && nodes.empty(); }
+    size_t byte_size() const;
+};
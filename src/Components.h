@@ -0,0 +1,96 @@
+#pragma once
+#include <cstdint>
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include "Bounds.h"
+#include "ResourcePool.h"
+
+class Mesh;
+struct OccluderGeometry;
+
+// Meshes live in a pool owned by the renderer and are referenced by handle.
+using MeshHandle = Handle<Mesh>;
+using MeshPool = ResourcePool<Mesh>;
+
+// Index into the World's entity table plus a generation that is bumped when
+// the slot is reused, so stale handles are detected.
+struct Entity {
+    uint32_t index = UINT32_MAX;
+    uint32_t generation = 0;
+
+    bool valid() const { return index != UINT32_MAX; }
+    bool operator==(const Entity&) const = default;
+};
+
+// One bit per component in an archetype mask. Every component struct names its
+// ComponentType; the World's component table follows this order.
+enum class ComponentType : uint32_t {
+    local_transform,
+    parent,
+    world_transform,
+    mesh_ref,
+    world_bounds,
+    material,
+    occluder,
+    lod_state,
+};
+inline constexpr uint32_t component_type_count = 8;
+
+// Components are plain data: the World moves them between chunks with memcpy.
+
+struct LocalTransform {
+    static constexpr ComponentType type = ComponentType::local_transform;
+    glm::vec3 position{0.0f}, rotation{0.0f}, scale{1.0f, 1.0f, 1.0f};
+
+    glm::mat4 matrix() const {
+        glm::mat4 local = glm::translate(glm::mat4(1.0f), position);
+        // For simplicity, only Y rotation for now
+        local = glm::rotate(local, rotation.y, glm::vec3(0, 1, 0));
+        return glm::scale(local, scale);
+    }
+};
+
+// depth is the number of ancestors; transforms are resolved one depth at a time.
+struct Parent {
+    static constexpr ComponentType type = ComponentType::parent;
+    Entity entity;
+    uint32_t depth = 1;
+};
+
+struct WorldTransform {
+    static constexpr ComponentType type = ComponentType::world_transform;
+    glm::mat4 matrix{1.0f};
+};
+
+// Non-owning; whoever built the entity keeps the Mesh in the pool. A stale
+// handle makes the entity invisible.
+struct MeshRef {
+    static constexpr ComponentType type = ComponentType::mesh_ref;
+    MeshHandle mesh;
+};
+
+// World-space bounds of the MeshRef, refreshed with the transforms.
+struct WorldBounds {
+    static constexpr ComponentType type = ComponentType::world_bounds;
+    Aabb box;
+};
+
+// Indices into the renderer's pipeline and material (descriptor set) tables.
+struct MaterialRef {
+    static constexpr ComponentType type = ComponentType::material;
+    uint32_t pipeline = 0;
+    uint32_t material = 0;
+};
+
+// Non-owning low-poly stand-in for software occlusion culling.
+struct OccluderRef {
+    static constexpr ComponentType type = ComponentType::occluder;
+    const OccluderGeometry* geometry = nullptr;
+};
+
+// Mesh LOD picked last frame; selection only steps away from it past a
+// hysteresis margin.
+struct LodState {
+    static constexpr ComponentType type = ComponentType::lod_state;
+    uint32_t lod = 0;
+};
@@ -0,0 +1,124 @@
+#include "CompressedClip.h"
+#include <algorithm>
+#include <cmath>
+
+namespace {
+constexpr float quat_component_range = 0.70710678f; // 1/sqrt(2)
+constexpr float max15 = 32767.0f;
+constexpr float max16 = 65535.0f;
+
+glm::vec4 decode_key(const CompressedTrack& track, const uint16_t* words) {
+    if (track.path == AnimationChannel::Path::rotation) {
+        glm::quat q = decode_smallest_three(words);
+        return glm::vec4(q.x, q.y, q.z, q.w);
+    }
+    glm::vec4 v(0.0f);
+    for (int c = 0; c < 3; ++c) v[c] = track.range_min[c] + track.range_extent[c] * (words[c] / max16);
+    return v;
+}
+
+// Value between key and key + 1 at q (16-bit time units); rotations are not
+// renormalized yet.
+glm::vec4 evaluate_key(const CompressedClip& clip, const CompressedTrack& track, uint32_t key, float q) {
+    const uint16_t* keyTimes = clip.times.data() + track.first_key;
+    const uint16_t* words = clip.words.data() + (track.first_key + key) * 3;
+    glm::vec4 value = decode_key(track, words);
+    if (!track.step && key + 1 < track.key_count && q > keyTimes[key]) {
+        float alpha = (q - keyTimes[key]) / static_cast<float>(keyTimes[key + 1] - keyTimes[key]);
+        glm::vec4 next = decode_key(track, words + 3);
+        if (track.path == AnimationChannel::Path::rotation && glm::dot(value, next) < 0.0f) next = -next;
+        value += (next - value) * alpha;
+    }
+    return value;
+}
+
+uint32_t find_key(const CompressedClip& clip, const CompressedTrack& track, float q) {
+    const uint16_t* keyTimes = clip.times.data() + track.first_key;
+    auto it = std::upper_bound(keyTimes, keyTimes + track.key_count, q, [](float value, uint16_t k) { return value < k; });
+    uint32_t key = static_cast<uint32_t>(it - keyTimes);
+    return key > 0 ? key - 1 : 0;
+}
+}
+
+void encode_smallest_three(const glm::quat& q, uint16_t out[3]) {
+    float c[4] = {q.x, q.y, q.z, q.w};
+    int largest = 0;
+    for (int i = 1; i < 4; ++i) {
+        if (std::abs(c[i]) > std::abs(c[largest])) largest = i;
+    }
+    // q and -q are the same rotation; make the dropped component positive.
+    float sign = c[largest] < 0.0f ? -1.0f : 1.0f;
+    for (int i = 0, o = 0; i < 4; ++i) {
+        if (i == largest) continue;
+        float v = std::clamp(c[i] * sign, -quat_component_range, quat_component_range);
+        out[o++] = static_cast<uint16_t>(std::lround((v / quat_component_range * 0.5f + 0.5f) * max15));
+    }
+    out[0] |= static_cast<uint16_t>((largest & 1) << 15);
+    out[1] |= static_cast<uint16_t>((largest >> 1) << 15);
+}
+
+glm::quat decode_smallest_three(const uint16_t in[3]) {
+    int largest = (in[0] >> 15) | ((in[1] >> 15) << 1);
+    float c[4];
+    float sum = 0.0f;
+    for (int i = 0, o = 0; i < 4; ++i) {
+        if (i == largest) continue;
+        float v = ((in[o++] & 0x7fff) / max15 * 2.0f - 1.0f) * quat_component_range;
+        c[i] = v;
+        sum += v * v;
+    }
+    c[largest] = std::sqrt(std::max(0.0f, 1.0f - sum));
+    return glm::quat(c[3], c[0], c[1], c[2]);
+}
+
+float CompressedClip::key_units(float time) const {
+    return duration > 0.0f ? std::clamp(time / duration, 0.0f, 1.0f) * max16 : 0.0f;
+}
+
+glm::vec4 CompressedClip::evaluate(size_t track, float time) const {
+    const CompressedTrack& t = tracks[track];
+    if (t.key_count == 0) return glm::vec4(0.0f);
+    float q = key_units(time);
+    glm::vec4 value = evaluate_key(*this, t, find_key(*this, t, q), q);
+    return t.path == AnimationChannel::Path::rotation ? value / glm::length(value) : value;
+}
+
+void CompressedClip::sample(float time, JointPose* pose, ClipCursor* cursor) const {
+    if (cursor && cursor->size() != tracks.size()) cursor->assign(tracks.size(), 0);
+    float q = key_units(time);
+    for (size_t t = 0; t < tracks.size(); ++t) {
+        const CompressedTrack& track = tracks[t];
+        if (track.key_count == 0) continue;
+        uint32_t key;
+        if (cursor) {
+            const uint16_t* keyTimes = times.data() + track.first_key;
+            key = (*cursor)[t];
+            // Playback looped or jumped back: restart the scan.
+            if (key >= track.key_count || keyTimes[key] > q) key = 0;
+            while (key + 1 < track.key_count && keyTimes[key + 1] <= q) ++key;
+            (*cursor)[t] = key;
+        } else {
+            key = find_key(*this, track, q);
+        }
+        glm::vec4 value = evaluate_key(*this, track, key, q);
+        JointPose& joint = pose[track.joint];
+        switch (track.path) {
+        case AnimationChannel::Path::translation:
+            joint.translation = glm::vec3(value);
+            break;
+        case AnimationChannel::Path::scale:
+            joint.scale = glm::vec3(value);
+            break;
+        case AnimationChannel::Path::rotation:
+            value /= glm::length(value);
+            joint.rotation = glm::quat(value.w, value.x, value.y, value.z);
+            break;
+        }
+    }
+}
+
+size_t CompressedClip::byte_size() const {
+    return sizeof(*this) + name.size() + tracks.size() * sizeof(CompressedTrack) +
+           times.size() * sizeof(uint16_t) + words.size() * sizeof(uint16_t) +
+           (morph_weights.times.size() + morph_weights.values.size()) * sizeof(float);
+}
@@ -0,0 +1,58 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "Animation.h"
+
+// One compressed property track. Keys are 16-bit times (fractions of the
+// clip duration) plus three 16-bit words: translation and scale are
+// quantized inside the track's range, rotations use the smallest-three
+// encoding (the largest component is dropped and rebuilt from the unit
+// length, its index rides in the top bits of the first two words).
+struct CompressedTrack {
+    uint16_t joint = 0;
+    AnimationChannel::Path path = AnimationChannel::Path::translation;
+    bool step = false;
+    uint32_t key_count = 0;
+    // Into CompressedClip::times and CompressedClip::words (three per key).
+    uint32_t first_key = 0;
+    float range_min[3] = {0.0f, 0.0f, 0.0f};
+    float range_extent[3] = {0.0f, 0.0f, 0.0f};
+    // Largest deviation from the source measured when cooking, in units
+    // (translation, scale) or radians (rotation).
+    float max_error = 0.0f;
+};
+
+// Forward-scan position per track, so steadily advancing playback touches
+// each key once instead of searching. One cursor array per playing instance.
+using ClipCursor = std::vector<uint32_t>;
+
+// Animation clip in the cooked, quantized format (see AnimationCooker).
+// Tracks are sorted by joint and all keys live in two flat arrays, so a
+// sample streams through memory front to back.
+struct CompressedClip {
+    std::string name;
+    float duration = 0.0f;
+    std::vector<CompressedTrack> tracks;
+    std::vector<uint16_t> times;
+    std::vector<uint16_t> words;
+    // Copied from the source clip; weight curves are small next to joints.
+    MorphWeightChannel morph_weights;
+
+    // Same contract as AnimationClip::sample, except that tracks the cooker
+    // found to stay at rest are absent: pose should start from the rest pose.
+    // cursor is resized to the track count on first use; a null cursor falls
+    // back to binary search.
+    void sample(float time, JointPose* pose, ClipCursor* cursor = nullptr) const;
+    // One track's value at time as xyz(w), like AnimationChannel::evaluate.
+    glm::vec4 evaluate(size_t track, float time) const;
+    size_t byte_size() const;
+
+private:
+    float key_units(float time) const;
+};
+
+// Unit quaternion to three 16-bit words and back.
+void encode_smallest_three(const glm::quat& q, uint16_t out[3]);
+glm::quat decode_smallest_three(const uint16_t in[3]);
@@ -0,0 +1,96 @@
+#include "DeletionQueue.h"
+#include "GpuMemory.h"
+
+DeletionQueue::~DeletionQueue() {
+    flush();
+}
+
+void DeletionQueue::init(VkDevice device) {
+    device_ = device;
+}
+
+void DeletionQueue::set_serial(uint64_t serial) {
+    std::lock_guard lock(mutex_);
+    serial_ = serial;
+}
+
+uint64_t DeletionQueue::serial() const {
+    std::lock_guard lock(mutex_);
+    return serial_;
+}
+
+DeletionQueue::Batch& DeletionQueue::current() {
+    if (batches_.empty() || batches_.back().serial != serial_) batches_.emplace_back().serial = serial_;
+    ++pending_;
+    return batches_.back();
+}
+
+void DeletionQueue::destroy_buffer(VkBuffer buffer) {
+    if (buffer == VK_NULL_HANDLE) return;
+    std::lock_guard lock(mutex_);
+    current().buffers.push_back(buffer);
+}
+
+void DeletionQueue::free_memory(VkDeviceMemory memory) {
+    if (memory == VK_NULL_HANDLE) return;
+    std::lock_guard lock(mutex_);
+    current().memory.push_back(memory);
+}
+
+void DeletionQueue::destroy_image(VkImage image) {
+    if (image == VK_NULL_HANDLE) return;
+    std::lock_guard lock(mutex_);
+    current().images.push_back(image);
+}
+
+void DeletionQueue::destroy_image_view(VkImageView view) {
+    if (view == VK_NULL_HANDLE) return;
+    std::lock_guard lock(mutex_);
+    current().image_views.push_back(view);
+}
+
+void DeletionQueue::destroy(std::function<void()> fn) {
+    std::lock_guard lock(mutex_);
+    current().callbacks.push_back(std::move(fn));
+}
+
+void DeletionQueue::collect(uint64_t completedSerial) {
+    // Destroy outside the lock so releases from other threads never wait on
+    // the driver.
+    std::deque<Batch> ready;
+    {
+        std::lock_guard lock(mutex_);
+        while (!batches_.empty() && batches_.front().serial <= completedSerial) {
+            ready.push_back(std::move(batches_.front()));
+            batches_.pop_front();
+        }
+    }
+    for (Batch& batch : ready) release(batch);
+}
+
+void DeletionQueue::flush() {
+    std::deque<Batch> ready;
+    {
+        std::lock_guard lock(mutex_);
+        ready.swap(batches_);
+    }
+    for (Batch& batch : ready) release(batch);
+}
+
+size_t DeletionQueue::pending() const {
+    std::lock_guard lock(mutex_);
+    return pending_;
+}
+
+void DeletionQueue::release(Batch& batch) {
+    // Views before their images, buffers and images before their memory.
+    for (VkImageView view : batch.image_views) vkDestroyImageView(device_, view, nullptr);
+    for (VkImage image : batch.images) vkDestroyImage(device_, image, nullptr);
+    for (VkBuffer buffer : batch.buffers) vkDestroyBuffer(device_, buffer, nullptr);
+    for (VkDeviceMemory memory : batch.memory) GpuMemory::shared().free(device_, memory);
+    for (auto& fn : batch.callbacks) fn();
+    size_t count = batch.image_views.size() + batch.images.size() + batch.buffers.size() + batch.memory.size() +
+                   batch.callbacks.size();
+    std::lock_guard lock(mutex_);
+    pending_ -= count;
+}
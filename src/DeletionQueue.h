@@ -0,0 +1,59 @@
+#pragma once
+#include <vulkan/vulkan.h>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <vector>
+
+// GPU objects released while frames that may use them are still in flight.
+//
+// Everything queued is tagged with the current serial, the frame that will
+// be submitted next (it may still be recorded from draws gathered before the
+// release), and destroyed by collect() once that frame has retired. Objects
+// released during the same frame share one batch. Any thread may queue.
+class DeletionQueue {
+public:
+    DeletionQueue() = default;
+    ~DeletionQueue();
+    DeletionQueue(const DeletionQueue&) = delete;
+    DeletionQueue& operator=(const DeletionQueue&) = delete;
+
+    void init(VkDevice device);
+    // Called by the renderer after each submit.
+    void set_serial(uint64_t serial);
+    uint64_t serial() const;
+
+    void destroy_buffer(VkBuffer buffer);
+    void free_memory(VkDeviceMemory memory);
+    void destroy_image(VkImage image);
+    void destroy_image_view(VkImageView view);
+    // Anything else, e.g. objects that have to go together.
+    void destroy(std::function<void()> fn);
+
+    // Destroys the batches of frames up to completedSerial.
+    void collect(uint64_t completedSerial);
+    // Destroys everything: idle the device first.
+    void flush();
+    size_t pending() const;
+
+private:
+    struct Batch {
+        uint64_t serial = 0;
+        std::vector<VkImageView> image_views;
+        std::vector<VkImage> images;
+        std::vector<VkBuffer> buffers;
+        std::vector<VkDeviceMemory> memory;
+        std::vector<std::function<void()>> callbacks;
+    };
+
+    Batch& current();
+    void release(Batch& batch);
+
+    VkDevice device_ = VK_NULL_HANDLE;
+    mutable std::mutex mutex_;
+    std::deque<Batch> batches_;
+    uint64_t serial_ = 1;
+    size_t pending_ = 0;
+};
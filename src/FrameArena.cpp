@@ -0,0 +1,64 @@
+#include "FrameArena.h"
+#include <algorithm>
+#include <new>
+
+namespace {
+constexpr size_t block_alignment = alignof(std::max_align_t);
+
+size_t aligned_offset(const std::byte* base, size_t offset, size_t alignment) {
+    uintptr_t address = reinterpret_cast<uintptr_t>(base) + offset;
+    return offset + ((alignment - address % alignment) % alignment);
+}
+}
+
+FrameArena::FrameArena(size_t capacity) {
+    blocks_.reserve(8);
+    add_block(std::max<size_t>(capacity, 1));
+}
+
+FrameArena::~FrameArena() {
+    free_blocks();
+}
+
+void FrameArena::reset() {
+    stats_.peak = std::max(stats_.peak, stats_.used);
+    if (blocks_.size() > 1) {
+        // The frame spilled over: one block the size of all of them holds it.
+        size_t total = 0;
+        for (const Block& block : blocks_) total += block.size;
+        free_blocks();
+        add_block(total);
+    }
+    offset_ = 0;
+    stats_.used = 0;
+}
+
+void* FrameArena::do_allocate(size_t bytes, size_t alignment) {
+    bytes = std::max<size_t>(bytes, 1);
+    size_t start = aligned_offset(blocks_.back().data, offset_, alignment);
+    if (start + bytes > blocks_.back().size) {
+        // Room for the request at any alignment, and at least double the
+        // last block so a long frame needs few of them.
+        add_block(std::max(blocks_.back().size * 2, bytes + alignment));
+        start = aligned_offset(blocks_.back().data, 0, alignment);
+    }
+    stats_.used += start - offset_ + bytes;
+    offset_ = start + bytes;
+    return blocks_.back().data + start;
+}
+
+void FrameArena::add_block(size_t size) {
+    Block block;
+    block.data = static_cast<std::byte*>(::operator new(size, std::align_val_t(block_alignment)));
+    block.size = size;
+    blocks_.push_back(block);
+    offset_ = 0;
+    stats_.capacity += size;
+    ++stats_.heap_blocks;
+}
+
+void FrameArena::free_blocks() {
+    for (const Block& block : blocks_) ::operator delete(block.data, std::align_val_t(block_alignment));
+    blocks_.clear();
+    stats_.capacity = 0;
+}
@@ -0,0 +1,52 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <memory_resource>
+#include <vector>
+
+struct FrameArenaStats {
+    // Bytes handed out since the last reset(), including alignment padding,
+    // and the most any frame has used.
+    size_t used = 0;
+    size_t peak = 0;
+    size_t capacity = 0;
+    // Blocks taken from the heap since construction; stops growing once the
+    // arena has seen the largest frame.
+    uint64_t heap_blocks = 0;
+};
+
+// Linear allocator for data that lives at most until the next reset(), used
+// as a std::pmr::memory_resource by per-frame containers. Allocation bumps a
+// pointer and deallocation does nothing. A frame that outgrows the block gets
+// more blocks from the heap; the next reset() replaces them with one block
+// that fits the whole frame, so steady-state frames never touch the heap.
+//
+// Not synchronized; allocate from one thread at a time.
+class FrameArena final : public std::pmr::memory_resource {
+public:
+    explicit FrameArena(size_t capacity = size_t(256) << 10);
+    ~FrameArena() override;
+    FrameArena(const FrameArena&) = delete;
+    FrameArena& operator=(const FrameArena&) = delete;
+
+    // Invalidates everything allocated since the previous reset.
+    void reset();
+    const FrameArenaStats& stats() const { return stats_; }
+
+private:
+    struct Block {
+        std::byte* data = nullptr;
+        size_t size = 0;
+    };
+
+    void* do_allocate(size_t bytes, size_t alignment) override;
+    void do_deallocate(void*, size_t, size_t) override {}
+    bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override { return this == &other; }
+    void add_block(size_t size);
+    void free_blocks();
+
+    std::vector<Block> blocks_;
+    // Bump offset into blocks_.back().
+    size_t offset_ = 0;
+    FrameArenaStats stats_;
+};
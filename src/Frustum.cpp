@@ -0,0 +1,31 @@
+#include "Frustum.h"
+
+Frustum::Frustum(const glm::mat4& viewProj) {
+    // Gribb/Hartmann: rows of the matrix combine into the clip planes.
+    glm::vec4 row0(viewProj[0][0], viewProj[1][0], viewProj[2][0], viewProj[3][0]);
+    glm::vec4 row1(viewProj[0][1], viewProj[1][1], viewProj[2][1], viewProj[3][1]);
+    glm::vec4 row2(viewProj[0][2], viewProj[1][2], viewProj[2][2], viewProj[3][2]);
+    glm::vec4 row3(viewProj[0][3], viewProj[1][3], viewProj[2][3], viewProj[3][3]);
+    planes_[0] = row3 + row0; // left
+    planes_[1] = row3 - row0; // right
+    planes_[2] = row3 + row1; // bottom
+    planes_[3] = row3 - row1; // top
+    planes_[4] = row2;        // near (z >= 0)
+    planes_[5] = row3 - row2; // far
+    for (auto& plane : planes_) {
+        float len = glm::length(glm::vec3(plane));
+        if (len > 0.0f) plane /= len;
+    }
+}
+
+bool Frustum::intersects(const Aabb& box) const {
+    if (!box.valid()) return false;
+    for (const auto& plane : planes_) {
+        // Corner furthest along the plane normal
+        glm::vec3 p(plane.x >= 0.0f ? box.max.x : box.min.x,
+                    plane.y >= 0.0f ? box.max.y : box.min.y,
+                    plane.z >= 0.0f ? box.max.z : box.min.z);
+        if (glm::dot(glm::vec3(plane), p) + plane.w < 0.0f) return false;
+    }
+    return true;
+}
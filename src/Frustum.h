@@ -0,0 +1,18 @@
+#pragma once
+#include <array>
+#include <glm/glm.hpp>
+#include "Bounds.h"
+
+// View frustum planes extracted from a view-projection matrix with a [0, 1]
+// clip-space depth range. Planes point inwards.
+class Frustum {
+public:
+    Frustum() = default;
+    explicit Frustum(const glm::mat4& viewProj);
+
+    // Conservative: may report boxes just outside a corner as intersecting.
+    bool intersects(const Aabb& box) const;
+
+private:
+    std::array<glm::vec4, 6> planes_{};
+};
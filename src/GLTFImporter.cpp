@@ -1,7 +1,12 @@
 #include "../external/stb_image_write.h"
 #define TINYGLTF_IMPLEMENTATION
 #include "GLTFImporter.h"
+#include <algorithm>
+#include <cstring>
 #include <iostream>
+#include <unordered_map>
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/type_ptr.hpp>
 
 bool GLTFImporter::load_glb(const std::string& filename) {
     tinygltf::Model model;
@@ -24,25 +29,9 @@ bool GLTFImporter::load_glb(const std::string& filename) {
     return true;
 }
 
-bool GLTFImporter::load_mesh(const std::string& filename, std::vector<Vertex>& outVertices, std::vector<uint32_t>& outIndices) {
-    tinygltf::Model model;
-    tinygltf::TinyGLTF loader;
-    std::string err, warn;
-    bool ret = loader.LoadBinaryFromFile(&model, &err, &warn, filename);
-    if (!ret) {
-        std::cerr << "Failed to load GLB: " << filename << std::endl;
-        return false;
-    }
-    if (model.meshes.empty()) {
-        std::cerr << "No meshes in GLB: " << filename << std::endl;
-        return false;
-    }
-    const tinygltf::Mesh& mesh = model.meshes[0];
-    if (mesh.primitives.empty()) {
-        std::cerr << "No primitives in mesh." << std::endl;
-        return false;
-    }
-    const tinygltf::Primitive& primitive = mesh.primitives[0];
+namespace {
+// Vertices and indices of one primitive.
+bool read_primitive(const tinygltf::Model& model, const tinygltf::Primitive& primitive, std::vector<Vertex>& outVertices, std::vector<uint32_t>& outIndices) {
     // Positions
     const float* positions = nullptr;
     const float* colors = nullptr;
@@ -81,11 +70,13 @@ bool GLTFImporter::load_mesh(const std::string& filename, std::vector<Vertex>& o
     // Indices
     outVertices.clear();
     outIndices.clear();
+    outVertices.reserve(vertexCount);
+    outIndices.reserve(primitive.indices >= 0 ? model.accessors[primitive.indices].count : vertexCount);
     for (size_t i = 0; i < vertexCount; ++i) {
         Vertex v{};
         v.pos[0] = positions[i * 3 + 0];
         v.pos[1] = positions[i * 3 + 1];
-        // Z is ignored for now
+        v.pos[2] = positions[i * 3 + 2];
         if (colors) {
             v.color[0] = colors[i * 3 + 0];
             v.color[1] = colors[i * 3 + 1];
@@ -121,4 +112,277 @@ bool GLTFImporter::load_mesh(const std::string& filename, std::vector<Vertex>& o
         for (uint32_t i = 0; i < (uint32_t)vertexCount; ++i) outIndices.push_back(i);
     }
     return true;
-} 
\ No newline at end of file
+}
+
+float read_component(int componentType, bool normalized, const unsigned char* p) {
+    float value = 0.0f;
+    switch (componentType) {
+        case TINYGLTF_COMPONENT_TYPE_FLOAT: memcpy(&value, p, 4); break;
+        case TINYGLTF_COMPONENT_TYPE_UNSIGNED_BYTE: value = normalized ? *p / 255.0f : *p; break;
+        case TINYGLTF_COMPONENT_TYPE_BYTE: { int8_t v; memcpy(&v, p, 1); value = normalized ? std::max(v / 127.0f, -1.0f) : v; break; }
+        case TINYGLTF_COMPONENT_TYPE_UNSIGNED_SHORT: { uint16_t v; memcpy(&v, p, 2); value = normalized ? v / 65535.0f : v; break; }
+        case TINYGLTF_COMPONENT_TYPE_SHORT: { int16_t v; memcpy(&v, p, 2); value = normalized ? std::max(v / 32767.0f, -1.0f) : v; break; }
+        case TINYGLTF_COMPONENT_TYPE_UNSIGNED_INT: { uint32_t v; memcpy(&v, p, 4); value = static_cast<float>(v); break; }
+        default: break;
+    }
+    return value;
+}
+
+// Every component of an accessor as float, honouring byteStride. Integer
+// components are scaled to [0, 1] / [-1, 1] when the accessor is normalized.
+// Sparse accessors (common for morph targets) are expanded; without a
+// buffer view their base is zero.
+std::vector<float> read_accessor(const tinygltf::Model& model, int index) {
+    std::vector<float> out;
+    if (index < 0) return out;
+    const tinygltf::Accessor& accessor = model.accessors[index];
+    const int components = tinygltf::GetNumComponentsInType(accessor.type);
+    const int componentSize = tinygltf::GetComponentSizeInBytes(accessor.componentType);
+    if (components <= 0 || componentSize <= 0) return out;
+    if (accessor.bufferView >= 0) {
+        const tinygltf::BufferView& view = model.bufferViews[accessor.bufferView];
+        const int stride = accessor.ByteStride(view);
+        if (stride <= 0) return out;
+        const unsigned char* data = &model.buffers[view.buffer].data[view.byteOffset + accessor.byteOffset];
+        out.resize(accessor.count * components);
+        for (size_t i = 0; i < accessor.count; ++i) {
+            const unsigned char* element = data + i * stride;
+            for (int c = 0; c < components; ++c) {
+                out[i * components + c] = read_component(accessor.componentType, accessor.normalized, element + c * componentSize);
+            }
+        }
+    } else if (accessor.sparse.isSparse) {
+        out.assign(accessor.count * components, 0.0f);
+    } else {
+        return out;
+    }
+    if (accessor.sparse.isSparse) {
+        const auto& sparse = accessor.sparse;
+        if (sparse.indices.bufferView < 0 || sparse.values.bufferView < 0) return out;
+        const tinygltf::BufferView& indexView = model.bufferViews[sparse.indices.bufferView];
+        const tinygltf::BufferView& valueView = model.bufferViews[sparse.values.bufferView];
+        const unsigned char* indices = &model.buffers[indexView.buffer].data[indexView.byteOffset + sparse.indices.byteOffset];
+        const unsigned char* values = &model.buffers[valueView.buffer].data[valueView.byteOffset + sparse.values.byteOffset];
+        const int indexSize = tinygltf::GetComponentSizeInBytes(sparse.indices.componentType);
+        for (int i = 0; i < sparse.count; ++i) {
+            uint32_t element = 0;
+            memcpy(&element, indices + i * indexSize, std::min(indexSize, 4)); // little endian
+            if (element >= accessor.count) continue;
+            for (int c = 0; c < components; ++c) {
+                out[element * components + c] = read_component(accessor.componentType, accessor.normalized, values + (i * components + c) * componentSize);
+            }
+        }
+    }
+    return out;
+}
+
+// POSITION deltas of every morph target of a primitive, keeping only the
+// vertices each target moves.
+void read_morph_targets(const tinygltf::Model& model, const tinygltf::Mesh& mesh, const tinygltf::Primitive& primitive,
+                        size_t vertexCount, MorphTargetSet& out) {
+    out = MorphTargetSet{};
+    const tinygltf::Value* names = mesh.extras.Has("targetNames") ? &mesh.extras.Get("targetNames") : nullptr;
+    for (size_t t = 0; t < primitive.targets.size(); ++t) {
+        MorphTarget target;
+        if (names && names->IsArray() && t < names->ArrayLen() && names->Get(t).IsString()) target.name = names->Get(t).Get<std::string>();
+        auto it = primitive.targets[t].find("POSITION");
+        std::vector<float> deltas = it != primitive.targets[t].end() ? read_accessor(model, it->second) : std::vector<float>{};
+        if (deltas.size() >= vertexCount * 3) {
+            for (size_t v = 0; v < vertexCount; ++v) {
+                const float* d = &deltas[v * 3];
+                if (d[0] == 0.0f && d[1] == 0.0f && d[2] == 0.0f) continue;
+                target.vertices.push_back(static_cast<uint32_t>(v));
+                target.deltas.insert(target.deltas.end(), {d[0], d[1], d[2], 0.0f});
+            }
+        }
+        out.targets.push_back(std::move(target));
+    }
+    out.default_weights.assign(out.targets.size(), 0.0f);
+    for (size_t t = 0; t < out.targets.size() && t < mesh.weights.size(); ++t) {
+        out.default_weights[t] = static_cast<float>(mesh.weights[t]);
+    }
+}
+
+JointPose node_pose(const tinygltf::Node& node) {
+    JointPose pose;
+    if (node.matrix.size() == 16) {
+        glm::mat4 m = glm::make_mat4(node.matrix.data());
+        pose.translation = glm::vec3(m[3]);
+        pose.scale = glm::vec3(glm::length(glm::vec3(m[0])), glm::length(glm::vec3(m[1])), glm::length(glm::vec3(m[2])));
+        glm::mat3 r(glm::vec3(m[0]) / pose.scale.x, glm::vec3(m[1]) / pose.scale.y, glm::vec3(m[2]) / pose.scale.z);
+        pose.rotation = glm::quat_cast(r);
+        return pose;
+    }
+    if (node.translation.size() == 3) pose.translation = glm::vec3(node.translation[0], node.translation[1], node.translation[2]);
+    // glTF stores quaternions as xyzw.
+    if (node.rotation.size() == 4) pose.rotation = glm::quat(static_cast<float>(node.rotation[3]), static_cast<float>(node.rotation[0]), static_cast<float>(node.rotation[1]), static_cast<float>(node.rotation[2]));
+    if (node.scale.size() == 3) pose.scale = glm::vec3(node.scale[0], node.scale[1], node.scale[2]);
+    return pose;
+}
+
+glm::mat4 node_matrix(const tinygltf::Node& node) {
+    if (node.matrix.size() == 16) return glm::mat4(glm::make_mat4(node.matrix.data()));
+    JointPose pose = node_pose(node);
+    return glm::translate(glm::mat4(1.0f), pose.translation) * glm::mat4_cast(pose.rotation) * glm::scale(glm::mat4(1.0f), pose.scale);
+}
+}
+
+bool GLTFImporter::load_mesh(const std::string& filename, std::vector<Vertex>& outVertices, std::vector<uint32_t>& outIndices,
+                             MorphTargetSet* outMorphs) {
+    tinygltf::Model model;
+    tinygltf::TinyGLTF loader;
+    std::string err, warn;
+    bool ret = loader.LoadBinaryFromFile(&model, &err, &warn, filename);
+    if (!ret) {
+        std::cerr << "Failed to load GLB: " << filename << std::endl;
+        return false;
+    }
+    if (model.meshes.empty()) {
+        std::cerr << "No meshes in GLB: " << filename << std::endl;
+        return false;
+    }
+    const tinygltf::Mesh& mesh = model.meshes[0];
+    if (mesh.primitives.empty()) {
+        std::cerr << "No primitives in mesh." << std::endl;
+        return false;
+    }
+    if (!read_primitive(model, mesh.primitives[0], outVertices, outIndices)) return false;
+    if (outMorphs) read_morph_targets(model, mesh, mesh.primitives[0], outVertices.size(), *outMorphs);
+    return true;
+}
+
+bool GLTFImporter::load_skinned_mesh(const std::string& filename, SkinnedMeshData& out) {
+    tinygltf::Model model;
+    tinygltf::TinyGLTF loader;
+    std::string err, warn;
+    if (!loader.LoadBinaryFromFile(&model, &err, &warn, filename)) {
+        std::cerr << "Failed to load GLB: " << filename << std::endl;
+        return false;
+    }
+    // The skinned mesh node; its own transform is ignored per the glTF spec.
+    auto meshNode = std::find_if(model.nodes.begin(), model.nodes.end(), [](const tinygltf::Node& node) {
+        return node.mesh >= 0 && node.skin >= 0;
+    });
+    if (meshNode == model.nodes.end()) {
+        std::cerr << "No skinned mesh in GLB: " << filename << std::endl;
+        return false;
+    }
+    const tinygltf::Mesh& mesh = model.meshes[meshNode->mesh];
+    if (mesh.primitives.empty()) {
+        std::cerr << "No primitives in mesh." << std::endl;
+        return false;
+    }
+    const tinygltf::Primitive& primitive = mesh.primitives[0];
+    if (!read_primitive(model, primitive, out.vertices, out.indices)) return false;
+    read_morph_targets(model, mesh, primitive, out.vertices.size(), out.morphs);
+    const int meshNodeIndex = static_cast<int>(meshNode - model.nodes.begin());
+
+    const tinygltf::Skin& skin = model.skins[meshNode->skin];
+    std::vector<int> nodeParents(model.nodes.size(), -1);
+    for (size_t n = 0; n < model.nodes.size(); ++n) {
+        for (int child : model.nodes[n].children) nodeParents[child] = static_cast<int>(n);
+    }
+    // Order joints by depth so parents come first.
+    const size_t jointCount = skin.joints.size();
+    std::vector<uint32_t> depths(jointCount, 0);
+    for (size_t j = 0; j < jointCount; ++j) {
+        for (int n = nodeParents[skin.joints[j]]; n >= 0; n = nodeParents[n]) ++depths[j];
+    }
+    std::vector<uint32_t> order(jointCount);
+    for (uint32_t j = 0; j < jointCount; ++j) order[j] = j;
+    std::stable_sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) { return depths[a] < depths[b]; });
+    std::vector<uint16_t> remap(jointCount);
+    std::unordered_map<int, uint32_t> nodeJoints;
+    for (uint32_t k = 0; k < jointCount; ++k) {
+        remap[order[k]] = static_cast<uint16_t>(k);
+        nodeJoints[skin.joints[order[k]]] = k;
+    }
+
+    std::vector<float> inverseBind = read_accessor(model, skin.inverseBindMatrices);
+    Skeleton& skeleton = out.skeleton;
+    skeleton = Skeleton{};
+    for (uint32_t k = 0; k < jointCount; ++k) {
+        uint32_t source = order[k];
+        const tinygltf::Node& node = model.nodes[skin.joints[source]];
+        skeleton.names.push_back(node.name);
+        skeleton.rest_pose.push_back(node_pose(node));
+        skeleton.inverse_bind.push_back(inverseBind.size() >= (source + 1) * 16 ? glm::make_mat4(&inverseBind[source * 16]) : glm::mat4(1.0f));
+        // Non-joint nodes above a root are folded into its base transform;
+        // ones between two joints are not expected and are skipped.
+        glm::mat4 base(1.0f);
+        int n = nodeParents[skin.joints[source]];
+        while (n >= 0 && !nodeJoints.count(n)) {
+            base = node_matrix(model.nodes[n]) * base;
+            n = nodeParents[n];
+        }
+        int32_t parent = n >= 0 ? static_cast<int32_t>(nodeJoints[n]) : -1;
+        skeleton.parents.push_back(parent);
+        skeleton.root_bases.push_back(parent < 0 ? base : glm::mat4(1.0f));
+    }
+
+    auto jointsIt = primitive.attributes.find("JOINTS_0");
+    auto weightsIt = primitive.attributes.find("WEIGHTS_0");
+    std::vector<float> joints = jointsIt != primitive.attributes.end() ? read_accessor(model, jointsIt->second) : std::vector<float>{};
+    std::vector<float> weights = weightsIt != primitive.attributes.end() ? read_accessor(model, weightsIt->second) : std::vector<float>{};
+    out.weights.assign(out.vertices.size(), SkinWeights{});
+    if (joints.size() >= out.vertices.size() * 4 && weights.size() >= out.vertices.size() * 4) {
+        for (size_t v = 0; v < out.vertices.size(); ++v) {
+            SkinWeights& w = out.weights[v];
+            float sum = 0.0f;
+            for (int i = 0; i < 4; ++i) {
+                uint32_t joint = static_cast<uint32_t>(joints[v * 4 + i]);
+                w.joints[i] = joint < jointCount ? remap[joint] : 0;
+                w.weights[i] = joint < jointCount ? weights[v * 4 + i] : 0.0f;
+                sum += w.weights[i];
+            }
+            if (sum > 0.0f) {
+                for (float& weight : w.weights) weight /= sum;
+            } else {
+                w = SkinWeights{};
+            }
+        }
+    }
+
+    out.clips.clear();
+    for (const tinygltf::Animation& animation : model.animations) {
+        AnimationClip clip;
+        clip.name = animation.name;
+        for (const tinygltf::AnimationChannel& source : animation.channels) {
+            const tinygltf::AnimationSampler& sampler = animation.samplers[source.sampler];
+            AnimationChannel::Interpolation interpolation = AnimationChannel::Interpolation::linear;
+            if (sampler.interpolation == "STEP") interpolation = AnimationChannel::Interpolation::step;
+            else if (sampler.interpolation == "CUBICSPLINE") interpolation = AnimationChannel::Interpolation::cubic;
+            if (source.target_path == "weights") {
+                if (source.target_node != meshNodeIndex || out.morphs.empty()) continue;
+                MorphWeightChannel& weights = clip.morph_weights;
+                weights.interpolation = interpolation;
+                weights.target_count = out.morphs.target_count();
+                weights.times = read_accessor(model, sampler.input);
+                weights.values = read_accessor(model, sampler.output);
+                size_t perKey = weights.target_count * (interpolation == AnimationChannel::Interpolation::cubic ? 3 : 1);
+                if (weights.times.empty() || weights.values.size() < weights.times.size() * perKey) {
+                    weights = MorphWeightChannel{};
+                    continue;
+                }
+                clip.duration = std::max(clip.duration, weights.times.back());
+                continue;
+            }
+            auto joint = nodeJoints.find(source.target_node);
+            if (joint == nodeJoints.end()) continue;
+            AnimationChannel channel;
+            channel.joint = joint->second;
+            if (source.target_path == "translation") channel.path = AnimationChannel::Path::translation;
+            else if (source.target_path == "rotation") channel.path = AnimationChannel::Path::rotation;
+            else if (source.target_path == "scale") channel.path = AnimationChannel::Path::scale;
+            else continue;
+            channel.interpolation = interpolation;
+            channel.times = read_accessor(model, sampler.input);
+            channel.values = read_accessor(model, sampler.output);
+            if (channel.times.empty()) continue;
+            clip.duration = std::max(clip.duration, channel.times.back());
+            clip.channels.push_back(std::move(channel));
+        }
+        out.clips.push_back(std::move(clip));
+    }
+    return true;
+}
@@ -2,12 +2,30 @@
 #include "../external/tiny_gltf.h"
 #include <string>
 #include <vector>
-#include "VulkanApp.h" // for Vertex
+#include "Vertex.h"
+#include "Animation.h"
+#include "Morph.h"
+
+// First skinned mesh of a file with its skin, morph targets and animations.
+// weights run parallel to vertices and index the skeleton's joints.
+struct SkinnedMeshData {
+    std::vector<Vertex> vertices;
+    std::vector<uint32_t> indices;
+    std::vector<SkinWeights> weights;
+    MorphTargetSet morphs;
+    Skeleton skeleton;
+    std::vector<AnimationClip> clips;
+};
 
 class GLTFImporter {
 public:
     // Loads a .glb file and prints basic info. Returns true on success.
     static bool load_glb(const std::string& filename);
-    // Loads the first mesh from a .glb file into vertices and indices. Returns true on success.
-    static bool load_mesh(const std::string& filename, std::vector<Vertex>& outVertices, std::vector<uint32_t>& outIndices);
+    // Loads the first mesh from a .glb file into vertices and indices, and its
+    // morph targets when outMorphs is given. Returns true on success.
+    static bool load_mesh(const std::string& filename, std::vector<Vertex>& outVertices, std::vector<uint32_t>& outIndices,
+                          MorphTargetSet* outMorphs = nullptr);
+    // Loads the first skinned mesh with its skeleton, morph targets and every
+    // animation clip that targets its joints or weights. Returns true on success.
+    static bool load_skinned_mesh(const std::string& filename, SkinnedMeshData& out);
 }; 
\ No newline at end of file
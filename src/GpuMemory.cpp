@@ -0,0 +1,120 @@
+#include "GpuMemory.h"
+#include "Log.h"
+
+const char* gpu_memory_category_name(GpuMemoryCategory category) {
+    switch (category) {
+    case GpuMemoryCategory::mesh: return "mesh";
+    case GpuMemoryCategory::texture: return "texture";
+    case GpuMemoryCategory::render_target: return "render_target";
+    case GpuMemoryCategory::uniform: return "uniform";
+    case GpuMemoryCategory::staging: return "staging";
+    case GpuMemoryCategory::other: return "other";
+    }
+    return "unknown";
+}
+
+VkDeviceSize GpuMemoryStats::device_local_headroom() const {
+    VkDeviceSize headroom = 0;
+    for (uint32_t i = 0; i < heap_count; ++i) {
+        if (heaps[i].device_local && heaps[i].budget > heaps[i].usage) headroom += heaps[i].budget - heaps[i].usage;
+    }
+    return headroom;
+}
+
+GpuMemory& GpuMemory::shared() {
+    static GpuMemory memory;
+    return memory;
+}
+
+void GpuMemory::init(VkPhysicalDevice physicalDevice, bool budgetExtension) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    physical_device_ = physicalDevice;
+    vkGetPhysicalDeviceMemoryProperties(physicalDevice, &memory_properties_);
+    budget_supported_ = budgetExtension;
+}
+
+VkResult GpuMemory::allocate(VkDevice device, const VkMemoryAllocateInfo& info, GpuMemoryCategory category, VkDeviceMemory* memory) {
+    VkResult result = vkAllocateMemory(device, &info, nullptr, memory);
+    if (result != VK_SUCCESS) {
+        LOG_WARN("GpuMemory: allocating {} bytes of {} failed ({})", info.allocationSize, gpu_memory_category_name(category),
+                 result);
+        return result;
+    }
+    std::lock_guard<std::mutex> lock(mutex_);
+    uint32_t heap = info.memoryTypeIndex < memory_properties_.memoryTypeCount
+        ? memory_properties_.memoryTypes[info.memoryTypeIndex].heapIndex : 0;
+    allocations_[*memory] = { info.allocationSize, heap, category };
+    bytes_[static_cast<size_t>(category)] += info.allocationSize;
+    ++counts_[static_cast<size_t>(category)];
+    heap_bytes_[heap] += info.allocationSize;
+    return result;
+}
+
+void GpuMemory::free(VkDevice device, VkDeviceMemory memory) {
+    if (memory == VK_NULL_HANDLE) return;
+    // Forget the handle before freeing it: once freed, the driver may hand the
+    // same handle to a concurrent allocate(), whose entry this must not erase.
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto it = allocations_.find(memory);
+        if (it != allocations_.end()) {
+            const Allocation& allocation = it->second;
+            bytes_[static_cast<size_t>(allocation.category)] -= allocation.size;
+            --counts_[static_cast<size_t>(allocation.category)];
+            heap_bytes_[allocation.heap] -= allocation.size;
+            allocations_.erase(it);
+        }
+    }
+    vkFreeMemory(device, memory, nullptr);
+}
+
+GpuMemoryStats GpuMemory::stats() const {
+    GpuMemoryStats stats;
+    std::lock_guard<std::mutex> lock(mutex_);
+    stats.bytes = bytes_;
+    stats.allocations = counts_;
+    for (size_t i = 0; i < gpu_memory_category_count; ++i) {
+        stats.total_bytes += bytes_[i];
+        stats.total_allocations += counts_[i];
+    }
+    stats.heap_count = memory_properties_.memoryHeapCount;
+    for (uint32_t i = 0; i < stats.heap_count; ++i) {
+        GpuHeapStats& heap = stats.heaps[i];
+        heap.size = memory_properties_.memoryHeaps[i].size;
+        heap.device_local = (memory_properties_.memoryHeaps[i].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT) != 0;
+        heap.tracked = heap_bytes_[i];
+        heap.budget = heap.size;
+        heap.usage = heap.tracked;
+    }
+    if (budget_supported_) {
+        VkPhysicalDeviceMemoryBudgetPropertiesEXT budget{};
+        budget.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_BUDGET_PROPERTIES_EXT;
+        VkPhysicalDeviceMemoryProperties2 properties{};
+        properties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_PROPERTIES_2;
+        properties.pNext = &budget;
+        vkGetPhysicalDeviceMemoryProperties2(physical_device_, &properties);
+        for (uint32_t i = 0; i < stats.heap_count; ++i) {
+            stats.heaps[i].budget = budget.heapBudget[i];
+            stats.heaps[i].usage = budget.heapUsage[i];
+        }
+        stats.budget_supported = true;
+    }
+    return stats;
+}
+
+void GpuMemory::log_stats() const {
+    GpuMemoryStats stats = this->stats();
+    LOG_INFO("GpuMemory: {} KiB in {} allocations", stats.total_bytes >> 10, stats.total_allocations);
+    for (size_t i = 0; i < gpu_memory_category_count; ++i) {
+        if (stats.allocations[i] == 0) continue;
+        LOG_INFO("GpuMemory:   {} {} KiB in {} allocations", gpu_memory_category_name(static_cast<GpuMemoryCategory>(i)),
+                 stats.bytes[i] >> 10, stats.allocations[i]);
+    }
+    for (uint32_t i = 0; i < stats.heap_count; ++i) {
+        const GpuHeapStats& heap = stats.heaps[i];
+        LOG_INFO("GpuMemory:   heap {}{}: {} / {} MiB used of budget (engine {} MiB, size {} MiB)", i,
+                 heap.device_local ? " (device local)" : "", heap.usage >> 20, heap.budget >> 20, heap.tracked >> 20,
+                 heap.size >> 20);
+    }
+    if (!stats.budget_supported) LOG_INFO("GpuMemory:   VK_EXT_memory_budget unavailable; usage is engine allocations only");
+}
@@ -0,0 +1,88 @@
+#pragma once
+#include <vulkan/vulkan.h>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <unordered_map>
+
+// What a device memory allocation backs.
+enum class GpuMemoryCategory : uint8_t {
+    mesh,           // vertex, index and position buffers
+    texture,        // sampled images
+    render_target,  // attachments: render graph transients, shadow maps
+    uniform,        // host-written per-frame data: uniforms, light lists, sprite instances
+    staging,        // upload sources, freed once the copy is done
+    other,
+};
+inline constexpr size_t gpu_memory_category_count = 6;
+const char* gpu_memory_category_name(GpuMemoryCategory category);
+
+struct GpuHeapStats {
+    VkDeviceSize size = 0;
+    // What the process may use and uses, as reported by VK_EXT_memory_budget.
+    // Without the extension, budget is the heap size and usage the tracked bytes.
+    VkDeviceSize budget = 0;
+    VkDeviceSize usage = 0;
+    // Allocated through GpuMemory.
+    VkDeviceSize tracked = 0;
+    bool device_local = false;
+};
+
+struct GpuMemoryStats {
+    std::array<VkDeviceSize, gpu_memory_category_count> bytes{};
+    std::array<uint32_t, gpu_memory_category_count> allocations{};
+    VkDeviceSize total_bytes = 0;
+    uint32_t total_allocations = 0;
+    std::array<GpuHeapStats, VK_MAX_MEMORY_HEAPS> heaps{};
+    uint32_t heap_count = 0;
+    bool budget_supported = false;
+
+    VkDeviceSize category_bytes(GpuMemoryCategory category) const { return bytes[static_cast<size_t>(category)]; }
+    // Bytes that can still be allocated from device-local heaps before
+    // reaching their budgets.
+    VkDeviceSize device_local_headroom() const;
+};
+
+// Accounting of every device memory allocation the engine makes.
+//
+// Allocations and frees go through allocate() and free() instead of
+// vkAllocateMemory and vkFreeMemory, tagged with a category; the tracker
+// keeps per-category and per-heap totals. stats() adds the driver's view of
+// each heap from VK_EXT_memory_budget when the device has it, which also
+// covers memory the engine does not allocate itself (swapchain images,
+// driver internals) and other processes' pressure on the budget. Thread-safe;
+// one process-wide instance, like JobSystem::shared().
+class GpuMemory {
+public:
+    static GpuMemory& shared();
+
+    // Caches the heap layout; budgetExtension tells whether the device was
+    // created with VK_EXT_memory_budget.
+    void init(VkPhysicalDevice physicalDevice, bool budgetExtension);
+
+    VkResult allocate(VkDevice device, const VkMemoryAllocateInfo& info, GpuMemoryCategory category, VkDeviceMemory* memory);
+    // Null memory is ignored.
+    void free(VkDevice device, VkDeviceMemory memory);
+
+    // Live totals; queries the budget from the driver when supported.
+    GpuMemoryStats stats() const;
+    // Writes the totals and heaps to the log.
+    void log_stats() const;
+
+private:
+    struct Allocation {
+        VkDeviceSize size;
+        uint32_t heap;
+        GpuMemoryCategory category;
+    };
+
+    mutable std::mutex mutex_;
+    VkPhysicalDevice physical_device_ = VK_NULL_HANDLE;
+    VkPhysicalDeviceMemoryProperties memory_properties_{};
+    bool budget_supported_ = false;
+    std::unordered_map<VkDeviceMemory, Allocation> allocations_;
+    std::array<VkDeviceSize, gpu_memory_category_count> bytes_{};
+    std::array<uint32_t, gpu_memory_category_count> counts_{};
+    std::array<VkDeviceSize, VK_MAX_MEMORY_HEAPS> heap_bytes_{};
+};
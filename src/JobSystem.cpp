@@ -0,0 +1,99 @@
+#include "JobSystem.h"
+#include <algorithm>
+
+namespace {
+// Set while a thread is executing batches, so nested parallel_for calls run
+// inline instead of deadlocking on the single job slot.
+thread_local bool t_in_job = false;
+}
+
+JobSystem::JobSystem(uint32_t worker_count) {
+    workers_.reserve(worker_count);
+    for (uint32_t i = 0; i < worker_count; ++i) {
+        workers_.emplace_back([this] { worker_loop(); });
+    }
+}
+
+JobSystem::~JobSystem() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stop_ = true;
+    }
+    wake_.notify_all();
+    for (auto& worker : workers_) worker.join();
+}
+
+uint32_t JobSystem::default_worker_count() {
+    uint32_t hw = std::thread::hardware_concurrency();
+    return hw > 1 ? hw - 1 : 0;
+}
+
+JobSystem& JobSystem::shared() {
+    static JobSystem instance;
+    return instance;
+}
+
+void JobSystem::run(size_t count, size_t min_batch, const void* context, BatchFn fn) {
+    if (count == 0) return;
+    min_batch = std::max<size_t>(min_batch, 1);
+    if (workers_.empty() || count <= min_batch || t_in_job) {
+        fn(context, 0, count);
+        return;
+    }
+    std::lock_guard<std::mutex> submit(submit_mutex_);
+    Job job;
+    job.context = context;
+    job.fn = fn;
+    job.count = count;
+    // Aim for a few batches per thread so uneven batches still balance out.
+    size_t target_batches = static_cast<size_t>(thread_count()) * 4;
+    job.batch = std::max(min_batch, (count + target_batches - 1) / target_batches);
+    size_t batch_count = (count + job.batch - 1) / job.batch;
+    job.remaining.store(batch_count, std::memory_order_relaxed);
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        job_ = &job;
+        ++generation_;
+    }
+    wake_.notify_all();
+    run_batches(job);
+    std::unique_lock<std::mutex> lock(mutex_);
+    done_.wait(lock, [&] { return job.remaining.load(std::memory_order_acquire) == 0 && active_ == 0; });
+    job_ = nullptr;
+}
+
+void JobSystem::run_batches(Job& job) {
+    t_in_job = true;
+    for (;;) {
+        size_t begin = job.next.fetch_add(job.batch, std::memory_order_relaxed);
+        if (begin >= job.count) break;
+        size_t end = std::min(begin + job.batch, job.count);
+        job.fn(job.context, begin, end);
+        if (job.remaining.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+            std::lock_guard<std::mutex> lock(mutex_);
+            done_.notify_all();
+        }
+    }
+    t_in_job = false;
+}
+
+void JobSystem::worker_loop() {
+    uint64_t seen = 0;
+    for (;;) {
+        Job* job = nullptr;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            wake_.wait(lock, [&] { return stop_ || (job_ && generation_ != seen); });
+            if (stop_) return;
+            seen = generation_;
+            job = job_;
+            ++active_;
+        }
+        run_batches(*job);
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            --active_;
+        }
+        done_.notify_all();
+    }
+}
@@ -0,0 +1,62 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Small fixed worker pool for data-parallel loops. The calling thread joins
+// in on every parallel_for, so a pool with zero workers degrades to a plain
+// serial loop.
+class JobSystem {
+public:
+    explicit JobSystem(uint32_t worker_count = default_worker_count());
+    ~JobSystem();
+
+    JobSystem(const JobSystem&) = delete;
+    JobSystem& operator=(const JobSystem&) = delete;
+
+    // Splits [0, count) into batches of at least min_batch items and runs
+    // fn(begin, end) on each batch. Blocks until all batches are done. fn is
+    // called through a reference, so capturing lambdas never hit the heap.
+    template<typename Fn>
+    void parallel_for(size_t count, size_t min_batch, const Fn& fn) {
+        run(count, min_batch, &fn, [](const void* context, size_t begin, size_t end) {
+            (*static_cast<const Fn*>(context))(begin, end);
+        });
+    }
+    // Number of threads that take part in a parallel_for (workers + caller).
+    uint32_t thread_count() const { return static_cast<uint32_t>(workers_.size()) + 1; }
+
+    // Process-wide pool shared by the engine subsystems.
+    static JobSystem& shared();
+    static uint32_t default_worker_count();
+
+private:
+    using BatchFn = void (*)(const void* context, size_t begin, size_t end);
+
+    struct Job {
+        const void* context = nullptr;
+        BatchFn fn = nullptr;
+        size_t count = 0;
+        size_t batch = 0;
+        std::atomic<size_t> next{0};
+        std::atomic<size_t> remaining{0};
+    };
+
+    void run(size_t count, size_t min_batch, const void* context, BatchFn fn);
+    void worker_loop();
+    void run_batches(Job& job);
+
+    std::vector<std::thread> workers_;
+    std::mutex mutex_;
+    std::condition_variable wake_;
+    std::condition_variable done_;
+    std::mutex submit_mutex_;
+    Job* job_ = nullptr;
+    uint32_t active_ = 0;
+    uint64_t generation_ = 0;
+    bool stop_ = false;
+};
@@ -0,0 +1,323 @@
+#include "LightGrid.h"
+#include "GpuMemory.h"
+#include "JobSystem.h"
+#include <algorithm>
+#include <array>
+#include <cfloat>
+#include <cmath>
+#include <stdexcept>
+
+namespace {
+uint32_t find_memory_type(VkPhysicalDevice physicalDevice, uint32_t typeBits, VkMemoryPropertyFlags properties) {
+    VkPhysicalDeviceMemoryProperties memProperties;
+    vkGetPhysicalDeviceMemoryProperties(physicalDevice, &memProperties);
+    for (uint32_t i = 0; i < memProperties.memoryTypeCount; i++) {
+        if ((typeBits & (1 << i)) && (memProperties.memoryTypes[i].propertyFlags & properties) == properties) return i;
+    }
+    throw std::runtime_error("No suitable memory type for light grid");
+}
+
+VkDeviceSize align_up(VkDeviceSize value, VkDeviceSize alignment) {
+    return (value + alignment - 1) / alignment * alignment;
+}
+
+// Mirrors LightGridParams in shader.vert/shader.frag (std140).
+struct GpuGridParams {
+    glm::mat4 view;
+    // tiles x, tiles y, slices, light count
+    uint32_t grid[4];
+    // slice = log(depth) * scale + bias; tile size in pixels
+    float slice[4];
+    float ambient[4];
+};
+
+// View-space position and radius, color and intensity (std430).
+struct GpuLight {
+    float position_radius[4];
+    float color_intensity[4];
+};
+
+uint32_t tile_size(uint32_t pixels, uint32_t tiles) {
+    return std::max<uint32_t>((pixels + tiles - 1) / tiles, 1);
+}
+
+constexpr uint32_t cluster_index(uint32_t x, uint32_t y, uint32_t z) {
+    return (z * LightGrid::tiles_y + y) * LightGrid::tiles_x + x;
+}
+}
+
+void LightGrid::init(VkDevice device, VkPhysicalDevice physicalDevice, uint32_t frameSlots) {
+    device_ = device;
+    frame_slots_ = frameSlots;
+
+    std::array<VkDescriptorSetLayoutBinding, 4> bindings{};
+    for (uint32_t i = 0; i < bindings.size(); ++i) {
+        bindings[i].binding = i;
+        bindings[i].descriptorCount = 1;
+        bindings[i].descriptorType = i == 0 ? VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER : VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        bindings[i].stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+    }
+    // The vertex shader needs the view matrix.
+    bindings[0].stageFlags |= VK_SHADER_STAGE_VERTEX_BIT;
+    VkDescriptorSetLayoutCreateInfo layoutInfo{};
+    layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+    layoutInfo.bindingCount = static_cast<uint32_t>(bindings.size());
+    layoutInfo.pBindings = bindings.data();
+    if (vkCreateDescriptorSetLayout(device_, &layoutInfo, nullptr, &set_layout_) != VK_SUCCESS)
+        throw std::runtime_error("Failed to create light grid descriptor set layout");
+
+    std::array<VkDescriptorPoolSize, 2> poolSizes{};
+    poolSizes[0].type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+    poolSizes[0].descriptorCount = frame_slots_;
+    poolSizes[1].type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    poolSizes[1].descriptorCount = 3 * frame_slots_;
+    VkDescriptorPoolCreateInfo poolInfo{};
+    poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+    poolInfo.poolSizeCount = static_cast<uint32_t>(poolSizes.size());
+    poolInfo.pPoolSizes = poolSizes.data();
+    poolInfo.maxSets = frame_slots_;
+    if (vkCreateDescriptorPool(device_, &poolInfo, nullptr, &descriptor_pool_) != VK_SUCCESS)
+        throw std::runtime_error("Failed to create light grid descriptor pool");
+
+    // One range per frame slot, each holding the parameters, lights, cluster
+    // ranges and indices at offsets every descriptor type accepts.
+    VkPhysicalDeviceProperties properties;
+    vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+    const VkDeviceSize alignment = std::max(properties.limits.minUniformBufferOffsetAlignment,
+                                            properties.limits.minStorageBufferOffsetAlignment);
+    lights_offset_ = align_up(sizeof(GpuGridParams), alignment);
+    clusters_offset_ = align_up(lights_offset_ + sizeof(GpuLight) * max_lights, alignment);
+    indices_offset_ = align_up(clusters_offset_ + sizeof(uint32_t) * 2 * cluster_count, alignment);
+    slot_size_ = align_up(indices_offset_ + sizeof(uint32_t) * max_light_indices, alignment);
+
+    VkBufferCreateInfo bufferInfo{};
+    bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+    bufferInfo.size = slot_size_ * frame_slots_;
+    bufferInfo.usage = VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT;
+    bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    if (vkCreateBuffer(device_, &bufferInfo, nullptr, &buffer_) != VK_SUCCESS)
+        throw std::runtime_error("Failed to create light grid buffer");
+    VkMemoryRequirements memRequirements;
+    vkGetBufferMemoryRequirements(device_, buffer_, &memRequirements);
+    VkMemoryAllocateInfo allocInfo{};
+    allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+    allocInfo.allocationSize = memRequirements.size;
+    allocInfo.memoryTypeIndex = find_memory_type(physicalDevice, memRequirements.memoryTypeBits,
+                                                 VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+    if (GpuMemory::shared().allocate(device_, allocInfo, GpuMemoryCategory::uniform, &memory_) != VK_SUCCESS)
+        throw std::runtime_error("Failed to allocate light grid memory");
+    vkBindBufferMemory(device_, buffer_, memory_, 0);
+    void* mapped = nullptr;
+    if (vkMapMemory(device_, memory_, 0, VK_WHOLE_SIZE, 0, &mapped) != VK_SUCCESS)
+        throw std::runtime_error("Failed to map light grid memory");
+    mapped_ = static_cast<std::byte*>(mapped);
+
+    std::vector<VkDescriptorSetLayout> layouts(frame_slots_, set_layout_);
+    sets_.resize(frame_slots_);
+    VkDescriptorSetAllocateInfo setInfo{};
+    setInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+    setInfo.descriptorPool = descriptor_pool_;
+    setInfo.descriptorSetCount = frame_slots_;
+    setInfo.pSetLayouts = layouts.data();
+    if (vkAllocateDescriptorSets(device_, &setInfo, sets_.data()) != VK_SUCCESS)
+        throw std::runtime_error("Failed to allocate light grid descriptor sets");
+    for (uint32_t slot = 0; slot < frame_slots_; ++slot) {
+        const VkDeviceSize base = slot * slot_size_;
+        std::array<VkDescriptorBufferInfo, 4> infos{};
+        infos[0] = { buffer_, base, sizeof(GpuGridParams) };
+        infos[1] = { buffer_, base + lights_offset_, sizeof(GpuLight) * max_lights };
+        infos[2] = { buffer_, base + clusters_offset_, sizeof(uint32_t) * 2 * cluster_count };
+        infos[3] = { buffer_, base + indices_offset_, sizeof(uint32_t) * max_light_indices };
+        std::array<VkWriteDescriptorSet, 4> writes{};
+        for (uint32_t i = 0; i < writes.size(); ++i) {
+            writes[i].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+            writes[i].dstSet = sets_[slot];
+            writes[i].dstBinding = i;
+            writes[i].descriptorCount = 1;
+            writes[i].descriptorType = bindings[i].descriptorType;
+            writes[i].pBufferInfo = &infos[i];
+        }
+        vkUpdateDescriptorSets(device_, static_cast<uint32_t>(writes.size()), writes.data(), 0, nullptr);
+    }
+}
+
+void LightGrid::destroy() {
+    if (device_ == VK_NULL_HANDLE) return;
+    if (memory_ != VK_NULL_HANDLE) {
+        vkUnmapMemory(device_, memory_);
+        GpuMemory::shared().free(device_, memory_);
+    }
+    if (buffer_ != VK_NULL_HANDLE) vkDestroyBuffer(device_, buffer_, nullptr);
+    // Sets go with the pool.
+    if (descriptor_pool_ != VK_NULL_HANDLE) vkDestroyDescriptorPool(device_, descriptor_pool_, nullptr);
+    if (set_layout_ != VK_NULL_HANDLE) vkDestroyDescriptorSetLayout(device_, set_layout_, nullptr);
+    *this = LightGrid{};
+}
+
+void LightGrid::build_cluster_bounds(const glm::mat4& projection, VkExtent2D extent, float nearZ, float farZ) {
+    cluster_bounds_.resize(cluster_count);
+    const glm::mat4 inverse = glm::inverse(projection);
+    const uint32_t tileWidth = tile_size(extent.width, tiles_x);
+    const uint32_t tileHeight = tile_size(extent.height, tiles_y);
+    auto ndcDepth = [&](float depth) {
+        glm::vec4 clip = projection * glm::vec4(0.0f, 0.0f, -depth, 1.0f);
+        return clip.z / clip.w;
+    };
+    auto ndc = [](uint32_t pixel, uint32_t pixels) {
+        return 2.0f * static_cast<float>(std::min(pixel, pixels)) / static_cast<float>(pixels) - 1.0f;
+    };
+    for (uint32_t z = 0; z < slices; ++z) {
+        const float depths[2] = { ndcDepth(nearZ * std::pow(farZ / nearZ, static_cast<float>(z) / slices)),
+                                  ndcDepth(nearZ * std::pow(farZ / nearZ, static_cast<float>(z + 1) / slices)) };
+        for (uint32_t y = 0; y < tiles_y; ++y) {
+            const float ys[2] = { ndc(y * tileHeight, extent.height), ndc((y + 1) * tileHeight, extent.height) };
+            for (uint32_t x = 0; x < tiles_x; ++x) {
+                const float xs[2] = { ndc(x * tileWidth, extent.width), ndc((x + 1) * tileWidth, extent.width) };
+                ClusterBounds& box = cluster_bounds_[cluster_index(x, y, z)];
+                box.min = glm::vec3(FLT_MAX);
+                box.max = glm::vec3(-FLT_MAX);
+                for (uint32_t corner = 0; corner < 8; ++corner) {
+                    glm::vec4 p = inverse * glm::vec4(xs[corner & 1], ys[(corner >> 1) & 1], depths[corner >> 2], 1.0f);
+                    glm::vec3 view = glm::vec3(p) / p.w;
+                    box.min = glm::min(box.min, view);
+                    box.max = glm::max(box.max, view);
+                }
+            }
+        }
+    }
+    bounds_projection_ = projection;
+    bounds_extent_ = extent;
+}
+
+void LightGrid::update(const Camera& camera, VkExtent2D extent, uint32_t frameSlot, std::pmr::memory_resource* temp) {
+    stats_ = {};
+    extent.width = std::max<uint32_t>(extent.width, 1);
+    extent.height = std::max<uint32_t>(extent.height, 1);
+    const float nearZ = camera.near_plane();
+    const float farZ = camera.far_plane();
+    const glm::mat4 view = camera.get_view_matrix();
+    const glm::mat4 projection = camera.get_projection_matrix();
+    if (projection != bounds_projection_ || extent.width != bounds_extent_.width || extent.height != bounds_extent_.height)
+        build_cluster_bounds(projection, extent, nearZ, farZ);
+
+    const uint32_t tileWidth = tile_size(extent.width, tiles_x);
+    const uint32_t tileHeight = tile_size(extent.height, tiles_y);
+    const float sliceScale = static_cast<float>(slices) / std::log(farZ / nearZ);
+    const float sliceBias = -sliceScale * std::log(nearZ);
+    auto sliceOf = [&](float depth) {
+        float slice = std::floor(std::log(depth) * sliceScale + sliceBias);
+        return static_cast<uint32_t>(std::clamp(slice, 0.0f, static_cast<float>(slices - 1)));
+    };
+    auto tileOf = [](float ndc, uint32_t pixels, uint32_t size, uint32_t tiles) {
+        float pixel = (ndc * 0.5f + 0.5f) * static_cast<float>(pixels);
+        return static_cast<uint32_t>(std::clamp(std::floor(pixel / size), 0.0f, static_cast<float>(tiles - 1)));
+    };
+
+    std::byte* slot = mapped_ + (frameSlot % frame_slots_) * slot_size_;
+    GpuLight* gpuLights = reinterpret_cast<GpuLight*>(slot + lights_offset_);
+    uint32_t* gpuClusters = reinterpret_cast<uint32_t*>(slot + clusters_offset_);
+    uint32_t* gpuIndices = reinterpret_cast<uint32_t*>(slot + indices_offset_);
+    const uint32_t lightCount = static_cast<uint32_t>(std::min<size_t>(lights_.size(), max_lights));
+    stats_.lights = lightCount;
+
+    // Lights to view space, and the cluster range of each one's bounding box.
+    JobSystem& jobs = JobSystem::shared();
+    std::pmr::vector<LightRange> ranges(lightCount, temp);
+    jobs.parallel_for(lightCount, 64, [&](size_t first, size_t last) {
+        for (size_t i = first; i < last; ++i) {
+            const PointLight& light = lights_[i];
+            const glm::vec3 center = glm::vec3(view * glm::vec4(light.position, 1.0f));
+            GpuLight& gpu = gpuLights[i];
+            gpu = { { center.x, center.y, center.z, light.radius },
+                    { light.color.r, light.color.g, light.color.b, light.intensity } };
+            LightRange& range = ranges[i];
+            range.center = center;
+            range.radius = light.radius;
+            range.x0 = 1;
+            range.x1 = 0;
+            float depthMin = -center.z - light.radius, depthMax = -center.z + light.radius;
+            if (light.radius <= 0.0f || depthMax < nearZ || depthMin > farZ) continue;
+            depthMin = std::max(depthMin, nearZ);
+            depthMax = std::min(depthMax, farZ);
+            // The box clipped to the depth range lies in front of the camera,
+            // so its projection is bounded by its projected corners.
+            glm::vec2 lo(FLT_MAX), hi(-FLT_MAX);
+            for (uint32_t corner = 0; corner < 8; ++corner) {
+                glm::vec4 clip = projection * glm::vec4(center.x + (corner & 1 ? light.radius : -light.radius),
+                                                        center.y + (corner & 2 ? light.radius : -light.radius),
+                                                        corner & 4 ? -depthMax : -depthMin, 1.0f);
+                glm::vec2 ndc = glm::vec2(clip) / clip.w;
+                lo = glm::min(lo, ndc);
+                hi = glm::max(hi, ndc);
+            }
+            if (hi.x < -1.0f || lo.x > 1.0f || hi.y < -1.0f || lo.y > 1.0f) continue;
+            range.x0 = tileOf(lo.x, extent.width, tileWidth, tiles_x);
+            range.x1 = tileOf(hi.x, extent.width, tileWidth, tiles_x);
+            range.y0 = tileOf(lo.y, extent.height, tileHeight, tiles_y);
+            range.y1 = tileOf(hi.y, extent.height, tileHeight, tiles_y);
+            range.z0 = sliceOf(depthMin);
+            range.z1 = sliceOf(depthMax);
+        }
+    });
+
+    // Visits the clusters of slice z each light's sphere touches. Both passes
+    // walk the lights in order, so each cluster's list ends up sorted.
+    auto forEachHit = [&](uint32_t z, auto&& visit) {
+        for (uint32_t i = 0; i < lightCount; ++i) {
+            const LightRange& light = ranges[i];
+            if (light.x0 > light.x1 || z < light.z0 || z > light.z1) continue;
+            const float radius2 = light.radius * light.radius;
+            for (uint32_t y = light.y0; y <= light.y1; ++y) {
+                for (uint32_t x = light.x0; x <= light.x1; ++x) {
+                    const uint32_t cluster = cluster_index(x, y, z);
+                    const ClusterBounds& box = cluster_bounds_[cluster];
+                    glm::vec3 d = glm::clamp(light.center, box.min, box.max) - light.center;
+                    if (glm::dot(d, d) <= radius2) visit(cluster, i);
+                }
+            }
+        }
+    };
+    // Slices own disjoint clusters, so they bin without synchronization.
+    std::pmr::vector<uint32_t> counts(cluster_count, 0u, temp);
+    jobs.parallel_for(slices, 1, [&](size_t first, size_t last) {
+        for (size_t z = first; z < last; ++z)
+            forEachHit(static_cast<uint32_t>(z), [&](uint32_t cluster, uint32_t) { ++counts[cluster]; });
+    });
+    std::pmr::vector<uint32_t> cursors(cluster_count, temp);
+    std::pmr::vector<uint32_t> ends(cluster_count, temp);
+    uint32_t offset = 0;
+    for (uint32_t cluster = 0; cluster < cluster_count; ++cluster) {
+        const uint32_t count = std::min(counts[cluster], max_light_indices - offset);
+        gpuClusters[cluster * 2 + 0] = offset;
+        gpuClusters[cluster * 2 + 1] = count;
+        cursors[cluster] = offset;
+        ends[cluster] = offset + count;
+        stats_.max_cluster_lights = std::max(stats_.max_cluster_lights, counts[cluster]);
+        stats_.dropped_indices += counts[cluster] - count;
+        offset += count;
+    }
+    stats_.light_indices = offset;
+    jobs.parallel_for(slices, 1, [&](size_t first, size_t last) {
+        for (size_t z = first; z < last; ++z) {
+            forEachHit(static_cast<uint32_t>(z), [&](uint32_t cluster, uint32_t light) {
+                if (cursors[cluster] < ends[cluster]) gpuIndices[cursors[cluster]++] = light;
+            });
+        }
+    });
+    for (const LightRange& range : ranges) stats_.visible_lights += range.x0 <= range.x1 ? 1 : 0;
+
+    GpuGridParams& params = *reinterpret_cast<GpuGridParams*>(slot);
+    params.view = view;
+    params.grid[0] = tiles_x;
+    params.grid[1] = tiles_y;
+    params.grid[2] = slices;
+    params.grid[3] = lightCount;
+    params.slice[0] = sliceScale;
+    params.slice[1] = sliceBias;
+    params.slice[2] = static_cast<float>(tileWidth);
+    params.slice[3] = static_cast<float>(tileHeight);
+    params.ambient[0] = ambient_.r;
+    params.ambient[1] = ambient_.g;
+    params.ambient[2] = ambient_.b;
+    params.ambient[3] = 0.0f;
+}
@@ -0,0 +1,107 @@
+#pragma once
+#include <vulkan/vulkan.h>
+#include <cstddef>
+#include <cstdint>
+#include <memory_resource>
+#include <vector>
+#include "Camera.h"
+
+// Omnidirectional light with a finite range; it contributes nothing beyond
+// radius, which is what lets it be binned.
+struct PointLight {
+    glm::vec3 position{0.0f};
+    float radius = 1.0f;
+    glm::vec3 color{1.0f};
+    float intensity = 1.0f;
+};
+
+struct LightGridStats {
+    uint32_t lights = 0;
+    // Lights whose bounds overlap the view frustum.
+    uint32_t visible_lights = 0;
+    uint32_t light_indices = 0;
+    uint32_t max_cluster_lights = 0;
+    // Cluster entries beyond max_light_indices; those lights are missing from
+    // some clusters this frame.
+    uint32_t dropped_indices = 0;
+};
+
+// Clustered forward lighting. The view frustum is cut into tiles_x x tiles_y
+// screen tiles and `slices` depth slices, spaced exponentially between the
+// near and far planes so clusters stay roughly cubic. Every frame, update()
+// bins the lights into the clusters their spheres touch across the shared
+// JobSystem and writes, into this frame slot's range of a persistently mapped
+// buffer, the view-space lights, one (offset, count) range per cluster and the
+// compact light index list the ranges point into. The main pass fragment
+// shader looks up its cluster from gl_FragCoord and view depth, so it only
+// shades the lights that reach it.
+//
+// Set layout (set 1 of the main pipeline): binding 0 the grid parameters
+// (uniform), 1 the lights, 2 the cluster ranges, 3 the light indices
+// (storage buffers).
+class LightGrid {
+public:
+    static constexpr uint32_t tiles_x = 16;
+    static constexpr uint32_t tiles_y = 9;
+    static constexpr uint32_t slices = 24;
+    static constexpr uint32_t cluster_count = tiles_x * tiles_y * slices;
+    static constexpr uint32_t max_lights = 4096;
+    static constexpr uint32_t max_light_indices = 1u << 17;
+
+    void init(VkDevice device, VkPhysicalDevice physicalDevice, uint32_t frameSlots);
+    void destroy();
+
+    VkDescriptorSetLayout set_layout() const { return set_layout_; }
+    VkDescriptorSet descriptor_set(uint32_t frameSlot) const { return sets_[frameSlot % frame_slots_]; }
+
+    // World-space lights, kept across frames; edit freely between frames.
+    // Lights past max_lights are ignored.
+    std::vector<PointLight>& lights() { return lights_; }
+    // Light reaching every surface regardless of the grid. White keeps the
+    // unlit look of the scene while there are no lights.
+    void set_ambient(const glm::vec3& ambient) { ambient_ = ambient; }
+
+    // Bins the lights for camera rendering to a target of extent pixels and
+    // writes the result to frameSlot's range, whose previous frame must have
+    // retired. Temporaries come from temp.
+    void update(const Camera& camera, VkExtent2D extent, uint32_t frameSlot, std::pmr::memory_resource* temp);
+    // Counters from the last update().
+    const LightGridStats& stats() const { return stats_; }
+
+private:
+    struct ClusterBounds {
+        glm::vec3 min;
+        glm::vec3 max;
+    };
+    // A light in view space and the cluster range its bounding box covers;
+    // empty (x0 > x1) when it is outside the frustum.
+    struct LightRange {
+        glm::vec3 center;
+        float radius;
+        uint32_t x0, x1, y0, y1, z0, z1;
+    };
+
+    void build_cluster_bounds(const glm::mat4& projection, VkExtent2D extent, float nearZ, float farZ);
+
+    VkDevice device_ = VK_NULL_HANDLE;
+    VkDescriptorSetLayout set_layout_ = VK_NULL_HANDLE;
+    VkDescriptorPool descriptor_pool_ = VK_NULL_HANDLE;
+    VkBuffer buffer_ = VK_NULL_HANDLE;
+    VkDeviceMemory memory_ = VK_NULL_HANDLE;
+    std::byte* mapped_ = nullptr;
+    std::vector<VkDescriptorSet> sets_;
+    uint32_t frame_slots_ = 0;
+    // Byte offsets of the regions within a frame slot's range, and its size.
+    VkDeviceSize lights_offset_ = 0;
+    VkDeviceSize clusters_offset_ = 0;
+    VkDeviceSize indices_offset_ = 0;
+    VkDeviceSize slot_size_ = 0;
+
+    std::vector<PointLight> lights_;
+    glm::vec3 ambient_{1.0f};
+    // View-space cluster boxes, rebuilt when the projection or extent changes.
+    std::vector<ClusterBounds> cluster_bounds_;
+    glm::mat4 bounds_projection_{0.0f};
+    VkExtent2D bounds_extent_{};
+    LightGridStats stats_;
+};
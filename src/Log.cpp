@@ -0,0 +1,258 @@
+#include "Log.h"
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+constexpr uint32_t ring_capacity = 512;    // records per thread, power of two
+constexpr auto drain_interval = std::chrono::milliseconds(5);
+
+uint64_t now_ns() {
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count());
+}
+
+const char* level_name(LogLevel level) {
+    switch (level) {
+    case LogLevel::trace: return "trace";
+    case LogLevel::debug: return "debug";
+    case LogLevel::info: return "info";
+    case LogLevel::warn: return "warn";
+    case LogLevel::error: return "error";
+    }
+    return "?";
+}
+
+// Single-producer / single-consumer ring. head is written by the owning
+// thread only, tail by the logger thread only.
+struct LogRing {
+    std::vector<LogRecord> records{ ring_capacity };
+    alignas(64) std::atomic<uint64_t> head{ 0 };
+    alignas(64) std::atomic<uint64_t> tail{ 0 };
+    std::atomic<uint64_t> dropped{ 0 };
+    std::atomic<bool> retired{ false };
+    uint32_t thread_id = 0;
+    uint64_t reported_dropped = 0;   // logger thread only
+};
+
+struct Entry {
+    uint64_t timestamp_ns;
+    uint32_t thread_id;
+    LogRecord record;
+};
+
+void format_record(std::string& out, const Entry& entry, uint64_t start_ns) {
+    const LogRecord& r = entry.record;
+    char prefix[96];
+    const char* file = r.file;
+    for (const char* c = r.file; *c; ++c) {
+        if (*c == '/' || *c == '\\') file = c + 1;
+    }
+    std::snprintf(prefix, sizeof(prefix), "[%10.3f] [%s] [t%u] %s:%u: ",
+                  static_cast<double>(entry.timestamp_ns - start_ns) / 1e6, level_name(r.level), entry.thread_id, file, r.line);
+    out += prefix;
+    uint32_t next = 0;
+    char buf[32];
+    for (const char* c = r.format; *c; ++c) {
+        if (c[0] != '{' || c[1] != '}' || next >= r.arg_count) {
+            out += *c;
+            continue;
+        }
+        const LogArg& arg = r.args[next++];
+        switch (arg.type) {
+        case LogArg::Type::i64: std::snprintf(buf, sizeof(buf), "%lld", static_cast<long long>(arg.i)); out += buf; break;
+        case LogArg::Type::u64: std::snprintf(buf, sizeof(buf), "%llu", static_cast<unsigned long long>(arg.u)); out += buf; break;
+        case LogArg::Type::f64: std::snprintf(buf, sizeof(buf), "%g", arg.f); out += buf; break;
+        case LogArg::Type::boolean: out += arg.u ? "true" : "false"; break;
+        case LogArg::Type::pointer: std::snprintf(buf, sizeof(buf), "%p", arg.p); out += buf; break;
+        case LogArg::Type::text: out.append(r.text + arg.text.offset, arg.text.length); break;
+        case LogArg::Type::none: break;
+        }
+        ++c;
+    }
+    out += '\n';
+}
+
+class LogBackend {
+public:
+    LogBackend() : thread_([this] { run(); }) {}
+    ~LogBackend() {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stop_ = true;
+        }
+        wake_.notify_all();
+        thread_.join();
+    }
+
+    std::shared_ptr<LogRing> register_thread() {
+        auto ring = std::make_shared<LogRing>();
+        std::lock_guard<std::mutex> lock(mutex_);
+        ring->thread_id = next_thread_id_++;
+        rings_.push_back(ring);
+        return ring;
+    }
+
+    void flush() {
+        std::unique_lock<std::mutex> lock(mutex_);
+        uint64_t ticket = ++flush_requested_;
+        wake_.notify_all();
+        flushed_.wait(lock, [&] { return flush_completed_ >= ticket || stop_; });
+    }
+
+    uint64_t dropped() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        uint64_t total = retired_dropped_;
+        for (const auto& ring : rings_) total += ring->dropped.load(std::memory_order_relaxed);
+        return total;
+    }
+
+private:
+    void run() {
+        std::vector<std::shared_ptr<LogRing>> rings;
+        std::vector<Entry> entries;
+        std::string text;
+        bool stopping = false;
+        while (!stopping) {
+            uint64_t ticket;
+            {
+                std::unique_lock<std::mutex> lock(mutex_);
+                wake_.wait_for(lock, drain_interval, [&] { return stop_ || flush_requested_ > flush_completed_; });
+                stopping = stop_;
+                ticket = flush_requested_;
+                // Rings of exited threads are dropped once empty.
+                std::erase_if(rings_, [&](const std::shared_ptr<LogRing>& ring) {
+                    bool done = ring->retired.load(std::memory_order_acquire) &&
+                                ring->head.load(std::memory_order_acquire) == ring->tail.load(std::memory_order_relaxed);
+                    if (done) retired_dropped_ += ring->dropped.load(std::memory_order_relaxed);
+                    return done;
+                });
+                rings = rings_;
+            }
+            drain(rings, entries, text);
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                flush_completed_ = ticket;
+            }
+            flushed_.notify_all();
+        }
+    }
+
+    void drain(const std::vector<std::shared_ptr<LogRing>>& rings, std::vector<Entry>& entries, std::string& text) {
+        entries.clear();
+        for (const auto& ring : rings) {
+            uint64_t tail = ring->tail.load(std::memory_order_relaxed);
+            uint64_t head = ring->head.load(std::memory_order_acquire);
+            for (; tail != head; ++tail) {
+                const LogRecord& r = ring->records[tail & (ring_capacity - 1)];
+                entries.push_back({ r.timestamp_ns, ring->thread_id, r });
+            }
+            ring->tail.store(tail, std::memory_order_release);
+            uint64_t dropped = ring->dropped.load(std::memory_order_relaxed);
+            if (dropped != ring->reported_dropped) {
+                LogRecord note;
+                note.timestamp_ns = now_ns();
+                note.format = "{} log records dropped, ring full";
+                note.file = __FILE__;
+                note.line = __LINE__;
+                note.level = LogLevel::warn;
+                note.push(dropped - ring->reported_dropped);
+                entries.push_back({ note.timestamp_ns, ring->thread_id, note });
+                ring->reported_dropped = dropped;
+            }
+        }
+        if (entries.empty()) return;
+        // Rings are drained one after another; merge them into time order.
+        std::stable_sort(entries.begin(), entries.end(),
+                         [](const Entry& a, const Entry& b) { return a.timestamp_ns < b.timestamp_ns; });
+        text.clear();
+        std::string errors;
+        for (const Entry& entry : entries) {
+            format_record(entry.record.level >= LogLevel::warn ? errors : text, entry, start_ns_);
+        }
+        if (!text.empty()) {
+            std::fwrite(text.data(), 1, text.size(), stdout);
+            std::fflush(stdout);
+        }
+        if (!errors.empty()) std::fwrite(errors.data(), 1, errors.size(), stderr);
+    }
+
+    std::mutex mutex_;
+    std::condition_variable wake_;
+    std::condition_variable flushed_;
+    std::vector<std::shared_ptr<LogRing>> rings_;
+    uint32_t next_thread_id_ = 0;
+    uint64_t flush_requested_ = 0;
+    uint64_t flush_completed_ = 0;
+    uint64_t retired_dropped_ = 0;
+    uint64_t start_ns_ = now_ns();
+    bool stop_ = false;
+    std::thread thread_;
+};
+
+LogBackend& backend() {
+    static LogBackend instance;
+    return instance;
+}
+
+// Owned by each producing thread; marks the ring retired on thread exit so
+// the backend can release it after the last records are written.
+struct ThreadRing {
+    std::shared_ptr<LogRing> ring;
+    ~ThreadRing() {
+        if (ring) ring->retired.store(true, std::memory_order_release);
+    }
+};
+
+thread_local ThreadRing t_ring;
+
+LogRing& thread_ring() {
+    if (!t_ring.ring) t_ring.ring = backend().register_thread();
+    return *t_ring.ring;
+}
+}
+
+LogRecord* Logger::acquire_record() {
+    LogRing& ring = thread_ring();
+    uint64_t head = ring.head.load(std::memory_order_relaxed);
+    if (head - ring.tail.load(std::memory_order_acquire) >= ring_capacity) {
+        ring.dropped.fetch_add(1, std::memory_order_relaxed);
+        return nullptr;
+    }
+    LogRecord* record = &ring.records[head & (ring_capacity - 1)];
+    record->timestamp_ns = now_ns();
+    return record;
+}
+
+void Logger::commit_record() {
+    LogRing& ring = *t_ring.ring;
+    ring.head.store(ring.head.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+}
+
+void Logger::flush() {
+    backend().flush();
+}
+
+uint64_t Logger::dropped() {
+    return backend().dropped();
+}
+
+bool LogRateLimit::allow(uint32_t per_second) {
+    // Steady-clock seconds fit in 32 bits for over a century of uptime.
+    const uint64_t now = static_cast<uint32_t>(now_ns() / 1000000000ull);
+    uint64_t state = state_.load(std::memory_order_relaxed);
+    for (;;) {
+        // A caller that read the clock just before another thread opened the
+        // next second counts against that one rather than reopening its own.
+        uint64_t second = std::max(state >> 32, now);
+        uint64_t count = second == state >> 32 ? state & 0xffffffffu : 0;
+        if (count >= per_second) return false;
+        if (state_.compare_exchange_weak(state, second << 32 | (count + 1), std::memory_order_relaxed)) return true;
+    }
+}
@@ -0,0 +1,173 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+#include <type_traits>
+
+// Levels below ENGINE_LOG_LEVEL are compiled out entirely (0 = trace ... 4 = error).
+#ifndef ENGINE_LOG_LEVEL
+#ifdef NDEBUG
+#define ENGINE_LOG_LEVEL 2
+#else
+#define ENGINE_LOG_LEVEL 0
+#endif
+#endif
+
+enum class LogLevel : uint8_t { trace = 0, debug, info, warn, error };
+
+constexpr int log_compiled_level = ENGINE_LOG_LEVEL;
+constexpr bool log_level_compiled(LogLevel level) { return static_cast<int>(level) >= log_compiled_level; }
+
+// One type-erased log argument. Strings are copied into the record so the
+// caller's buffer may die before the record is formatted.
+struct LogArg {
+    enum class Type : uint8_t { none, i64, u64, f64, boolean, pointer, text };
+    struct TextRange { uint16_t offset; uint16_t length; };
+    Type type = Type::none;
+    union {
+        int64_t i;
+        uint64_t u;
+        double f;
+        const void* p;
+        TextRange text;
+    };
+    LogArg() : u(0) {}
+};
+
+// Fixed-size entry in a per-thread ring. The format string is kept by pointer
+// and must be a string literal; formatting happens on the logger thread.
+struct LogRecord {
+    static constexpr uint32_t max_args = 8;
+    static constexpr uint32_t text_capacity = 128;
+
+    uint64_t timestamp_ns = 0;
+    const char* format = nullptr;
+    const char* file = nullptr;
+    uint32_t line = 0;
+    LogLevel level = LogLevel::info;
+    uint8_t arg_count = 0;
+    uint16_t text_used = 0;
+    LogArg args[max_args];
+    char text[text_capacity];
+
+    template <typename T>
+    void push(const T& value);
+};
+
+// Logging front end. Each producing thread owns a lock-free single-producer /
+// single-consumer ring; a background thread drains all rings, orders the
+// records by time, formats "{}" placeholders and writes them out. A full ring
+// drops the record (and counts it) instead of blocking the caller.
+//
+// Use the LOG_* macros: a site below ENGINE_LOG_LEVEL costs nothing, a site
+// filtered by the runtime level costs one compare and branch.
+class Logger {
+public:
+    static void set_level(LogLevel level) { runtime_level_.store(static_cast<uint8_t>(level), std::memory_order_relaxed); }
+    static LogLevel level() { return static_cast<LogLevel>(runtime_level_.load(std::memory_order_relaxed)); }
+    static bool enabled(LogLevel level) {
+        return static_cast<uint8_t>(level) >= runtime_level_.load(std::memory_order_relaxed);
+    }
+
+    // Blocks until every record queued before the call has been written.
+    static void flush();
+    // Total records dropped because a thread's ring was full.
+    static uint64_t dropped();
+
+    template <typename... Args>
+    static void write(LogLevel level, const char* file, uint32_t line, const char* format, const Args&... args) {
+        static_assert(sizeof...(Args) <= LogRecord::max_args, "Too many log arguments");
+        LogRecord* record = acquire_record();
+        if (!record) return;
+        record->level = level;
+        record->file = file;
+        record->line = line;
+        record->format = format;
+        record->arg_count = 0;
+        record->text_used = 0;
+        (record->push(args), ...);
+        commit_record();
+    }
+
+private:
+    static LogRecord* acquire_record();
+    static void commit_record();
+
+    // Trace and debug sites stay compiled in for debug builds but are off
+    // until set_level() asks for them.
+    static inline std::atomic<uint8_t> runtime_level_{ static_cast<uint8_t>(std::max(ENGINE_LOG_LEVEL, 2)) };
+};
+
+// Per-site limiter for LOG_RATE_LIMITED: lets at most per_second records
+// through in each second of the steady clock, exactly, from any number of
+// threads.
+class LogRateLimit {
+public:
+    bool allow(uint32_t per_second);
+private:
+    // Current second in the high 32 bits, records let through in it in the
+    // low 32, so both change in one compare-exchange.
+    std::atomic<uint64_t> state_{ 0 };
+};
+
+template <typename T>
+void LogRecord::push(const T& value) {
+    LogArg& arg = args[arg_count++];
+    using U = std::decay_t<T>;
+    if constexpr (std::is_same_v<U, bool>) {
+        arg.type = LogArg::Type::boolean;
+        arg.u = value ? 1 : 0;
+    } else if constexpr (std::is_enum_v<U>) {
+        arg.type = LogArg::Type::i64;
+        arg.i = static_cast<int64_t>(value);
+    } else if constexpr (std::is_integral_v<U> && std::is_signed_v<U>) {
+        arg.type = LogArg::Type::i64;
+        arg.i = value;
+    } else if constexpr (std::is_integral_v<U>) {
+        arg.type = LogArg::Type::u64;
+        arg.u = value;
+    } else if constexpr (std::is_floating_point_v<U>) {
+        arg.type = LogArg::Type::f64;
+        arg.f = value;
+    } else if constexpr (std::is_convertible_v<const T&, std::string_view>) {
+        std::string_view s(value);
+        size_t n = std::min<size_t>(s.size(), text_capacity - text_used);
+        s.copy(text + text_used, n);
+        arg.type = LogArg::Type::text;
+        arg.text.offset = text_used;
+        arg.text.length = static_cast<uint16_t>(n);
+        text_used = static_cast<uint16_t>(text_used + n);
+    } else if constexpr (std::is_pointer_v<U>) {
+        arg.type = LogArg::Type::pointer;
+        arg.p = static_cast<const void*>(value);
+    } else {
+        static_assert(std::is_pointer_v<U>, "Unsupported log argument type");
+    }
+}
+
+#define ENGINE_LOG_AT(lvl, ...)                                                              \
+    do {                                                                                     \
+        if constexpr (log_level_compiled(lvl)) {                                              \
+            if (Logger::enabled(lvl)) Logger::write(lvl, __FILE__, __LINE__, __VA_ARGS__);   \
+        }                                                                                    \
+    } while (0)
+
+#define LOG_TRACE(...) ENGINE_LOG_AT(LogLevel::trace, __VA_ARGS__)
+#define LOG_DEBUG(...) ENGINE_LOG_AT(LogLevel::debug, __VA_ARGS__)
+#define LOG_INFO(...) ENGINE_LOG_AT(LogLevel::info, __VA_ARGS__)
+#define LOG_WARN(...) ENGINE_LOG_AT(LogLevel::warn, __VA_ARGS__)
+#define LOG_ERROR(...) ENGINE_LOG_AT(LogLevel::error, __VA_ARGS__)
+
+// Like LOG_* but lets at most per_second records from this site through.
+#define LOG_RATE_LIMITED(lvl, per_second, ...)                                               \
+    do {                                                                                     \
+        if constexpr (log_level_compiled(lvl)) {                                              \
+            if (Logger::enabled(lvl)) {                                                      \
+                static LogRateLimit log_rate_limit_;                                         \
+                if (log_rate_limit_.allow(per_second))                                       \
+                    Logger::write(lvl, __FILE__, __LINE__, __VA_ARGS__);                     \
+            }                                                                                \
+        }                                                                                    \
+    } while (0)
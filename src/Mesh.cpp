@@ -1,4 +1,7 @@
 #include "Mesh.h"
+#include "DeletionQueue.h"
+#include "GpuMemory.h"
+#include "Log.h"
 #include <cstring>
 #include <stdexcept>
 
@@ -24,23 +27,56 @@ void create_buffer(VkDevice device, VkPhysicalDevice physicalDevice, VkDeviceSiz
             break;
         }
     }
-    if (vkAllocateMemory(device, &allocInfo, nullptr, &bufferMemory) != VK_SUCCESS)
+    if (GpuMemory::shared().allocate(device, allocInfo, GpuMemoryCategory::mesh, &bufferMemory) != VK_SUCCESS)
         throw std::runtime_error("Failed to allocate buffer memory");
     vkBindBufferMemory(device, buffer, bufferMemory, 0);
 }
 }
 
-Mesh::Mesh(VkDevice device, VkPhysicalDevice physicalDevice, const std::vector<Vertex>& vertices, const std::vector<uint32_t>& indices)
-    : device_(device), physicalDevice_(physicalDevice), index_count_(indices.size()) {
+Mesh::Mesh(VkDevice device, VkPhysicalDevice physicalDevice, const std::vector<Vertex>& vertices, const std::vector<uint32_t>& indices,
+           DeletionQueue* deletionQueue)
+    : device_(device), physicalDevice_(physicalDevice), deletion_queue_(deletionQueue), index_count_(indices.size()) {
+    for (const Vertex& v : vertices) bounds_.expand(glm::vec3(v.pos[0], v.pos[1], v.pos[2]));
+    lods_.push_back({0, static_cast<uint32_t>(indices.size()), 0.0f});
     create_vertex_buffer(vertices);
     create_index_buffer(indices);
+    create_position_buffer(vertices);
+}
+
+Mesh::Mesh(VkDevice device, VkPhysicalDevice physicalDevice, const CookedMesh& cooked, DeletionQueue* deletionQueue)
+    : device_(device), physicalDevice_(physicalDevice), deletion_queue_(deletionQueue), index_count_(cooked.lods.empty() ? 0 : cooked.lods[0].index_count), lods_(cooked.lods) {
+    for (const Vertex& v : cooked.vertices) bounds_.expand(glm::vec3(v.pos[0], v.pos[1], v.pos[2]));
+    create_vertex_buffer(cooked.vertices);
+    create_index_buffer(cooked.indices);
+    create_position_buffer(cooked.vertices);
 }
 
 Mesh::~Mesh() {
-    if (vertex_buffer_ != VK_NULL_HANDLE) vkDestroyBuffer(device_, vertex_buffer_, nullptr);
-    if (vertex_memory_ != VK_NULL_HANDLE) vkFreeMemory(device_, vertex_memory_, nullptr);
-    if (index_buffer_ != VK_NULL_HANDLE) vkDestroyBuffer(device_, index_buffer_, nullptr);
-    if (index_memory_ != VK_NULL_HANDLE) vkFreeMemory(device_, index_memory_, nullptr);
+    release();
+}
+
+void Mesh::release() {
+    if (deletion_queue_) {
+        deletion_queue_->destroy_buffer(vertex_buffer_);
+        deletion_queue_->free_memory(vertex_memory_);
+        deletion_queue_->destroy_buffer(index_buffer_);
+        deletion_queue_->free_memory(index_memory_);
+        deletion_queue_->destroy_buffer(position_buffer_);
+        deletion_queue_->free_memory(position_memory_);
+    } else {
+        if (vertex_buffer_ != VK_NULL_HANDLE) vkDestroyBuffer(device_, vertex_buffer_, nullptr);
+        GpuMemory::shared().free(device_, vertex_memory_);
+        if (index_buffer_ != VK_NULL_HANDLE) vkDestroyBuffer(device_, index_buffer_, nullptr);
+        GpuMemory::shared().free(device_, index_memory_);
+        if (position_buffer_ != VK_NULL_HANDLE) vkDestroyBuffer(device_, position_buffer_, nullptr);
+        GpuMemory::shared().free(device_, position_memory_);
+    }
+    vertex_buffer_ = VK_NULL_HANDLE;
+    vertex_memory_ = VK_NULL_HANDLE;
+    index_buffer_ = VK_NULL_HANDLE;
+    index_memory_ = VK_NULL_HANDLE;
+    position_buffer_ = VK_NULL_HANDLE;
+    position_memory_ = VK_NULL_HANDLE;
 }
 
 Mesh::Mesh(Mesh&& other) noexcept {
@@ -49,17 +85,26 @@ Mesh::Mesh(Mesh&& other) noexcept {
 
 Mesh& Mesh::operator=(Mesh&& other) noexcept {
     if (this != &other) {
+        release();
         device_ = other.device_;
         physicalDevice_ = other.physicalDevice_;
+        deletion_queue_ = other.deletion_queue_;
         vertex_buffer_ = other.vertex_buffer_;
         vertex_memory_ = other.vertex_memory_;
         index_buffer_ = other.index_buffer_;
         index_memory_ = other.index_memory_;
+        position_buffer_ = other.position_buffer_;
+        position_memory_ = other.position_memory_;
         index_count_ = other.index_count_;
+        bounds_ = other.bounds_;
+        lods_ = std::move(other.lods_);
+        bvh_ = std::move(other.bvh_);
         other.vertex_buffer_ = VK_NULL_HANDLE;
         other.vertex_memory_ = VK_NULL_HANDLE;
         other.index_buffer_ = VK_NULL_HANDLE;
         other.index_memory_ = VK_NULL_HANDLE;
+        other.position_buffer_ = VK_NULL_HANDLE;
+        other.position_memory_ = VK_NULL_HANDLE;
         other.index_count_ = 0;
     }
     return *this;
@@ -83,9 +128,21 @@ void Mesh::create_index_buffer(const std::vector<uint32_t>& indices) {
     vkUnmapMemory(device_, index_memory_);
 }
 
+void Mesh::create_position_buffer(const std::vector<Vertex>& vertices) {
+    VkDeviceSize bufferSize = sizeof(float) * 3 * vertices.size();
+    create_buffer(device_, physicalDevice_, bufferSize, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, position_buffer_, position_memory_);
+    void* data;
+    vkMapMemory(device_, position_memory_, 0, bufferSize, 0, &data);
+    float* positions = static_cast<float*>(data);
+    for (size_t i = 0; i < vertices.size(); ++i) {
+        memcpy(positions + i * 3, vertices[i].pos, sizeof(float) * 3);
+    }
+    vkUnmapMemory(device_, position_memory_);
+}
+
 void Mesh::bind(VkCommandBuffer cmdBuffer) const {
     if (vertex_buffer_ == VK_NULL_HANDLE) {
-        printf("[Mesh::bind] vertex_buffer_ is VK_NULL_HANDLE, skipping bind.\n");
+        LOG_RATE_LIMITED(LogLevel::warn, 4, "Mesh::bind: vertex buffer is VK_NULL_HANDLE, skipping bind");
         return;
     }
     VkBuffer vertexBuffers[] = { vertex_buffer_ };
@@ -94,15 +151,15 @@ void Mesh::bind(VkCommandBuffer cmdBuffer) const {
     if (index_buffer_ != VK_NULL_HANDLE) {
         vkCmdBindIndexBuffer(cmdBuffer, index_buffer_, 0, VK_INDEX_TYPE_UINT32);
     } else {
-        printf("[Mesh::bind] index_buffer_ is VK_NULL_HANDLE, not binding index buffer.\n");
+        LOG_RATE_LIMITED(LogLevel::warn, 4, "Mesh::bind: index buffer is VK_NULL_HANDLE, not binding it");
     }
 }
 
-void Mesh::draw(VkCommandBuffer cmdBuffer) const {
-    if (index_buffer_ != VK_NULL_HANDLE && index_count_ > 0) {
-        vkCmdDrawIndexed(cmdBuffer, static_cast<uint32_t>(index_count_), 1, 0, 0, 0);
-        printf("[Mesh::draw] Drawing mesh with %zu indices.\n", index_count_);
+void Mesh::draw(VkCommandBuffer cmdBuffer, uint32_t lod) const {
+    if (index_buffer_ != VK_NULL_HANDLE && lod < lods_.size() && lods_[lod].index_count > 0) {
+        vkCmdDrawIndexed(cmdBuffer, lods_[lod].index_count, 1, lods_[lod].first_index, 0, 0);
+        LOG_TRACE("Mesh::draw: {} indices (LOD {})", lods_[lod].index_count, lod);
     } else {
-        printf("[Mesh::draw] index_buffer_ is VK_NULL_HANDLE or index_count_ == 0, skipping draw.\n");
+        LOG_RATE_LIMITED(LogLevel::warn, 4, "Mesh::draw: no index buffer or no indices, skipping draw");
     }
 } 
\ No newline at end of file
@@ -1,18 +1,25 @@
 #pragma once
 #include <vulkan/vulkan.h>
 #include <vector>
+#include "Vertex.h"
+#include "Bounds.h"
+#include "Bvh.h"
+#include "MeshCooker.h"
 
-struct Vertex {
-    float pos[2];
-    float color[3];
-    float uv[2];
-};
+class DeletionQueue;
 
+// With a deletion queue the buffers are handed to it on destruction, so a mesh
+// can be released while frames drawing it are in flight; without one they are
+// destroyed immediately and the device has to be idle.
 class Mesh {
 public:
     Mesh(VkDevice device, VkPhysicalDevice physicalDevice,
          const std::vector<Vertex>& vertices,
-         const std::vector<uint32_t>& indices);
+         const std::vector<uint32_t>& indices,
+         DeletionQueue* deletionQueue = nullptr);
+    // Uploads every LOD's index range into one index buffer.
+    Mesh(VkDevice device, VkPhysicalDevice physicalDevice, const CookedMesh& cooked,
+         DeletionQueue* deletionQueue = nullptr);
     ~Mesh();
 
     Mesh(const Mesh&) = delete;
@@ -21,18 +28,40 @@ public:
     Mesh& operator=(Mesh&& other) noexcept;
 
     void bind(VkCommandBuffer cmdBuffer) const;
-    void draw(VkCommandBuffer cmdBuffer) const;
+    void draw(VkCommandBuffer cmdBuffer, uint32_t lod = 0) const;
+    // Index count of LOD 0.
     size_t index_count() const { return index_count_; }
+    uint32_t lod_count() const { return static_cast<uint32_t>(lods_.size()); }
+    const MeshLod& lod(uint32_t level) const { return lods_[level]; }
+    const std::vector<MeshLod>& lods() const { return lods_; }
+    VkBuffer vertex_buffer() const { return vertex_buffer_; }
+    VkBuffer index_buffer() const { return index_buffer_; }
+    // Tightly packed float3 positions for depth-only passes.
+    VkBuffer position_buffer() const { return position_buffer_; }
+    // Object-space bounds of the vertex positions.
+    const Aabb& bounds() const { return bounds_; }
+    // Triangle BVH for ray queries, or null if none was attached. Meshes only
+    // used for drawing skip the build.
+    const TriangleBvh* bvh() const { return bvh_.nodes().empty() ? nullptr : &bvh_; }
+    void set_bvh(TriangleBvh bvh) { bvh_ = std::move(bvh); }
 
 private:
     void create_vertex_buffer(const std::vector<Vertex>& vertices);
     void create_index_buffer(const std::vector<uint32_t>& indices);
+    void create_position_buffer(const std::vector<Vertex>& vertices);
+    void release();
 
     VkDevice device_ = VK_NULL_HANDLE;
     VkPhysicalDevice physicalDevice_ = VK_NULL_HANDLE;
+    DeletionQueue* deletion_queue_ = nullptr;
     VkBuffer vertex_buffer_ = VK_NULL_HANDLE;
     VkDeviceMemory vertex_memory_ = VK_NULL_HANDLE;
     VkBuffer index_buffer_ = VK_NULL_HANDLE;
     VkDeviceMemory index_memory_ = VK_NULL_HANDLE;
+    VkBuffer position_buffer_ = VK_NULL_HANDLE;
+    VkDeviceMemory position_memory_ = VK_NULL_HANDLE;
     size_t index_count_ = 0;
-}; 
\ No newline at end of file
+    Aabb bounds_;
+    std::vector<MeshLod> lods_;
+    TriangleBvh bvh_;
+};
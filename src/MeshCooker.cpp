@@ -0,0 +1,457 @@
+#include "MeshCooker.h"
+#include <algorithm>
+#include <array>
+#include <cfloat>
+#include <cmath>
+#include <cstring>
+#include <functional>
+#include <iterator>
+#include <queue>
+#include <unordered_map>
+#include <glm/glm.hpp>
+#include "Bounds.h"
+#include "JobSystem.h"
+
+namespace {
+// Symmetric 4x4 error quadric (upper triangle) summing squared plane distances.
+struct Quadric {
+    double a00 = 0, a01 = 0, a02 = 0, a03 = 0;
+    double a11 = 0, a12 = 0, a13 = 0;
+    double a22 = 0, a23 = 0;
+    double a33 = 0;
+
+    void add_plane(const glm::dvec3& n, double d, double weight) {
+        a00 += weight * n.x * n.x; a01 += weight * n.x * n.y; a02 += weight * n.x * n.z; a03 += weight * n.x * d;
+        a11 += weight * n.y * n.y; a12 += weight * n.y * n.z; a13 += weight * n.y * d;
+        a22 += weight * n.z * n.z; a23 += weight * n.z * d;
+        a33 += weight * d * d;
+    }
+    Quadric& operator+=(const Quadric& q) {
+        a00 += q.a00; a01 += q.a01; a02 += q.a02; a03 += q.a03;
+        a11 += q.a11; a12 += q.a12; a13 += q.a13;
+        a22 += q.a22; a23 += q.a23;
+        a33 += q.a33;
+        return *this;
+    }
+    double evaluate(const glm::dvec3& p) const {
+        double e = a00 * p.x * p.x + 2 * a01 * p.x * p.y + 2 * a02 * p.x * p.z + 2 * a03 * p.x
+                 + a11 * p.y * p.y + 2 * a12 * p.y * p.z + 2 * a13 * p.y
+                 + a22 * p.z * p.z + 2 * a23 * p.z
+                 + a33;
+        return std::max(e, 0.0);
+    }
+};
+
+// Border and attribute-seam edges are held in place by a plane through the
+// edge, perpendicular to its triangle, weighted above the surface planes.
+constexpr double border_weight = 10.0;
+// Collapses that tilt a surviving triangle's normal beyond this cosine are
+// rejected, which also rules out flipped triangles.
+constexpr double min_normal_cosine = 0.2;
+
+// Neighbouring positions of a vertex with the number of live triangles that
+// share the edge to each; an edge used once lies on the mesh border.
+using Link = std::vector<std::pair<uint32_t, uint32_t>>;
+
+struct PositionKey {
+    uint32_t x, y, z;
+    bool operator==(const PositionKey&) const = default;
+};
+
+struct PositionKeyHash {
+    size_t operator()(const PositionKey& k) const {
+        return (static_cast<size_t>(k.x) * 73856093u) ^ (static_cast<size_t>(k.y) * 19349663u) ^ (static_cast<size_t>(k.z) * 83492791u);
+    }
+};
+
+PositionKey position_key(const Vertex& v) {
+    PositionKey key;
+    // + 0.0f folds -0 into +0 so both weld.
+    float x = v.pos[0] + 0.0f, y = v.pos[1] + 0.0f, z = v.pos[2] + 0.0f;
+    memcpy(&key.x, &x, 4);
+    memcpy(&key.y, &y, 4);
+    memcpy(&key.z, &z, 4);
+    return key;
+}
+
+uint64_t edge_key(uint32_t a, uint32_t b) {
+    return a < b ? (static_cast<uint64_t>(a) << 32) | b : (static_cast<uint64_t>(b) << 32) | a;
+}
+
+struct Collapse {
+    double cost;
+    uint32_t from, to;
+    uint32_t from_version, to_version;
+    bool operator>(const Collapse& other) const { return cost > other.cost; }
+};
+
+// Vertices are welded by position; collapses move a position onto a neighbour
+// and remap each corner to the target's vertex with the closest attributes, so
+// the output only references existing vertices.
+//
+// The quadrics only order the collapses. The error bound is checked against
+// the largest distance from the moved vertex to the source triangle planes it
+// has absorbed (Ronfard-Rossignac), without the border weighting.
+class Simplifier {
+public:
+    Simplifier(const std::vector<Vertex>& vertices, const std::vector<uint32_t>& indices);
+    void run(size_t target_index_count, double max_distance);
+    std::vector<uint32_t> result() const;
+    double max_distance() const { return max_distance_; }
+
+private:
+    glm::dvec3 corner_position(uint32_t tri, uint32_t corner) const { return positions_[wedge_position_[tris_[tri][corner]]]; }
+    void push_edge(uint32_t a, uint32_t b);
+    double plane_distance(uint32_t from, uint32_t to) const;
+    void link(uint32_t position, Link& out) const;
+    bool link_condition(uint32_t from, uint32_t to) const;
+    bool collapse_valid(uint32_t from, uint32_t to) const;
+    void collapse(uint32_t from, uint32_t to);
+    uint32_t nearest_wedge(uint32_t wedge, uint32_t position) const;
+
+    const std::vector<Vertex>& vertices_;
+    std::vector<glm::dvec3> positions_;
+    std::vector<uint32_t> wedge_position_;
+    // Vertices sharing each position, as offsets into wedges_.
+    std::vector<uint32_t> wedge_offsets_;
+    std::vector<uint32_t> wedges_;
+    std::vector<std::array<uint32_t, 3>> tris_;
+    std::vector<char> tri_alive_;
+    size_t alive_tris_ = 0;
+    std::vector<std::vector<uint32_t>> position_tris_;
+    std::vector<Quadric> quadrics_;
+    // Unit normal and offset of each source triangle, and the sorted source
+    // triangles whose planes each position must stay close to.
+    std::vector<glm::dvec4> planes_;
+    std::vector<std::vector<uint32_t>> position_planes_;
+    std::vector<char> position_alive_;
+    std::vector<uint32_t> version_;
+    std::priority_queue<Collapse, std::vector<Collapse>, std::greater<Collapse>> heap_;
+    double max_distance_ = 0.0;
+};
+
+Simplifier::Simplifier(const std::vector<Vertex>& vertices, const std::vector<uint32_t>& indices) : vertices_(vertices) {
+    std::unordered_map<PositionKey, uint32_t, PositionKeyHash> welded;
+    welded.reserve(vertices.size());
+    wedge_position_.resize(vertices.size());
+    for (size_t v = 0; v < vertices.size(); ++v) {
+        auto [it, inserted] = welded.emplace(position_key(vertices[v]), static_cast<uint32_t>(positions_.size()));
+        if (inserted) positions_.emplace_back(vertices[v].pos[0], vertices[v].pos[1], vertices[v].pos[2]);
+        wedge_position_[v] = it->second;
+    }
+    const size_t positionCount = positions_.size();
+    wedge_offsets_.assign(positionCount + 1, 0);
+    for (uint32_t p : wedge_position_) ++wedge_offsets_[p + 1];
+    for (size_t p = 0; p < positionCount; ++p) wedge_offsets_[p + 1] += wedge_offsets_[p];
+    wedges_.resize(vertices.size());
+    std::vector<uint32_t> fill(wedge_offsets_.begin(), wedge_offsets_.end() - 1);
+    for (uint32_t v = 0; v < vertices.size(); ++v) wedges_[fill[wedge_position_[v]]++] = v;
+
+    quadrics_.resize(positionCount);
+    position_planes_.resize(positionCount);
+    position_tris_.resize(positionCount);
+    position_alive_.assign(positionCount, 1);
+    version_.assign(positionCount, 0);
+
+    // Wedge edges used by a single triangle are mesh borders or attribute seams.
+    std::unordered_map<uint64_t, std::pair<uint32_t, uint32_t>> wedgeEdges;
+    wedgeEdges.reserve(indices.size());
+    for (size_t i = 0; i + 2 < indices.size(); i += 3) {
+        std::array<uint32_t, 3> tri{indices[i], indices[i + 1], indices[i + 2]};
+        uint32_t p0 = wedge_position_[tri[0]], p1 = wedge_position_[tri[1]], p2 = wedge_position_[tri[2]];
+        if (p0 == p1 || p1 == p2 || p0 == p2) continue;
+        uint32_t t = static_cast<uint32_t>(tris_.size());
+        tris_.push_back(tri);
+        glm::dvec3 n = glm::cross(positions_[p1] - positions_[p0], positions_[p2] - positions_[p0]);
+        double length = glm::length(n);
+        planes_.emplace_back(0.0);
+        if (length > 0.0) {
+            n /= length;
+            double d = -glm::dot(n, positions_[p0]);
+            planes_.back() = glm::dvec4(n, d);
+            for (uint32_t p : {p0, p1, p2}) {
+                quadrics_[p].add_plane(n, d, 1.0);
+                position_planes_[p].push_back(t);
+            }
+        }
+        for (uint32_t p : {p0, p1, p2}) position_tris_[p].push_back(t);
+        for (uint32_t k = 0; k < 3; ++k) {
+            ++wedgeEdges.try_emplace(edge_key(tri[k], tri[(k + 1) % 3]), t, 0u).first->second.second;
+        }
+    }
+    tri_alive_.assign(tris_.size(), 1);
+    alive_tris_ = tris_.size();
+
+    for (const auto& [key, use] : wedgeEdges) {
+        if (use.second != 1) continue;
+        uint32_t a = wedge_position_[static_cast<uint32_t>(key >> 32)];
+        uint32_t b = wedge_position_[static_cast<uint32_t>(key)];
+        glm::dvec3 n = glm::cross(corner_position(use.first, 1) - corner_position(use.first, 0),
+                                  corner_position(use.first, 2) - corner_position(use.first, 0));
+        glm::dvec3 edgeNormal = glm::cross(positions_[b] - positions_[a], n);
+        double length = glm::length(edgeNormal);
+        if (length <= 0.0) continue;
+        edgeNormal /= length;
+        double d = -glm::dot(edgeNormal, positions_[a]);
+        quadrics_[a].add_plane(edgeNormal, d, border_weight);
+        quadrics_[b].add_plane(edgeNormal, d, border_weight);
+    }
+
+    for (uint32_t t = 0; t < tris_.size(); ++t) {
+        for (uint32_t k = 0; k < 3; ++k) {
+            uint32_t a = wedge_position_[tris_[t][k]];
+            uint32_t b = wedge_position_[tris_[t][(k + 1) % 3]];
+            // Interior edges show up in two triangles; queue them once.
+            if (a < b) push_edge(a, b);
+        }
+    }
+}
+
+void Simplifier::push_edge(uint32_t a, uint32_t b) {
+    Quadric q = quadrics_[a];
+    q += quadrics_[b];
+    // Both directions go in; if one is rejected as a fold, the other may pass.
+    heap_.push({q.evaluate(positions_[b]), a, b, version_[a], version_[b]});
+    heap_.push({q.evaluate(positions_[a]), b, a, version_[b], version_[a]});
+}
+
+double Simplifier::plane_distance(uint32_t from, uint32_t to) const {
+    const glm::dvec3& p = positions_[to];
+    double distance = 0.0;
+    for (uint32_t position : {from, to}) {
+        for (uint32_t t : position_planes_[position]) {
+            distance = std::max(distance, std::abs(glm::dot(glm::dvec3(planes_[t]), p) + planes_[t].w));
+        }
+    }
+    return distance;
+}
+
+void Simplifier::link(uint32_t position, Link& out) const {
+    out.clear();
+    for (uint32_t t : position_tris_[position]) {
+        if (!tri_alive_[t]) continue;
+        for (uint32_t k = 0; k < 3; ++k) {
+            uint32_t n = wedge_position_[tris_[t][k]];
+            if (n != position) out.emplace_back(n, 1u);
+        }
+    }
+    std::sort(out.begin(), out.end());
+    size_t unique = 0;
+    for (size_t i = 0; i < out.size(); ++i) {
+        if (unique > 0 && out[unique - 1].first == out[i].first) ++out[unique - 1].second;
+        else out[unique++] = out[i];
+    }
+    out.resize(unique);
+}
+
+// Edge (from, to) may only collapse when the vertices adjacent to both ends
+// are exactly the apexes of the triangles on the edge, with the border
+// counted as one more shared vertex. Otherwise the collapse would pinch the
+// surface or fold two triangles onto each other.
+bool Simplifier::link_condition(uint32_t from, uint32_t to) const {
+    thread_local Link fromLink, toLink;
+    link(from, fromLink);
+    link(to, toLink);
+    auto onBorder = [](const Link& l) {
+        return std::any_of(l.begin(), l.end(), [](const auto& n) { return n.second == 1; });
+    };
+
+    uint32_t edgeTris = 0;
+    for (const auto& [n, count] : fromLink) {
+        if (n == to) edgeTris = count;
+    }
+    if (edgeTris == 0 || edgeTris > 2) return false;
+    if (edgeTris == 2 && onBorder(fromLink) && onBorder(toLink)) return false;
+
+    size_t shared = 0;
+    auto a = fromLink.begin(), b = toLink.begin();
+    while (a != fromLink.end() && b != toLink.end()) {
+        if (a->first < b->first) ++a;
+        else if (b->first < a->first) ++b;
+        else { ++shared; ++a; ++b; }
+    }
+    // Each triangle on the edge contributes one apex to both links.
+    if (shared != edgeTris) return false;
+
+    // The link condition still lets a tetrahedron collapse into two
+    // back-to-back triangles; reject any collapse that leaves two triangles
+    // around the target on the same pair of other vertices.
+    thread_local std::vector<uint64_t> fans;
+    fans.clear();
+    for (uint32_t position : {from, to}) {
+        for (uint32_t t : position_tris_[position]) {
+            if (!tri_alive_[t]) continue;
+            uint32_t other[2], count = 0;
+            bool onEdge = false;
+            for (uint32_t k = 0; k < 3; ++k) {
+                uint32_t p = wedge_position_[tris_[t][k]];
+                onEdge |= p == (position == from ? to : from);
+                if (p != position && count < 2) other[count++] = p;
+            }
+            if (!onEdge) fans.push_back(edge_key(other[0], other[1]));
+        }
+    }
+    std::sort(fans.begin(), fans.end());
+    return std::adjacent_find(fans.begin(), fans.end()) == fans.end();
+}
+
+bool Simplifier::collapse_valid(uint32_t from, uint32_t to) const {
+    if (!link_condition(from, to)) return false;
+    for (uint32_t t : position_tris_[from]) {
+        if (!tri_alive_[t]) continue;
+        glm::dvec3 p[3];
+        bool touchesTarget = false;
+        for (uint32_t k = 0; k < 3; ++k) {
+            uint32_t position = wedge_position_[tris_[t][k]];
+            touchesTarget |= position == to;
+            p[k] = positions_[position];
+        }
+        // Triangles on the collapsed edge disappear.
+        if (touchesTarget) continue;
+        glm::dvec3 before = glm::cross(p[1] - p[0], p[2] - p[0]);
+        for (uint32_t k = 0; k < 3; ++k) {
+            if (wedge_position_[tris_[t][k]] == from) p[k] = positions_[to];
+        }
+        glm::dvec3 after = glm::cross(p[1] - p[0], p[2] - p[0]);
+        double lengths = glm::length(before) * glm::length(after);
+        if (lengths <= 0.0 || glm::dot(before, after) < min_normal_cosine * lengths) return false;
+    }
+    return true;
+}
+
+uint32_t Simplifier::nearest_wedge(uint32_t wedge, uint32_t position) const {
+    uint32_t begin = wedge_offsets_[position], end = wedge_offsets_[position + 1];
+    if (end - begin == 1) return wedges_[begin];
+    const Vertex& v = vertices_[wedge];
+    uint32_t best = wedges_[begin];
+    float bestDistance = FLT_MAX;
+    for (uint32_t i = begin; i < end; ++i) {
+        const Vertex& c = vertices_[wedges_[i]];
+        float du = c.uv[0] - v.uv[0], dv = c.uv[1] - v.uv[1];
+        float dr = c.color[0] - v.color[0], dg = c.color[1] - v.color[1], db = c.color[2] - v.color[2];
+        float distance = du * du + dv * dv + dr * dr + dg * dg + db * db;
+        if (distance < bestDistance) {
+            bestDistance = distance;
+            best = wedges_[i];
+        }
+    }
+    return best;
+}
+
+void Simplifier::collapse(uint32_t from, uint32_t to) {
+    position_alive_[from] = 0;
+    ++version_[to];
+    quadrics_[to] += quadrics_[from];
+    std::vector<uint32_t> planes;
+    planes.reserve(position_planes_[from].size() + position_planes_[to].size());
+    std::set_union(position_planes_[from].begin(), position_planes_[from].end(),
+                   position_planes_[to].begin(), position_planes_[to].end(), std::back_inserter(planes));
+    position_planes_[to] = std::move(planes);
+    position_planes_[from].clear();
+    position_planes_[from].shrink_to_fit();
+    for (uint32_t t : position_tris_[from]) {
+        if (!tri_alive_[t]) continue;
+        auto& tri = tris_[t];
+        bool touchesTarget = false;
+        for (uint32_t k = 0; k < 3; ++k) touchesTarget |= wedge_position_[tri[k]] == to;
+        if (touchesTarget) {
+            tri_alive_[t] = 0;
+            --alive_tris_;
+            continue;
+        }
+        for (uint32_t k = 0; k < 3; ++k) {
+            if (wedge_position_[tri[k]] == from) tri[k] = nearest_wedge(tri[k], to);
+        }
+        position_tris_[to].push_back(t);
+    }
+    position_tris_[from].clear();
+    position_tris_[from].shrink_to_fit();
+
+    auto& around = position_tris_[to];
+    around.erase(std::remove_if(around.begin(), around.end(), [&](uint32_t t) { return !tri_alive_[t]; }), around.end());
+    std::vector<uint32_t> neighbours;
+    for (uint32_t t : around) {
+        for (uint32_t k = 0; k < 3; ++k) {
+            uint32_t position = wedge_position_[tris_[t][k]];
+            if (position != to) neighbours.push_back(position);
+        }
+    }
+    std::sort(neighbours.begin(), neighbours.end());
+    neighbours.erase(std::unique(neighbours.begin(), neighbours.end()), neighbours.end());
+    for (uint32_t n : neighbours) push_edge(to, n);
+}
+
+void Simplifier::run(size_t target_index_count, double max_distance) {
+    while (alive_tris_ * 3 > target_index_count && !heap_.empty()) {
+        Collapse c = heap_.top();
+        heap_.pop();
+        if (!position_alive_[c.from] || !position_alive_[c.to]) continue;
+        if (version_[c.from] != c.from_version || version_[c.to] != c.to_version) continue;
+        // Rejected edges stay out of the heap until a neighbouring collapse
+        // requeues them, so a costly edge doesn't end the run early.
+        double distance = plane_distance(c.from, c.to);
+        if (distance > max_distance) continue;
+        if (!collapse_valid(c.from, c.to)) continue;
+        collapse(c.from, c.to);
+        max_distance_ = std::max(max_distance_, distance);
+    }
+}
+
+std::vector<uint32_t> Simplifier::result() const {
+    std::vector<uint32_t> indices;
+    indices.reserve(alive_tris_ * 3);
+    // Surviving triangles keep their source order, and with it most of the
+    // source's vertex cache locality.
+    for (uint32_t t = 0; t < tris_.size(); ++t) {
+        if (tri_alive_[t]) indices.insert(indices.end(), tris_[t].begin(), tris_[t].end());
+    }
+    return indices;
+}
+}
+
+std::vector<uint32_t> MeshCooker::simplify(const std::vector<Vertex>& vertices, const std::vector<uint32_t>& indices,
+                                           size_t target_index_count, float max_error, float* out_error) {
+    Simplifier simplifier(vertices, indices);
+    simplifier.run(target_index_count, max_error);
+    if (out_error) *out_error = static_cast<float>(simplifier.max_distance());
+    return simplifier.result();
+}
+
+CookedMesh MeshCooker::cook(const std::vector<Vertex>& vertices, const std::vector<uint32_t>& indices, const LodSettings& settings) {
+    CookedMesh cooked;
+    cooked.vertices = vertices;
+    cooked.indices = indices;
+    cooked.lods.push_back({0, static_cast<uint32_t>(indices.size()), 0.0f});
+
+    std::vector<size_t> targets;
+    size_t target = indices.size();
+    for (uint32_t level = 1; level < settings.max_lods; ++level) {
+        target = static_cast<size_t>(static_cast<float>(target) * settings.reduction) / 3 * 3;
+        if (target / 3 < settings.min_triangles) break;
+        targets.push_back(target);
+    }
+    if (targets.empty()) return cooked;
+
+    Aabb bounds;
+    for (const Vertex& v : vertices) bounds.expand(glm::vec3(v.pos[0], v.pos[1], v.pos[2]));
+    float maxError = settings.max_error * glm::length(bounds.max - bounds.min);
+
+    std::vector<std::vector<uint32_t>> levels(targets.size());
+    std::vector<float> errors(targets.size(), 0.0f);
+    JobSystem::shared().parallel_for(targets.size(), 1, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i) levels[i] = simplify(vertices, indices, targets[i], maxError, &errors[i]);
+    });
+
+    size_t previous = indices.size();
+    float error = 0.0f;
+    for (size_t i = 0; i < levels.size(); ++i) {
+        // Once the error bound stops the simplifier, further levels barely
+        // shrink and aren't worth a switch.
+        if (levels[i].empty() || levels[i].size() * 20 > previous * 17) break;
+        error = std::max(error, errors[i]);
+        cooked.lods.push_back({static_cast<uint32_t>(cooked.indices.size()), static_cast<uint32_t>(levels[i].size()), error});
+        cooked.indices.insert(cooked.indices.end(), levels[i].begin(), levels[i].end());
+        previous = levels[i].size();
+    }
+    return cooked;
+}
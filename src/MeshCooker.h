@@ -0,0 +1,49 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "Vertex.h"
+
+// One level of detail: a range of the mesh's index buffer. All levels index
+// the same vertex buffer. error is the object-space distance the level may
+// deviate from the full-resolution surface.
+struct MeshLod {
+    uint32_t first_index = 0;
+    uint32_t index_count = 0;
+    float error = 0.0f;
+};
+
+// Vertices plus the concatenated index ranges of every level, LOD 0 first.
+struct CookedMesh {
+    std::vector<Vertex> vertices;
+    std::vector<uint32_t> indices;
+    std::vector<MeshLod> lods;
+};
+
+struct LodSettings {
+    uint32_t max_lods = 5;
+    // Index count of each level relative to the previous one.
+    float reduction = 0.5f;
+    // Largest allowed error, relative to the bounds diagonal.
+    float max_error = 0.25f;
+    uint32_t min_triangles = 64;
+};
+
+// Offline processing of imported geometry into GPU-ready data.
+class MeshCooker {
+public:
+    // Builds the LOD chain. Levels are simplified from the source mesh
+    // independently, one per JobSystem worker; the chain ends early when a
+    // level stops shrinking or would exceed max_error.
+    static CookedMesh cook(const std::vector<Vertex>& vertices, const std::vector<uint32_t>& indices,
+                           const LodSettings& settings = {});
+
+    // Quadric error metric edge collapse (Garland-Heckbert) restricted to
+    // half-edge collapses, so the result indexes the original vertices.
+    // Collapses that break the link condition or would move a vertex further
+    // than max_error from any source plane it covers are skipped; stops at
+    // target_index_count or when none are left. out_error receives the
+    // largest such vertex-to-plane distance.
+    static std::vector<uint32_t> simplify(const std::vector<Vertex>& vertices, const std::vector<uint32_t>& indices,
+                                          size_t target_index_count, float max_error, float* out_error = nullptr);
+};
@@ -0,0 +1,59 @@
+#include "Morph.h"
+#include <cmath>
+#include <cstddef>
+
+#if defined(__SSE2__) || defined(_M_X64) || defined(_M_AMD64)
+#include <emmintrin.h>
+#define MORPH_USE_SSE 1
+#endif
+
+namespace {
+// Weights below this leave no visible trace.
+constexpr float min_weight = 1e-5f;
+
+bool active(const float* weights, uint32_t target) {
+    return weights && std::abs(weights[target]) >= min_weight;
+}
+
+void reset_target(const Vertex* base, const MorphTarget& target, Vertex* dst) {
+    for (uint32_t v : target.vertices) {
+        dst[v].pos[0] = base[v].pos[0];
+        dst[v].pos[1] = base[v].pos[1];
+        dst[v].pos[2] = base[v].pos[2];
+    }
+}
+
+void add_target(const MorphTarget& target, float weight, Vertex* dst) {
+    const float* delta = target.deltas.data();
+    const uint32_t count = target.size();
+#if MORPH_USE_SSE
+    // The four-wide load covers pos and color[0]; the delta's fourth lane is
+    // zero so color is written back unchanged.
+    static_assert(offsetof(Vertex, color) == offsetof(Vertex, pos) + 3 * sizeof(float));
+    const __m128 w = _mm_set1_ps(weight);
+    for (uint32_t i = 0; i < count; ++i) {
+        float* p = dst[target.vertices[i]].pos;
+        _mm_storeu_ps(p, _mm_add_ps(_mm_loadu_ps(p), _mm_mul_ps(_mm_loadu_ps(delta + i * 4), w)));
+    }
+#else
+    for (uint32_t i = 0; i < count; ++i) {
+        float* p = dst[target.vertices[i]].pos;
+        p[0] += delta[i * 4 + 0] * weight;
+        p[1] += delta[i * 4 + 1] * weight;
+        p[2] += delta[i * 4 + 2] * weight;
+    }
+#endif
+}
+}
+
+void apply_morph_targets(const Vertex* base, const MorphTargetSet& morphs, const float* weights,
+                         const float* previousWeights, Vertex* dst) {
+    const uint32_t count = morphs.target_count();
+    // Return every vertex touched last time or this time to its base position.
+    for (uint32_t t = 0; t < count; ++t) {
+        if (active(previousWeights, t) || active(weights, t)) reset_target(base, morphs.targets[t], dst);
+    }
+    for (uint32_t t = 0; t < count; ++t) {
+        if (active(weights, t)) add_target(morphs.targets[t], weights[t], dst);
+    }
+}
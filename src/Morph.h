@@ -0,0 +1,33 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "Vertex.h"
+
+// Position deltas of one blend shape, stored only for the vertices it moves.
+// deltas hold four floats per entry (xyz, 0) so the blend can add them with
+// one vector operation.
+struct MorphTarget {
+    std::string name;
+    std::vector<uint32_t> vertices;
+    std::vector<float> deltas;
+
+    uint32_t size() const { return static_cast<uint32_t>(vertices.size()); }
+};
+
+// Blend shapes of one mesh with the weights the mesh declares by default.
+struct MorphTargetSet {
+    std::vector<MorphTarget> targets;
+    std::vector<float> default_weights;
+
+    uint32_t target_count() const { return static_cast<uint32_t>(targets.size()); }
+    bool empty() const { return targets.empty(); }
+};
+
+// Blends weighted deltas onto base. dst must hold the result of the previous
+// call for this mesh (with previousWeights), or a copy of base (with null
+// previousWeights). Only vertices touched by targets active now or in the
+// previous call are rewritten; targets whose weight is (almost) zero cost
+// nothing. Uses SSE where available.
+void apply_morph_targets(const Vertex* base, const MorphTargetSet& morphs, const float* weights,
+                         const float* previousWeights, Vertex* dst);
@@ -0,0 +1,24 @@
+#include "NullWindow.h"
+#include <stdexcept>
+
+NullWindow::NullWindow(uint32_t width, uint32_t height, uint64_t max_frames) : max_frames_(max_frames) {
+    width_ = width;
+    height_ = height;
+}
+
+bool NullWindow::process_messages() {
+    ++frame_;
+    return max_frames_ == 0 || frame_ <= max_frames_;
+}
+
+VkSurfaceKHR NullWindow::create_surface(VkInstance instance) const {
+    auto createHeadlessSurface = reinterpret_cast<PFN_vkCreateHeadlessSurfaceEXT>(
+        vkGetInstanceProcAddr(instance, "vkCreateHeadlessSurfaceEXT"));
+    if (!createHeadlessSurface) throw std::runtime_error("VK_EXT_headless_surface not available");
+    VkHeadlessSurfaceCreateInfoEXT createInfo{};
+    createInfo.sType = VK_STRUCTURE_TYPE_HEADLESS_SURFACE_CREATE_INFO_EXT;
+    VkSurfaceKHR surface = VK_NULL_HANDLE;
+    if (createHeadlessSurface(instance, &createInfo, nullptr, &surface) != VK_SUCCESS)
+        throw std::runtime_error("Failed to create headless surface");
+    return surface;
+}
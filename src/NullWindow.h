@@ -0,0 +1,18 @@
+#pragma once
+#include "Window.h"
+
+// Window without a display, presenting through VK_EXT_headless_surface. Lets
+// the real renderer run under perf, valgrind or sanitizers on machines
+// without a desktop. Closes itself after max_frames pumps (0 = never).
+class NullWindow : public Window {
+public:
+    NullWindow(uint32_t width, uint32_t height, uint64_t max_frames = 0);
+
+    bool process_messages() override;
+    const char* surface_extension() const override { return VK_EXT_HEADLESS_SURFACE_EXTENSION_NAME; }
+    VkSurfaceKHR create_surface(VkInstance instance) const override;
+
+private:
+    uint64_t max_frames_;
+    uint64_t frame_ = 0;
+};
@@ -0,0 +1,245 @@
+#include "OcclusionCuller.h"
+#include "JobSystem.h"
+#include <algorithm>
+#include <cmath>
+
+#if defined(__SSE2__) || defined(_M_X64) || defined(_M_AMD64)
+#include <emmintrin.h>
+#define OCCLUSION_USE_SSE 1
+#endif
+
+namespace {
+// Clip-space w below this is treated as crossing the near plane.
+constexpr float near_w_epsilon = 1e-5f;
+// Keeps occluders from culling themselves through depth quantization.
+constexpr float depth_bias = 1e-4f;
+
+inline float edge(const glm::vec3& a, const glm::vec3& b, float px, float py) {
+    return (b.x - a.x) * (py - a.y) - (b.y - a.y) * (px - a.x);
+}
+}
+
+std::shared_ptr<OccluderGeometry> OccluderGeometry::from_vertices(const std::vector<Vertex>& vertices, const std::vector<uint32_t>& indices) {
+    auto geometry = std::make_shared<OccluderGeometry>();
+    geometry->positions.reserve(vertices.size());
+    for (const Vertex& v : vertices) geometry->positions.emplace_back(v.pos[0], v.pos[1], v.pos[2]);
+    geometry->indices = indices;
+    return geometry;
+}
+
+OcclusionCuller::OcclusionCuller(uint32_t width, uint32_t height) {
+    tiles_x_ = std::max<uint32_t>(1, (width + tile_width - 1) / tile_width);
+    tiles_y_ = std::max<uint32_t>(1, (height + tile_height - 1) / tile_height);
+    width_ = tiles_x_ * tile_width;
+    height_ = tiles_y_ * tile_height;
+    tile_bins_.resize(tiles_x_ * tiles_y_);
+    uint32_t w = width_, h = height_;
+    for (;;) {
+        hiz_sizes_.push_back({ w, h });
+        hiz_.emplace_back(static_cast<size_t>(w) * h, 1.0f);
+        if (w == 1 && h == 1) break;
+        w = std::max(1u, (w + 1) / 2);
+        h = std::max(1u, (h + 1) / 2);
+    }
+}
+
+void OcclusionCuller::begin_frame(const glm::mat4& viewProj) {
+    view_proj_ = viewProj;
+    triangles_.clear();
+    for (auto& bin : tile_bins_) bin.clear();
+    stats_ = {};
+}
+
+void OcclusionCuller::add_occluder(const OccluderGeometry& geometry, const glm::mat4& world) {
+    glm::mat4 m = view_proj_ * world;
+    const float half_w = 0.5f * static_cast<float>(width_);
+    const float half_h = 0.5f * static_cast<float>(height_);
+    const size_t tri_count = geometry.indices.size() / 3;
+    stats_.occluder_triangles += static_cast<uint32_t>(tri_count);
+    for (size_t t = 0; t < tri_count; ++t) {
+        ScreenTriangle tri;
+        bool clipped = false;
+        for (int k = 0; k < 3; ++k) {
+            uint32_t index = geometry.indices[t * 3 + k];
+            if (index >= geometry.positions.size()) { clipped = true; break; }
+            glm::vec4 clip = m * glm::vec4(geometry.positions[index], 1.0f);
+            // Dropping near-clipped triangles only removes occlusion, never
+            // adds it, so it stays conservative.
+            if (clip.w < near_w_epsilon) { clipped = true; break; }
+            float inv_w = 1.0f / clip.w;
+            tri.v[k] = glm::vec3((clip.x * inv_w + 1.0f) * half_w,
+                                 (clip.y * inv_w + 1.0f) * half_h,
+                                 std::clamp(clip.z * inv_w, 0.0f, 1.0f));
+        }
+        if (clipped) continue;
+        float area = edge(tri.v[0], tri.v[1], tri.v[2].x, tri.v[2].y);
+        if (std::abs(area) < 1e-8f) continue;
+        // Occluders are rasterized double sided; normalize the winding.
+        if (area < 0.0f) std::swap(tri.v[1], tri.v[2]);
+        float fmin_x = std::min({ tri.v[0].x, tri.v[1].x, tri.v[2].x });
+        float fmax_x = std::max({ tri.v[0].x, tri.v[1].x, tri.v[2].x });
+        float fmin_y = std::min({ tri.v[0].y, tri.v[1].y, tri.v[2].y });
+        float fmax_y = std::max({ tri.v[0].y, tri.v[1].y, tri.v[2].y });
+        tri.min_x = std::max(0, static_cast<int>(std::floor(fmin_x)));
+        tri.min_y = std::max(0, static_cast<int>(std::floor(fmin_y)));
+        tri.max_x = std::min(static_cast<int>(width_) - 1, static_cast<int>(std::ceil(fmax_x)));
+        tri.max_y = std::min(static_cast<int>(height_) - 1, static_cast<int>(std::ceil(fmax_y)));
+        if (tri.min_x > tri.max_x || tri.min_y > tri.max_y) continue;
+        triangles_.push_back(tri);
+    }
+}
+
+void OcclusionCuller::rasterize() {
+    // Bin triangles into the tiles their bounding rectangle touches.
+    for (uint32_t i = 0; i < triangles_.size(); ++i) {
+        const ScreenTriangle& tri = triangles_[i];
+        uint32_t tx0 = tri.min_x / tile_width, tx1 = tri.max_x / tile_width;
+        uint32_t ty0 = tri.min_y / tile_height, ty1 = tri.max_y / tile_height;
+        for (uint32_t ty = ty0; ty <= ty1; ++ty)
+            for (uint32_t tx = tx0; tx <= tx1; ++tx)
+                tile_bins_[ty * tiles_x_ + tx].push_back(i);
+    }
+    stats_.rasterized_triangles = static_cast<uint32_t>(triangles_.size());
+    // Tiles own disjoint pixels, so workers never touch the same memory.
+    JobSystem::shared().parallel_for(tile_bins_.size(), 1, [this](size_t begin, size_t end) {
+        for (size_t tile = begin; tile < end; ++tile) rasterize_tile(static_cast<uint32_t>(tile));
+    });
+    build_hiz();
+}
+
+void OcclusionCuller::rasterize_tile(uint32_t tile) {
+    std::vector<float>& depth = hiz_[0];
+    const int tile_x0 = static_cast<int>((tile % tiles_x_) * tile_width);
+    const int tile_y0 = static_cast<int>((tile / tiles_x_) * tile_height);
+    const int tile_x1 = tile_x0 + static_cast<int>(tile_width) - 1;
+    const int tile_y1 = tile_y0 + static_cast<int>(tile_height) - 1;
+    for (int y = tile_y0; y <= tile_y1; ++y)
+        std::fill_n(&depth[static_cast<size_t>(y) * width_ + tile_x0], tile_width, 1.0f);
+
+    for (uint32_t index : tile_bins_[tile]) {
+        const ScreenTriangle& tri = triangles_[index];
+        const glm::vec3& v0 = tri.v[0];
+        const glm::vec3& v1 = tri.v[1];
+        const glm::vec3& v2 = tri.v[2];
+        const float area = edge(v0, v1, v2.x, v2.y);
+        const float inv_area = 1.0f / area;
+        // Per-pixel x steps of the edge functions and interpolated depth
+        const float w0_dx = -(v2.y - v1.y);
+        const float w1_dx = -(v0.y - v2.y);
+        const float w2_dx = -(v1.y - v0.y);
+        const float z_dx = (w0_dx * v0.z + w1_dx * v1.z + w2_dx * v2.z) * inv_area;
+        // A thousandth of a pixel of slack closes float cracks along edges
+        // shared by two triangles; one cracked pixel would otherwise poison a
+        // whole max-depth HiZ texel.
+        const float w0_bias = 1e-3f * (std::abs(v2.x - v1.x) + std::abs(v2.y - v1.y));
+        const float w1_bias = 1e-3f * (std::abs(v0.x - v2.x) + std::abs(v0.y - v2.y));
+        const float w2_bias = 1e-3f * (std::abs(v1.x - v0.x) + std::abs(v1.y - v0.y));
+
+        // Start on a 4-pixel boundary so SIMD spans never leave the tile.
+        const int x0 = std::max(tile_x0, tri.min_x) & ~3;
+        const int x1 = std::min(tile_x1, tri.max_x);
+        const int y0 = std::max(tile_y0, tri.min_y);
+        const int y1 = std::min(tile_y1, tri.max_y);
+        const float px = static_cast<float>(x0) + 0.5f;
+        for (int y = y0; y <= y1; ++y) {
+            const float py = static_cast<float>(y) + 0.5f;
+            float w0 = edge(v1, v2, px, py);
+            float w1 = edge(v2, v0, px, py);
+            float w2 = edge(v0, v1, px, py);
+            float z = (w0 * v0.z + w1 * v1.z + w2 * v2.z) * inv_area;
+            w0 += w0_bias;
+            w1 += w1_bias;
+            w2 += w2_bias;
+            float* row = &depth[static_cast<size_t>(y) * width_];
+#if OCCLUSION_USE_SSE
+            const __m128 lane = _mm_set_ps(3.0f, 2.0f, 1.0f, 0.0f);
+            __m128 e0 = _mm_add_ps(_mm_set1_ps(w0), _mm_mul_ps(lane, _mm_set1_ps(w0_dx)));
+            __m128 e1 = _mm_add_ps(_mm_set1_ps(w1), _mm_mul_ps(lane, _mm_set1_ps(w1_dx)));
+            __m128 e2 = _mm_add_ps(_mm_set1_ps(w2), _mm_mul_ps(lane, _mm_set1_ps(w2_dx)));
+            __m128 zs = _mm_add_ps(_mm_set1_ps(z), _mm_mul_ps(lane, _mm_set1_ps(z_dx)));
+            const __m128 e0_step = _mm_set1_ps(w0_dx * 4.0f);
+            const __m128 e1_step = _mm_set1_ps(w1_dx * 4.0f);
+            const __m128 e2_step = _mm_set1_ps(w2_dx * 4.0f);
+            const __m128 z_step = _mm_set1_ps(z_dx * 4.0f);
+            const __m128 zero = _mm_setzero_ps();
+            for (int x = x0; x <= x1; x += 4) {
+                __m128 inside = _mm_and_ps(_mm_and_ps(_mm_cmpge_ps(e0, zero), _mm_cmpge_ps(e1, zero)), _mm_cmpge_ps(e2, zero));
+                if (_mm_movemask_ps(inside)) {
+                    __m128 current = _mm_loadu_ps(row + x);
+                    __m128 nearer = _mm_min_ps(current, zs);
+                    _mm_storeu_ps(row + x, _mm_or_ps(_mm_and_ps(inside, nearer), _mm_andnot_ps(inside, current)));
+                }
+                e0 = _mm_add_ps(e0, e0_step);
+                e1 = _mm_add_ps(e1, e1_step);
+                e2 = _mm_add_ps(e2, e2_step);
+                zs = _mm_add_ps(zs, z_step);
+            }
+#else
+            for (int x = x0; x <= x1; ++x) {
+                if (w0 >= 0.0f && w1 >= 0.0f && w2 >= 0.0f && z < row[x]) row[x] = z;
+                w0 += w0_dx;
+                w1 += w1_dx;
+                w2 += w2_dx;
+                z += z_dx;
+            }
+#endif
+        }
+    }
+}
+
+void OcclusionCuller::build_hiz() {
+    for (size_t level = 1; level < hiz_.size(); ++level) {
+        const std::vector<float>& src = hiz_[level - 1];
+        std::vector<float>& dst = hiz_[level];
+        const glm::uvec2 src_size = hiz_sizes_[level - 1];
+        const glm::uvec2 dst_size = hiz_sizes_[level];
+        for (uint32_t y = 0; y < dst_size.y; ++y) {
+            uint32_t sy0 = std::min(y * 2, src_size.y - 1), sy1 = std::min(y * 2 + 1, src_size.y - 1);
+            for (uint32_t x = 0; x < dst_size.x; ++x) {
+                uint32_t sx0 = std::min(x * 2, src_size.x - 1), sx1 = std::min(x * 2 + 1, src_size.x - 1);
+                dst[y * dst_size.x + x] = std::max(std::max(src[sy0 * src_size.x + sx0], src[sy0 * src_size.x + sx1]),
+                                                   std::max(src[sy1 * src_size.x + sx0], src[sy1 * src_size.x + sx1]));
+            }
+        }
+    }
+}
+
+bool OcclusionCuller::is_visible(const Aabb& worldBounds) const {
+    if (!worldBounds.valid()) return false;
+    float min_x = FLT_MAX, min_y = FLT_MAX, max_x = -FLT_MAX, max_y = -FLT_MAX, min_z = FLT_MAX;
+    for (int i = 0; i < 8; ++i) {
+        glm::vec3 corner((i & 1) ? worldBounds.max.x : worldBounds.min.x,
+                         (i & 2) ? worldBounds.max.y : worldBounds.min.y,
+                         (i & 4) ? worldBounds.max.z : worldBounds.min.z);
+        glm::vec4 clip = view_proj_ * glm::vec4(corner, 1.0f);
+        // Boxes reaching behind the camera are always treated as visible.
+        if (clip.w < near_w_epsilon) return true;
+        float inv_w = 1.0f / clip.w;
+        float sx = (clip.x * inv_w + 1.0f) * 0.5f * static_cast<float>(width_);
+        float sy = (clip.y * inv_w + 1.0f) * 0.5f * static_cast<float>(height_);
+        min_x = std::min(min_x, sx); max_x = std::max(max_x, sx);
+        min_y = std::min(min_y, sy); max_y = std::max(max_y, sy);
+        min_z = std::min(min_z, clip.z * inv_w);
+    }
+    int x0 = std::max(0, static_cast<int>(std::floor(min_x)));
+    int y0 = std::max(0, static_cast<int>(std::floor(min_y)));
+    int x1 = std::min(static_cast<int>(width_) - 1, static_cast<int>(std::floor(max_x)));
+    int y1 = std::min(static_cast<int>(height_) - 1, static_cast<int>(std::floor(max_y)));
+    if (x0 > x1 || y0 > y1) return false; // off screen
+
+    // Pick the level where the rectangle spans at most 2x2 texels.
+    uint32_t span = static_cast<uint32_t>(std::max(x1 - x0, y1 - y0)) + 1;
+    size_t level = 0;
+    while (span > 2 && level + 1 < hiz_.size()) {
+        span = (span + 1) / 2;
+        ++level;
+    }
+    const std::vector<float>& depth = hiz_[level];
+    const glm::uvec2 size = hiz_sizes_[level];
+    uint32_t lx0 = static_cast<uint32_t>(x0) >> level, lx1 = std::min(size.x - 1, static_cast<uint32_t>(x1) >> level);
+    uint32_t ly0 = static_cast<uint32_t>(y0) >> level, ly1 = std::min(size.y - 1, static_cast<uint32_t>(y1) >> level);
+    for (uint32_t y = ly0; y <= ly1; ++y)
+        for (uint32_t x = lx0; x <= lx1; ++x)
+            if (min_z - depth_bias <= depth[y * size.x + x]) return true;
+    return false;
+}
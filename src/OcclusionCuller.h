@@ -0,0 +1,71 @@
+#pragma once
+#include <cstdint>
+#include <memory>
+#include <vector>
+#include <glm/glm.hpp>
+#include "Bounds.h"
+#include "Vertex.h"
+
+// Simplified CPU-side triangle list used to rasterize an occluder. Occluders
+// should be low-poly stand-ins that lie inside the visible surface.
+struct OccluderGeometry {
+    std::vector<glm::vec3> positions;
+    std::vector<uint32_t> indices;
+
+    static std::shared_ptr<OccluderGeometry> from_vertices(const std::vector<Vertex>& vertices, const std::vector<uint32_t>& indices);
+};
+
+// Software occlusion culling. Occluders are rasterized on the CPU into a small
+// depth buffer (screen split into tiles, tiles rasterized in parallel with SSE
+// where available), a max-depth HiZ pyramid is built on top, and occludee
+// bounds are tested against the pyramid. Everything runs without a GPU.
+//
+// Usage per view: begin_frame(), add_occluder() for each occluder,
+// rasterize(), then is_visible() for each occludee.
+class OcclusionCuller {
+public:
+    struct Stats {
+        uint32_t occluder_triangles = 0;
+        uint32_t rasterized_triangles = 0;
+    };
+
+    // width/height are rounded up to whole tiles.
+    OcclusionCuller(uint32_t width = 256, uint32_t height = 128);
+
+    void begin_frame(const glm::mat4& viewProj);
+    void add_occluder(const OccluderGeometry& geometry, const glm::mat4& world);
+    void rasterize();
+    // False only when the box is completely behind rasterized occluders.
+    bool is_visible(const Aabb& worldBounds) const;
+
+    uint32_t width() const { return width_; }
+    uint32_t height() const { return height_; }
+    // Level 0 of the pyramid; nearest depth per pixel in [0, 1], 1 = empty.
+    const std::vector<float>& depth_buffer() const { return hiz_[0]; }
+    const Stats& stats() const { return stats_; }
+
+private:
+    static constexpr uint32_t tile_width = 32;
+    static constexpr uint32_t tile_height = 16;
+
+    struct ScreenTriangle {
+        glm::vec3 v[3];   // x, y in pixels, z in [0, 1]
+        int min_x, min_y, max_x, max_y;
+    };
+
+    void rasterize_tile(uint32_t tile);
+    void build_hiz();
+
+    uint32_t width_;
+    uint32_t height_;
+    uint32_t tiles_x_;
+    uint32_t tiles_y_;
+    glm::mat4 view_proj_{1.0f};
+    std::vector<ScreenTriangle> triangles_;
+    std::vector<std::vector<uint32_t>> tile_bins_;
+    // hiz_[0] is the full resolution depth buffer, each further level keeps
+    // the farthest depth of a 2x2 block of the level below.
+    std::vector<std::vector<float>> hiz_;
+    std::vector<glm::uvec2> hiz_sizes_;
+    Stats stats_;
+};
@@ -0,0 +1,235 @@
+#include "Profiler.h"
+#include <algorithm>
+#include <fstream>
+#include <stdexcept>
+
+namespace {
+constexpr VkQueryPipelineStatisticFlags statistics_flags =
+    VK_QUERY_PIPELINE_STATISTIC_INPUT_ASSEMBLY_VERTICES_BIT |
+    VK_QUERY_PIPELINE_STATISTIC_INPUT_ASSEMBLY_PRIMITIVES_BIT |
+    VK_QUERY_PIPELINE_STATISTIC_VERTEX_SHADER_INVOCATIONS_BIT |
+    VK_QUERY_PIPELINE_STATISTIC_CLIPPING_PRIMITIVES_BIT |
+    VK_QUERY_PIPELINE_STATISTIC_FRAGMENT_SHADER_INVOCATIONS_BIT;
+constexpr uint32_t statistics_count = 5;
+constexpr uint32_t queries_per_slot = Profiler::max_gpu_scopes * 2;
+
+void write_json_string(std::ofstream& out, const char* s) {
+    out << '"';
+    for (; *s; ++s) {
+        if (*s == '"' || *s == '\\') out << '\\';
+        out << *s;
+    }
+    out << '"';
+}
+}
+
+void Profiler::init(VkDevice device, VkPhysicalDevice physicalDevice, uint32_t slotCount, uint32_t frameSlots,
+                    uint32_t timestampValidBits, bool pipelineStatistics) {
+    device_ = device;
+    slots_.assign(slotCount, {});
+    for (SlotRecording& rec : slots_) {
+        rec.scopes.reserve(max_gpu_scopes);
+        rec.open.reserve(max_gpu_scopes);
+    }
+    pending_.assign(frameSlots, {});
+    VkPhysicalDeviceProperties props;
+    vkGetPhysicalDeviceProperties(physicalDevice, &props);
+    timestamp_period_ns_ = props.limits.timestampPeriod;
+    timestamp_mask_ = timestampValidBits >= 64 ? ~0ull : ((1ull << timestampValidBits) - 1);
+    if (timestampValidBits > 0) {
+        VkQueryPoolCreateInfo poolInfo{};
+        poolInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+        poolInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+        poolInfo.queryCount = slotCount * queries_per_slot;
+        if (vkCreateQueryPool(device_, &poolInfo, nullptr, &timestamp_pool_) != VK_SUCCESS)
+            throw std::runtime_error("Failed to create timestamp query pool");
+    }
+    if (pipelineStatistics) {
+        VkQueryPoolCreateInfo poolInfo{};
+        poolInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+        poolInfo.queryType = VK_QUERY_TYPE_PIPELINE_STATISTICS;
+        poolInfo.queryCount = slotCount;
+        poolInfo.pipelineStatistics = statistics_flags;
+        if (vkCreateQueryPool(device_, &poolInfo, nullptr, &statistics_pool_) != VK_SUCCESS)
+            throw std::runtime_error("Failed to create pipeline statistics query pool");
+    }
+}
+
+void Profiler::destroy() {
+    if (timestamp_pool_ != VK_NULL_HANDLE) vkDestroyQueryPool(device_, timestamp_pool_, nullptr);
+    if (statistics_pool_ != VK_NULL_HANDLE) vkDestroyQueryPool(device_, statistics_pool_, nullptr);
+    timestamp_pool_ = VK_NULL_HANDLE;
+    statistics_pool_ = VK_NULL_HANDLE;
+}
+
+double Profiler::now_us() const {
+    return std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - epoch_).count();
+}
+
+Profiler::Frame* Profiler::find_frame(uint64_t index) {
+    for (size_t i = frame_count_; i-- > 0;) {
+        Frame& frame = frames_[ring_index(i)];
+        if (frame.index == index) return &frame;
+    }
+    return nullptr;
+}
+
+void Profiler::begin_frame() {
+    if (!enabled_) return;
+    if (frames_.empty()) {
+        frames_.resize(max_frames);
+        for (Frame& frame : frames_) {
+            frame.cpu.reserve(max_cpu_scopes);
+            frame.gpu.reserve(max_gpu_scopes);
+        }
+        cpu_stack_.reserve(max_cpu_scopes);
+        newest_ = max_frames - 1;
+    }
+    // Reuses the oldest frame, keeping its event capacity.
+    newest_ = (newest_ + 1) % max_frames;
+    frame_count_ = std::min(frame_count_ + 1, max_frames);
+    Frame& frame = frames_[newest_];
+    frame.index = ++frame_index_;
+    frame.cpu.clear();
+    frame.gpu.clear();
+    frame.stats = {};
+    frame.gpu_resolved = false;
+    cpu_stack_.clear();
+}
+
+void Profiler::begin_cpu_scope(const char* name) {
+    if (!enabled_ || frame_count_ == 0) return;
+    cpu_stack_.emplace_back(name, now_us());
+}
+
+void Profiler::end_cpu_scope() {
+    if (!enabled_ || frame_count_ == 0 || cpu_stack_.empty()) return;
+    auto [name, start] = cpu_stack_.back();
+    cpu_stack_.pop_back();
+    std::vector<Event>& events = frames_[newest_].cpu;
+    if (events.size() < max_cpu_scopes)
+        events.push_back({ name, start, now_us() - start, static_cast<uint32_t>(cpu_stack_.size()) });
+}
+
+void Profiler::begin_recording(VkCommandBuffer cmd, uint32_t slot) {
+    SlotRecording& rec = slots_[slot];
+    rec.scopes.clear();
+    rec.open.clear();
+    rec.next_query = 0;
+    rec.has_statistics = false;
+    if (!enabled_) return;
+    if (timestamp_pool_ != VK_NULL_HANDLE)
+        vkCmdResetQueryPool(cmd, timestamp_pool_, slot * queries_per_slot, queries_per_slot);
+    if (statistics_pool_ != VK_NULL_HANDLE)
+        vkCmdResetQueryPool(cmd, statistics_pool_, slot, 1);
+}
+
+void Profiler::begin_gpu_scope(VkCommandBuffer cmd, uint32_t slot, const char* name) {
+    SlotRecording& rec = slots_[slot];
+    if (!enabled_ || timestamp_pool_ == VK_NULL_HANDLE || rec.next_query + 2 > queries_per_slot) return;
+    uint32_t query = slot * queries_per_slot + rec.next_query;
+    rec.scopes.push_back({ name, query, query + 1, static_cast<uint32_t>(rec.open.size()) });
+    rec.open.push_back(static_cast<uint32_t>(rec.scopes.size() - 1));
+    rec.next_query += 2;
+    vkCmdWriteTimestamp(cmd, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, timestamp_pool_, query);
+}
+
+void Profiler::end_gpu_scope(VkCommandBuffer cmd, uint32_t slot) {
+    SlotRecording& rec = slots_[slot];
+    if (rec.open.empty()) return;
+    const GpuScope& scope = rec.scopes[rec.open.back()];
+    rec.open.pop_back();
+    vkCmdWriteTimestamp(cmd, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, timestamp_pool_, scope.end_query);
+}
+
+void Profiler::begin_statistics(VkCommandBuffer cmd, uint32_t slot) {
+    if (!enabled_ || statistics_pool_ == VK_NULL_HANDLE) return;
+    vkCmdBeginQuery(cmd, statistics_pool_, slot, 0);
+    slots_[slot].has_statistics = true;
+}
+
+void Profiler::end_statistics(VkCommandBuffer cmd, uint32_t slot) {
+    if (!slots_[slot].has_statistics) return;
+    vkCmdEndQuery(cmd, statistics_pool_, slot);
+}
+
+void Profiler::on_submit(uint32_t frameSlot, uint32_t slot) {
+    if (!enabled_ || frame_count_ == 0) return;
+    PendingSubmit& pending = pending_[frameSlot];
+    pending.valid = true;
+    pending.slot = slot;
+    pending.frame = frames_[newest_].index;
+    pending.submit_us = now_us();
+}
+
+void Profiler::on_frame_retired(uint32_t frameSlot) {
+    PendingSubmit& pending = pending_[frameSlot];
+    if (!pending.valid) return;
+    pending.valid = false;
+    Frame* frame = find_frame(pending.frame);
+    const SlotRecording& rec = slots_[pending.slot];
+    if (!frame || frame->gpu_resolved) return;
+
+    if (!rec.scopes.empty()) {
+        std::array<uint64_t, queries_per_slot> ticks{};
+        uint32_t first = pending.slot * queries_per_slot;
+        // No WAIT flag: the fence already retired the work, and if results are
+        // somehow not ready the frame simply keeps no GPU events.
+        VkResult result = vkGetQueryPoolResults(device_, timestamp_pool_, first, rec.next_query,
+                                                sizeof(uint64_t) * rec.next_query, ticks.data(), sizeof(uint64_t),
+                                                VK_QUERY_RESULT_64_BIT);
+        if (result == VK_SUCCESS) {
+            // GPU and CPU clocks are not calibrated; the GPU track is anchored
+            // so the first scope starts at the submit time.
+            uint64_t base = ticks[rec.scopes.front().begin_query - first] & timestamp_mask_;
+            for (const GpuScope& scope : rec.scopes) {
+                uint64_t begin = ticks[scope.begin_query - first] & timestamp_mask_;
+                uint64_t end = ticks[scope.end_query - first] & timestamp_mask_;
+                double start_us = pending.submit_us + static_cast<double>((begin - base) & timestamp_mask_) * timestamp_period_ns_ / 1000.0;
+                double duration_us = static_cast<double>((end - begin) & timestamp_mask_) * timestamp_period_ns_ / 1000.0;
+                frame->gpu.push_back({ scope.name, start_us, duration_us, scope.depth });
+            }
+        }
+    }
+    if (rec.has_statistics) {
+        std::array<uint64_t, statistics_count> values{};
+        if (vkGetQueryPoolResults(device_, statistics_pool_, pending.slot, 1, sizeof(values), values.data(),
+                                  sizeof(values), VK_QUERY_RESULT_64_BIT) == VK_SUCCESS) {
+            // Results come in bit order of the enabled statistics flags.
+            frame->stats.input_vertices = values[0];
+            frame->stats.input_primitives = values[1];
+            frame->stats.vertex_invocations = values[2];
+            frame->stats.clipping_primitives = values[3];
+            frame->stats.fragment_invocations = values[4];
+        }
+    }
+    frame->gpu_resolved = true;
+}
+
+bool Profiler::write_chrome_trace(const std::string& path) const {
+    std::ofstream out(path);
+    if (!out.is_open()) return false;
+    out << "{\"traceEvents\":[\n";
+    out << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":0,\"args\":{\"name\":\"CPU\"}},\n";
+    out << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":1,\"args\":{\"name\":\"GPU\"}}";
+    auto write_event = [&](const Event& e, int tid, uint64_t frame) {
+        out << ",\n{\"name\":";
+        write_json_string(out, e.name);
+        out << ",\"ph\":\"X\",\"pid\":0,\"tid\":" << tid << ",\"ts\":" << e.start_us << ",\"dur\":" << e.duration_us
+            << ",\"args\":{\"frame\":" << frame << "}}";
+    };
+    for (size_t i = 0; i < frame_count_; ++i) {
+        const Frame& frame = this->frame(i);
+        for (const Event& e : frame.cpu) write_event(e, 0, frame.index);
+        for (const Event& e : frame.gpu) write_event(e, 1, frame.index);
+        if (frame.gpu_resolved && !frame.gpu.empty()) {
+            const PipelineStats& s = frame.stats;
+            out << ",\n{\"name\":\"pipeline_statistics\",\"ph\":\"C\",\"pid\":0,\"tid\":1,\"ts\":" << frame.gpu.front().start_us
+                << ",\"args\":{\"input_vertices\":" << s.input_vertices << ",\"input_primitives\":" << s.input_primitives
+                << ",\"vertex_invocations\":" << s.vertex_invocations << ",\"clipping_primitives\":" << s.clipping_primitives
+                << ",\"fragment_invocations\":" << s.fragment_invocations << "}}";
+        }
+    }
+    out << "\n]}\n";
+    return out.good();
+}
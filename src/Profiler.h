@@ -0,0 +1,147 @@
+#pragma once
+#include <vulkan/vulkan.h>
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Set by CMake (ENGINE_ENABLE_PROFILER). When 0 the PROFILE_* macros expand to
+// nothing and VulkanApp never creates query pools.
+#ifndef ENGINE_PROFILER
+#define ENGINE_PROFILER 0
+#endif
+
+// Frame profiler with a CPU and a GPU track.
+//
+// CPU scopes are timed with steady_clock. GPU scopes write timestamps with
+// vkCmdWriteTimestamp into a per-slot range of a query pool (a slot is one
+// command buffer), and an optional pipeline-statistics query spans the slot.
+// Results are read back without waiting once the fence of the frame that
+// submitted the slot has signaled, so profiling never stalls the queue.
+// Frames are kept in a ring whose event storage is reserved by the first
+// begin_frame(), so recording does not allocate after that; CPU scopes past
+// max_cpu_scopes in one frame are dropped. Only the render thread may use it.
+class Profiler {
+public:
+    static constexpr uint32_t max_gpu_scopes = 16;
+    static constexpr uint32_t max_cpu_scopes = 64;
+    static constexpr size_t max_frames = 240;
+
+    struct Event {
+        const char* name;
+        double start_us;
+        double duration_us;
+        uint32_t depth;
+    };
+    // Counters from the slot's pipeline-statistics query.
+    struct PipelineStats {
+        uint64_t input_vertices = 0;
+        uint64_t input_primitives = 0;
+        uint64_t vertex_invocations = 0;
+        uint64_t clipping_primitives = 0;
+        uint64_t fragment_invocations = 0;
+    };
+    struct Frame {
+        uint64_t index = 0;
+        std::vector<Event> cpu;
+        std::vector<Event> gpu;
+        PipelineStats stats;
+        bool gpu_resolved = false;
+    };
+
+    // RAII CPU scope used by PROFILE_CPU_SCOPE.
+    class CpuScope {
+    public:
+        CpuScope(Profiler& profiler, const char* name) : profiler_(profiler) { profiler_.begin_cpu_scope(name); }
+        ~CpuScope() { profiler_.end_cpu_scope(); }
+        CpuScope(const CpuScope&) = delete;
+        CpuScope& operator=(const CpuScope&) = delete;
+    private:
+        Profiler& profiler_;
+    };
+
+    // timestampValidBits comes from the graphics queue family; 0 disables the
+    // GPU track. frameSlots is the number of frames in flight.
+    void init(VkDevice device, VkPhysicalDevice physicalDevice, uint32_t slotCount, uint32_t frameSlots,
+              uint32_t timestampValidBits, bool pipelineStatistics);
+    void destroy();
+    void set_enabled(bool enabled) { enabled_ = enabled; }
+    bool enabled() const { return enabled_; }
+
+    // CPU track. begin_frame starts a new frame record; scopes opened after it
+    // belong to that frame.
+    void begin_frame();
+    void begin_cpu_scope(const char* name);
+    void end_cpu_scope();
+
+    // GPU track, recorded into the command buffer of `slot`. begin_recording
+    // must come first and outside rendering.
+    void begin_recording(VkCommandBuffer cmd, uint32_t slot);
+    void begin_gpu_scope(VkCommandBuffer cmd, uint32_t slot, const char* name);
+    void end_gpu_scope(VkCommandBuffer cmd, uint32_t slot);
+    void begin_statistics(VkCommandBuffer cmd, uint32_t slot);
+    void end_statistics(VkCommandBuffer cmd, uint32_t slot);
+
+    // Called right after the slot was submitted from frame-in-flight frameSlot.
+    void on_submit(uint32_t frameSlot, uint32_t slot);
+    // Called once frameSlot's fence has signaled; reads back its queries.
+    void on_frame_retired(uint32_t frameSlot);
+
+    // Recorded frames, oldest first; at most max_frames.
+    size_t frame_count() const { return frame_count_; }
+    const Frame& frame(size_t i) const { return frames_[ring_index(i)]; }
+    // Writes the recorded frames as Chrome trace JSON (chrome://tracing, Perfetto).
+    bool write_chrome_trace(const std::string& path) const;
+
+private:
+    struct GpuScope {
+        const char* name;
+        uint32_t begin_query;
+        uint32_t end_query;
+        uint32_t depth;
+    };
+    struct SlotRecording {
+        std::vector<GpuScope> scopes;
+        std::vector<uint32_t> open;
+        uint32_t next_query = 0;
+        bool has_statistics = false;
+    };
+    struct PendingSubmit {
+        bool valid = false;
+        uint32_t slot = 0;
+        uint64_t frame = 0;
+        double submit_us = 0.0;
+    };
+
+    double now_us() const;
+    size_t ring_index(size_t i) const { return (newest_ + max_frames - frame_count_ + 1 + i) % max_frames; }
+    Frame* find_frame(uint64_t index);
+
+    VkDevice device_ = VK_NULL_HANDLE;
+    VkQueryPool timestamp_pool_ = VK_NULL_HANDLE;
+    VkQueryPool statistics_pool_ = VK_NULL_HANDLE;
+    double timestamp_period_ns_ = 1.0;
+    uint64_t timestamp_mask_ = ~0ull;
+    bool enabled_ = true;
+    std::vector<SlotRecording> slots_;
+    std::vector<PendingSubmit> pending_;
+    std::chrono::steady_clock::time_point epoch_ = std::chrono::steady_clock::now();
+    std::vector<Frame> frames_;
+    size_t frame_count_ = 0;
+    size_t newest_ = 0;
+    uint64_t frame_index_ = 0;
+    std::vector<std::pair<const char*, double>> cpu_stack_;
+};
+
+#if ENGINE_PROFILER
+#define PROFILE_CONCAT_INNER(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_INNER(a, b)
+#define PROFILE_CPU_SCOPE(profiler, name) Profiler::CpuScope PROFILE_CONCAT(profile_scope_, __LINE__)(profiler, name)
+#define PROFILE_GPU_BEGIN(profiler, cmd, slot, name) (profiler).begin_gpu_scope(cmd, slot, name)
+#define PROFILE_GPU_END(profiler, cmd, slot) (profiler).end_gpu_scope(cmd, slot)
+#else
+#define PROFILE_CPU_SCOPE(profiler, name) ((void)0)
+#define PROFILE_GPU_BEGIN(profiler, cmd, slot, name) ((void)0)
+#define PROFILE_GPU_END(profiler, cmd, slot) ((void)0)
+#endif
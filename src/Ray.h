@@ -0,0 +1,10 @@
+#pragma once
+#include <cfloat>
+#include <glm/glm.hpp>
+
+struct Ray {
+    glm::vec3 origin{0.0f};
+    // Need not be normalized; hit distances are in multiples of it.
+    glm::vec3 direction{0.0f, 0.0f, -1.0f};
+    float t_max = FLT_MAX;
+};
@@ -0,0 +1,442 @@
+#include "RenderGraph.h"
+#include "GpuMemory.h"
+#include <algorithm>
+#include <numeric>
+#include <stdexcept>
+#include <string>
+
+namespace {
+constexpr VkAccessFlags2 write_access_mask =
+    VK_ACCESS_2_SHADER_WRITE_BIT | VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT | VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT |
+    VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT | VK_ACCESS_2_TRANSFER_WRITE_BIT | VK_ACCESS_2_HOST_WRITE_BIT |
+    VK_ACCESS_2_MEMORY_WRITE_BIT;
+
+uint32_t find_memory_type(VkPhysicalDevice physicalDevice, uint32_t typeBits, VkMemoryPropertyFlags properties) {
+    VkPhysicalDeviceMemoryProperties memProperties;
+    vkGetPhysicalDeviceMemoryProperties(physicalDevice, &memProperties);
+    for (uint32_t i = 0; i < memProperties.memoryTypeCount; i++) {
+        if ((typeBits & (1 << i)) && (memProperties.memoryTypes[i].propertyFlags & properties) == properties) return i;
+    }
+    throw std::runtime_error("No suitable memory type for transient images");
+}
+}
+
+ImageAccess ImageAccess::color_attachment() {
+    return { VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT,
+             VK_ACCESS_2_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT,
+             VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL };
+}
+
+ImageAccess ImageAccess::depth_attachment() {
+    return { VK_PIPELINE_STAGE_2_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_2_LATE_FRAGMENT_TESTS_BIT,
+             VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
+             VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL };
+}
+
+ImageAccess ImageAccess::depth_read() {
+    return { VK_PIPELINE_STAGE_2_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_2_LATE_FRAGMENT_TESTS_BIT,
+             VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_READ_BIT,
+             VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL };
+}
+
+ImageAccess ImageAccess::fragment_sampled() {
+    return { VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT, VK_ACCESS_2_SHADER_SAMPLED_READ_BIT,
+             VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL };
+}
+
+ImageAccess ImageAccess::transfer_write() {
+    return { VK_PIPELINE_STAGE_2_ALL_TRANSFER_BIT, VK_ACCESS_2_TRANSFER_WRITE_BIT,
+             VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL };
+}
+
+ImageAccess ImageAccess::present() {
+    // Presentation is ordered by the semaphore, which the submit signals after
+    // color output; the transition only has to finish before that stage.
+    return { VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT, VK_ACCESS_2_NONE, VK_IMAGE_LAYOUT_PRESENT_SRC_KHR };
+}
+
+bool ImageAccess::writes() const {
+    return (access & write_access_mask) != 0;
+}
+
+RenderGraph::~RenderGraph() {
+    destroy();
+}
+
+void RenderGraph::init(VkDevice device, VkPhysicalDevice physicalDevice, DeletionQueue& deletionQueue) {
+    device_ = device;
+    physical_device_ = physicalDevice;
+    deletion_queue_ = &deletionQueue;
+}
+
+void RenderGraph::destroy() {
+    if (device_ == VK_NULL_HANDLE) return;
+    release(allocation_);
+    allocation_ = {};
+    lifetimes_.clear();
+    resources_.clear();
+    passes_.clear();
+    device_ = VK_NULL_HANDLE;
+}
+
+void RenderGraph::release(Allocation& allocation) {
+    for (PhysicalImage& image : allocation.images) {
+        vkDestroyImageView(device_, image.view, nullptr);
+        vkDestroyImage(device_, image.image, nullptr);
+    }
+    for (MemoryBlock& block : allocation.blocks) GpuMemory::shared().free(device_, block.memory);
+    allocation.images.clear();
+    allocation.blocks.clear();
+}
+
+void RenderGraph::retire(Allocation& allocation) {
+    for (PhysicalImage& image : allocation.images) {
+        deletion_queue_->destroy_image_view(image.view);
+        deletion_queue_->destroy_image(image.image);
+    }
+    for (MemoryBlock& block : allocation.blocks) deletion_queue_->free_memory(block.memory);
+    allocation.images.clear();
+    allocation.blocks.clear();
+}
+
+void RenderGraph::begin_frame(std::pmr::memory_resource& arena) {
+    resources_.clear();
+    // The uses of the previous frame's passes belong to its arena, which may
+    // have been reset already; releasing them into it does nothing.
+    passes_.clear();
+    barriers_.clear();
+    arena_ = &arena;
+}
+
+RenderGraph::Resource RenderGraph::import_image(const char* name, VkImage image, VkImageView view,
+                                                VkImageAspectFlags aspect, const ImageAccess& before) {
+    ResourceNode& node = resources_.emplace_back();
+    node.name = name;
+    node.image = image;
+    node.view = view;
+    node.aspect = aspect;
+    node.before = before;
+    return static_cast<Resource>(resources_.size() - 1);
+}
+
+RenderGraph::Resource RenderGraph::create_image(const char* name, const TransientImageDesc& desc) {
+    ResourceNode& node = resources_.emplace_back();
+    node.name = name;
+    node.transient = true;
+    node.desc = desc;
+    node.aspect = desc.aspect;
+    return static_cast<Resource>(resources_.size() - 1);
+}
+
+void RenderGraph::export_image(Resource resource, const ImageAccess& after) {
+    resources_[resource].exported = true;
+    resources_[resource].after = after;
+}
+
+RenderGraph::Pass RenderGraph::add_pass(const char* name, const void* context, PassFn execute) {
+    PassNode& node = passes_.emplace_back(arena_);
+    node.name = name;
+    node.context = context;
+    node.execute = execute;
+    return static_cast<Pass>(passes_.size() - 1);
+}
+
+void RenderGraph::read(Pass pass, Resource resource, const ImageAccess& access) {
+    use(pass, resource, access, false);
+}
+
+void RenderGraph::write(Pass pass, Resource resource, const ImageAccess& access) {
+    use(pass, resource, access, true);
+}
+
+void RenderGraph::use(Pass pass, Resource resource, const ImageAccess& access, bool write) {
+    PassNode& node = passes_[pass];
+    for (Use& existing : node.uses) {
+        if (existing.resource != resource) continue;
+        // One layout per image and pass: barriers only go between passes.
+        if (existing.access.layout != access.layout)
+            throw std::runtime_error(std::string("Render graph pass ") + node.name + " uses " +
+                                     resources_[resource].name + " in two layouts");
+        existing.access.stages |= access.stages;
+        existing.access.access |= access.access;
+        existing.read |= !write;
+        existing.write |= write;
+        return;
+    }
+    node.uses.push_back({ resource, access, !write, write });
+}
+
+void RenderGraph::keep(Pass pass) {
+    passes_[pass].keep = true;
+}
+
+void RenderGraph::compile() {
+    cull();
+    allocate_transients();
+    build_barriers();
+}
+
+void RenderGraph::cull() {
+    // Walk back from the exports: a pass lives if it writes something a later
+    // live pass reads (or an export), and then what it reads is needed too.
+    // A write that does not read ends the need for earlier contents.
+    std::pmr::vector<bool> needed(resources_.size(), arena_);
+    for (size_t r = 0; r < resources_.size(); ++r) needed[r] = resources_[r].exported;
+    stats_ = {};
+    for (size_t p = passes_.size(); p-- > 0;) {
+        PassNode& pass = passes_[p];
+        pass.live = pass.keep;
+        for (const Use& use : pass.uses) {
+            if (use.write && needed[use.resource]) pass.live = true;
+        }
+        if (!pass.live) {
+            ++stats_.culled_passes;
+            continue;
+        }
+        ++stats_.passes;
+        for (const Use& use : pass.uses) {
+            if (use.write && !use.read) needed[use.resource] = false;
+        }
+        for (const Use& use : pass.uses) {
+            if (use.read) needed[use.resource] = true;
+        }
+    }
+}
+
+void RenderGraph::allocate_transients() {
+    std::pmr::vector<Lifetime> lifetimes(arena_);
+    std::pmr::vector<Resource> owners(arena_);
+    for (Resource r = 0; r < resources_.size(); ++r) {
+        ResourceNode& resource = resources_[r];
+        if (!resource.transient) continue;
+        resource.physical = UINT32_MAX;
+        resource.image = VK_NULL_HANDLE;
+        resource.view = VK_NULL_HANDLE;
+        Lifetime lifetime{ resource.desc, UINT32_MAX, 0 };
+        for (uint32_t p = 0; p < passes_.size(); ++p) {
+            if (!passes_[p].live) continue;
+            for (const Use& use : passes_[p].uses) {
+                if (use.resource != r) continue;
+                lifetime.first = std::min(lifetime.first, p);
+                lifetime.last = std::max(lifetime.last, p);
+            }
+        }
+        if (lifetime.first == UINT32_MAX) continue;
+        resource.physical = static_cast<uint32_t>(lifetimes.size());
+        lifetimes.push_back(lifetime);
+        owners.push_back(r);
+    }
+
+    if (!std::ranges::equal(lifetimes, lifetimes_)) {
+        // Frames already submitted may still use the old images.
+        retire(allocation_);
+        allocation_ = {};
+        lifetimes_.assign(lifetimes.begin(), lifetimes.end());
+
+        std::vector<VkMemoryRequirements> requirements(lifetimes_.size());
+        allocation_.images.resize(lifetimes_.size());
+        for (size_t i = 0; i < lifetimes_.size(); ++i) {
+            const TransientImageDesc& desc = lifetimes_[i].desc;
+            VkImageCreateInfo imageInfo{};
+            imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+            imageInfo.imageType = VK_IMAGE_TYPE_2D;
+            imageInfo.extent = { desc.width, desc.height, 1 };
+            imageInfo.mipLevels = 1;
+            imageInfo.arrayLayers = 1;
+            imageInfo.format = desc.format;
+            imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+            imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+            imageInfo.usage = desc.usage;
+            imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+            imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+            if (vkCreateImage(device_, &imageInfo, nullptr, &allocation_.images[i].image) != VK_SUCCESS)
+                throw std::runtime_error("Failed to create transient image");
+            vkGetImageMemoryRequirements(device_, allocation_.images[i].image, &requirements[i]);
+            allocation_.unaliased_bytes += requirements[i].size;
+        }
+
+        // Largest first into the first block whose images are all used in
+        // other passes; every image is bound at the start of its block, so the
+        // block is as large as its largest image.
+        std::vector<uint32_t> order(lifetimes_.size());
+        std::iota(order.begin(), order.end(), 0u);
+        std::stable_sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) {
+            return requirements[a].size > requirements[b].size;
+        });
+        for (uint32_t i : order) {
+            const Lifetime& lifetime = lifetimes_[i];
+            uint32_t chosen = UINT32_MAX;
+            for (uint32_t b = 0; b < allocation_.blocks.size() && chosen == UINT32_MAX; ++b) {
+                const MemoryBlock& block = allocation_.blocks[b];
+                if ((block.type_bits & requirements[i].memoryTypeBits) == 0) continue;
+                bool overlaps = false;
+                for (uint32_t other : block.images) {
+                    const Lifetime& used = lifetimes_[other];
+                    if (lifetime.first <= used.last && used.first <= lifetime.last) overlaps = true;
+                }
+                if (!overlaps) chosen = b;
+            }
+            if (chosen == UINT32_MAX) {
+                chosen = static_cast<uint32_t>(allocation_.blocks.size());
+                allocation_.blocks.emplace_back();
+            }
+            MemoryBlock& block = allocation_.blocks[chosen];
+            block.size = std::max(block.size, requirements[i].size);
+            block.type_bits &= requirements[i].memoryTypeBits;
+            block.images.push_back(i);
+            allocation_.images[i].block = chosen;
+        }
+
+        for (MemoryBlock& block : allocation_.blocks) {
+            std::sort(block.images.begin(), block.images.end(), [&](uint32_t a, uint32_t b) {
+                return lifetimes_[a].first < lifetimes_[b].first;
+            });
+            VkMemoryAllocateInfo allocInfo{};
+            allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+            allocInfo.allocationSize = block.size;
+            allocInfo.memoryTypeIndex = find_memory_type(physical_device_, block.type_bits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+            if (GpuMemory::shared().allocate(device_, allocInfo, GpuMemoryCategory::render_target, &block.memory) != VK_SUCCESS)
+                throw std::runtime_error("Failed to allocate transient image memory");
+            for (uint32_t i : block.images) {
+                if (vkBindImageMemory(device_, allocation_.images[i].image, block.memory, 0) != VK_SUCCESS)
+                    throw std::runtime_error("Failed to bind transient image memory");
+            }
+        }
+
+        for (size_t i = 0; i < lifetimes_.size(); ++i) {
+            VkImageViewCreateInfo viewInfo{};
+            viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+            viewInfo.image = allocation_.images[i].image;
+            viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+            viewInfo.format = lifetimes_[i].desc.format;
+            viewInfo.subresourceRange.aspectMask = lifetimes_[i].desc.aspect;
+            viewInfo.subresourceRange.levelCount = 1;
+            viewInfo.subresourceRange.layerCount = 1;
+            if (vkCreateImageView(device_, &viewInfo, nullptr, &allocation_.images[i].view) != VK_SUCCESS)
+                throw std::runtime_error("Failed to create transient image view");
+        }
+    }
+
+    for (size_t i = 0; i < owners.size(); ++i) {
+        resources_[owners[i]].image = allocation_.images[i].image;
+        resources_[owners[i]].view = allocation_.images[i].view;
+    }
+    stats_.transient_images = static_cast<uint32_t>(allocation_.images.size());
+    stats_.unaliased_bytes = allocation_.unaliased_bytes;
+    for (const MemoryBlock& block : allocation_.blocks) stats_.transient_bytes += block.size;
+}
+
+VkImageMemoryBarrier2 RenderGraph::image_barrier(const ResourceNode& resource, VkPipelineStageFlags2 srcStages,
+                                                 VkAccessFlags2 srcAccess, VkImageLayout oldLayout,
+                                                 const ImageAccess& dst) {
+    VkImageMemoryBarrier2 barrier{};
+    barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2;
+    barrier.srcStageMask = srcStages;
+    barrier.srcAccessMask = srcAccess;
+    barrier.dstStageMask = dst.stages;
+    barrier.dstAccessMask = dst.access;
+    barrier.oldLayout = oldLayout;
+    barrier.newLayout = dst.layout;
+    barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.image = resource.image;
+    barrier.subresourceRange.aspectMask = resource.aspect;
+    barrier.subresourceRange.levelCount = VK_REMAINING_MIP_LEVELS;
+    barrier.subresourceRange.layerCount = VK_REMAINING_ARRAY_LAYERS;
+    return barrier;
+}
+
+void RenderGraph::add_barrier(Resource resource, State& state, const ImageAccess& access, bool write) {
+    bool transition = state.layout != access.layout;
+    if (write || transition) {
+        // Writes and layout transitions wait for every earlier access.
+        VkPipelineStageFlags2 srcStages = state.write_stages | state.read_stages;
+        if (transition || srcStages != VK_PIPELINE_STAGE_2_NONE) {
+            barriers_.push_back(image_barrier(resources_[resource], srcStages, state.write_access, state.layout, access));
+        }
+        // A transition counts as a write at the destination stages, so later
+        // readers in other stages still wait for it.
+        state.layout = access.layout;
+        state.write_stages = access.stages;
+        state.write_access = write ? (access.access & write_access_mask) : VK_ACCESS_2_NONE;
+        state.read_stages = write ? VK_PIPELINE_STAGE_2_NONE : access.stages;
+        state.visible_stages = write ? VK_PIPELINE_STAGE_2_NONE : access.stages;
+        return;
+    }
+    // Read in the current layout: only stages the last write has not been
+    // made visible to need a barrier.
+    VkPipelineStageFlags2 newStages = access.stages & ~state.visible_stages;
+    if (newStages != VK_PIPELINE_STAGE_2_NONE && state.write_stages != VK_PIPELINE_STAGE_2_NONE) {
+        barriers_.push_back(image_barrier(resources_[resource], state.write_stages, state.write_access, state.layout, access));
+    }
+    state.visible_stages |= access.stages;
+    state.read_stages |= access.stages;
+}
+
+void RenderGraph::build_barriers() {
+    barriers_.clear();
+    for (PhysicalImage& image : allocation_.images) image.footprint = {};
+    for (const PassNode& pass : passes_) {
+        if (!pass.live) continue;
+        for (const Use& use : pass.uses) {
+            uint32_t physical = resources_[use.resource].physical;
+            if (physical == UINT32_MAX) continue;
+            allocation_.images[physical].footprint.stages |= use.access.stages;
+            allocation_.images[physical].footprint.access |= use.access.access;
+        }
+    }
+
+    std::pmr::vector<State> states(resources_.size(), arena_);
+    for (size_t r = 0; r < resources_.size(); ++r) {
+        const ResourceNode& resource = resources_[r];
+        State& state = states[r];
+        if (!resource.transient) {
+            state.layout = resource.before.layout;
+            state.write_stages = resource.before.stages;
+            state.write_access = resource.before.access & write_access_mask;
+        } else if (resource.physical != UINT32_MAX) {
+            // Contents never survive, but the memory was last used by the
+            // image before this one in the block; for the first image that is
+            // the last one of the previous frame.
+            const MemoryBlock& block = allocation_.blocks[allocation_.images[resource.physical].block];
+            auto it = std::find(block.images.begin(), block.images.end(), resource.physical);
+            uint32_t previous = it == block.images.begin() ? block.images.back() : *(it - 1);
+            const ImageAccess& footprint = allocation_.images[previous].footprint;
+            state.write_stages = footprint.stages;
+            state.write_access = footprint.access & write_access_mask;
+        }
+    }
+
+    stats_.barrier_batches = 0;
+    for (PassNode& pass : passes_) {
+        pass.first_barrier = static_cast<uint32_t>(barriers_.size());
+        pass.barrier_count = 0;
+        if (!pass.live) continue;
+        for (const Use& use : pass.uses) add_barrier(use.resource, states[use.resource], use.access, use.write);
+        pass.barrier_count = static_cast<uint32_t>(barriers_.size()) - pass.first_barrier;
+        if (pass.barrier_count > 0) ++stats_.barrier_batches;
+    }
+    final_barrier_ = static_cast<uint32_t>(barriers_.size());
+    for (Resource r = 0; r < resources_.size(); ++r) {
+        if (resources_[r].exported) add_barrier(r, states[r], resources_[r].after, false);
+    }
+    if (barriers_.size() > final_barrier_) ++stats_.barrier_batches;
+    stats_.image_barriers = static_cast<uint32_t>(barriers_.size());
+}
+
+void RenderGraph::execute(VkCommandBuffer cmd) {
+    auto record = [&](uint32_t first, uint32_t count) {
+        if (count == 0) return;
+        VkDependencyInfo dependency{};
+        dependency.sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO;
+        dependency.imageMemoryBarrierCount = count;
+        dependency.pImageMemoryBarriers = barriers_.data() + first;
+        vkCmdPipelineBarrier2(cmd, &dependency);
+    };
+    for (PassNode& pass : passes_) {
+        if (!pass.live) continue;
+        record(pass.first_barrier, pass.barrier_count);
+        pass.execute(pass.context, cmd);
+    }
+    record(final_barrier_, static_cast<uint32_t>(barriers_.size()) - final_barrier_);
+}
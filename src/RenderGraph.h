@@ -0,0 +1,217 @@
+#pragma once
+#include <vulkan/vulkan.h>
+#include "DeletionQueue.h"
+#include <cstddef>
+#include <cstdint>
+#include <memory_resource>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+// How a pass touches an image: the stages and accesses it uses and the layout
+// it needs the image in. Any write bit in access makes the use a write.
+struct ImageAccess {
+    VkPipelineStageFlags2 stages = VK_PIPELINE_STAGE_2_NONE;
+    VkAccessFlags2 access = VK_ACCESS_2_NONE;
+    VkImageLayout layout = VK_IMAGE_LAYOUT_UNDEFINED;
+
+    static ImageAccess color_attachment();
+    static ImageAccess depth_attachment();
+    static ImageAccess depth_read();
+    static ImageAccess fragment_sampled();
+    static ImageAccess transfer_write();
+    static ImageAccess present();
+    bool writes() const;
+};
+
+// Image owned by the graph for the duration of one frame.
+struct TransientImageDesc {
+    uint32_t width = 0;
+    uint32_t height = 0;
+    VkFormat format = VK_FORMAT_UNDEFINED;
+    VkImageUsageFlags usage = 0;
+    VkImageAspectFlags aspect = VK_IMAGE_ASPECT_COLOR_BIT;
+
+    bool operator==(const TransientImageDesc&) const = default;
+};
+
+struct RenderGraphStats {
+    uint32_t passes = 0;
+    uint32_t culled_passes = 0;
+    uint32_t barrier_batches = 0;
+    uint32_t image_barriers = 0;
+    uint32_t transient_images = 0;
+    // Device memory backing the transients, and what it would be without aliasing.
+    VkDeviceSize transient_bytes = 0;
+    VkDeviceSize unaliased_bytes = 0;
+};
+
+// Per-frame graph of passes over images.
+//
+// Each frame, passes are declared in execution order together with the images
+// they read and write. compile() drops passes whose writes never reach an
+// exported image (or a pass marked keep()), derives one batch of
+// VkImageMemoryBarrier2 per pass from the declared accesses, and places
+// transient images whose pass ranges do not overlap in the same memory.
+// execute() records the barriers and the passes' callbacks.
+//
+// Per-frame data (pass callbacks, per-pass uses, compile temporaries) comes
+// from the arena given to begin_frame(), which must stay valid until
+// execute() returns; the graph's own vectors keep their capacity, so a frame
+// with the same shape as the last does not touch the heap.
+//
+// Transient images persist across frames while the declared set is
+// unchanged. When it changes, the old ones go to the deletion queue.
+class RenderGraph {
+public:
+    using Resource = uint32_t;
+    using Pass = uint32_t;
+
+    RenderGraph() = default;
+    ~RenderGraph();
+    RenderGraph(const RenderGraph&) = delete;
+    RenderGraph& operator=(const RenderGraph&) = delete;
+
+    void init(VkDevice device, VkPhysicalDevice physicalDevice, DeletionQueue& deletionQueue);
+    // Frees every transient image: idle the device first.
+    void destroy();
+
+    // Starts declaring a frame.
+    void begin_frame(std::pmr::memory_resource& arena);
+    // An image owned elsewhere. before is the state earlier work left it in;
+    // an UNDEFINED layout discards its contents.
+    Resource import_image(const char* name, VkImage image, VkImageView view, VkImageAspectFlags aspect,
+                          const ImageAccess& before);
+    Resource create_image(const char* name, const TransientImageDesc& desc);
+    // Makes the image an output of the frame, left in the after state.
+    void export_image(Resource resource, const ImageAccess& after);
+
+    // execute(VkCommandBuffer) is copied into the arena and never destroyed,
+    // so it must be trivially destructible, e.g. a lambda capturing by reference.
+    template<typename Fn>
+    Pass add_pass(const char* name, Fn&& execute) {
+        using Callback = std::decay_t<Fn>;
+        static_assert(std::is_trivially_destructible_v<Callback>, "Pass callbacks are never destroyed");
+        void* storage = arena_->allocate(sizeof(Callback), alignof(Callback));
+        const Callback* callback = new (storage) Callback(std::forward<Fn>(execute));
+        return add_pass(name, callback, [](const void* context, VkCommandBuffer cmd) {
+            (*static_cast<const Callback*>(context))(cmd);
+        });
+    }
+    // A pass that reads and writes an image (e.g. an attachment with
+    // LOAD_OP_LOAD) declares both.
+    void read(Pass pass, Resource resource, const ImageAccess& access);
+    void write(Pass pass, Resource resource, const ImageAccess& access);
+    // Keeps a pass with effects outside the graph from being culled.
+    void keep(Pass pass);
+
+    void compile();
+    void execute(VkCommandBuffer cmd);
+
+    // Valid after compile() for images used by a live pass.
+    VkImage image(Resource resource) const { return resources_[resource].image; }
+    VkImageView view(Resource resource) const { return resources_[resource].view; }
+    bool culled(Pass pass) const { return !passes_[pass].live; }
+    const RenderGraphStats& stats() const { return stats_; }
+
+private:
+    struct ResourceNode {
+        const char* name = nullptr;
+        bool transient = false;
+        TransientImageDesc desc;
+        VkImage image = VK_NULL_HANDLE;
+        VkImageView view = VK_NULL_HANDLE;
+        VkImageAspectFlags aspect = 0;
+        ImageAccess before;
+        ImageAccess after;
+        bool exported = false;
+        // Into allocation_.images for transients used by a live pass.
+        uint32_t physical = UINT32_MAX;
+    };
+    // All accesses of a pass to one resource, merged.
+    struct Use {
+        Resource resource;
+        ImageAccess access;
+        bool read;
+        bool write;
+    };
+    using PassFn = void (*)(const void* context, VkCommandBuffer cmd);
+    struct PassNode {
+        explicit PassNode(std::pmr::memory_resource* arena) : uses(arena) {}
+
+        const char* name = nullptr;
+        const void* context = nullptr;
+        PassFn execute = nullptr;
+        std::pmr::vector<Use> uses;
+        bool keep = false;
+        bool live = false;
+        // Into barriers_, recorded before the pass.
+        uint32_t first_barrier = 0;
+        uint32_t barrier_count = 0;
+    };
+    // Transient resource as seen by the allocator: its description and the
+    // range of live passes it is used in.
+    struct Lifetime {
+        TransientImageDesc desc;
+        uint32_t first = 0;
+        uint32_t last = 0;
+
+        bool operator==(const Lifetime&) const = default;
+    };
+    struct PhysicalImage {
+        VkImage image = VK_NULL_HANDLE;
+        VkImageView view = VK_NULL_HANDLE;
+        uint32_t block = 0;
+        // Every stage and access of the image this frame, which the next image
+        // placed in the same block has to wait for.
+        ImageAccess footprint;
+    };
+    struct MemoryBlock {
+        VkDeviceMemory memory = VK_NULL_HANDLE;
+        VkDeviceSize size = 0;
+        uint32_t type_bits = UINT32_MAX;
+        // Physical images placed in the block, in order of first use.
+        std::vector<uint32_t> images;
+    };
+    struct Allocation {
+        std::vector<PhysicalImage> images;
+        std::vector<MemoryBlock> blocks;
+        VkDeviceSize unaliased_bytes = 0;
+    };
+    // Synchronization state of one resource while walking the passes.
+    struct State {
+        VkImageLayout layout = VK_IMAGE_LAYOUT_UNDEFINED;
+        VkPipelineStageFlags2 write_stages = VK_PIPELINE_STAGE_2_NONE;
+        VkAccessFlags2 write_access = VK_ACCESS_2_NONE;
+        // Stages that read since the last write; a write has to wait for them.
+        VkPipelineStageFlags2 read_stages = VK_PIPELINE_STAGE_2_NONE;
+        // Stages the last write has already been made visible to.
+        VkPipelineStageFlags2 visible_stages = VK_PIPELINE_STAGE_2_NONE;
+    };
+
+    Pass add_pass(const char* name, const void* context, PassFn execute);
+    void cull();
+    void allocate_transients();
+    void release(Allocation& allocation);
+    void retire(Allocation& allocation);
+    void build_barriers();
+    void use(Pass pass, Resource resource, const ImageAccess& access, bool write);
+    void add_barrier(Resource resource, State& state, const ImageAccess& access, bool write);
+    static VkImageMemoryBarrier2 image_barrier(const ResourceNode& resource, VkPipelineStageFlags2 srcStages,
+                                               VkAccessFlags2 srcAccess, VkImageLayout oldLayout,
+                                               const ImageAccess& dst);
+
+    VkDevice device_ = VK_NULL_HANDLE;
+    VkPhysicalDevice physical_device_ = VK_NULL_HANDLE;
+    DeletionQueue* deletion_queue_ = nullptr;
+    std::pmr::memory_resource* arena_ = std::pmr::get_default_resource();
+    std::vector<ResourceNode> resources_;
+    std::vector<PassNode> passes_;
+    std::vector<VkImageMemoryBarrier2> barriers_;
+    // Barriers into the exported states, recorded after the last pass.
+    uint32_t final_barrier_ = 0;
+    std::vector<Lifetime> lifetimes_;
+    Allocation allocation_;
+    RenderGraphStats stats_;
+};
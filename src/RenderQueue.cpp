@@ -0,0 +1,223 @@
+#include "RenderQueue.h"
+#include "JobSystem.h"
+#include "Mesh.h"
+#include <algorithm>
+#include <array>
+
+namespace {
+constexpr uint32_t radix_bits = 8;
+constexpr uint32_t radix_buckets = 1u << radix_bits;
+constexpr uint32_t radix_passes = 64 / radix_bits;
+// Below this many entries the thread hand-off costs more than it saves.
+constexpr size_t parallel_sort_threshold = 8192;
+
+using Histogram = std::array<uint32_t, radix_buckets>;
+
+inline uint32_t digit(uint64_t key, uint32_t pass) {
+    return static_cast<uint32_t>(key >> (pass * radix_bits)) & (radix_buckets - 1);
+}
+
+// State bound by the previous draw; binds() counts the ones the next draw changes.
+struct BoundState {
+    VkPipeline pipeline = VK_NULL_HANDLE;
+    VkDescriptorSet set = VK_NULL_HANDLE;
+    VkBuffer vertex_buffer = VK_NULL_HANDLE;
+    VkBuffer index_buffer = VK_NULL_HANDLE;
+
+    uint32_t binds(VkPipeline p, VkDescriptorSet s, VkBuffer vb, VkBuffer ib) {
+        uint32_t changed = (p != pipeline) + (s != set) + (vb != vertex_buffer) + (ib != index_buffer);
+        pipeline = p;
+        set = s;
+        vertex_buffer = vb;
+        index_buffer = ib;
+        return changed;
+    }
+};
+}
+
+void radix_sort(std::vector<RenderSortEntry>& entries, std::vector<RenderSortEntry>& scratch, std::pmr::memory_resource* temp) {
+    const size_t count = entries.size();
+    if (count < 2) return;
+    scratch.resize(count);
+
+    JobSystem& jobs = JobSystem::shared();
+    const size_t chunk_count = count < parallel_sort_threshold ? 1 : std::min<size_t>(jobs.thread_count(), count / (parallel_sort_threshold / 4));
+    const size_t chunk_size = (count + chunk_count - 1) / chunk_count;
+
+    // One sweep gathers the histograms of every digit so constant digits can
+    // be skipped without touching the data again.
+    std::pmr::vector<std::array<Histogram, radix_passes>> chunk_digit_hist(chunk_count, temp);
+    jobs.parallel_for(chunk_count, 1, [&](size_t first, size_t last) {
+        for (size_t c = first; c < last; ++c) {
+            auto& hist = chunk_digit_hist[c];
+            for (auto& h : hist) h.fill(0);
+            size_t end = std::min(count, (c + 1) * chunk_size);
+            for (size_t i = c * chunk_size; i < end; ++i) {
+                uint64_t key = entries[i].key;
+                for (uint32_t p = 0; p < radix_passes; ++p) ++hist[p][digit(key, p)];
+            }
+        }
+    });
+    std::array<bool, radix_passes> skip{};
+    for (uint32_t p = 0; p < radix_passes; ++p) {
+        Histogram total{};
+        for (const auto& hist : chunk_digit_hist)
+            for (uint32_t b = 0; b < radix_buckets; ++b) total[b] += hist[p][b];
+        skip[p] = std::any_of(total.begin(), total.end(), [&](uint32_t n) { return n == count; });
+    }
+
+    std::pmr::vector<Histogram> chunk_offsets(chunk_count, temp);
+    RenderSortEntry* src = entries.data();
+    RenderSortEntry* dst = scratch.data();
+    for (uint32_t p = 0; p < radix_passes; ++p) {
+        if (skip[p]) continue;
+        // The first sweep's histograms are only valid while the data is still
+        // in its original chunk order, so later passes recount.
+        std::pmr::vector<Histogram> chunk_hist(chunk_count, temp);
+        jobs.parallel_for(chunk_count, 1, [&](size_t first, size_t last) {
+            for (size_t c = first; c < last; ++c) {
+                chunk_hist[c].fill(0);
+                size_t end = std::min(count, (c + 1) * chunk_size);
+                for (size_t i = c * chunk_size; i < end; ++i) ++chunk_hist[c][digit(src[i].key, p)];
+            }
+        });
+        // Exclusive prefix sum in (bucket, chunk) order keeps the sort stable.
+        uint32_t running = 0;
+        for (uint32_t b = 0; b < radix_buckets; ++b) {
+            for (size_t c = 0; c < chunk_count; ++c) {
+                chunk_offsets[c][b] = running;
+                running += chunk_hist[c][b];
+            }
+        }
+        jobs.parallel_for(chunk_count, 1, [&](size_t first, size_t last) {
+            for (size_t c = first; c < last; ++c) {
+                Histogram& offsets = chunk_offsets[c];
+                size_t end = std::min(count, (c + 1) * chunk_size);
+                for (size_t i = c * chunk_size; i < end; ++i) dst[offsets[digit(src[i].key, p)]++] = src[i];
+            }
+        });
+        std::swap(src, dst);
+    }
+    if (src != entries.data()) entries.swap(scratch);
+}
+
+uint64_t RenderQueue::make_key(uint32_t pipeline, uint32_t material, uint32_t mesh, float depth01) {
+    constexpr uint64_t depth_max = (1ull << depth_bits) - 1;
+    float d = std::clamp(depth01, 0.0f, 1.0f);
+    uint64_t depth = static_cast<uint64_t>(d * static_cast<float>(depth_max));
+    uint64_t key = 0;
+    key |= (static_cast<uint64_t>(pipeline) & ((1ull << pipeline_bits) - 1)) << (material_bits + mesh_bits + depth_bits);
+    key |= (static_cast<uint64_t>(material) & ((1ull << material_bits) - 1)) << (mesh_bits + depth_bits);
+    key |= (static_cast<uint64_t>(mesh) & ((1ull << mesh_bits) - 1)) << depth_bits;
+    key |= std::min(depth, depth_max);
+    return key;
+}
+
+void RenderQueue::clear() {
+    items_.clear();
+    entries_.clear();
+}
+
+void RenderQueue::submit(MeshHandle mesh, const glm::mat4& model, uint32_t pipeline, uint32_t material, float depth01,
+                         uint32_t lod) {
+    if (!mesh.valid()) return;
+    uint32_t index = static_cast<uint32_t>(items_.size());
+    items_.push_back({ model, mesh, pipeline, material, lod });
+    // Pool slots are dense and reused, so the slot index groups draws of a mesh.
+    entries_.push_back({ make_key(pipeline, material, mesh.index(), depth01), index });
+}
+
+void RenderQueue::sort(std::pmr::memory_resource* temp) {
+    radix_sort(entries_, scratch_, temp);
+}
+
+const Mesh* RenderQueue::resolve(const Item& item, const RenderQueueBindings& bindings) const {
+    if (item.pipeline >= bindings.pipeline_count || item.material >= bindings.descriptor_set_count) return nullptr;
+    const Mesh* mesh = bindings.meshes->get(item.mesh);
+    if (!mesh || mesh->vertex_buffer() == VK_NULL_HANDLE || mesh->index_buffer() == VK_NULL_HANDLE || mesh->index_count() == 0)
+        return nullptr;
+    return mesh;
+}
+
+void RenderQueue::record(VkCommandBuffer cmd, const RenderQueueBindings& bindings, RenderStats& stats) const {
+    VkPipeline bound_pipeline = VK_NULL_HANDLE;
+    VkDescriptorSet bound_set = VK_NULL_HANDLE;
+    VkBuffer bound_vertex_buffer = VK_NULL_HANDLE;
+    VkBuffer bound_index_buffer = VK_NULL_HANDLE;
+    uint32_t draws = 0;
+    for (const RenderSortEntry& entry : entries_) {
+        const Item& item = items_[entry.item];
+        const Mesh* mesh = resolve(item, bindings);
+        if (!mesh) continue;
+        VkBuffer vertex_buffer = mesh->vertex_buffer();
+        VkBuffer index_buffer = mesh->index_buffer();
+
+        VkPipeline pipeline = bindings.pipelines[item.pipeline];
+        if (pipeline != bound_pipeline) {
+            vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
+            bound_pipeline = pipeline;
+            ++stats.pipeline_binds;
+        }
+        VkDescriptorSet set = bindings.descriptor_sets[item.material];
+        if (set != bound_set) {
+            vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, bindings.pipeline_layout, 0, 1, &set, 0, nullptr);
+            bound_set = set;
+            ++stats.descriptor_binds;
+        }
+        if (vertex_buffer != bound_vertex_buffer) {
+            VkDeviceSize offset = 0;
+            vkCmdBindVertexBuffers(cmd, 0, 1, &vertex_buffer, &offset);
+            bound_vertex_buffer = vertex_buffer;
+            ++stats.vertex_buffer_binds;
+        }
+        if (index_buffer != bound_index_buffer) {
+            vkCmdBindIndexBuffer(cmd, index_buffer, 0, VK_INDEX_TYPE_UINT32);
+            bound_index_buffer = index_buffer;
+            ++stats.index_buffer_binds;
+        }
+        vkCmdPushConstants(cmd, bindings.pipeline_layout, VK_SHADER_STAGE_VERTEX_BIT, 0, model_push_size, &item.model);
+        uint32_t lod = item.lod < mesh->lod_count() ? item.lod : 0;
+        mesh->draw(cmd, lod);
+        stats.triangles += mesh->lod(lod).index_count / 3;
+        ++draws;
+    }
+    stats.draws += draws;
+
+    // Replays the draws in submission order, without issuing anything.
+    BoundState unsorted;
+    for (const Item& item : items_) {
+        const Mesh* mesh = resolve(item, bindings);
+        if (!mesh) continue;
+        stats.unsorted_binds += unsorted.binds(bindings.pipelines[item.pipeline], bindings.descriptor_sets[item.material],
+                                               mesh->vertex_buffer(), mesh->index_buffer());
+    }
+}
+
+void RenderQueue::record_depth(VkCommandBuffer cmd, VkPipeline depthPipeline, VkPipelineLayout layout, const MeshPool& meshes,
+                               RenderStats& stats) const {
+    if (entries_.empty()) return;
+    vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, depthPipeline);
+    VkBuffer bound_position_buffer = VK_NULL_HANDLE;
+    VkBuffer bound_index_buffer = VK_NULL_HANDLE;
+    for (const RenderSortEntry& entry : entries_) {
+        const Item& item = items_[entry.item];
+        const Mesh* mesh = meshes.get(item.mesh);
+        if (!mesh) continue;
+        VkBuffer position_buffer = mesh->position_buffer();
+        VkBuffer index_buffer = mesh->index_buffer();
+        if (position_buffer == VK_NULL_HANDLE || index_buffer == VK_NULL_HANDLE || mesh->index_count() == 0) continue;
+        if (position_buffer != bound_position_buffer) {
+            VkDeviceSize offset = 0;
+            vkCmdBindVertexBuffers(cmd, 0, 1, &position_buffer, &offset);
+            bound_position_buffer = position_buffer;
+        }
+        if (index_buffer != bound_index_buffer) {
+            vkCmdBindIndexBuffer(cmd, index_buffer, 0, VK_INDEX_TYPE_UINT32);
+            bound_index_buffer = index_buffer;
+        }
+        vkCmdPushConstants(cmd, layout, VK_SHADER_STAGE_VERTEX_BIT, 0, model_push_size, &item.model);
+        const MeshLod& lod = mesh->lod(item.lod < mesh->lod_count() ? item.lod : 0);
+        vkCmdDrawIndexed(cmd, lod.index_count, 1, lod.first_index, 0, 0);
+        ++stats.prepass_draws;
+    }
+}
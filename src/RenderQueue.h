@@ -0,0 +1,109 @@
+#pragma once
+#include <vulkan/vulkan.h>
+#include <cstddef>
+#include <cstdint>
+#include <memory_resource>
+#include <vector>
+#include "Components.h"
+
+// Counters for the state changes issued while recording one frame.
+struct RenderStats {
+    uint32_t draws = 0;
+    uint32_t pipeline_binds = 0;
+    uint32_t descriptor_binds = 0;
+    uint32_t vertex_buffer_binds = 0;
+    uint32_t index_buffer_binds = 0;
+    // Binds the same draws would have needed in submission order, with the
+    // same redundant binds skipped; compare with total_binds().
+    uint32_t unsorted_binds = 0;
+    uint32_t prepass_draws = 0;
+    uint32_t frustum_culled = 0;
+    uint32_t occlusion_culled = 0;
+    // Triangles drawn in the main pass, after LOD selection.
+    uint32_t triangles = 0;
+
+    uint32_t total_binds() const {
+        return pipeline_binds + descriptor_binds + vertex_buffer_binds + index_buffer_binds;
+    }
+};
+
+// Sort key plus the index of the queued draw it belongs to.
+struct RenderSortEntry {
+    uint64_t key;
+    uint32_t item;
+};
+
+// Stable LSD radix sort on 8-bit digits. Digits that are identical across all
+// keys are skipped, and the histogram/scatter passes of large inputs are split
+// over the shared JobSystem. scratch is resized as needed; the histograms come
+// from temp.
+void radix_sort(std::vector<RenderSortEntry>& entries, std::vector<RenderSortEntry>& scratch,
+                std::pmr::memory_resource* temp = std::pmr::get_default_resource());
+
+// Pipeline and descriptor objects the sort key ids resolve to at record time.
+struct RenderQueueBindings {
+    const VkPipeline* pipelines = nullptr;
+    uint32_t pipeline_count = 0;
+    const VkDescriptorSet* descriptor_sets = nullptr;
+    uint32_t descriptor_set_count = 0;
+    VkPipelineLayout pipeline_layout = VK_NULL_HANDLE;
+    // Resolves the queued mesh handles; stale ones are skipped.
+    const MeshPool* meshes = nullptr;
+};
+
+// Collects the draws of a frame, sorts them by a packed 64-bit key and records
+// them with redundant pipeline, descriptor and buffer binds removed.
+//
+// Each draw carries its entity's model matrix, pushed as the first
+// model_push_size bytes of vertex-stage push constants. Pipelines recorded
+// through a queue reserve that range; per-pass constants such as a
+// view-projection follow it.
+//
+// Key layout, most significant first:
+//   [63..56] pipeline  [55..40] material  [39..24] mesh  [23..0] depth
+// Sorting by pipeline first groups the most expensive state change; depth
+// sits in the low bits so draws sharing state go front to back.
+class RenderQueue {
+public:
+    static constexpr uint32_t pipeline_bits = 8;
+    static constexpr uint32_t material_bits = 16;
+    static constexpr uint32_t mesh_bits = 16;
+    static constexpr uint32_t depth_bits = 24;
+    static constexpr uint32_t model_push_size = sizeof(glm::mat4);
+
+    static uint64_t make_key(uint32_t pipeline, uint32_t material, uint32_t mesh, float depth01);
+
+    void clear();
+    // depth01 is the normalized view depth in [0, 1]; values outside are clamped.
+    // lod picks the mesh's index range; all levels share its buffers. Handles
+    // are resolved at record time; model is copied.
+    void submit(MeshHandle mesh, const glm::mat4& model, uint32_t pipeline, uint32_t material, float depth01,
+                uint32_t lod = 0);
+    // temp holds the sort's histograms, typically the frame arena.
+    void sort(std::pmr::memory_resource* temp = std::pmr::get_default_resource());
+    void record(VkCommandBuffer cmd, const RenderQueueBindings& bindings, RenderStats& stats) const;
+    // Records every queued draw with a single depth-only pipeline, binding the
+    // meshes' position streams. Descriptor sets the pipeline reads must already
+    // be bound; layout is the one the model matrix is pushed through.
+    void record_depth(VkCommandBuffer cmd, VkPipeline depthPipeline, VkPipelineLayout layout, const MeshPool& meshes,
+                      RenderStats& stats) const;
+
+    size_t size() const { return items_.size(); }
+    bool empty() const { return items_.empty(); }
+
+private:
+    struct Item {
+        glm::mat4 model;
+        MeshHandle mesh;
+        uint32_t pipeline;
+        uint32_t material;
+        uint32_t lod;
+    };
+
+    // The item's mesh, or null when record() skips the item.
+    const Mesh* resolve(const Item& item, const RenderQueueBindings& bindings) const;
+
+    std::vector<Item> items_;
+    std::vector<RenderSortEntry> entries_;
+    std::vector<RenderSortEntry> scratch_;
+};
@@ -0,0 +1,123 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <optional>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+// 32-bit reference into a ResourcePool<T>: slot index in the low bits, the
+// slot's generation in the high ones. Removing a resource bumps its slot's
+// generation, so stale handles fail lookups instead of aliasing whatever
+// reuses the slot. Generations start at 1, so the zero handle is null.
+template<typename T>
+struct Handle {
+    static constexpr uint32_t index_bits = 20;
+    static constexpr uint32_t index_mask = (1u << index_bits) - 1;
+    static constexpr uint32_t generation_mask = (1u << (32 - index_bits)) - 1;
+
+    uint32_t value = 0;
+
+    static Handle make(uint32_t index, uint32_t generation) { return {(generation << index_bits) | index}; }
+    uint32_t index() const { return value & index_mask; }
+    uint32_t generation() const { return value >> index_bits; }
+    bool valid() const { return value != 0; }
+    bool operator==(const Handle&) const = default;
+};
+
+template<typename T>
+struct std::hash<Handle<T>> {
+    size_t operator()(Handle<T> handle) const { return std::hash<uint32_t>()(handle.value); }
+};
+
+// Owns resources of one type in fixed-size pages of slots addressed by
+// Handle<T>. Lookups are an index and a generation compare; resources never
+// move, so pointers stay valid until the resource is removed. Freed slots are
+// reused most recently freed first.
+//
+// Not synchronized: create and remove from one thread; concurrent get() is
+// fine while nothing is created or removed.
+template<typename T>
+class ResourcePool {
+public:
+    static constexpr uint32_t page_size = 256;
+
+    ResourcePool() = default;
+    ResourcePool(const ResourcePool&) = delete;
+    ResourcePool& operator=(const ResourcePool&) = delete;
+
+    template<typename... Args>
+    Handle<T> create(Args&&... args) {
+        uint32_t index;
+        if (!free_.empty()) {
+            index = free_.back();
+            free_.pop_back();
+        } else {
+            index = capacity_;
+            if (index > Handle<T>::index_mask) throw std::runtime_error("Resource pool is full");
+            if (index % page_size == 0) pages_.push_back(std::make_unique<Slot[]>(page_size));
+            ++capacity_;
+        }
+        Slot& slot = slot_at(index);
+        slot.value.emplace(std::forward<Args>(args)...);
+        ++size_;
+        return Handle<T>::make(index, slot.generation);
+    }
+    // Destroys the resource; the handle and its copies go stale. Returns false
+    // if it already was.
+    bool remove(Handle<T> handle) {
+        Slot* slot = live_slot(handle);
+        if (!slot) return false;
+        slot->value.reset();
+        // Generation 0 is reserved for the null handle.
+        if (++slot->generation > Handle<T>::generation_mask) slot->generation = 1;
+        free_.push_back(handle.index());
+        --size_;
+        return true;
+    }
+    void clear() {
+        pages_.clear();
+        free_.clear();
+        capacity_ = 0;
+        size_ = 0;
+    }
+
+    // Null for the null handle and for stale ones.
+    T* get(Handle<T> handle) {
+        Slot* slot = live_slot(handle);
+        return slot ? &*slot->value : nullptr;
+    }
+    const T* get(Handle<T> handle) const { return const_cast<ResourcePool*>(this)->get(handle); }
+    bool contains(Handle<T> handle) const { return get(handle) != nullptr; }
+    size_t size() const { return size_; }
+
+    // fn(Handle<T>, T&) for every live resource, in slot order.
+    template<typename Fn>
+    void each(Fn&& fn) {
+        for (uint32_t i = 0; i < capacity_; ++i) {
+            Slot& slot = slot_at(i);
+            if (slot.value) fn(Handle<T>::make(i, slot.generation), *slot.value);
+        }
+    }
+
+private:
+    struct Slot {
+        std::optional<T> value;
+        uint32_t generation = 1;
+    };
+
+    Slot& slot_at(uint32_t index) { return pages_[index / page_size][index % page_size]; }
+    Slot* live_slot(Handle<T> handle) {
+        uint32_t index = handle.index();
+        if (!handle.valid() || index >= capacity_) return nullptr;
+        Slot& slot = slot_at(index);
+        return slot.value && slot.generation == handle.generation() ? &slot : nullptr;
+    }
+
+    std::vector<std::unique_ptr<Slot[]>> pages_;
+    std::vector<uint32_t> free_;
+    uint32_t capacity_ = 0;
+    size_t size_ = 0;
+};
@@ -0,0 +1,258 @@
+#include "Scene.h"
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include "Mesh.h"
+#include "RenderQueue.h"
+#include "OcclusionCuller.h"
+#include "JobSystem.h"
+
+namespace {
+// Steps from the previous level: finer while its error is visible, coarser
+// while the next level stays under the threshold minus the hysteresis margin.
+uint32_t select_lod(const std::vector<MeshLod>& lods, uint32_t current, float pixelsPerUnit, float thresholdPixels, float hysteresis) {
+    uint32_t lod = std::min<uint32_t>(current, static_cast<uint32_t>(lods.size()) - 1);
+    while (lod > 0 && lods[lod].error * pixelsPerUnit > thresholdPixels) --lod;
+    float coarsen = thresholdPixels * (1.0f - hysteresis);
+    while (lod + 1 < lods.size() && lods[lod + 1].error * pixelsPerUnit <= coarsen) ++lod;
+    return lod;
+}
+
+float max_scale(const glm::mat4& m) {
+    float sx = glm::dot(glm::vec3(m[0]), glm::vec3(m[0]));
+    float sy = glm::dot(glm::vec3(m[1]), glm::vec3(m[1]));
+    float sz = glm::dot(glm::vec3(m[2]), glm::vec3(m[2]));
+    return std::sqrt(std::max(sx, std::max(sy, sz)));
+}
+}
+
+World& Scene::world() {
+    if (dirty_ || root.get() != flattened_root_) flatten();
+    return world_;
+}
+
+Entity Scene::entity(const SceneNode* node) const {
+    auto it = node_entities_.find(node);
+    return it != node_entities_.end() ? it->second : Entity{};
+}
+
+void Scene::flatten() {
+    world_.clear();
+    node_entities_.clear();
+    entity_nodes_.clear();
+    bvh_built_ = false;
+    max_depth_ = 0;
+    flattened_root_ = root.get();
+    dirty_ = false;
+    if (root) flatten_node(*root, Entity{}, 0);
+}
+
+void Scene::flatten_node(const SceneNode& node, Entity parent, uint32_t depth) {
+    ComponentMask mask = component_mask<LocalTransform, WorldTransform>();
+    if (depth > 0) mask |= component_bit<Parent>();
+    if (node.mesh.valid()) mask |= component_mask<MeshRef, WorldBounds, MaterialRef, LodState>();
+    if (node.occluder) mask |= component_bit<OccluderRef>();
+    Entity entity = world_.create(mask);
+    *world_.get<LocalTransform>(entity) = {node.position, node.rotation, node.scale};
+    if (depth > 0) *world_.get<Parent>(entity) = {parent, depth};
+    if (node.mesh.valid()) {
+        world_.get<MeshRef>(entity)->mesh = node.mesh;
+        *world_.get<MaterialRef>(entity) = {node.pipeline, node.material};
+    }
+    if (node.occluder) world_.get<OccluderRef>(entity)->geometry = node.occluder.get();
+    node_entities_[&node] = entity;
+    if (entity.index >= entity_nodes_.size()) entity_nodes_.resize(entity.index + 1, nullptr);
+    entity_nodes_[entity.index] = &node;
+    max_depth_ = std::max(max_depth_, depth);
+    for (auto& child : node.children) {
+        flatten_node(*child, entity, depth + 1);
+    }
+}
+
+void Scene::update() {
+    World& entities = world();
+    entities.parallel_each_chunk<LocalTransform, WorldTransform>([](const auto& chunk) {
+        const LocalTransform* local = chunk.template get<LocalTransform>();
+        WorldTransform* world = chunk.template get<WorldTransform>();
+        for (uint32_t i = 0; i < chunk.count; ++i) world[i].matrix = local[i].matrix();
+    }, component_bit<Parent>());
+    // Each pass only reads parents resolved by the previous one. Hierarchies
+    // are shallow, so rescanning the child chunks per depth is cheap.
+    for (uint32_t depth = 1; depth <= max_depth_; ++depth) {
+        entities.parallel_each_chunk<LocalTransform, Parent, WorldTransform>([&](const auto& chunk) {
+            const LocalTransform* local = chunk.template get<LocalTransform>();
+            const Parent* parent = chunk.template get<Parent>();
+            WorldTransform* world = chunk.template get<WorldTransform>();
+            for (uint32_t i = 0; i < chunk.count; ++i) {
+                if (parent[i].depth != depth) continue;
+                const WorldTransform* parentWorld = entities.get<WorldTransform>(parent[i].entity);
+                glm::mat4 base = parentWorld ? parentWorld->matrix : glm::mat4(1.0f);
+                world[i].matrix = base * local[i].matrix();
+            }
+        });
+    }
+    entities.parallel_each_chunk<MeshRef, WorldTransform, WorldBounds>([&](const auto& chunk) {
+        const MeshRef* mesh = chunk.template get<MeshRef>();
+        const WorldTransform* world = chunk.template get<WorldTransform>();
+        WorldBounds* bounds = chunk.template get<WorldBounds>();
+        for (uint32_t i = 0; i < chunk.count; ++i) {
+            const Mesh* resolved = meshes_.get(mesh[i].mesh);
+            bounds[i].box = resolved ? resolved->bounds().transformed(world[i].matrix) : Aabb{};
+        }
+    });
+    bvh_stale_ = true;
+}
+
+const SceneBvh& Scene::bvh() {
+    World& entities = world();
+    if (!bvh_built_) {
+        bvh_.build(entities, meshes_);
+        bvh_built_ = true;
+    } else if (bvh_stale_) {
+        bvh_.refit(entities, meshes_);
+    }
+    bvh_stale_ = false;
+    return bvh_;
+}
+
+const SceneNode* Scene::pick(const Ray& ray, RayHit* hit) {
+    RayHit local;
+    RayHit& result = hit ? *hit : local;
+    if (!raycast(ray, result)) return nullptr;
+    Entity entity = bvh_.entity(result.instance);
+    return entity.index < entity_nodes_.size() ? entity_nodes_[entity.index] : nullptr;
+}
+
+void Scene::collect(RenderQueue& queue, CullContext& ctx, OcclusionCuller* occlusion) {
+    update();
+    ctx.frustum = Frustum(ctx.view_proj);
+    ctx.occlusion = nullptr;
+    if (occlusion) {
+        occlusion->begin_frame(ctx.view_proj);
+        // Occluders attached to a mesh are skipped when the mesh is off screen.
+        world_.each_chunk<OccluderRef, WorldTransform, WorldBounds>([&](const auto& chunk) {
+            const OccluderRef* occluder = chunk.template get<OccluderRef>();
+            const WorldTransform* world = chunk.template get<WorldTransform>();
+            const WorldBounds* bounds = chunk.template get<WorldBounds>();
+            for (uint32_t i = 0; i < chunk.count; ++i) {
+                if (ctx.frustum.intersects(bounds[i].box)) occlusion->add_occluder(*occluder[i].geometry, world[i].matrix);
+            }
+        });
+        world_.each<OccluderRef, WorldTransform>([&](const OccluderRef& occluder, const WorldTransform& world) {
+            occlusion->add_occluder(*occluder.geometry, world.matrix);
+        }, component_bit<WorldBounds>());
+        occlusion->rasterize();
+        ctx.occlusion = occlusion;
+    }
+
+    // Cull in parallel into a flat result array, then queue serially in the
+    // same chunk order so RenderQueue stays single-threaded.
+    cull_results_.resize(world_.count<WorldTransform, WorldBounds, MeshRef, MaterialRef, LodState>());
+    std::atomic<uint32_t> frustumCulled{0};
+    std::atomic<uint32_t> occlusionCulled{0};
+    const CullContext& view = ctx;
+    world_.parallel_each_chunk<WorldTransform, WorldBounds, MeshRef, MaterialRef, LodState>([&](const auto& chunk) {
+        const WorldTransform* world = chunk.template get<WorldTransform>();
+        const WorldBounds* bounds = chunk.template get<WorldBounds>();
+        const MeshRef* mesh = chunk.template get<MeshRef>();
+        LodState* lodState = chunk.template get<LodState>();
+        CullResult* results = cull_results_.data() + chunk.first;
+        uint32_t frustumCount = 0, occlusionCount = 0;
+        for (uint32_t i = 0; i < chunk.count; ++i) {
+            results[i].visible = false;
+            const Mesh* resolved = meshes_.get(mesh[i].mesh);
+            if (!resolved) continue;
+            if (!view.frustum.intersects(bounds[i].box)) {
+                ++frustumCount;
+            } else if (view.occlusion && !view.occlusion->is_visible(bounds[i].box)) {
+                ++occlusionCount;
+            } else {
+                // Sort depth from the entity origin; good enough to order opaque draws.
+                glm::vec4 clip = view.view_proj * world[i].matrix[3];
+                results[i].depth = clip.w > 0.0f ? clip.z / clip.w : 0.0f;
+                results[i].visible = true;
+                if (view.reuse_lod) {
+                    results[i].lod = lodState[i].lod;
+                    continue;
+                }
+                const auto& lods = resolved->lods();
+                if (view.lod_pixel_scale > 0.0f && lods.size() > 1 && clip.w > 0.0f) {
+                    float pixelsPerUnit = view.lod_pixel_scale * max_scale(world[i].matrix) / clip.w;
+                    lodState[i].lod = select_lod(lods, lodState[i].lod, pixelsPerUnit, view.lod_error_pixels, view.lod_hysteresis);
+                } else {
+                    lodState[i].lod = 0;
+                }
+                results[i].lod = lodState[i].lod;
+            }
+        }
+        frustumCulled.fetch_add(frustumCount, std::memory_order_relaxed);
+        occlusionCulled.fetch_add(occlusionCount, std::memory_order_relaxed);
+    });
+    ctx.frustum_culled += frustumCulled.load(std::memory_order_relaxed);
+    ctx.occlusion_culled += occlusionCulled.load(std::memory_order_relaxed);
+
+    world_.each_chunk<WorldTransform, WorldBounds, MeshRef, MaterialRef, LodState>([&](const auto& chunk) {
+        const WorldTransform* world = chunk.template get<WorldTransform>();
+        const MeshRef* mesh = chunk.template get<MeshRef>();
+        const MaterialRef* material = chunk.template get<MaterialRef>();
+        const CullResult* results = cull_results_.data() + chunk.first;
+        for (uint32_t i = 0; i < chunk.count; ++i) {
+            if (results[i].visible)
+                queue.submit(mesh[i].mesh, world[i].matrix, material[i].pipeline, material[i].material, results[i].depth, results[i].lod);
+        }
+    });
+}
+
+void Scene::collect_views(std::span<RenderQueue> queues, std::span<CullContext> views) {
+    const size_t viewCount = std::min(queues.size(), views.size());
+    if (viewCount == 0) return;
+    update();
+    for (size_t v = 0; v < viewCount; ++v) views[v].frustum = Frustum(views[v].view_proj);
+
+    const size_t entityCount = world_.count<WorldTransform, WorldBounds, MeshRef, MaterialRef, LodState>();
+    view_results_.resize(entityCount * viewCount);
+    world_.parallel_each_chunk<WorldTransform, WorldBounds, MeshRef, MaterialRef, LodState>([&](const auto& chunk) {
+        const WorldTransform* world = chunk.template get<WorldTransform>();
+        const WorldBounds* bounds = chunk.template get<WorldBounds>();
+        const MeshRef* mesh = chunk.template get<MeshRef>();
+        CullResult* results = view_results_.data() + chunk.first * viewCount;
+        for (uint32_t i = 0; i < chunk.count; ++i, results += viewCount) {
+            const Mesh* resolved = meshes_.get(mesh[i].mesh);
+            const float scale = max_scale(world[i].matrix);
+            for (size_t v = 0; v < viewCount; ++v) {
+                const CullContext& view = views[v];
+                results[v].visible = resolved && view.frustum.intersects(bounds[i].box);
+                if (!results[v].visible) continue;
+                glm::vec4 clip = view.view_proj * world[i].matrix[3];
+                results[v].depth = clip.w > 0.0f ? clip.z / clip.w : 0.0f;
+                results[v].lod = 0;
+                const auto& lods = resolved->lods();
+                if (view.lod_pixel_scale > 0.0f && lods.size() > 1 && clip.w > 0.0f)
+                    results[v].lod = select_lod(lods, 0, view.lod_pixel_scale * scale / clip.w, view.lod_error_pixels, 0.0f);
+            }
+        }
+    });
+
+    // Each view's queue is filled by one thread, in chunk order.
+    JobSystem::shared().parallel_for(viewCount, 1, [&](size_t begin, size_t end) {
+        for (size_t v = begin; v < end; ++v) {
+            RenderQueue& queue = queues[v];
+            uint32_t culled = 0;
+            world_.each_chunk<WorldTransform, WorldBounds, MeshRef, MaterialRef, LodState>([&](const auto& chunk) {
+                const WorldTransform* world = chunk.template get<WorldTransform>();
+                const MeshRef* mesh = chunk.template get<MeshRef>();
+                const MaterialRef* material = chunk.template get<MaterialRef>();
+                const CullResult* results = view_results_.data() + chunk.first * viewCount + v;
+                for (uint32_t i = 0; i < chunk.count; ++i, results += viewCount) {
+                    if (results->visible) {
+                        queue.submit(mesh[i].mesh, world[i].matrix, material[i].pipeline, material[i].material, results->depth,
+                                     results->lod);
+                    } else if (meshes_.get(mesh[i].mesh)) {
+                        ++culled;
+                    }
+                }
+            });
+            views[v].frustum_culled += culled;
+        }
+    });
+}
@@ -1,13 +1,102 @@
 #pragma once
 #include <memory>
+#include <span>
+#include <unordered_map>
+#include <vector>
 #include "SceneNode.h"
+#include "World.h"
+#include "Frustum.h"
+#include "SceneBvh.h"
 
 class VulkanApp;
+class RenderQueue;
+class OcclusionCuller;
 
+// Per-view culling inputs and counters for Scene::collect.
+struct CullContext {
+    glm::mat4 view_proj{1.0f};
+    Frustum frustum;
+    // Optional; rasterized occluders must already be in it when collecting.
+    const OcclusionCuller* occlusion = nullptr;
+    // Pixels covered by one world unit at view depth 1: half the viewport
+    // height times projection[1][1]. Zero disables LOD selection.
+    float lod_pixel_scale = 0.0f;
+    // Coarsest LOD whose error projects below this many pixels is drawn.
+    float lod_error_pixels = 1.0f;
+    // Switching to a coarser LOD needs its error this fraction below the
+    // threshold, so objects at a boundary don't flicker between levels.
+    float lod_hysteresis = 0.25f;
+    // Draw the LOD the main view last selected instead of selecting one, so a
+    // secondary view (a shadow cascade) neither disturbs the main view's
+    // hysteresis nor draws different geometry.
+    bool reuse_lod = false;
+    uint32_t frustum_culled = 0;
+    uint32_t occlusion_culled = 0;
+};
+
+// Scene data lives in an archetype World; the SceneNode tree stays as the API
+// for building hierarchies. The tree is flattened into entities (parents before
+// children) on first use and again after mark_dirty() or a new root. Meshes
+// are looked up by handle in a pool that must outlive the scene; entities
+// whose mesh was removed from it are skipped. Occluders remain owned by the
+// nodes, so the tree must outlive its entities. Between rebuilds, move things
+// through world() directly.
 class Scene {
 public:
+    explicit Scene(const MeshPool& meshes) : meshes_(meshes) {}
+
     std::unique_ptr<SceneNode> root;
-    void render(VkCommandBuffer cmd) {
-        if (root) root->render(cmd);
-    }
-}; 
\ No newline at end of file
+
+    // Re-flattens the tree on next use. Call after editing nodes.
+    void mark_dirty() { dirty_ = true; }
+    World& world();
+    // Entity created for node by the last flatten, or an invalid entity.
+    Entity entity(const SceneNode* node) const;
+
+    // Recomputes world transforms (one hierarchy depth at a time) and mesh
+    // bounds, with chunks spread over the JobSystem.
+    void update();
+    // Frustum culls against ctx.view_proj. If an occlusion culler is passed,
+    // the scene's occluders are rasterized into it first and occludees are
+    // tested against it before anything is queued.
+    void collect(RenderQueue& queue, CullContext& ctx, OcclusionCuller* occlusion = nullptr);
+    // Culls for many views at once, filling queues[i] from views[i]. Entities
+    // are updated and visited once, each tested against every view, and the
+    // queues are filled in parallel. LODs are selected per view without
+    // hysteresis and leave the main view's state alone; reuse_lod and
+    // occlusion are not supported.
+    void collect_views(std::span<RenderQueue> queues, std::span<CullContext> views);
+
+    // Ray queries against meshes that have a TriangleBvh, using the transforms
+    // of the last update() or collect(). The top-level BVH is rebuilt after a
+    // flatten and refit after an update, on the next query.
+    const SceneBvh& bvh();
+    bool raycast(const Ray& ray, RayHit& hit) { return bvh().intersect(ray, hit); }
+    // Node owning the closest mesh along ray, or null.
+    const SceneNode* pick(const Ray& ray, RayHit* hit = nullptr);
+
+private:
+    struct CullResult {
+        float depth;
+        uint32_t lod;
+        bool visible;
+    };
+
+    void flatten();
+    void flatten_node(const SceneNode& node, Entity parent, uint32_t depth);
+
+    const MeshPool& meshes_;
+    World world_;
+    std::unordered_map<const SceneNode*, Entity> node_entities_;
+    // By entity index.
+    std::vector<const SceneNode*> entity_nodes_;
+    const SceneNode* flattened_root_ = nullptr;
+    uint32_t max_depth_ = 0;
+    bool dirty_ = true;
+    std::vector<CullResult> cull_results_;
+    // Entity-major: the views' results for one entity are adjacent.
+    std::vector<CullResult> view_results_;
+    SceneBvh bvh_;
+    bool bvh_built_ = false;
+    bool bvh_stale_ = false;
+};
@@ -0,0 +1,206 @@
+#include "SceneBvh.h"
+#include <algorithm>
+#include "Mesh.h"
+
+namespace {
+// Refits touching more leaves than this fraction of the nodes sweep the whole
+// tree once instead of walking up from each leaf.
+constexpr uint32_t full_refit_divisor = 4;
+
+Ray to_object_space(const Ray& ray, const glm::mat4& inverse, float tMax) {
+    // Affine, so hit distances along the transformed direction are unchanged.
+    Ray local;
+    local.origin = glm::vec3(inverse * glm::vec4(ray.origin, 1.0f));
+    local.direction = glm::mat3(inverse) * ray.direction;
+    local.t_max = tMax;
+    return local;
+}
+}
+
+void SceneBvh::clear() {
+    nodes_.clear();
+    parents_.clear();
+    instances_.clear();
+    instance_leaves_.clear();
+    candidate_count_ = 0;
+    refit_nodes_ = 0;
+}
+
+void SceneBvh::build(const World& world, const MeshPool& meshes) {
+    clear();
+    std::vector<Instance> gathered;
+    world.each_chunk<MeshRef, WorldTransform, WorldBounds>([&](const auto& chunk) {
+        const MeshRef* mesh = chunk.template get<MeshRef>();
+        const WorldTransform* transform = chunk.template get<WorldTransform>();
+        const WorldBounds* bounds = chunk.template get<WorldBounds>();
+        candidate_count_ += chunk.count;
+        for (uint32_t i = 0; i < chunk.count; ++i) {
+            const Mesh* resolved = meshes.get(mesh[i].mesh);
+            const TriangleBvh* bvh = resolved ? resolved->bvh() : nullptr;
+            if (!bvh || bvh->nodes().empty()) continue;
+            gathered.push_back({bvh, transform[i].matrix, glm::inverse(transform[i].matrix), bounds[i].box, chunk.entities[i]});
+        }
+    });
+
+    std::vector<Aabb> bounds(gathered.size());
+    for (size_t i = 0; i < gathered.size(); ++i) bounds[i] = gathered[i].bounds;
+    std::vector<uint32_t> order;
+    build_bvh(bounds, 2, nodes_, order);
+    instances_.resize(gathered.size());
+    for (size_t i = 0; i < order.size(); ++i) instances_[i] = gathered[order[i]];
+
+    parents_.assign(nodes_.size(), UINT32_MAX);
+    instance_leaves_.resize(instances_.size());
+    for (uint32_t n = 0; n < nodes_.size(); ++n) {
+        const BvhNode& node = nodes_[n];
+        if (node.leaf()) {
+            for (uint32_t i = node.first; i < node.first + node.count; ++i) instance_leaves_[i] = n;
+        } else {
+            parents_[node.first] = n;
+            parents_[node.first + 1] = n;
+        }
+    }
+}
+
+void SceneBvh::refit_node(uint32_t index) {
+    BvhNode& node = nodes_[index];
+    Aabb box;
+    if (node.leaf()) {
+        for (uint32_t i = node.first; i < node.first + node.count; ++i) box.expand(instances_[i].bounds);
+    } else {
+        for (uint32_t c = node.first; c < node.first + 2; ++c) {
+            box.expand(glm::vec3(nodes_[c].min));
+            box.expand(glm::vec3(nodes_[c].max));
+        }
+    }
+    node.min = box.min;
+    node.max = box.max;
+}
+
+void SceneBvh::refit(const World& world, const MeshPool& meshes) {
+    refit_nodes_ = 0;
+    if (world.count<MeshRef, WorldTransform, WorldBounds>() != candidate_count_) {
+        build(world, meshes);
+        return;
+    }
+    changed_.clear();
+    for (uint32_t i = 0; i < instances_.size(); ++i) {
+        Instance& instance = instances_[i];
+        const WorldTransform* transform = world.get<WorldTransform>(instance.entity);
+        const WorldBounds* bounds = world.get<WorldBounds>(instance.entity);
+        if (!transform || !bounds) {
+            build(world, meshes);
+            return;
+        }
+        if (transform->matrix == instance.world) continue;
+        instance.world = transform->matrix;
+        instance.inverse = glm::inverse(transform->matrix);
+        instance.bounds = bounds->box;
+        if (changed_.empty() || changed_.back() != instance_leaves_[i]) changed_.push_back(instance_leaves_[i]);
+    }
+    if (changed_.size() * full_refit_divisor > nodes_.size()) {
+        // Children always come after their parent.
+        for (uint32_t n = static_cast<uint32_t>(nodes_.size()); n-- > 0;) refit_node(n);
+        refit_nodes_ = static_cast<uint32_t>(nodes_.size());
+        return;
+    }
+    for (uint32_t node : changed_) {
+        // Once a node's box comes out unchanged, nothing above it moves either.
+        while (node != UINT32_MAX) {
+            glm::vec3 oldMin = nodes_[node].min, oldMax = nodes_[node].max;
+            refit_node(node);
+            ++refit_nodes_;
+            if (nodes_[node].min == oldMin && nodes_[node].max == oldMax) break;
+            node = parents_[node];
+        }
+    }
+}
+
+bool SceneBvh::intersect(const Ray& ray, RayHit& hit) const {
+    if (nodes_.empty()) return false;
+    glm::vec3 invDir = ray_inverse_direction(ray.direction);
+    float tMax = std::min(ray.t_max, hit.t);
+    bool found = false;
+    uint32_t stack[64];
+    uint32_t top = 0;
+    stack[top++] = 0;
+    while (top > 0) {
+        const BvhNode& node = nodes_[stack[--top]];
+        if (intersect_node(node, ray.origin, invDir, tMax) == FLT_MAX) continue;
+        if (!node.leaf()) {
+            float tLeft = intersect_node(nodes_[node.first], ray.origin, invDir, tMax);
+            float tRight = intersect_node(nodes_[node.first + 1], ray.origin, invDir, tMax);
+            // Near child on top.
+            stack[top++] = tLeft <= tRight ? node.first + 1 : node.first;
+            stack[top++] = tLeft <= tRight ? node.first : node.first + 1;
+            continue;
+        }
+        for (uint32_t i = node.first; i < node.first + node.count; ++i) {
+            const Instance& instance = instances_[i];
+            BvhNode box{instance.bounds.min, 0, instance.bounds.max, 0};
+            if (intersect_node(box, ray.origin, invDir, tMax) == FLT_MAX) continue;
+            if (instance.bvh->intersect(to_object_space(ray, instance.inverse, tMax), hit)) {
+                hit.instance = i;
+                tMax = hit.t;
+                found = true;
+            }
+        }
+    }
+    return found;
+}
+
+void SceneBvh::intersect(const RayPacket& packet, RayHit hits[4]) const {
+    if (nodes_.empty()) return;
+    // The top level holds few nodes next to the meshes below it, so it is
+    // walked lane by lane; the packet stays together inside each TriangleBvh.
+    Ray rays[4];
+    glm::vec3 invDir[4];
+    float tMax[4];
+    glm::vec3 dirSum(0.0f);
+    for (uint32_t l = 0; l < 4; ++l) {
+        rays[l] = packet.ray(l);
+        invDir[l] = ray_inverse_direction(rays[l].direction);
+        tMax[l] = std::min(rays[l].t_max, hits[l].t);
+        dirSum += rays[l].direction;
+    }
+    auto lanes_hitting = [&](const BvhNode& node) {
+        uint32_t mask = 0;
+        for (uint32_t l = 0; l < 4; ++l) {
+            if (tMax[l] > 0.0f && intersect_node(node, rays[l].origin, invDir[l], tMax[l]) != FLT_MAX) mask |= 1u << l;
+        }
+        return mask;
+    };
+
+    uint32_t stack[64];
+    uint32_t top = 0;
+    stack[top++] = 0;
+    while (top > 0) {
+        const BvhNode& node = nodes_[stack[--top]];
+        if (!lanes_hitting(node)) continue;
+        if (!node.leaf()) {
+            glm::vec3 leftCenter = nodes_[node.first].min + nodes_[node.first].max;
+            glm::vec3 rightCenter = nodes_[node.first + 1].min + nodes_[node.first + 1].max;
+            bool leftFirst = glm::dot(leftCenter - rightCenter, dirSum) <= 0.0f;
+            stack[top++] = leftFirst ? node.first + 1 : node.first;
+            stack[top++] = leftFirst ? node.first : node.first + 1;
+            continue;
+        }
+        for (uint32_t i = node.first; i < node.first + node.count; ++i) {
+            const Instance& instance = instances_[i];
+            uint32_t mask = lanes_hitting(BvhNode{instance.bounds.min, 0, instance.bounds.max, 0});
+            if (!mask) continue;
+            RayPacket local;
+            for (uint32_t l = 0; l < 4; ++l) {
+                // Lanes that miss this instance ride along inactive.
+                local.set(l, to_object_space(rays[l], instance.inverse, (mask & (1u << l)) ? tMax[l] : 0.0f));
+            }
+            instance.bvh->intersect(local, hits);
+            for (uint32_t l = 0; l < 4; ++l) {
+                if (hits[l].t < tMax[l]) {
+                    hits[l].instance = i;
+                    tMax[l] = hits[l].t;
+                }
+            }
+        }
+    }
+}
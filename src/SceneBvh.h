@@ -0,0 +1,51 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+#include "Bvh.h"
+#include "World.h"
+
+// Top-level BVH over the mesh entities of a World, each instancing its mesh's
+// TriangleBvh. Rays are moved into object space per instance, so moving an
+// entity only touches this level: refit() re-reads transforms and walks the
+// changed leaves up to the first ancestor whose bounds did not change.
+class SceneBvh {
+public:
+    // Every entity with MeshRef, WorldTransform and WorldBounds whose mesh has
+    // a TriangleBvh. Reads the current world transforms and bounds. Removing
+    // one of the meshes from the pool requires a rebuild.
+    void build(const World& world, const MeshPool& meshes);
+    // Picks up moved entities; rebuilds instead when entities came or went.
+    void refit(const World& world, const MeshPool& meshes);
+    void clear();
+    bool empty() const { return instances_.empty(); }
+
+    // hit.instance is set on a hit; entity() maps it back.
+    bool intersect(const Ray& ray, RayHit& hit) const;
+    void intersect(const RayPacket& packet, RayHit hits[4]) const;
+
+    Entity entity(uint32_t instance) const { return instances_[instance].entity; }
+    size_t instance_count() const { return instances_.size(); }
+    // Nodes recomputed by the last refit.
+    uint32_t refit_node_count() const { return refit_nodes_; }
+
+private:
+    struct Instance {
+        const TriangleBvh* bvh;
+        glm::mat4 world;
+        glm::mat4 inverse;
+        Aabb bounds;
+        Entity entity;
+    };
+
+    void refit_node(uint32_t node);
+
+    std::vector<BvhNode> nodes_;
+    std::vector<uint32_t> parents_;
+    // In leaf order, so leaves index them directly.
+    std::vector<Instance> instances_;
+    std::vector<uint32_t> instance_leaves_;
+    std::vector<uint32_t> changed_;
+    // Entities the query matched at build time, with or without a TriangleBvh.
+    size_t candidate_count_ = 0;
+    uint32_t refit_nodes_ = 0;
+};
@@ -2,17 +2,26 @@
 #include <vector>
 #include <memory>
 #include <glm/glm.hpp>
-#include "Mesh.h"
+#include "Components.h"
 // #include "VulkanApp.h" // Remove this include
 
 class VulkanApp; // Forward declaration
+struct OccluderGeometry;
 
+// Authoring node for building hierarchies. Scene flattens the tree into its
+// World for updates, culling and rendering.
 class SceneNode {
 public:
     glm::vec3 position{0.0f}, rotation{0.0f}, scale{1.0f, 1.0f, 1.0f};
-    std::shared_ptr<Mesh> mesh;
+    // Null for nodes that only group or transform others.
+    MeshHandle mesh;
+    // Indices into the renderer's pipeline and material (descriptor set) tables.
+    uint32_t pipeline = 0;
+    uint32_t material = 0;
+    // Optional low-poly stand-in rasterized for software occlusion culling.
+    std::shared_ptr<OccluderGeometry> occluder;
     std::vector<std::unique_ptr<SceneNode>> children;
 
     void add_child(std::unique_ptr<SceneNode> child);
-    void render(VkCommandBuffer cmd, const glm::mat4& parentTransform = glm::mat4(1.0f));
-}; 
\ No newline at end of file
+    glm::mat4 local_transform() const;
+};
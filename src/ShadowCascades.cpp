@@ -0,0 +1,467 @@
+#include "ShadowCascades.h"
+#include "GpuMemory.h"
+#include "Scene.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+
+namespace {
+std::vector<char> read_file(const std::string& filename) {
+    std::ifstream file(filename, std::ios::ate | std::ios::binary);
+    if (!file.is_open()) throw std::runtime_error("failed to open file: " + filename);
+    std::vector<char> buffer(static_cast<size_t>(file.tellg()));
+    file.seekg(0);
+    file.read(buffer.data(), static_cast<std::streamsize>(buffer.size()));
+    return buffer;
+}
+
+VkShaderModule create_shader_module(VkDevice device, const std::string& filename) {
+    std::vector<char> code = read_file(filename);
+    VkShaderModuleCreateInfo createInfo{};
+    createInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+    createInfo.codeSize = code.size();
+    createInfo.pCode = reinterpret_cast<const uint32_t*>(code.data());
+    VkShaderModule module;
+    if (vkCreateShaderModule(device, &createInfo, nullptr, &module) != VK_SUCCESS)
+        throw std::runtime_error("Failed to create shader module: " + filename);
+    return module;
+}
+
+uint32_t find_memory_type(VkPhysicalDevice physicalDevice, uint32_t typeBits, VkMemoryPropertyFlags properties) {
+    VkPhysicalDeviceMemoryProperties memProperties;
+    vkGetPhysicalDeviceMemoryProperties(physicalDevice, &memProperties);
+    for (uint32_t i = 0; i < memProperties.memoryTypeCount; i++) {
+        if ((typeBits & (1 << i)) && (memProperties.memoryTypes[i].propertyFlags & properties) == properties) return i;
+    }
+    throw std::runtime_error("No suitable memory type for shadow cascades");
+}
+
+// Mirrors ShadowParams in shader.frag (std140).
+struct GpuShadowParams {
+    // Camera view space to each cascade's clip space.
+    glm::mat4 view_to_shadow[ShadowCascades::cascade_count];
+    // View depth where each cascade ends.
+    float cascade_end[4];
+    // World size of one shadow texel per cascade, for the normal offset.
+    float texel_world[4];
+    // View-space direction towards the light; w is the intensity.
+    float light_direction[4];
+    // Light color; w is the size of one texel in texture coordinates.
+    float light_color[4];
+};
+static_assert(ShadowCascades::cascade_count == 4, "GpuShadowParams packs per-cascade values in vec4s");
+
+const char* const pass_names[ShadowCascades::cascade_count] = {
+    "shadow_cascade0", "shadow_cascade1", "shadow_cascade2", "shadow_cascade3",
+};
+}
+
+void ShadowCascades::init(VkDevice device, VkPhysicalDevice physicalDevice, uint32_t frameSlots, uint32_t resolution) {
+    device_ = device;
+    frame_slots_ = frameSlots;
+    resolution_ = resolution;
+
+    VkImageCreateInfo imageInfo{};
+    imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+    imageInfo.imageType = VK_IMAGE_TYPE_2D;
+    imageInfo.format = format;
+    imageInfo.extent = { resolution_, resolution_, 1 };
+    imageInfo.mipLevels = 1;
+    imageInfo.arrayLayers = cascade_count;
+    imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+    imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+    imageInfo.usage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+    imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    if (vkCreateImage(device_, &imageInfo, nullptr, &image_) != VK_SUCCESS)
+        throw std::runtime_error("Failed to create shadow map");
+    VkMemoryRequirements imageRequirements;
+    vkGetImageMemoryRequirements(device_, image_, &imageRequirements);
+    VkMemoryAllocateInfo imageAlloc{};
+    imageAlloc.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+    imageAlloc.allocationSize = imageRequirements.size;
+    imageAlloc.memoryTypeIndex = find_memory_type(physicalDevice, imageRequirements.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+    if (GpuMemory::shared().allocate(device_, imageAlloc, GpuMemoryCategory::render_target, &image_memory_) != VK_SUCCESS)
+        throw std::runtime_error("Failed to allocate shadow map memory");
+    vkBindImageMemory(device_, image_, image_memory_, 0);
+    VkImageViewCreateInfo viewInfo{};
+    viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+    viewInfo.image = image_;
+    viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D_ARRAY;
+    viewInfo.format = format;
+    viewInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_DEPTH_BIT;
+    viewInfo.subresourceRange.levelCount = 1;
+    viewInfo.subresourceRange.layerCount = cascade_count;
+    if (vkCreateImageView(device_, &viewInfo, nullptr, &array_view_) != VK_SUCCESS)
+        throw std::runtime_error("Failed to create shadow map view");
+    viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+    viewInfo.subresourceRange.layerCount = 1;
+    for (uint32_t i = 0; i < cascade_count; ++i) {
+        viewInfo.subresourceRange.baseArrayLayer = i;
+        if (vkCreateImageView(device_, &viewInfo, nullptr, &layer_views_[i]) != VK_SUCCESS)
+            throw std::runtime_error("Failed to create shadow cascade view");
+    }
+
+    // Hardware 2x2 PCF; lookups outside a cascade count as lit.
+    VkSamplerCreateInfo samplerInfo{};
+    samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+    samplerInfo.magFilter = VK_FILTER_LINEAR;
+    samplerInfo.minFilter = VK_FILTER_LINEAR;
+    samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+    samplerInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_BORDER;
+    samplerInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_BORDER;
+    samplerInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_BORDER;
+    samplerInfo.borderColor = VK_BORDER_COLOR_FLOAT_OPAQUE_WHITE;
+    samplerInfo.compareEnable = VK_TRUE;
+    samplerInfo.compareOp = VK_COMPARE_OP_LESS_OR_EQUAL;
+    samplerInfo.maxLod = 0.0f;
+    if (vkCreateSampler(device_, &samplerInfo, nullptr, &sampler_) != VK_SUCCESS)
+        throw std::runtime_error("Failed to create shadow sampler");
+
+    std::array<VkDescriptorSetLayoutBinding, 2> bindings{};
+    bindings[0].binding = 0;
+    bindings[0].descriptorCount = 1;
+    bindings[0].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+    bindings[0].stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+    bindings[1].binding = 1;
+    bindings[1].descriptorCount = 1;
+    bindings[1].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    bindings[1].stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+    VkDescriptorSetLayoutCreateInfo layoutInfo{};
+    layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+    layoutInfo.bindingCount = static_cast<uint32_t>(bindings.size());
+    layoutInfo.pBindings = bindings.data();
+    if (vkCreateDescriptorSetLayout(device_, &layoutInfo, nullptr, &set_layout_) != VK_SUCCESS)
+        throw std::runtime_error("Failed to create shadow descriptor set layout");
+
+    std::array<VkDescriptorPoolSize, 2> poolSizes{};
+    poolSizes[0].type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+    poolSizes[0].descriptorCount = frame_slots_;
+    poolSizes[1].type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    poolSizes[1].descriptorCount = frame_slots_;
+    VkDescriptorPoolCreateInfo poolInfo{};
+    poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+    poolInfo.poolSizeCount = static_cast<uint32_t>(poolSizes.size());
+    poolInfo.pPoolSizes = poolSizes.data();
+    poolInfo.maxSets = frame_slots_;
+    if (vkCreateDescriptorPool(device_, &poolInfo, nullptr, &descriptor_pool_) != VK_SUCCESS)
+        throw std::runtime_error("Failed to create shadow descriptor pool");
+
+    // One parameter range per frame slot, mapped for the lifetime of the cascades.
+    VkPhysicalDeviceProperties properties;
+    vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+    const VkDeviceSize alignment = properties.limits.minUniformBufferOffsetAlignment;
+    params_stride_ = (sizeof(GpuShadowParams) + alignment - 1) / alignment * alignment;
+    VkBufferCreateInfo bufferInfo{};
+    bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+    bufferInfo.size = params_stride_ * frame_slots_;
+    bufferInfo.usage = VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT;
+    bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    if (vkCreateBuffer(device_, &bufferInfo, nullptr, &params_buffer_) != VK_SUCCESS)
+        throw std::runtime_error("Failed to create shadow parameter buffer");
+    VkMemoryRequirements bufferRequirements;
+    vkGetBufferMemoryRequirements(device_, params_buffer_, &bufferRequirements);
+    VkMemoryAllocateInfo bufferAlloc{};
+    bufferAlloc.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+    bufferAlloc.allocationSize = bufferRequirements.size;
+    bufferAlloc.memoryTypeIndex = find_memory_type(physicalDevice, bufferRequirements.memoryTypeBits,
+                                                   VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+    if (GpuMemory::shared().allocate(device_, bufferAlloc, GpuMemoryCategory::uniform, &params_memory_) != VK_SUCCESS)
+        throw std::runtime_error("Failed to allocate shadow parameter memory");
+    vkBindBufferMemory(device_, params_buffer_, params_memory_, 0);
+    void* mapped = nullptr;
+    if (vkMapMemory(device_, params_memory_, 0, VK_WHOLE_SIZE, 0, &mapped) != VK_SUCCESS)
+        throw std::runtime_error("Failed to map shadow parameter memory");
+    params_ = static_cast<std::byte*>(mapped);
+
+    std::vector<VkDescriptorSetLayout> layouts(frame_slots_, set_layout_);
+    sets_.resize(frame_slots_);
+    VkDescriptorSetAllocateInfo setInfo{};
+    setInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+    setInfo.descriptorPool = descriptor_pool_;
+    setInfo.descriptorSetCount = frame_slots_;
+    setInfo.pSetLayouts = layouts.data();
+    if (vkAllocateDescriptorSets(device_, &setInfo, sets_.data()) != VK_SUCCESS)
+        throw std::runtime_error("Failed to allocate shadow descriptor sets");
+    VkDescriptorImageInfo imageDescriptor{};
+    imageDescriptor.sampler = sampler_;
+    imageDescriptor.imageView = array_view_;
+    imageDescriptor.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+    for (uint32_t slot = 0; slot < frame_slots_; ++slot) {
+        VkDescriptorBufferInfo bufferDescriptor{ params_buffer_, slot * params_stride_, sizeof(GpuShadowParams) };
+        std::array<VkWriteDescriptorSet, 2> writes{};
+        writes[0].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        writes[0].dstSet = sets_[slot];
+        writes[0].dstBinding = 0;
+        writes[0].descriptorCount = 1;
+        writes[0].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+        writes[0].pBufferInfo = &bufferDescriptor;
+        writes[1].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        writes[1].dstSet = sets_[slot];
+        writes[1].dstBinding = 1;
+        writes[1].descriptorCount = 1;
+        writes[1].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+        writes[1].pImageInfo = &imageDescriptor;
+        vkUpdateDescriptorSets(device_, static_cast<uint32_t>(writes.size()), writes.data(), 0, nullptr);
+    }
+
+    create_pipeline();
+}
+
+void ShadowCascades::create_pipeline() {
+    VkShaderModule vertModule = create_shader_module(device_, "assets/shadow.vert.spv");
+    VkPipelineShaderStageCreateInfo stage{};
+    stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    stage.stage = VK_SHADER_STAGE_VERTEX_BIT;
+    stage.module = vertModule;
+    stage.pName = "main";
+
+    // The meshes' position streams, as in the depth pre-pass.
+    VkVertexInputBindingDescription bindingDesc{};
+    bindingDesc.binding = 0;
+    bindingDesc.stride = sizeof(float) * 3;
+    bindingDesc.inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
+    VkVertexInputAttributeDescription attrDesc{};
+    attrDesc.binding = 0;
+    attrDesc.location = 0;
+    attrDesc.format = VK_FORMAT_R32G32B32_SFLOAT;
+    VkPipelineVertexInputStateCreateInfo vertexInputInfo{};
+    vertexInputInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
+    vertexInputInfo.vertexBindingDescriptionCount = 1;
+    vertexInputInfo.pVertexBindingDescriptions = &bindingDesc;
+    vertexInputInfo.vertexAttributeDescriptionCount = 1;
+    vertexInputInfo.pVertexAttributeDescriptions = &attrDesc;
+    VkPipelineInputAssemblyStateCreateInfo inputAssembly{};
+    inputAssembly.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
+    inputAssembly.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+    VkPipelineViewportStateCreateInfo viewportState{};
+    viewportState.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
+    viewportState.viewportCount = 1;
+    viewportState.scissorCount = 1;
+    std::array<VkDynamicState, 2> dynamicStates = { VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR };
+    VkPipelineDynamicStateCreateInfo dynamicState{};
+    dynamicState.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
+    dynamicState.dynamicStateCount = static_cast<uint32_t>(dynamicStates.size());
+    dynamicState.pDynamicStates = dynamicStates.data();
+    // Slope-scaled bias against acne; the sampling side adds a normal offset.
+    VkPipelineRasterizationStateCreateInfo rasterizer{};
+    rasterizer.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
+    rasterizer.polygonMode = VK_POLYGON_MODE_FILL;
+    rasterizer.lineWidth = 1.0f;
+    rasterizer.cullMode = VK_CULL_MODE_NONE;
+    rasterizer.frontFace = VK_FRONT_FACE_CLOCKWISE;
+    rasterizer.depthBiasEnable = VK_TRUE;
+    rasterizer.depthBiasConstantFactor = 1.25f;
+    rasterizer.depthBiasSlopeFactor = 1.75f;
+    VkPipelineMultisampleStateCreateInfo multisampling{};
+    multisampling.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
+    multisampling.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
+    VkPipelineColorBlendStateCreateInfo colorBlending{};
+    colorBlending.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
+    VkPipelineDepthStencilStateCreateInfo depthStencil{};
+    depthStencil.sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
+    depthStencil.depthTestEnable = VK_TRUE;
+    depthStencil.depthWriteEnable = VK_TRUE;
+    depthStencil.depthCompareOp = VK_COMPARE_OP_LESS;
+
+    // The caster's model matrix, then the cascade's view-projection.
+    VkPushConstantRange pushRange{};
+    pushRange.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+    pushRange.size = RenderQueue::model_push_size + sizeof(glm::mat4);
+    VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
+    pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+    pipelineLayoutInfo.pushConstantRangeCount = 1;
+    pipelineLayoutInfo.pPushConstantRanges = &pushRange;
+    if (vkCreatePipelineLayout(device_, &pipelineLayoutInfo, nullptr, &pipeline_layout_) != VK_SUCCESS)
+        throw std::runtime_error("Failed to create shadow pipeline layout");
+
+    VkFormat depthFormat = format;
+    VkPipelineRenderingCreateInfo renderingInfo{};
+    renderingInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_RENDERING_CREATE_INFO;
+    renderingInfo.depthAttachmentFormat = depthFormat;
+    VkGraphicsPipelineCreateInfo pipelineInfo{};
+    pipelineInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+    pipelineInfo.pNext = &renderingInfo;
+    pipelineInfo.stageCount = 1;
+    pipelineInfo.pStages = &stage;
+    pipelineInfo.pVertexInputState = &vertexInputInfo;
+    pipelineInfo.pInputAssemblyState = &inputAssembly;
+    pipelineInfo.pViewportState = &viewportState;
+    pipelineInfo.pRasterizationState = &rasterizer;
+    pipelineInfo.pMultisampleState = &multisampling;
+    pipelineInfo.pColorBlendState = &colorBlending;
+    pipelineInfo.pDepthStencilState = &depthStencil;
+    pipelineInfo.pDynamicState = &dynamicState;
+    pipelineInfo.layout = pipeline_layout_;
+    VkResult result = vkCreateGraphicsPipelines(device_, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &pipeline_);
+    vkDestroyShaderModule(device_, vertModule, nullptr);
+    if (result != VK_SUCCESS) throw std::runtime_error("Failed to create shadow pipeline");
+}
+
+void ShadowCascades::destroy() {
+    if (device_ == VK_NULL_HANDLE) return;
+    if (pipeline_ != VK_NULL_HANDLE) vkDestroyPipeline(device_, pipeline_, nullptr);
+    if (pipeline_layout_ != VK_NULL_HANDLE) vkDestroyPipelineLayout(device_, pipeline_layout_, nullptr);
+    if (params_memory_ != VK_NULL_HANDLE) {
+        vkUnmapMemory(device_, params_memory_);
+        GpuMemory::shared().free(device_, params_memory_);
+    }
+    if (params_buffer_ != VK_NULL_HANDLE) vkDestroyBuffer(device_, params_buffer_, nullptr);
+    // Sets go with the pool.
+    if (descriptor_pool_ != VK_NULL_HANDLE) vkDestroyDescriptorPool(device_, descriptor_pool_, nullptr);
+    if (set_layout_ != VK_NULL_HANDLE) vkDestroyDescriptorSetLayout(device_, set_layout_, nullptr);
+    if (sampler_ != VK_NULL_HANDLE) vkDestroySampler(device_, sampler_, nullptr);
+    for (VkImageView view : layer_views_)
+        if (view != VK_NULL_HANDLE) vkDestroyImageView(device_, view, nullptr);
+    if (array_view_ != VK_NULL_HANDLE) vkDestroyImageView(device_, array_view_, nullptr);
+    if (image_ != VK_NULL_HANDLE) vkDestroyImage(device_, image_, nullptr);
+    GpuMemory::shared().free(device_, image_memory_);
+    *this = ShadowCascades{};
+}
+
+void ShadowCascades::fit(Cascade& cascade, const glm::mat4& lightRotation, const glm::vec3& center, float radius) const {
+    // Moving the origin in whole texels keeps every texel's footprint on the
+    // ground fixed, so edges don't shimmer.
+    const float texel = 2.0f * radius / static_cast<float>(resolution_);
+    glm::vec3 lightCenter = glm::vec3(lightRotation * glm::vec4(center, 1.0f));
+    lightCenter.x = std::floor(lightCenter.x / texel) * texel;
+    lightCenter.y = std::floor(lightCenter.y / texel) * texel;
+    // Light space looks down -z; casters up to caster_distance in front of
+    // the sphere still land in the map.
+    const float depth = -lightCenter.z;
+    glm::mat4 projection = glm::orthoRH_ZO(lightCenter.x - radius, lightCenter.x + radius,
+                                           lightCenter.y - radius, lightCenter.y + radius,
+                                           depth - radius - caster_distance_, depth + radius);
+    cascade.view_proj = projection * lightRotation;
+    cascade.center = glm::vec3(glm::inverse(lightRotation) * glm::vec4(lightCenter, 1.0f));
+    cascade.radius = radius;
+}
+
+void ShadowCascades::update(const Camera& camera, Scene* scene, uint32_t frameSlot, std::pmr::memory_resource* temp) {
+    stats_ = {};
+    const float nearZ = camera.near_plane();
+    const float farZ = std::max(std::min(camera.far_plane(), max_distance_), nearZ * 2.0f);
+    const glm::mat4 view = camera.get_view_matrix();
+    const glm::mat4 projection = camera.get_projection_matrix();
+    const glm::mat4 inverseViewProj = glm::inverse(projection * view);
+    const glm::vec3 direction = glm::normalize(light_.direction);
+    const glm::vec3 up = std::abs(direction.y) > 0.99f ? glm::vec3(0.0f, 0.0f, 1.0f) : glm::vec3(0.0f, 1.0f, 0.0f);
+    // Orientation only: fit() places each cascade's origin in this space.
+    const glm::mat4 lightRotation = glm::lookAtRH(glm::vec3(0.0f), direction, up);
+    auto ndcDepth = [&](float depth) {
+        glm::vec4 clip = projection * glm::vec4(0.0f, 0.0f, -depth, 1.0f);
+        return clip.z / clip.w;
+    };
+
+    float sliceNear = nearZ;
+    for (uint32_t i = 0; i < cascade_count; ++i) {
+        Cascade& cascade = cascades_[i];
+        const float t = static_cast<float>(i + 1) / cascade_count;
+        const float logSplit = nearZ * std::pow(farZ / nearZ, t);
+        const float uniformSplit = nearZ + (farZ - nearZ) * t;
+        const float sliceFar = uniformSplit + (logSplit - uniformSplit) * split_lambda_;
+
+        // Bounding sphere of the slice. Its radius only depends on the
+        // projection, so rounding it up keeps it fixed as the camera turns.
+        std::array<glm::vec3, 8> corners;
+        glm::vec3 center(0.0f);
+        for (uint32_t c = 0; c < 8; ++c) {
+            glm::vec4 p = inverseViewProj * glm::vec4(c & 1 ? 1.0f : -1.0f, c & 2 ? 1.0f : -1.0f,
+                                                      ndcDepth(c & 4 ? sliceFar : sliceNear), 1.0f);
+            corners[c] = glm::vec3(p) / p.w;
+            center += corners[c] / 8.0f;
+        }
+        float radius = 0.0f;
+        for (const glm::vec3& corner : corners) radius = std::max(radius, glm::length(corner - center));
+        radius = std::ceil(radius * 16.0f) / 16.0f;
+
+        const bool cached = i >= first_cached_cascade;
+        const bool casterChange = !cascade.valid || cascade.static_generation != static_generation_ ||
+                                  cascade.light_direction != direction;
+        const bool outside = glm::length(center - cascade.center) + radius > cascade.radius;
+        const glm::mat4 previous = cascade.view_proj;
+        cascade.render = !cached || casterChange || outside;
+        if (!cached || casterChange || outside) fit(cascade, lightRotation, center, cached ? radius * cache_margin_ : radius);
+        cascade.end_depth = sliceFar;
+        if (casterChange || cascade.view_proj != previous) {
+            cascade.casters.clear();
+            if (scene) {
+                CullContext cull{};
+                cull.view_proj = cascade.view_proj;
+                cull.reuse_lod = true;
+                scene->collect(cascade.casters, cull);
+            }
+            cascade.casters.sort(temp);
+            ++stats_.collected_cascades;
+        }
+        cascade.light_direction = direction;
+        cascade.static_generation = static_generation_;
+        cascade.valid = true;
+        sliceNear = sliceFar;
+    }
+
+    GpuShadowParams params{};
+    const glm::mat4 inverseView = glm::inverse(view);
+    for (uint32_t i = 0; i < cascade_count; ++i) {
+        params.view_to_shadow[i] = cascades_[i].view_proj * inverseView;
+        params.cascade_end[i] = cascades_[i].end_depth;
+        params.texel_world[i] = 2.0f * cascades_[i].radius / static_cast<float>(resolution_);
+    }
+    const glm::vec3 toLight = glm::normalize(glm::mat3(view) * -direction);
+    params.light_direction[0] = toLight.x;
+    params.light_direction[1] = toLight.y;
+    params.light_direction[2] = toLight.z;
+    params.light_direction[3] = light_.intensity;
+    params.light_color[0] = light_.color.r;
+    params.light_color[1] = light_.color.g;
+    params.light_color[2] = light_.color.b;
+    params.light_color[3] = 1.0f / static_cast<float>(resolution_);
+    std::memcpy(params_ + (frameSlot % frame_slots_) * params_stride_, &params, sizeof(params));
+}
+
+RenderGraph::Resource ShadowCascades::add_passes(RenderGraph& graph, const MeshPool& meshes) {
+    // Sampling is the last thing each frame does with the map; cascades that
+    // are not rendered keep their contents through the layout changes.
+    ImageAccess before = image_initialized_ ? ImageAccess::fragment_sampled() : ImageAccess{};
+    RenderGraph::Resource map = graph.import_image("shadow_map", image_, array_view_, VK_IMAGE_ASPECT_DEPTH_BIT, before);
+    for (uint32_t i = 0; i < cascade_count; ++i) {
+        Cascade& cascade = cascades_[i];
+        // The first frame defines every layer.
+        if (!cascade.render && image_initialized_) continue;
+        RenderGraph::Pass pass = graph.add_pass(pass_names[i], [this, i, &meshes](VkCommandBuffer cmd) {
+            VkRenderingAttachmentInfo depthAttachment{};
+            depthAttachment.sType = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO;
+            depthAttachment.imageView = layer_views_[i];
+            depthAttachment.imageLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+            depthAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+            depthAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+            depthAttachment.clearValue.depthStencil = { 1.0f, 0 };
+            VkRect2D area{};
+            area.extent = { resolution_, resolution_ };
+            VkRenderingInfo renderingInfo{};
+            renderingInfo.sType = VK_STRUCTURE_TYPE_RENDERING_INFO;
+            renderingInfo.renderArea = area;
+            renderingInfo.layerCount = 1;
+            renderingInfo.pDepthAttachment = &depthAttachment;
+            VkViewport viewport{};
+            viewport.width = static_cast<float>(resolution_);
+            viewport.height = static_cast<float>(resolution_);
+            viewport.maxDepth = 1.0f;
+            vkCmdBeginRendering(cmd, &renderingInfo);
+            vkCmdSetViewport(cmd, 0, 1, &viewport);
+            vkCmdSetScissor(cmd, 0, 1, &area);
+            vkCmdPushConstants(cmd, pipeline_layout_, VK_SHADER_STAGE_VERTEX_BIT, RenderQueue::model_push_size, sizeof(glm::mat4),
+                               &cascades_[i].view_proj);
+            cascades_[i].casters.record_depth(cmd, pipeline_, pipeline_layout_, meshes, draw_stats_);
+            vkCmdEndRendering(cmd);
+        });
+        graph.write(pass, map, ImageAccess::depth_attachment());
+        ++stats_.rendered_cascades;
+        stats_.draws += static_cast<uint32_t>(cascade.casters.size());
+    }
+    image_initialized_ = true;
+    return map;
+}
@@ -0,0 +1,131 @@
+#pragma once
+#include <vulkan/vulkan.h>
+#include <array>
+#include <cstdint>
+#include <memory_resource>
+#include <vector>
+#include "Camera.h"
+#include "RenderGraph.h"
+#include "RenderQueue.h"
+
+class Scene;
+
+// Sun-like light infinitely far away. direction points from the light into
+// the scene. Zero intensity leaves the scene lit by the ambient and point
+// lights only.
+struct DirectionalLight {
+    glm::vec3 direction{-0.4f, -1.0f, -0.3f};
+    glm::vec3 color{1.0f};
+    float intensity = 0.0f;
+};
+
+struct ShadowStats {
+    // Cascades re-rendered by the last update(), and their draws.
+    uint32_t rendered_cascades = 0;
+    uint32_t draws = 0;
+    // Cascades whose casters were re-collected.
+    uint32_t collected_cascades = 0;
+};
+
+// Cascaded shadow maps for one DirectionalLight.
+//
+// The camera frustum up to max_distance is split between the cascades (a
+// blend of logarithmic and uniform splits). Each cascade covers the bounding
+// sphere of its slice, whose size does not change as the camera turns, with a
+// light-space projection of fixed orientation whose origin is snapped to
+// whole shadow texels, so shadow edges do not swim as the camera moves.
+//
+// Cascades below first_cached_cascade are rendered every frame. The far ones
+// are fitted with extra margin and keep their image until the camera's slice
+// leaves that margin, the light turns, or invalidate_static() reports a
+// change in the casters, so a still or slowly moving camera renders only the
+// near cascades. Each cascade collects its casters from the scene with its
+// own light-space frustum, reaching caster_distance towards the light, and
+// only again when its projection or the casters change.
+//
+// All cascades are layers of one depth array image, sampled with hardware
+// depth comparison from set 2 of the main pipeline: binding 0 the cascade
+// parameters (uniform, one range per frame slot), 1 the shadow map.
+class ShadowCascades {
+public:
+    static constexpr uint32_t cascade_count = 4;
+    static constexpr uint32_t first_cached_cascade = 2;
+    static constexpr VkFormat format = VK_FORMAT_D16_UNORM;
+
+    void init(VkDevice device, VkPhysicalDevice physicalDevice, uint32_t frameSlots, uint32_t resolution = 2048);
+    void destroy();
+
+    VkDescriptorSetLayout set_layout() const { return set_layout_; }
+    VkDescriptorSet descriptor_set(uint32_t frameSlot) const { return sets_[frameSlot % frame_slots_]; }
+
+    void set_light(const DirectionalLight& light) { light_ = light; }
+    const DirectionalLight& light() const { return light_; }
+    // View depth the cascades reach; nothing casts shadows beyond it.
+    void set_max_distance(float distance) { max_distance_ = distance; }
+    // How far behind a cascade (towards the light) casters are collected.
+    void set_caster_distance(float distance) { caster_distance_ = distance; }
+    // Casters came, went or moved: every cascade re-collects and the cached
+    // ones are rendered again.
+    void invalidate_static() { ++static_generation_; }
+
+    // Fits the cascades to camera, re-collects casters from scene where
+    // needed and writes the sampling parameters of frameSlot, whose previous
+    // frame must have retired. scene may be null.
+    void update(const Camera& camera, Scene* scene, uint32_t frameSlot, std::pmr::memory_resource* temp);
+    // Declares a depth pass for every cascade update() marked for rendering
+    // and returns the shadow map for the passes that sample it to read.
+    RenderGraph::Resource add_passes(RenderGraph& graph, const MeshPool& meshes);
+    const ShadowStats& stats() const { return stats_; }
+
+private:
+    struct Cascade {
+        glm::mat4 view_proj{1.0f};
+        // Snapped world-space center and radius of the covered sphere.
+        glm::vec3 center{0.0f};
+        float radius = 0.0f;
+        // View depth where the cascade hands over to the next one.
+        float end_depth = 0.0f;
+        glm::vec3 light_direction{0.0f};
+        uint64_t static_generation = 0;
+        bool valid = false;
+        bool render = false;
+        RenderQueue casters;
+    };
+
+    void create_pipeline();
+    void fit(Cascade& cascade, const glm::mat4& lightRotation, const glm::vec3& center, float radius) const;
+
+    VkDevice device_ = VK_NULL_HANDLE;
+    uint32_t frame_slots_ = 0;
+    uint32_t resolution_ = 0;
+    VkImage image_ = VK_NULL_HANDLE;
+    VkDeviceMemory image_memory_ = VK_NULL_HANDLE;
+    // All layers for sampling, and one per cascade for rendering.
+    VkImageView array_view_ = VK_NULL_HANDLE;
+    std::array<VkImageView, cascade_count> layer_views_{};
+    VkSampler sampler_ = VK_NULL_HANDLE;
+    VkDescriptorSetLayout set_layout_ = VK_NULL_HANDLE;
+    VkDescriptorPool descriptor_pool_ = VK_NULL_HANDLE;
+    std::vector<VkDescriptorSet> sets_;
+    VkBuffer params_buffer_ = VK_NULL_HANDLE;
+    VkDeviceMemory params_memory_ = VK_NULL_HANDLE;
+    std::byte* params_ = nullptr;
+    VkDeviceSize params_stride_ = 0;
+    VkPipelineLayout pipeline_layout_ = VK_NULL_HANDLE;
+    VkPipeline pipeline_ = VK_NULL_HANDLE;
+    // The image holds rendered cascades once a frame has written it.
+    bool image_initialized_ = false;
+
+    DirectionalLight light_;
+    float max_distance_ = 80.0f;
+    float caster_distance_ = 50.0f;
+    // Blend from uniform (0) to logarithmic (1) split distances.
+    float split_lambda_ = 0.75f;
+    // Radius factor of the cached cascades; the camera's slice can move this
+    // much before they are refitted and rendered again.
+    float cache_margin_ = 1.3f;
+    uint64_t static_generation_ = 1;
+    std::array<Cascade, cascade_count> cascades_;
+    RenderStats draw_stats_;
+    ShadowStats stats_;
+};
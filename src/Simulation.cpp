@@ -0,0 +1,102 @@
+#include "Simulation.h"
+#include <algorithm>
+#include <utility>
+
+Simulation::Simulation(std::chrono::microseconds step, StepFn fn) : step_(step), fn_(std::move(fn)) {}
+
+Simulation::~Simulation() {
+    stop();
+}
+
+void Simulation::start(const SimulationState& initial) {
+    stop();
+    stop_ = false;
+    working_ = initial;
+    working_.tick = 0;
+    working_.wall_time = Clock::now();
+    working_.input_time = working_.wall_time;
+    {
+        std::lock_guard<std::mutex> lock(publish_mutex_);
+        previous_ = working_;
+        latest_ = working_;
+    }
+    ticks_ = 0;
+    skipped_ticks_ = 0;
+    thread_ = std::thread([this] { run(); });
+}
+
+void Simulation::stop() {
+    {
+        std::lock_guard<std::mutex> lock(stop_mutex_);
+        stop_ = true;
+    }
+    stop_wake_.notify_all();
+    if (thread_.joinable()) thread_.join();
+}
+
+void Simulation::run() {
+    const float dt = std::chrono::duration<float>(step_).count();
+    Clock::time_point next = working_.wall_time + step_;
+    for (;;) {
+        {
+            std::unique_lock<std::mutex> lock(stop_mutex_);
+            if (stop_wake_.wait_until(lock, next, [this] { return stop_; })) return;
+        }
+        Clock::time_point now = Clock::now();
+        for (uint32_t steps = 0; next <= now && steps < max_catch_up; ++steps) {
+            // Input is sampled when the tick starts running.
+            working_.input_time = Clock::now();
+            working_.wall_time = next;
+            ++working_.tick;
+            working_.time += dt;
+            fn_(working_, dt);
+            step_ms_.store(std::chrono::duration<float, std::milli>(Clock::now() - working_.input_time).count(),
+                           std::memory_order_relaxed);
+            {
+                std::lock_guard<std::mutex> lock(publish_mutex_);
+                std::swap(previous_, latest_);
+                latest_ = working_;
+            }
+            ticks_.fetch_add(1, std::memory_order_relaxed);
+            next += step_;
+        }
+        if (next <= now) {
+            // Too far behind to catch up; resume from now instead.
+            uint64_t behind = static_cast<uint64_t>((now - next) / step_) + 1;
+            skipped_ticks_.fetch_add(behind, std::memory_order_relaxed);
+            next += step_ * behind;
+        }
+    }
+}
+
+void Simulation::interpolate(Clock::time_point now, SimulationState& out) const {
+    std::lock_guard<std::mutex> lock(publish_mutex_);
+    const SimulationState& a = previous_;
+    const SimulationState& b = latest_;
+    // Show the state one step in the past, which lies between the two
+    // published ticks until the next one is due.
+    float alpha = 1.0f;
+    if (b.wall_time > a.wall_time) {
+        alpha = std::chrono::duration<float>(now - step_ - a.wall_time).count() /
+                std::chrono::duration<float>(b.wall_time - a.wall_time).count();
+        alpha = std::clamp(alpha, 0.0f, 1.0f);
+    }
+    out.tick = b.tick;
+    out.time = a.time + (b.time - a.time) * alpha;
+    out.wall_time = b.wall_time;
+    out.input_time = b.input_time;
+    out.camera_position = glm::mix(a.camera_position, b.camera_position, alpha);
+    out.camera_target = glm::mix(a.camera_target, b.camera_target, alpha);
+    out.lights = b.lights;
+    const size_t blended = std::min(a.lights.size(), b.lights.size());
+    for (size_t i = 0; i < blended; ++i)
+        out.lights[i].position = glm::mix(a.lights[i].position, b.lights[i].position, alpha);
+}
+
+SimulationStats Simulation::stats() const {
+    SimulationStats stats;
+    stats.ticks = ticks_.load(std::memory_order_relaxed);
+    stats.skipped_ticks = skipped_ticks_.load(std::memory_order_relaxed);
+    stats.step_ms = step_ms_.load(std::memory_order_relaxed);
+    return stats;
+}
@@ -0,0 +1,93 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "Camera.h"
+#include "LightGrid.h"
+
+// Everything the simulation hands to the renderer for one tick.
+struct SimulationState {
+    uint64_t tick = 0;
+    // Simulated seconds since start().
+    double time = 0.0;
+    // Wall-clock time the tick is scheduled for; interpolation works on these.
+    std::chrono::steady_clock::time_point wall_time{};
+    // When the tick sampled input. Renderers pass it on to the frame that
+    // shows the state, which closes the input-to-photon measurement.
+    std::chrono::steady_clock::time_point input_time{};
+    glm::vec3 camera_position{0.0f};
+    glm::vec3 camera_target{0.0f, 0.0f, -1.0f};
+    std::vector<PointLight> lights;
+};
+
+struct SimulationStats {
+    uint64_t ticks = 0;
+    // Ticks dropped because stepping fell behind by more than max_catch_up.
+    uint64_t skipped_ticks = 0;
+    // CPU time of the last step.
+    float step_ms = 0.0f;
+};
+
+// Fixed-timestep simulation on its own thread.
+//
+// Every step, the step function advances a state owned by the simulation
+// thread, which is then published: the published previous and latest states
+// are never modified while visible, and copying out of them happens under a
+// short lock. The render thread calls interpolate() once per frame for a
+// state one step behind the newest tick, blended between the two published
+// ones, so rendering is smooth at any frame rate and neither thread waits on
+// the other's work. Once the vectors have grown to their size, neither side
+// allocates.
+//
+// The step function runs on the simulation thread only and must not touch
+// renderer or scene objects.
+class Simulation {
+public:
+    using Clock = std::chrono::steady_clock;
+    using StepFn = std::function<void(SimulationState& state, float dt)>;
+    // Steps run back to back at most this many times to catch up after a
+    // stall; older ticks are skipped.
+    static constexpr uint32_t max_catch_up = 5;
+
+    Simulation(std::chrono::microseconds step, StepFn fn);
+    ~Simulation();
+    Simulation(const Simulation&) = delete;
+    Simulation& operator=(const Simulation&) = delete;
+
+    // Publishes initial as tick 0 and starts stepping from it.
+    void start(const SimulationState& initial);
+    // Joins the simulation thread. Safe to call twice.
+    void stop();
+
+    // Writes the state to show at now into out, reusing its capacity.
+    // Positions are blended; everything else comes from the newer state.
+    void interpolate(Clock::time_point now, SimulationState& out) const;
+    SimulationStats stats() const;
+    std::chrono::microseconds step() const { return step_; }
+
+private:
+    void run();
+
+    std::chrono::microseconds step_;
+    StepFn fn_;
+    std::thread thread_;
+    std::mutex stop_mutex_;
+    std::condition_variable stop_wake_;
+    bool stop_ = false;
+
+    // Owned by the simulation thread.
+    SimulationState working_;
+    // Guarded by publish_mutex_.
+    mutable std::mutex publish_mutex_;
+    SimulationState previous_;
+    SimulationState latest_;
+
+    std::atomic<uint64_t> ticks_{0};
+    std::atomic<uint64_t> skipped_ticks_{0};
+    std::atomic<float> step_ms_{0.0f};
+};
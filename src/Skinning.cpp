@@ -0,0 +1,100 @@
+#include "Skinning.h"
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64) || defined(_M_AMD64)
+#include <emmintrin.h>
+#define SKINNING_USE_SSE 1
+#endif
+
+namespace {
+glm::mat4 pose_matrix(const JointPose& pose) {
+    glm::mat3 r = glm::mat3_cast(pose.rotation);
+    glm::mat4 m(1.0f);
+    m[0] = glm::vec4(r[0] * pose.scale.x, 0.0f);
+    m[1] = glm::vec4(r[1] * pose.scale.y, 0.0f);
+    m[2] = glm::vec4(r[2] * pose.scale.z, 0.0f);
+    m[3] = glm::vec4(pose.translation, 1.0f);
+    return m;
+}
+
+// out = a * b for column-major matrices; out must not alias a or b.
+inline void multiply(const glm::mat4& a, const glm::mat4& b, glm::mat4& out) {
+#if SKINNING_USE_SSE
+    const float* pa = &a[0][0];
+    const float* pb = &b[0][0];
+    float* po = &out[0][0];
+    __m128 a0 = _mm_loadu_ps(pa), a1 = _mm_loadu_ps(pa + 4), a2 = _mm_loadu_ps(pa + 8), a3 = _mm_loadu_ps(pa + 12);
+    for (int c = 0; c < 4; ++c) {
+        __m128 r = _mm_mul_ps(a0, _mm_set1_ps(pb[c * 4 + 0]));
+        r = _mm_add_ps(r, _mm_mul_ps(a1, _mm_set1_ps(pb[c * 4 + 1])));
+        r = _mm_add_ps(r, _mm_mul_ps(a2, _mm_set1_ps(pb[c * 4 + 2])));
+        r = _mm_add_ps(r, _mm_mul_ps(a3, _mm_set1_ps(pb[c * 4 + 3])));
+        _mm_storeu_ps(po + c * 4, r);
+    }
+#else
+    out = a * b;
+#endif
+}
+}
+
+void compute_skin_palette(const Skeleton& skeleton, const JointPose* pose, glm::mat4* globals, glm::mat4* palette) {
+    const uint32_t count = skeleton.joint_count();
+    for (uint32_t j = 0; j < count; ++j) {
+        glm::mat4 local = pose_matrix(pose[j]);
+        int32_t parent = skeleton.parents[j];
+        multiply(parent >= 0 ? globals[parent] : skeleton.root_bases[j], local, globals[j]);
+        multiply(globals[j], skeleton.inverse_bind[j], palette[j]);
+    }
+}
+
+void skin_vertices(const Vertex* src, const SkinWeights* weights, size_t count, const glm::mat4* palette, Vertex* dst) {
+    for (size_t v = 0; v < count; ++v) {
+        const SkinWeights& w = weights[v];
+        const Vertex& in = src[v];
+        float position[4];
+#if SKINNING_USE_SSE
+        // Blend the four columns, then transform the position with the sum.
+        __m128 c0 = _mm_setzero_ps(), c1 = _mm_setzero_ps(), c2 = _mm_setzero_ps(), c3 = _mm_setzero_ps();
+        for (int i = 0; i < 4; ++i) {
+            if (w.weights[i] == 0.0f) continue;
+            const float* m = &palette[w.joints[i]][0][0];
+            __m128 s = _mm_set1_ps(w.weights[i]);
+            c0 = _mm_add_ps(c0, _mm_mul_ps(_mm_loadu_ps(m), s));
+            c1 = _mm_add_ps(c1, _mm_mul_ps(_mm_loadu_ps(m + 4), s));
+            c2 = _mm_add_ps(c2, _mm_mul_ps(_mm_loadu_ps(m + 8), s));
+            c3 = _mm_add_ps(c3, _mm_mul_ps(_mm_loadu_ps(m + 12), s));
+        }
+        __m128 p = _mm_add_ps(_mm_add_ps(_mm_mul_ps(c0, _mm_set1_ps(in.pos[0])), _mm_mul_ps(c1, _mm_set1_ps(in.pos[1]))),
+                              _mm_add_ps(_mm_mul_ps(c2, _mm_set1_ps(in.pos[2])), c3));
+        _mm_storeu_ps(position, p);
+#else
+        glm::mat4 m(0.0f);
+        for (int i = 0; i < 4; ++i) {
+            if (w.weights[i] != 0.0f) m += palette[w.joints[i]] * w.weights[i];
+        }
+        glm::vec4 p = m * glm::vec4(in.pos[0], in.pos[1], in.pos[2], 1.0f);
+        position[0] = p.x;
+        position[1] = p.y;
+        position[2] = p.z;
+#endif
+        Vertex& out = dst[v];
+        if (&out != &in) out = in;
+        memcpy(out.pos, position, sizeof(out.pos));
+    }
+}
+
+void deform_skinned_mesh(const Vertex* base, const SkinWeights* weights, size_t count, const MorphTargetSet& morphs,
+                         const float* morphWeights, MorphedVertices& morphed, const glm::mat4* palette, Vertex* dst) {
+    if (morphs.empty() || !morphWeights) {
+        skin_vertices(base, weights, count, palette, dst);
+        return;
+    }
+    const float* previousWeights = morphed.weights.data();
+    if (morphed.vertices.size() != count) {
+        morphed.vertices.assign(base, base + count);
+        previousWeights = nullptr;
+    }
+    apply_morph_targets(base, morphs, morphWeights, previousWeights, morphed.vertices.data());
+    morphed.weights.assign(morphWeights, morphWeights + morphs.target_count());
+    skin_vertices(morphed.vertices.data(), weights, count, palette, dst);
+}
@@ -0,0 +1,32 @@
+#pragma once
+#include <cstddef>
+#include <vector>
+#include <glm/glm.hpp>
+#include "Animation.h"
+#include "Morph.h"
+#include "Vertex.h"
+
+// Joint matrices for a pose: each joint's model-space transform (parents
+// first) times its inverse bind matrix. globals is scratch of joint_count
+// matrices. Matrix products use SSE where available.
+void compute_skin_palette(const Skeleton& skeleton, const JointPose* pose, glm::mat4* globals, glm::mat4* palette);
+
+// Linear blend skinning of count vertices: positions are transformed by the
+// weighted sum of up to four palette matrices, the other attributes are
+// copied. src and dst may alias. Uses SSE where available.
+void skin_vertices(const Vertex* src, const SkinWeights* weights, size_t count, const glm::mat4* palette, Vertex* dst);
+
+// Bind-pose vertices of one skinned instance with its morph targets blended
+// in, kept between calls so only vertices of changed targets are rewritten.
+struct MorphedVertices {
+    std::vector<Vertex> vertices;
+    // Weights vertices was blended with.
+    std::vector<float> weights;
+};
+
+// Deforms one instance in glTF order: morph targets are blended onto base in
+// the bind pose (apply_morph_targets), then the result is skinned with
+// palette into dst. Without morph weights or targets, base is skinned
+// directly and morphed is left alone.
+void deform_skinned_mesh(const Vertex* base, const SkinWeights* weights, size_t count, const MorphTargetSet& morphs,
+                         const float* morphWeights, MorphedVertices& morphed, const glm::mat4* palette, Vertex* dst);
@@ -0,0 +1,344 @@
+#include "SpriteBatch.h"
+#include "GpuMemory.h"
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstddef>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+
+namespace {
+std::vector<char> read_file(const std::string& filename) {
+    std::ifstream file(filename, std::ios::ate | std::ios::binary);
+    if (!file.is_open()) throw std::runtime_error("failed to open file: " + filename);
+    std::vector<char> buffer(static_cast<size_t>(file.tellg()));
+    file.seekg(0);
+    file.read(buffer.data(), static_cast<std::streamsize>(buffer.size()));
+    return buffer;
+}
+
+VkShaderModule create_shader_module(VkDevice device, const std::string& filename) {
+    std::vector<char> code = read_file(filename);
+    VkShaderModuleCreateInfo createInfo{};
+    createInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+    createInfo.codeSize = code.size();
+    createInfo.pCode = reinterpret_cast<const uint32_t*>(code.data());
+    VkShaderModule module;
+    if (vkCreateShaderModule(device, &createInfo, nullptr, &module) != VK_SUCCESS)
+        throw std::runtime_error("Failed to create shader module: " + filename);
+    return module;
+}
+
+uint32_t find_memory_type(VkPhysicalDevice physicalDevice, uint32_t typeBits, VkMemoryPropertyFlags properties) {
+    VkPhysicalDeviceMemoryProperties memProperties;
+    vkGetPhysicalDeviceMemoryProperties(physicalDevice, &memProperties);
+    for (uint32_t i = 0; i < memProperties.memoryTypeCount; i++) {
+        if ((typeBits & (1 << i)) && (memProperties.memoryTypes[i].propertyFlags & properties) == properties) return i;
+    }
+    throw std::runtime_error("No suitable memory type for sprite ring");
+}
+
+// Pixel to NDC transform, passed as a push constant.
+struct SpritePushConstants {
+    float scale[2];
+    float offset[2];
+};
+}
+
+SpriteAtlas::SpriteAtlas(SpriteTexture texture, uint32_t width, uint32_t height)
+    : texture_(texture), width_(width), height_(height) {}
+
+uint32_t SpriteAtlas::add_region(uint32_t x, uint32_t y, uint32_t width, uint32_t height) {
+    SpriteRegion region;
+    region.texture = texture_;
+    region.u0 = static_cast<float>(x) / width_;
+    region.v0 = static_cast<float>(y) / height_;
+    region.u1 = static_cast<float>(x + width) / width_;
+    region.v1 = static_cast<float>(y + height) / height_;
+    regions_.push_back(region);
+    rects_.push_back({x, y, width, height});
+    return static_cast<uint32_t>(regions_.size() - 1);
+}
+
+uint32_t SpriteAtlas::pack(uint32_t width, uint32_t height) {
+    const uint32_t paddedWidth = width + 1, paddedHeight = height + 1;
+    if (paddedWidth > width_) return UINT32_MAX;
+    // Best-fitting shelf that has room: the least wasted height.
+    Shelf* best = nullptr;
+    for (Shelf& shelf : shelves_) {
+        if (shelf.height < paddedHeight || shelf.used + paddedWidth > width_) continue;
+        if (!best || shelf.height < best->height) best = &shelf;
+    }
+    if (!best) {
+        if (shelf_end_ + paddedHeight > height_) return UINT32_MAX;
+        shelves_.push_back({shelf_end_, paddedHeight, 0});
+        shelf_end_ += paddedHeight;
+        best = &shelves_.back();
+    }
+    uint32_t x = best->used;
+    best->used += paddedWidth;
+    return add_region(x, best->y, width, height);
+}
+
+void SpriteBatch::init(VkDevice device, VkPhysicalDevice physicalDevice, VkFormat colorFormat, VkFormat depthFormat,
+                       uint32_t frameSlots, uint32_t capacity) {
+    device_ = device;
+    frame_slots_ = frameSlots;
+    capacity_ = capacity;
+
+    VkDescriptorSetLayoutBinding samplerBinding{};
+    samplerBinding.binding = 0;
+    samplerBinding.descriptorCount = 1;
+    samplerBinding.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    samplerBinding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+    VkDescriptorSetLayoutCreateInfo layoutInfo{};
+    layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+    layoutInfo.bindingCount = 1;
+    layoutInfo.pBindings = &samplerBinding;
+    if (vkCreateDescriptorSetLayout(device_, &layoutInfo, nullptr, &set_layout_) != VK_SUCCESS)
+        throw std::runtime_error("Failed to create sprite descriptor set layout");
+
+    VkDescriptorPoolSize poolSize{};
+    poolSize.type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    poolSize.descriptorCount = max_textures;
+    VkDescriptorPoolCreateInfo poolInfo{};
+    poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+    poolInfo.poolSizeCount = 1;
+    poolInfo.pPoolSizes = &poolSize;
+    poolInfo.maxSets = max_textures;
+    if (vkCreateDescriptorPool(device_, &poolInfo, nullptr, &descriptor_pool_) != VK_SUCCESS)
+        throw std::runtime_error("Failed to create sprite descriptor pool");
+
+    create_pipeline(colorFormat, depthFormat);
+
+    // One ring range per frame slot, mapped for the lifetime of the batch.
+    VkBufferCreateInfo bufferInfo{};
+    bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+    bufferInfo.size = sizeof(Instance) * capacity_ * frame_slots_;
+    bufferInfo.usage = VK_BUFFER_USAGE_VERTEX_BUFFER_BIT;
+    bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    if (vkCreateBuffer(device_, &bufferInfo, nullptr, &ring_buffer_) != VK_SUCCESS)
+        throw std::runtime_error("Failed to create sprite ring buffer");
+    VkMemoryRequirements memRequirements;
+    vkGetBufferMemoryRequirements(device_, ring_buffer_, &memRequirements);
+    VkMemoryAllocateInfo allocInfo{};
+    allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+    allocInfo.allocationSize = memRequirements.size;
+    allocInfo.memoryTypeIndex = find_memory_type(physicalDevice, memRequirements.memoryTypeBits,
+                                                 VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+    if (GpuMemory::shared().allocate(device_, allocInfo, GpuMemoryCategory::uniform, &ring_memory_) != VK_SUCCESS)
+        throw std::runtime_error("Failed to allocate sprite ring memory");
+    vkBindBufferMemory(device_, ring_buffer_, ring_memory_, 0);
+    void* mapped = nullptr;
+    if (vkMapMemory(device_, ring_memory_, 0, VK_WHOLE_SIZE, 0, &mapped) != VK_SUCCESS)
+        throw std::runtime_error("Failed to map sprite ring memory");
+    ring_ = static_cast<Instance*>(mapped);
+}
+
+void SpriteBatch::create_pipeline(VkFormat colorFormat, VkFormat depthFormat) {
+    VkShaderModule vertModule = create_shader_module(device_, "assets/sprite.vert.spv");
+    VkShaderModule fragModule = create_shader_module(device_, "assets/sprite.frag.spv");
+    std::array<VkPipelineShaderStageCreateInfo, 2> stages{};
+    stages[0].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    stages[0].stage = VK_SHADER_STAGE_VERTEX_BIT;
+    stages[0].module = vertModule;
+    stages[0].pName = "main";
+    stages[1].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    stages[1].stage = VK_SHADER_STAGE_FRAGMENT_BIT;
+    stages[1].module = fragModule;
+    stages[1].pName = "main";
+
+    // Per-instance stream only; the four corners come from gl_VertexIndex.
+    VkVertexInputBindingDescription bindingDesc{};
+    bindingDesc.binding = 0;
+    bindingDesc.stride = sizeof(Instance);
+    bindingDesc.inputRate = VK_VERTEX_INPUT_RATE_INSTANCE;
+    std::array<VkVertexInputAttributeDescription, 3> attrDescs{};
+    attrDescs[0].binding = 0; attrDescs[0].location = 0; attrDescs[0].format = VK_FORMAT_R32G32B32A32_SFLOAT; attrDescs[0].offset = offsetof(Instance, rect);
+    attrDescs[1].binding = 0; attrDescs[1].location = 1; attrDescs[1].format = VK_FORMAT_R32G32B32A32_SFLOAT; attrDescs[1].offset = offsetof(Instance, uv);
+    attrDescs[2].binding = 0; attrDescs[2].location = 2; attrDescs[2].format = VK_FORMAT_R8G8B8A8_UNORM; attrDescs[2].offset = offsetof(Instance, color);
+    VkPipelineVertexInputStateCreateInfo vertexInputInfo{};
+    vertexInputInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
+    vertexInputInfo.vertexBindingDescriptionCount = 1;
+    vertexInputInfo.pVertexBindingDescriptions = &bindingDesc;
+    vertexInputInfo.vertexAttributeDescriptionCount = static_cast<uint32_t>(attrDescs.size());
+    vertexInputInfo.pVertexAttributeDescriptions = attrDescs.data();
+    VkPipelineInputAssemblyStateCreateInfo inputAssembly{};
+    inputAssembly.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
+    inputAssembly.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_STRIP;
+    VkPipelineViewportStateCreateInfo viewportState{};
+    viewportState.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
+    viewportState.viewportCount = 1;
+    viewportState.scissorCount = 1;
+    std::array<VkDynamicState, 2> dynamicStates = { VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR };
+    VkPipelineDynamicStateCreateInfo dynamicState{};
+    dynamicState.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
+    dynamicState.dynamicStateCount = static_cast<uint32_t>(dynamicStates.size());
+    dynamicState.pDynamicStates = dynamicStates.data();
+    VkPipelineRasterizationStateCreateInfo rasterizer{};
+    rasterizer.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
+    rasterizer.polygonMode = VK_POLYGON_MODE_FILL;
+    rasterizer.lineWidth = 1.0f;
+    rasterizer.cullMode = VK_CULL_MODE_NONE;
+    rasterizer.frontFace = VK_FRONT_FACE_CLOCKWISE;
+    VkPipelineMultisampleStateCreateInfo multisampling{};
+    multisampling.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
+    multisampling.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
+    // Straight alpha over whatever the scene left in the target
+    VkPipelineColorBlendAttachmentState colorBlendAttachment{};
+    colorBlendAttachment.colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
+    colorBlendAttachment.blendEnable = VK_TRUE;
+    colorBlendAttachment.srcColorBlendFactor = VK_BLEND_FACTOR_SRC_ALPHA;
+    colorBlendAttachment.dstColorBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA;
+    colorBlendAttachment.colorBlendOp = VK_BLEND_OP_ADD;
+    colorBlendAttachment.srcAlphaBlendFactor = VK_BLEND_FACTOR_ONE;
+    colorBlendAttachment.dstAlphaBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA;
+    colorBlendAttachment.alphaBlendOp = VK_BLEND_OP_ADD;
+    VkPipelineColorBlendStateCreateInfo colorBlending{};
+    colorBlending.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
+    colorBlending.attachmentCount = 1;
+    colorBlending.pAttachments = &colorBlendAttachment;
+    // Overlays ignore scene depth
+    VkPipelineDepthStencilStateCreateInfo depthStencil{};
+    depthStencil.sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
+    depthStencil.depthTestEnable = VK_FALSE;
+    depthStencil.depthWriteEnable = VK_FALSE;
+
+    VkPushConstantRange pushRange{};
+    pushRange.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+    pushRange.size = sizeof(SpritePushConstants);
+    VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
+    pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+    pipelineLayoutInfo.setLayoutCount = 1;
+    pipelineLayoutInfo.pSetLayouts = &set_layout_;
+    pipelineLayoutInfo.pushConstantRangeCount = 1;
+    pipelineLayoutInfo.pPushConstantRanges = &pushRange;
+    if (vkCreatePipelineLayout(device_, &pipelineLayoutInfo, nullptr, &pipeline_layout_) != VK_SUCCESS)
+        throw std::runtime_error("Failed to create sprite pipeline layout");
+
+    VkPipelineRenderingCreateInfo renderingInfo{};
+    renderingInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_RENDERING_CREATE_INFO;
+    renderingInfo.colorAttachmentCount = 1;
+    renderingInfo.pColorAttachmentFormats = &colorFormat;
+    renderingInfo.depthAttachmentFormat = depthFormat;
+    VkGraphicsPipelineCreateInfo pipelineInfo{};
+    pipelineInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+    pipelineInfo.pNext = &renderingInfo;
+    pipelineInfo.stageCount = static_cast<uint32_t>(stages.size());
+    pipelineInfo.pStages = stages.data();
+    pipelineInfo.pVertexInputState = &vertexInputInfo;
+    pipelineInfo.pInputAssemblyState = &inputAssembly;
+    pipelineInfo.pViewportState = &viewportState;
+    pipelineInfo.pRasterizationState = &rasterizer;
+    pipelineInfo.pMultisampleState = &multisampling;
+    pipelineInfo.pColorBlendState = &colorBlending;
+    pipelineInfo.pDepthStencilState = &depthStencil;
+    pipelineInfo.pDynamicState = &dynamicState;
+    pipelineInfo.layout = pipeline_layout_;
+    VkResult result = vkCreateGraphicsPipelines(device_, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &pipeline_);
+    vkDestroyShaderModule(device_, vertModule, nullptr);
+    vkDestroyShaderModule(device_, fragModule, nullptr);
+    if (result != VK_SUCCESS) throw std::runtime_error("Failed to create sprite pipeline");
+}
+
+void SpriteBatch::destroy() {
+    if (device_ == VK_NULL_HANDLE) return;
+    if (ring_memory_ != VK_NULL_HANDLE) {
+        vkUnmapMemory(device_, ring_memory_);
+        GpuMemory::shared().free(device_, ring_memory_);
+    }
+    if (ring_buffer_ != VK_NULL_HANDLE) vkDestroyBuffer(device_, ring_buffer_, nullptr);
+    if (pipeline_ != VK_NULL_HANDLE) vkDestroyPipeline(device_, pipeline_, nullptr);
+    if (pipeline_layout_ != VK_NULL_HANDLE) vkDestroyPipelineLayout(device_, pipeline_layout_, nullptr);
+    // Sets go with the pool.
+    if (descriptor_pool_ != VK_NULL_HANDLE) vkDestroyDescriptorPool(device_, descriptor_pool_, nullptr);
+    if (set_layout_ != VK_NULL_HANDLE) vkDestroyDescriptorSetLayout(device_, set_layout_, nullptr);
+    *this = SpriteBatch{};
+}
+
+SpriteTexture SpriteBatch::add_texture(VkImageView view, VkSampler sampler) {
+    if (textures_.size() >= max_textures) throw std::runtime_error("Too many sprite textures");
+    VkDescriptorSetAllocateInfo allocInfo{};
+    allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+    allocInfo.descriptorPool = descriptor_pool_;
+    allocInfo.descriptorSetCount = 1;
+    allocInfo.pSetLayouts = &set_layout_;
+    VkDescriptorSet set;
+    if (vkAllocateDescriptorSets(device_, &allocInfo, &set) != VK_SUCCESS)
+        throw std::runtime_error("Failed to allocate sprite descriptor set");
+    VkDescriptorImageInfo imageInfo{};
+    imageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+    imageInfo.imageView = view;
+    imageInfo.sampler = sampler;
+    VkWriteDescriptorSet write{};
+    write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+    write.dstSet = set;
+    write.dstBinding = 0;
+    write.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    write.descriptorCount = 1;
+    write.pImageInfo = &imageInfo;
+    vkUpdateDescriptorSets(device_, 1, &write, 0, nullptr);
+    textures_.push_back(set);
+    return static_cast<SpriteTexture>(textures_.size() - 1);
+}
+
+uint32_t SpriteBatch::pack_color(float r, float g, float b, float a) {
+    auto channel = [](float v) { return static_cast<uint32_t>(std::lround(std::clamp(v, 0.0f, 1.0f) * 255.0f)); };
+    // R8G8B8A8_UNORM reads the bytes in memory order, R first.
+    return channel(r) | (channel(g) << 8) | (channel(b) << 16) | (channel(a) << 24);
+}
+
+void SpriteBatch::draw(float x, float y, float width, float height, const SpriteRegion& region, uint32_t color, uint16_t layer) {
+    Quad quad;
+    quad.instance = {{x, y, width, height}, {region.u0, region.v0, region.u1, region.v1}, color};
+    quad.texture = region.texture;
+    quad.layer = layer;
+    quads_.push_back(quad);
+}
+
+void SpriteBatch::record(VkCommandBuffer cmd, uint32_t frameSlot, VkExtent2D extent) {
+    stats_ = {};
+    if (quads_.empty()) return;
+    const uint32_t count = static_cast<uint32_t>(std::min<size_t>(quads_.size(), capacity_));
+    stats_.quads = count;
+    stats_.dropped = static_cast<uint32_t>(quads_.size() - count);
+
+    // The radix sort is stable, so equal keys keep submission order.
+    entries_.resize(count);
+    for (uint32_t i = 0; i < count; ++i) {
+        entries_[i] = {(static_cast<uint64_t>(quads_[i].layer) << 16) | quads_[i].texture, i};
+    }
+    radix_sort(entries_, scratch_);
+    Instance* out = ring_ + static_cast<size_t>(frameSlot % frame_slots_) * capacity_;
+    for (uint32_t i = 0; i < count; ++i) out[i] = quads_[entries_[i].item].instance;
+
+    SpritePushConstants push{};
+    push.scale[0] = 2.0f / static_cast<float>(extent.width);
+    push.scale[1] = 2.0f / static_cast<float>(extent.height);
+    push.offset[0] = -1.0f;
+    push.offset[1] = -1.0f;
+    vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline_);
+    vkCmdPushConstants(cmd, pipeline_layout_, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(push), &push);
+    VkDeviceSize offset = static_cast<VkDeviceSize>(out - ring_) * sizeof(Instance);
+    vkCmdBindVertexBuffers(cmd, 0, 1, &ring_buffer_, &offset);
+    // One draw per run of equal texture, which spans layers when it can.
+    uint32_t first = 0;
+    SpriteTexture bound = UINT16_MAX;
+    while (first < count) {
+        SpriteTexture texture = quads_[entries_[first].item].texture;
+        uint32_t last = first + 1;
+        while (last < count && quads_[entries_[last].item].texture == texture) ++last;
+        if (texture < textures_.size()) {
+            if (texture != bound) {
+                vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline_layout_, 0, 1, &textures_[texture], 0, nullptr);
+                bound = texture;
+                ++stats_.texture_binds;
+            }
+            vkCmdDraw(cmd, 4, last - first, 0, first);
+            ++stats_.draws;
+        }
+        first = last;
+    }
+    quads_.clear();
+}
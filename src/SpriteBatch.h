@@ -0,0 +1,130 @@
+#pragma once
+#include <vulkan/vulkan.h>
+#include <cstdint>
+#include <vector>
+#include "RenderQueue.h"
+
+// Texture registered with a SpriteBatch.
+using SpriteTexture = uint16_t;
+
+// Part of a texture in normalized coordinates.
+struct SpriteRegion {
+    SpriteTexture texture = 0;
+    float u0 = 0.0f, v0 = 0.0f, u1 = 1.0f, v1 = 1.0f;
+};
+
+// Named-by-index sub-rectangles of one texture, so sprites cut from it share
+// a draw call. Regions are either declared by pixel rectangle or packed onto
+// shelves as images are added at load time.
+class SpriteAtlas {
+public:
+    struct PixelRect {
+        uint32_t x = 0, y = 0, width = 0, height = 0;
+    };
+
+    SpriteAtlas(SpriteTexture texture, uint32_t width, uint32_t height);
+
+    uint32_t add_region(uint32_t x, uint32_t y, uint32_t width, uint32_t height);
+    // Reserves width x height texels (plus one texel of padding against
+    // filtering bleed) and returns the region, or UINT32_MAX when the atlas
+    // is full. The caller uploads the image at pixel_rect().
+    uint32_t pack(uint32_t width, uint32_t height);
+
+    const SpriteRegion& region(uint32_t index) const { return regions_[index]; }
+    const PixelRect& pixel_rect(uint32_t index) const { return rects_[index]; }
+    uint32_t size() const { return static_cast<uint32_t>(regions_.size()); }
+    SpriteTexture texture() const { return texture_; }
+
+private:
+    struct Shelf {
+        uint32_t y = 0, height = 0, used = 0;
+    };
+
+    SpriteTexture texture_;
+    uint32_t width_;
+    uint32_t height_;
+    uint32_t shelf_end_ = 0;
+    std::vector<Shelf> shelves_;
+    std::vector<SpriteRegion> regions_;
+    std::vector<PixelRect> rects_;
+};
+
+struct SpriteStats {
+    uint32_t quads = 0;
+    uint32_t draws = 0;
+    uint32_t texture_binds = 0;
+    // Quads beyond the per-frame capacity.
+    uint32_t dropped = 0;
+};
+
+// Immediate-mode 2D quad batcher for HUD and debug overlays.
+//
+// Quads queued with draw() are consumed by the next record(): they are sorted
+// by layer and then texture, written into this frame slot's range of a
+// persistently mapped instance ring, and drawn with one instanced draw per
+// run of equal texture. A frame slot's range is only rewritten after its fence
+// has signaled, so no copies or maps happen per frame.
+//
+// Quads in a higher layer cover lower ones. Within a layer, quads sharing a
+// texture keep submission order; the order between different textures in
+// the same layer is unspecified, which is what lets them batch.
+class SpriteBatch {
+public:
+    static constexpr uint32_t default_capacity = 16384;
+    static constexpr uint32_t max_textures = 64;
+
+    // Builds the pipeline for passes rendering to colorFormat, with a
+    // depthFormat attachment (UNDEFINED for none), and a ring with capacity
+    // quads for each of frameSlots frames in flight.
+    void init(VkDevice device, VkPhysicalDevice physicalDevice, VkFormat colorFormat, VkFormat depthFormat,
+              uint32_t frameSlots, uint32_t capacity = default_capacity);
+    void destroy();
+
+    // The view and sampler must outlive the batch. Throws when max_textures
+    // are registered.
+    SpriteTexture add_texture(VkImageView view, VkSampler sampler);
+
+    // x, y, width and height are in pixels from the top-left corner of the
+    // render target. color is RGBA8 (see pack_color), multiplied with the texel.
+    void draw(float x, float y, float width, float height, const SpriteRegion& region,
+              uint32_t color = 0xffffffffu, uint16_t layer = 0);
+    static uint32_t pack_color(float r, float g, float b, float a = 1.0f);
+
+    // Records the queued quads into cmd, inside rendering with the init()
+    // formats, and clears the queue. Viewport and scissor must already be set.
+    void record(VkCommandBuffer cmd, uint32_t frameSlot, VkExtent2D extent);
+    size_t queued() const { return quads_.size(); }
+    // Counters from the last record().
+    const SpriteStats& stats() const { return stats_; }
+
+private:
+    // One instance of the unit quad; the vertex shader expands the corners.
+    struct Instance {
+        float rect[4];
+        float uv[4];
+        uint32_t color;
+    };
+    struct Quad {
+        Instance instance;
+        SpriteTexture texture;
+        uint16_t layer;
+    };
+
+    void create_pipeline(VkFormat colorFormat, VkFormat depthFormat);
+
+    VkDevice device_ = VK_NULL_HANDLE;
+    VkDescriptorSetLayout set_layout_ = VK_NULL_HANDLE;
+    VkDescriptorPool descriptor_pool_ = VK_NULL_HANDLE;
+    VkPipelineLayout pipeline_layout_ = VK_NULL_HANDLE;
+    VkPipeline pipeline_ = VK_NULL_HANDLE;
+    VkBuffer ring_buffer_ = VK_NULL_HANDLE;
+    VkDeviceMemory ring_memory_ = VK_NULL_HANDLE;
+    Instance* ring_ = nullptr;
+    uint32_t frame_slots_ = 0;
+    uint32_t capacity_ = 0;
+    std::vector<VkDescriptorSet> textures_;
+    std::vector<Quad> quads_;
+    std::vector<RenderSortEntry> entries_;
+    std::vector<RenderSortEntry> scratch_;
+    SpriteStats stats_;
+};
@@ -0,0 +1,7 @@
+#pragma once
+
+struct Vertex {
+    float pos[3];
+    float color[3];
+    float uv[2];
+};
@@ -0,0 +1,334 @@
+#include "ViewAtlas.h"
+#include "GpuMemory.h"
+#include "Vertex.h"
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstddef>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+
+namespace {
+std::vector<char> read_file(const std::string& filename) {
+    std::ifstream file(filename, std::ios::ate | std::ios::binary);
+    if (!file.is_open()) throw std::runtime_error("failed to open file: " + filename);
+    std::vector<char> buffer(static_cast<size_t>(file.tellg()));
+    file.seekg(0);
+    file.read(buffer.data(), static_cast<std::streamsize>(buffer.size()));
+    return buffer;
+}
+
+VkShaderModule create_shader_module(VkDevice device, const std::string& filename) {
+    std::vector<char> code = read_file(filename);
+    VkShaderModuleCreateInfo createInfo{};
+    createInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+    createInfo.codeSize = code.size();
+    createInfo.pCode = reinterpret_cast<const uint32_t*>(code.data());
+    VkShaderModule module;
+    if (vkCreateShaderModule(device, &createInfo, nullptr, &module) != VK_SUCCESS)
+        throw std::runtime_error("Failed to create shader module: " + filename);
+    return module;
+}
+
+uint32_t find_memory_type(VkPhysicalDevice physicalDevice, uint32_t typeBits, VkMemoryPropertyFlags properties) {
+    VkPhysicalDeviceMemoryProperties memProperties;
+    vkGetPhysicalDeviceMemoryProperties(physicalDevice, &memProperties);
+    for (uint32_t i = 0; i < memProperties.memoryTypeCount; i++) {
+        if ((typeBits & (1 << i)) && (memProperties.memoryTypes[i].propertyFlags & properties) == properties) return i;
+    }
+    throw std::runtime_error("No suitable memory type for the view atlas");
+}
+}
+
+void ViewAtlas::init(VkDevice device, VkPhysicalDevice physicalDevice, VkDescriptorSetLayout materialLayout, VkFormat depthFormat,
+                     const ViewAtlasLayout& layout) {
+    if (layout.tile_width == 0 || layout.tile_height == 0 || layout.columns == 0 || layout.rows == 0)
+        throw std::runtime_error("View atlas layout must have at least one non-empty tile");
+    device_ = device;
+    layout_ = layout;
+    depth_format_ = depthFormat;
+
+    VkImageCreateInfo imageInfo{};
+    imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+    imageInfo.imageType = VK_IMAGE_TYPE_2D;
+    imageInfo.format = format;
+    imageInfo.extent = { layout_.columns * layout_.tile_width, layout_.rows * layout_.tile_height, 1 };
+    imageInfo.mipLevels = 1;
+    imageInfo.arrayLayers = 1;
+    imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+    imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+    imageInfo.usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+    imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    if (vkCreateImage(device_, &imageInfo, nullptr, &image_) != VK_SUCCESS)
+        throw std::runtime_error("Failed to create view atlas");
+    VkMemoryRequirements requirements;
+    vkGetImageMemoryRequirements(device_, image_, &requirements);
+    VkMemoryAllocateInfo allocInfo{};
+    allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+    allocInfo.allocationSize = requirements.size;
+    allocInfo.memoryTypeIndex = find_memory_type(physicalDevice, requirements.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+    if (GpuMemory::shared().allocate(device_, allocInfo, GpuMemoryCategory::render_target, &image_memory_) != VK_SUCCESS)
+        throw std::runtime_error("Failed to allocate view atlas memory");
+    vkBindImageMemory(device_, image_, image_memory_, 0);
+    VkImageViewCreateInfo viewInfo{};
+    viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+    viewInfo.image = image_;
+    viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+    viewInfo.format = format;
+    viewInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    viewInfo.subresourceRange.levelCount = 1;
+    viewInfo.subresourceRange.layerCount = 1;
+    if (vkCreateImageView(device_, &viewInfo, nullptr, &view_) != VK_SUCCESS)
+        throw std::runtime_error("Failed to create view atlas view");
+
+    // Every tile's queue keeps its capacity from frame to frame.
+    culls_.resize(capacity());
+    queues_.resize(capacity());
+    create_pipeline(materialLayout, depthFormat);
+}
+
+void ViewAtlas::create_pipeline(VkDescriptorSetLayout materialLayout, VkFormat depthFormat) {
+    VkShaderModule vertModule = create_shader_module(device_, "assets/view_atlas.vert.spv");
+    VkShaderModule fragModule = create_shader_module(device_, "assets/view_atlas.frag.spv");
+    std::array<VkPipelineShaderStageCreateInfo, 2> stages{};
+    stages[0].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    stages[0].stage = VK_SHADER_STAGE_VERTEX_BIT;
+    stages[0].module = vertModule;
+    stages[0].pName = "main";
+    stages[1].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    stages[1].stage = VK_SHADER_STAGE_FRAGMENT_BIT;
+    stages[1].module = fragModule;
+    stages[1].pName = "main";
+
+    // The meshes' full vertex stream, as in the main pass.
+    VkVertexInputBindingDescription bindingDesc{};
+    bindingDesc.binding = 0;
+    bindingDesc.stride = sizeof(Vertex);
+    bindingDesc.inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
+    std::array<VkVertexInputAttributeDescription, 3> attrDescs{};
+    attrDescs[0].binding = 0; attrDescs[0].location = 0; attrDescs[0].format = VK_FORMAT_R32G32B32_SFLOAT; attrDescs[0].offset = offsetof(Vertex, pos);
+    attrDescs[1].binding = 0; attrDescs[1].location = 1; attrDescs[1].format = VK_FORMAT_R32G32B32_SFLOAT; attrDescs[1].offset = offsetof(Vertex, color);
+    attrDescs[2].binding = 0; attrDescs[2].location = 2; attrDescs[2].format = VK_FORMAT_R32G32_SFLOAT; attrDescs[2].offset = offsetof(Vertex, uv);
+    VkPipelineVertexInputStateCreateInfo vertexInputInfo{};
+    vertexInputInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
+    vertexInputInfo.vertexBindingDescriptionCount = 1;
+    vertexInputInfo.pVertexBindingDescriptions = &bindingDesc;
+    vertexInputInfo.vertexAttributeDescriptionCount = static_cast<uint32_t>(attrDescs.size());
+    vertexInputInfo.pVertexAttributeDescriptions = attrDescs.data();
+    VkPipelineInputAssemblyStateCreateInfo inputAssembly{};
+    inputAssembly.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
+    inputAssembly.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+    // Viewport and scissor move from tile to tile.
+    VkPipelineViewportStateCreateInfo viewportState{};
+    viewportState.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
+    viewportState.viewportCount = 1;
+    viewportState.scissorCount = 1;
+    std::array<VkDynamicState, 2> dynamicStates = { VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR };
+    VkPipelineDynamicStateCreateInfo dynamicState{};
+    dynamicState.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
+    dynamicState.dynamicStateCount = static_cast<uint32_t>(dynamicStates.size());
+    dynamicState.pDynamicStates = dynamicStates.data();
+    VkPipelineRasterizationStateCreateInfo rasterizer{};
+    rasterizer.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
+    rasterizer.polygonMode = VK_POLYGON_MODE_FILL;
+    rasterizer.lineWidth = 1.0f;
+    rasterizer.cullMode = VK_CULL_MODE_BACK_BIT;
+    rasterizer.frontFace = VK_FRONT_FACE_CLOCKWISE;
+    VkPipelineMultisampleStateCreateInfo multisampling{};
+    multisampling.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
+    multisampling.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
+    VkPipelineColorBlendAttachmentState colorBlendAttachment{};
+    colorBlendAttachment.colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
+    VkPipelineColorBlendStateCreateInfo colorBlending{};
+    colorBlending.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
+    colorBlending.attachmentCount = 1;
+    colorBlending.pAttachments = &colorBlendAttachment;
+    VkPipelineDepthStencilStateCreateInfo depthStencil{};
+    depthStencil.sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
+    depthStencil.depthTestEnable = VK_TRUE;
+    depthStencil.depthWriteEnable = VK_TRUE;
+    depthStencil.depthCompareOp = VK_COMPARE_OP_LESS;
+
+    // Set 0 matches the main pipeline's, so the material sets bind as they are.
+    // The push constants are the draw's model matrix, then the tile's view-projection.
+    VkPushConstantRange pushRange{};
+    pushRange.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+    pushRange.size = RenderQueue::model_push_size + sizeof(glm::mat4);
+    VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
+    pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+    pipelineLayoutInfo.setLayoutCount = 1;
+    pipelineLayoutInfo.pSetLayouts = &materialLayout;
+    pipelineLayoutInfo.pushConstantRangeCount = 1;
+    pipelineLayoutInfo.pPushConstantRanges = &pushRange;
+    if (vkCreatePipelineLayout(device_, &pipelineLayoutInfo, nullptr, &pipeline_layout_) != VK_SUCCESS)
+        throw std::runtime_error("Failed to create view atlas pipeline layout");
+
+    VkFormat colorFormat = format;
+    VkPipelineRenderingCreateInfo renderingInfo{};
+    renderingInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_RENDERING_CREATE_INFO;
+    renderingInfo.colorAttachmentCount = 1;
+    renderingInfo.pColorAttachmentFormats = &colorFormat;
+    renderingInfo.depthAttachmentFormat = depthFormat;
+    VkGraphicsPipelineCreateInfo pipelineInfo{};
+    pipelineInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+    pipelineInfo.pNext = &renderingInfo;
+    pipelineInfo.stageCount = static_cast<uint32_t>(stages.size());
+    pipelineInfo.pStages = stages.data();
+    pipelineInfo.pVertexInputState = &vertexInputInfo;
+    pipelineInfo.pInputAssemblyState = &inputAssembly;
+    pipelineInfo.pViewportState = &viewportState;
+    pipelineInfo.pRasterizationState = &rasterizer;
+    pipelineInfo.pMultisampleState = &multisampling;
+    pipelineInfo.pColorBlendState = &colorBlending;
+    pipelineInfo.pDepthStencilState = &depthStencil;
+    pipelineInfo.pDynamicState = &dynamicState;
+    pipelineInfo.layout = pipeline_layout_;
+    VkResult result = vkCreateGraphicsPipelines(device_, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &pipeline_);
+    vkDestroyShaderModule(device_, vertModule, nullptr);
+    vkDestroyShaderModule(device_, fragModule, nullptr);
+    if (result != VK_SUCCESS) throw std::runtime_error("Failed to create view atlas pipeline");
+}
+
+void ViewAtlas::destroy() {
+    if (device_ == VK_NULL_HANDLE) return;
+    if (pipeline_ != VK_NULL_HANDLE) vkDestroyPipeline(device_, pipeline_, nullptr);
+    if (pipeline_layout_ != VK_NULL_HANDLE) vkDestroyPipelineLayout(device_, pipeline_layout_, nullptr);
+    if (view_ != VK_NULL_HANDLE) vkDestroyImageView(device_, view_, nullptr);
+    if (image_ != VK_NULL_HANDLE) vkDestroyImage(device_, image_, nullptr);
+    GpuMemory::shared().free(device_, image_memory_);
+    *this = ViewAtlas{};
+}
+
+VkRect2D ViewAtlas::tile(uint32_t index) const {
+    VkRect2D rect{};
+    rect.offset.x = static_cast<int32_t>(index % layout_.columns * layout_.tile_width);
+    rect.offset.y = static_cast<int32_t>(index / layout_.columns * layout_.tile_height);
+    rect.extent = { layout_.tile_width, layout_.tile_height };
+    return rect;
+}
+
+uint32_t ViewAtlas::add_view(const Camera& camera, float lodErrorPixels) {
+    if (!initialized() || view_count_ >= capacity()) return UINT32_MAX;
+    CullContext& cull = culls_[view_count_];
+    cull = CullContext{};
+    cull.view_proj = camera.get_view_projection_matrix();
+    if (lodErrorPixels > 0.0f) {
+        cull.lod_pixel_scale = 0.5f * static_cast<float>(layout_.tile_height) * std::abs(camera.get_projection_matrix()[1][1]);
+        cull.lod_error_pixels = lodErrorPixels;
+    }
+    return view_count_++;
+}
+
+void ViewAtlas::collect(Scene* scene, std::pmr::memory_resource* temp) {
+    if (view_count_ == 0) return;
+    auto start = Clock::now();
+    for (uint32_t i = 0; i < view_count_; ++i) queues_[i].clear();
+    if (scene) scene->collect_views(std::span<RenderQueue>(queues_.data(), view_count_), std::span<CullContext>(culls_.data(), view_count_));
+    // The queues are small; sorting them one after another keeps the radix
+    // sort's own parallel passes out of a nested parallel_for.
+    stats_.frustum_culled = 0;
+    for (uint32_t i = 0; i < view_count_; ++i) {
+        queues_[i].sort(temp);
+        stats_.frustum_culled += culls_[i].frustum_culled;
+    }
+    stats_.cull_ms = std::chrono::duration<float, std::milli>(Clock::now() - start).count();
+}
+
+void ViewAtlas::add_passes(RenderGraph& graph, const MeshPool& meshes, const VkDescriptorSet* materialSets,
+                           uint32_t materialSetCount, uint64_t serial) {
+    const uint32_t count = view_count_;
+    if (count == 0) return;
+    view_count_ = 0;
+    const VkExtent2D extent = { layout_.columns * layout_.tile_width, layout_.rows * layout_.tile_height };
+    // Every tile is cleared, so the previous contents are discarded; the
+    // previous frame's reads still have to finish first.
+    ImageAccess before = image_initialized_ ? ImageAccess::fragment_sampled() : ImageAccess{};
+    before.layout = VK_IMAGE_LAYOUT_UNDEFINED;
+    RenderGraph::Resource atlas = graph.import_image("view_atlas", image_, view_, VK_IMAGE_ASPECT_COLOR_BIT, before);
+    graph.export_image(atlas, ImageAccess::fragment_sampled());
+    TransientImageDesc depthDesc{};
+    depthDesc.width = extent.width;
+    depthDesc.height = extent.height;
+    depthDesc.format = depth_format_;
+    depthDesc.usage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT;
+    depthDesc.aspect = depth_format_ == VK_FORMAT_D32_SFLOAT
+        ? VK_IMAGE_ASPECT_DEPTH_BIT : VK_IMAGE_ASPECT_DEPTH_BIT | VK_IMAGE_ASPECT_STENCIL_BIT;
+    RenderGraph::Resource depth = graph.create_image("view_atlas_depth", depthDesc);
+
+    RenderGraph::Pass pass = graph.add_pass("view_atlas", [this, &graph, &meshes, materialSets, materialSetCount, count, extent,
+                                                           atlas, depth](VkCommandBuffer cmd) {
+        VkRenderingAttachmentInfo colorAttachment{};
+        colorAttachment.sType = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO;
+        colorAttachment.imageView = graph.view(atlas);
+        colorAttachment.imageLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+        colorAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+        colorAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+        colorAttachment.clearValue.color = { {0.0f, 0.0f, 0.0f, 0.0f} };
+        VkRenderingAttachmentInfo depthAttachment{};
+        depthAttachment.sType = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO;
+        depthAttachment.imageView = graph.view(depth);
+        depthAttachment.imageLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+        depthAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+        depthAttachment.storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+        depthAttachment.clearValue.depthStencil = { 1.0f, 0 };
+        VkRenderingInfo renderingInfo{};
+        renderingInfo.sType = VK_STRUCTURE_TYPE_RENDERING_INFO;
+        renderingInfo.renderArea.extent = extent;
+        renderingInfo.layerCount = 1;
+        renderingInfo.colorAttachmentCount = 1;
+        renderingInfo.pColorAttachments = &colorAttachment;
+        renderingInfo.pDepthAttachment = &depthAttachment;
+        RenderQueueBindings bindings{};
+        bindings.pipelines = &pipeline_;
+        bindings.pipeline_count = 1;
+        bindings.descriptor_sets = materialSets;
+        bindings.descriptor_set_count = materialSetCount;
+        bindings.pipeline_layout = pipeline_layout_;
+        bindings.meshes = &meshes;
+        draw_stats_ = {};
+        vkCmdBeginRendering(cmd, &renderingInfo);
+        for (uint32_t i = 0; i < count; ++i) {
+            VkRect2D area = tile(i);
+            VkViewport viewport{};
+            viewport.x = static_cast<float>(area.offset.x);
+            viewport.y = static_cast<float>(area.offset.y);
+            viewport.width = static_cast<float>(area.extent.width);
+            viewport.height = static_cast<float>(area.extent.height);
+            viewport.maxDepth = 1.0f;
+            vkCmdSetViewport(cmd, 0, 1, &viewport);
+            vkCmdSetScissor(cmd, 0, 1, &area);
+            // Push constants stay set across the queue's pipeline binds.
+            vkCmdPushConstants(cmd, pipeline_layout_, VK_SHADER_STAGE_VERTEX_BIT, RenderQueue::model_push_size, sizeof(glm::mat4),
+                               &culls_[i].view_proj);
+            queues_[i].record(cmd, bindings, draw_stats_);
+        }
+        vkCmdEndRendering(cmd);
+        stats_.draws = draw_stats_.draws;
+        stats_.triangles = draw_stats_.triangles;
+    });
+    graph.write(pass, atlas, ImageAccess::color_attachment());
+    graph.write(pass, depth, ImageAccess::depth_attachment());
+    image_initialized_ = true;
+    stats_.views = count;
+    if (window_start_ == Clock::time_point{}) window_start_ = Clock::now();
+    in_flight_.push_back({ serial, count });
+}
+
+void ViewAtlas::retire(uint64_t completedSerial) {
+    size_t done = 0;
+    while (done < in_flight_.size() && in_flight_[done].serial <= completedSerial) {
+        window_views_ += in_flight_[done].views;
+        stats_.completed_views += in_flight_[done].views;
+        ++done;
+    }
+    in_flight_.erase(in_flight_.begin(), in_flight_.begin() + static_cast<std::ptrdiff_t>(done));
+    if (window_start_ == Clock::time_point{}) return;
+    auto now = Clock::now();
+    float elapsed = std::chrono::duration<float>(now - window_start_).count();
+    if (elapsed < 1.0f) return;
+    stats_.views_per_second = static_cast<float>(window_views_) / elapsed;
+    window_views_ = 0;
+    window_start_ = in_flight_.empty() ? Clock::time_point{} : now;
+}
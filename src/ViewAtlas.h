@@ -0,0 +1,117 @@
+#pragma once
+#include <vulkan/vulkan.h>
+#include <chrono>
+#include <cstdint>
+#include <memory_resource>
+#include <vector>
+#include "Camera.h"
+#include "RenderGraph.h"
+#include "RenderQueue.h"
+#include "Scene.h"
+
+// Tile grid of a ViewAtlas; the image is columns * tile_width wide.
+struct ViewAtlasLayout {
+    uint32_t tile_width = 256;
+    uint32_t tile_height = 256;
+    uint32_t columns = 8;
+    uint32_t rows = 8;
+};
+
+struct ViewAtlasStats {
+    // Views, draws and culling of the last frame that rendered any.
+    uint32_t views = 0;
+    uint32_t draws = 0;
+    uint32_t triangles = 0;
+    uint32_t frustum_culled = 0;
+    float cull_ms = 0.0f;
+    // Views whose frames completed on the GPU, and their rate measured over
+    // roughly the last second.
+    uint64_t completed_views = 0;
+    float views_per_second = 0.0f;
+};
+
+// Renders the scene from many cameras into tiles of one offscreen color image,
+// for thumbnails and previews.
+//
+// Views are immediate mode like VulkanApp::draw_quad(): add_view() queues a
+// camera for the next frame only. At record time all views are culled in one
+// Scene::collect_views() call, which visits every entity once for all views
+// and fills the per-view queues across the job system, and a single render
+// graph pass draws them tile by tile (viewport and scissor per tile) against
+// a transient depth image of the atlas size, in the frame's one submission.
+// Meshes, textures and materials are shared with the main view: the draws
+// bind the material sets (set 0) and take the view-projection from a push
+// constant. Shading is unlit (texture times vertex color); the light grid and
+// shadow cascades belong to the main camera.
+//
+// The atlas is left in SHADER_READ_ONLY_OPTIMAL for sampling, e.g. as a
+// sprite texture. Tiles without a view this frame are cleared.
+class ViewAtlas {
+public:
+    static constexpr VkFormat format = VK_FORMAT_R8G8B8A8_UNORM;
+
+    // materialLayout is the layout of the descriptor sets the scene's
+    // materials index.
+    void init(VkDevice device, VkPhysicalDevice physicalDevice, VkDescriptorSetLayout materialLayout, VkFormat depthFormat,
+              const ViewAtlasLayout& layout);
+    void destroy();
+    bool initialized() const { return image_ != VK_NULL_HANDLE; }
+
+    const ViewAtlasLayout& layout() const { return layout_; }
+    uint32_t capacity() const { return layout_.columns * layout_.rows; }
+    // Pixel rectangle of tile index, row by row from the top left.
+    VkRect2D tile(uint32_t index) const;
+    VkImage image() const { return image_; }
+    VkImageView view() const { return view_; }
+
+    // Queues camera for the next frame and returns its tile, or UINT32_MAX
+    // once the atlas is full. LODs are picked with lodErrorPixels against
+    // the tile height; zero always draws LOD 0.
+    uint32_t add_view(const Camera& camera, float lodErrorPixels = 1.0f);
+    uint32_t view_count() const { return view_count_; }
+
+    // Culls every queued view against scene (which may be null) and sorts
+    // the queues. temp holds the sort histograms.
+    void collect(Scene* scene, std::pmr::memory_resource* temp);
+    // Declares the atlas pass if any view is queued and clears the queue.
+    // materialSets are the sets the queued materials index; serial is the
+    // submit serial of the frame being recorded, for retire().
+    void add_passes(RenderGraph& graph, const MeshPool& meshes, const VkDescriptorSet* materialSets,
+                    uint32_t materialSetCount, uint64_t serial);
+    // Counts the views of frames up to completedSerial as done.
+    void retire(uint64_t completedSerial);
+    const ViewAtlasStats& stats() const { return stats_; }
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    struct Batch {
+        uint64_t serial;
+        uint32_t views;
+    };
+
+    void create_pipeline(VkDescriptorSetLayout materialLayout, VkFormat depthFormat);
+
+    VkDevice device_ = VK_NULL_HANDLE;
+    ViewAtlasLayout layout_;
+    VkFormat depth_format_ = VK_FORMAT_UNDEFINED;
+    VkImage image_ = VK_NULL_HANDLE;
+    VkDeviceMemory image_memory_ = VK_NULL_HANDLE;
+    VkImageView view_ = VK_NULL_HANDLE;
+    VkPipelineLayout pipeline_layout_ = VK_NULL_HANDLE;
+    VkPipeline pipeline_ = VK_NULL_HANDLE;
+    // The image holds a rendered atlas once a frame has written it.
+    bool image_initialized_ = false;
+
+    // By tile; the first view_count_ are queued for the next frame.
+    std::vector<CullContext> culls_;
+    std::vector<RenderQueue> queues_;
+    uint32_t view_count_ = 0;
+    RenderStats draw_stats_;
+
+    // Submitted batches not yet known to have completed.
+    std::vector<Batch> in_flight_;
+    Clock::time_point window_start_{};
+    uint64_t window_views_ = 0;
+    ViewAtlasStats stats_;
+};
@@ -1,5 +1,3 @@
-#define NOMINMAX
-#define VK_USE_PLATFORM_WIN32_KHR
 #include <algorithm>
 #include <vector>
 #include <array>
@@ -11,7 +9,10 @@
 #include <fstream>
 #include "stb_image.h"
 #include "Camera.h"
+#include "Log.h"
+#include "GpuMemory.h"
 #include <cstring>
+#include <thread>
 
 #define VK_CHECK(x) do { VkResult err = x; if (err) throw std::runtime_error("Vulkan error"); } while(0)
 
@@ -21,6 +22,7 @@ struct QueueFamilyIndices {
     int present_family = -1;
     bool is_complete() const { return graphics_family >= 0 && present_family >= 0; }
 };
+QueueFamilyIndices FindQueueFamilies(VkPhysicalDevice device, VkSurfaceKHR surface);
 
 // Helper for swapchain support
 struct SwapChainSupportDetails {
@@ -66,7 +68,7 @@ static std::vector<char> ReadFile(const std::string& filename) {
 }
 
 // Helper for Vulkan buffer creation
-void CreateBuffer(VkDevice device, VkPhysicalDevice physicalDevice, VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, VkBuffer& buffer, VkDeviceMemory& bufferMemory) {
+void CreateBuffer(VkDevice device, VkPhysicalDevice physicalDevice, VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, GpuMemoryCategory category, VkBuffer& buffer, VkDeviceMemory& bufferMemory) {
     VkBufferCreateInfo bufferInfo{};
     bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
     bufferInfo.size = size;
@@ -87,12 +89,12 @@ void CreateBuffer(VkDevice device, VkPhysicalDevice physicalDevice, VkDeviceSize
             break;
         }
     }
-    VK_CHECK(vkAllocateMemory(device, &allocInfo, nullptr, &bufferMemory));
+    VK_CHECK(GpuMemory::shared().allocate(device, allocInfo, category, &bufferMemory));
     VK_CHECK(vkBindBufferMemory(device, buffer, bufferMemory, 0));
 }
 
 // Helper for Vulkan image creation
-void CreateImage(VkDevice device, VkPhysicalDevice physicalDevice, uint32_t width, uint32_t height, VkFormat format, VkImageTiling tiling, VkImageUsageFlags usage, VkMemoryPropertyFlags properties, VkImage& image, VkDeviceMemory& imageMemory) {
+void CreateImage(VkDevice device, VkPhysicalDevice physicalDevice, uint32_t width, uint32_t height, VkFormat format, VkImageTiling tiling, VkImageUsageFlags usage, VkMemoryPropertyFlags properties, GpuMemoryCategory category, VkImage& image, VkDeviceMemory& imageMemory) {
     VkImageCreateInfo imageInfo{};
     imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
     imageInfo.imageType = VK_IMAGE_TYPE_2D;
@@ -121,7 +123,7 @@ void CreateImage(VkDevice device, VkPhysicalDevice physicalDevice, uint32_t widt
             break;
         }
     }
-    VK_CHECK(vkAllocateMemory(device, &allocInfo, nullptr, &imageMemory));
+    VK_CHECK(GpuMemory::shared().allocate(device, allocInfo, category, &imageMemory));
     VK_CHECK(vkBindImageMemory(device, image, imageMemory, 0));
 }
 
@@ -142,18 +144,21 @@ VkCommandBuffer BeginSingleTimeCommands(VkDevice device, VkCommandPool commandPo
 }
 void EndSingleTimeCommands(VkDevice device, VkCommandPool commandPool, VkQueue queue, VkCommandBuffer commandBuffer) {
     vkEndCommandBuffer(commandBuffer);
-    VkSubmitInfo submitInfo{};
-    submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
-    submitInfo.commandBufferCount = 1;
-    submitInfo.pCommandBuffers = &commandBuffer;
-    vkQueueSubmit(queue, 1, &submitInfo, VK_NULL_HANDLE);
+    VkCommandBufferSubmitInfo commandBufferInfo{};
+    commandBufferInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_SUBMIT_INFO;
+    commandBufferInfo.commandBuffer = commandBuffer;
+    VkSubmitInfo2 submitInfo{};
+    submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO_2;
+    submitInfo.commandBufferInfoCount = 1;
+    submitInfo.pCommandBufferInfos = &commandBufferInfo;
+    vkQueueSubmit2(queue, 1, &submitInfo, VK_NULL_HANDLE);
     vkQueueWaitIdle(queue);
     vkFreeCommandBuffers(device, commandPool, 1, &commandBuffer);
 }
 void TransitionImageLayout(VkDevice device, VkCommandPool commandPool, VkQueue queue, VkImage image, VkFormat format, VkImageLayout oldLayout, VkImageLayout newLayout) {
     VkCommandBuffer commandBuffer = BeginSingleTimeCommands(device, commandPool);
-    VkImageMemoryBarrier barrier{};
-    barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+    VkImageMemoryBarrier2 barrier{};
+    barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2;
     barrier.oldLayout = oldLayout;
     barrier.newLayout = newLayout;
     barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
@@ -164,31 +169,24 @@ void TransitionImageLayout(VkDevice device, VkCommandPool commandPool, VkQueue q
     barrier.subresourceRange.levelCount = 1;
     barrier.subresourceRange.baseArrayLayer = 0;
     barrier.subresourceRange.layerCount = 1;
-    barrier.srcAccessMask = 0;
-    barrier.dstAccessMask = 0;
-    VkPipelineStageFlags sourceStage;
-    VkPipelineStageFlags destinationStage;
     if (oldLayout == VK_IMAGE_LAYOUT_UNDEFINED && newLayout == VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL) {
-        barrier.srcAccessMask = 0;
-        barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-        sourceStage = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
-        destinationStage = VK_PIPELINE_STAGE_TRANSFER_BIT;
+        barrier.srcStageMask = VK_PIPELINE_STAGE_2_NONE;
+        barrier.srcAccessMask = VK_ACCESS_2_NONE;
+        barrier.dstStageMask = VK_PIPELINE_STAGE_2_COPY_BIT;
+        barrier.dstAccessMask = VK_ACCESS_2_TRANSFER_WRITE_BIT;
     } else if (oldLayout == VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL && newLayout == VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL) {
-        barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-        barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
-        sourceStage = VK_PIPELINE_STAGE_TRANSFER_BIT;
-        destinationStage = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+        barrier.srcStageMask = VK_PIPELINE_STAGE_2_COPY_BIT;
+        barrier.srcAccessMask = VK_ACCESS_2_TRANSFER_WRITE_BIT;
+        barrier.dstStageMask = VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT;
+        barrier.dstAccessMask = VK_ACCESS_2_SHADER_SAMPLED_READ_BIT;
     } else {
         throw std::invalid_argument("unsupported layout transition!");
     }
-    vkCmdPipelineBarrier(
-        commandBuffer,
-        sourceStage, destinationStage,
-        0,
-        0, nullptr,
-        0, nullptr,
-        1, &barrier
-    );
+    VkDependencyInfo dependency{};
+    dependency.sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO;
+    dependency.imageMemoryBarrierCount = 1;
+    dependency.pImageMemoryBarriers = &barrier;
+    vkCmdPipelineBarrier2(commandBuffer, &dependency);
     EndSingleTimeCommands(device, commandPool, queue, commandBuffer);
 }
 void CopyBufferToImage(VkDevice device, VkCommandPool commandPool, VkQueue queue, VkBuffer buffer, VkImage image, uint32_t width, uint32_t height) {
@@ -208,8 +206,8 @@ void CopyBufferToImage(VkDevice device, VkCommandPool commandPool, VkQueue queue
 }
 
 // --- VulkanApp Implementation ---
-VulkanApp::VulkanApp(HINSTANCE hInstance, HWND hwnd, uint32_t width, uint32_t height) {
-    init_vulkan(hInstance, hwnd, width, height);
+VulkanApp::VulkanApp(const Window& window) {
+    init_vulkan(window);
 }
 
 VulkanApp::~VulkanApp() {
@@ -217,65 +215,95 @@ VulkanApp::~VulkanApp() {
     cleanup();
 }
 
-void VulkanApp::init_vulkan(HINSTANCE hInstance, HWND hwnd, uint32_t width, uint32_t height) {
-    create_instance();
-    create_surface(hInstance, hwnd);
+void VulkanApp::init_vulkan(const Window& window) {
+    window_width_ = window.width();
+    window_height_ = window.height();
+    create_instance(window.surface_extension());
+    surface_ = window.create_surface(instance_);
     pick_physical_device();
     create_logical_device();
-    create_swapchain(width, height);
+    deletion_queue_.init(device_);
+    render_graph_.init(device_, physical_device_, deletion_queue_);
+    create_swapchain(window_width_, window_height_);
     create_image_views();
-    create_render_pass();
+    depth_format_ = find_depth_format();
     create_descriptor_set_layout();
+    light_grid_.init(device_, physical_device_, max_frames_in_flight);
+    shadows_.init(device_, physical_device_, max_frames_in_flight);
     create_graphics_pipeline();
     create_command_pool();
     create_texture_image();
     create_texture_image_view();
     create_texture_sampler();
-    // Create MVP uniform buffer
-    VkDeviceSize mvp_buffer_size = sizeof(glm::mat4);
-    CreateBuffer(device_, physical_device_, mvp_buffer_size, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, mvp_buffer_, mvp_buffer_memory_);
-    glm::mat4 mvp = camera_.get_view_projection_matrix();
+    sprites_.init(device_, physical_device_, swapchain_image_format_, depth_format_, max_frames_in_flight);
+    debug_sprite_.texture = sprites_.add_texture(texture_image_view_, texture_sampler_);
+    // Create MVP uniform buffer: a range per frame slot, mapped for the app's lifetime
+    VkPhysicalDeviceProperties properties;
+    vkGetPhysicalDeviceProperties(physical_device_, &properties);
+    const VkDeviceSize alignment = properties.limits.minUniformBufferOffsetAlignment;
+    mvp_stride_ = (sizeof(glm::mat4) + alignment - 1) / alignment * alignment;
+    CreateBuffer(device_, physical_device_, mvp_stride_ * max_frames_in_flight, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, GpuMemoryCategory::uniform, mvp_buffer_, mvp_buffer_memory_);
     void* data;
-    vkMapMemory(device_, mvp_buffer_memory_, 0, mvp_buffer_size, 0, &data);
-    memcpy(data, &mvp, sizeof(glm::mat4));
-    vkUnmapMemory(device_, mvp_buffer_memory_);
+    VK_CHECK(vkMapMemory(device_, mvp_buffer_memory_, 0, VK_WHOLE_SIZE, 0, &data));
+    mvp_mapped_ = static_cast<std::byte*>(data);
     create_descriptor_pool();
     create_descriptor_set();
-    create_framebuffers();
+    create_present_semaphores();
     create_command_buffers();
-    float red[3] = {1.0f, 1.0f, 1.0f};
-    draw_quad(-0.5f, -0.5f, 1.0f, 1.0f, red);
-    record_draw_commands();
     create_sync_objects();
+    init_profiler();
+    record_draw_commands();
+}
+
+void VulkanApp::init_profiler() {
+#if ENGINE_PROFILER
+    QueueFamilyIndices indices = FindQueueFamilies(physical_device_, surface_);
+    uint32_t queueFamilyCount = 0;
+    vkGetPhysicalDeviceQueueFamilyProperties(physical_device_, &queueFamilyCount, nullptr);
+    std::vector<VkQueueFamilyProperties> queueFamilies(queueFamilyCount);
+    vkGetPhysicalDeviceQueueFamilyProperties(physical_device_, &queueFamilyCount, queueFamilies.data());
+    uint32_t timestampBits = queueFamilies[indices.graphics_family].timestampValidBits;
+    // One query slot per frame in flight, since each frame records its own command buffer.
+    profiler_.init(device_, physical_device_, frames_in_flight_, frames_in_flight_, timestampBits, pipeline_statistics_supported_);
+#endif
 }
 
 void VulkanApp::cleanup() {
     vkDeviceWaitIdle(device_);
-    for (size_t i = 0; i < max_frames_in_flight_; i++) {
-        vkDestroySemaphore(device_, render_finished_semaphores_[i], nullptr);
-        vkDestroySemaphore(device_, image_available_semaphores_[i], nullptr);
-        vkDestroyFence(device_, in_flight_fences_[i], nullptr);
-    }
-    for (auto framebuffer : swapchain_framebuffers_)
-        vkDestroyFramebuffer(device_, framebuffer, nullptr);
+    profiler_.destroy();
+    sprites_.destroy();
+    light_grid_.destroy();
+    shadows_.destroy();
+    view_atlas_.destroy();
+    render_graph_.destroy();
+    destroy_frame_resources();
+    meshes_.clear();
+    deletion_queue_.flush();
+    for (auto semaphore : render_finished_semaphores_)
+        vkDestroySemaphore(device_, semaphore, nullptr);
+    for (const auto& retired : retired_swapchains_)
+        retired.destroy(device_);
+    retired_swapchains_.clear();
     if (graphics_pipeline_ != VK_NULL_HANDLE)
         vkDestroyPipeline(device_, graphics_pipeline_, nullptr);
+    if (graphics_pipeline_equal_ != VK_NULL_HANDLE)
+        vkDestroyPipeline(device_, graphics_pipeline_equal_, nullptr);
+    if (depth_prepass_pipeline_ != VK_NULL_HANDLE)
+        vkDestroyPipeline(device_, depth_prepass_pipeline_, nullptr);
     if (pipeline_layout_ != VK_NULL_HANDLE)
         vkDestroyPipelineLayout(device_, pipeline_layout_, nullptr);
-    if (vertex_buffer_ != VK_NULL_HANDLE)
-        vkDestroyBuffer(device_, vertex_buffer_, nullptr);
-    if (vertex_buffer_memory_ != VK_NULL_HANDLE)
-        vkFreeMemory(device_, vertex_buffer_memory_, nullptr);
     if (mvp_buffer_ != VK_NULL_HANDLE)
         vkDestroyBuffer(device_, mvp_buffer_, nullptr);
-    if (mvp_buffer_memory_ != VK_NULL_HANDLE)
-        vkFreeMemory(device_, mvp_buffer_memory_, nullptr);
+    if (mvp_buffer_memory_ != VK_NULL_HANDLE) {
+        vkUnmapMemory(device_, mvp_buffer_memory_);
+        GpuMemory::shared().free(device_, mvp_buffer_memory_);
+    }
     if (texture_image_view_ != VK_NULL_HANDLE)
         vkDestroyImageView(device_, texture_image_view_, nullptr);
     if (texture_image_ != VK_NULL_HANDLE)
         vkDestroyImage(device_, texture_image_, nullptr);
     if (texture_image_memory_ != VK_NULL_HANDLE)
-        vkFreeMemory(device_, texture_image_memory_, nullptr);
+        GpuMemory::shared().free(device_, texture_image_memory_);
     if (texture_sampler_ != VK_NULL_HANDLE)
         vkDestroySampler(device_, texture_sampler_, nullptr);
     if (descriptor_pool_ != VK_NULL_HANDLE)
@@ -283,7 +311,6 @@ void VulkanApp::cleanup() {
     if (descriptor_set_layout_ != VK_NULL_HANDLE)
         vkDestroyDescriptorSetLayout(device_, descriptor_set_layout_, nullptr);
     vkDestroyCommandPool(device_, command_pool_, nullptr);
-    vkDestroyRenderPass(device_, render_pass_, nullptr);
     for (auto view : swapchain_image_views_)
         vkDestroyImageView(device_, view, nullptr);
     vkDestroySwapchainKHR(device_, swapchain_, nullptr);
@@ -292,16 +319,16 @@ void VulkanApp::cleanup() {
     vkDestroyInstance(instance_, nullptr);
 }
 
-void VulkanApp::create_instance() {
+void VulkanApp::create_instance(const char* surfaceExtension) {
     VkApplicationInfo appInfo{};
     appInfo.sType = VK_STRUCTURE_TYPE_APPLICATION_INFO;
     appInfo.pApplicationName = "VulkanApp";
     appInfo.applicationVersion = VK_MAKE_VERSION(1, 0, 0);
     appInfo.pEngineName = "No Engine";
     appInfo.engineVersion = VK_MAKE_VERSION(1, 0, 0);
-    appInfo.apiVersion = VK_API_VERSION_1_0;
+    appInfo.apiVersion = VK_API_VERSION_1_3;
 
-    std::vector<const char*> extensions = { "VK_KHR_surface", "VK_KHR_win32_surface" };
+    std::vector<const char*> extensions = { VK_KHR_SURFACE_EXTENSION_NAME, surfaceExtension };
     if (enable_validation_layers_) {
         extensions.push_back("VK_EXT_debug_utils");
     }
@@ -332,14 +359,6 @@ void VulkanApp::create_instance() {
     }
 }
 
-void VulkanApp::create_surface(HINSTANCE hInstance, HWND hwnd) {
-    VkWin32SurfaceCreateInfoKHR createInfo{};
-    createInfo.sType = VK_STRUCTURE_TYPE_WIN32_SURFACE_CREATE_INFO_KHR;
-    createInfo.hinstance = hInstance;
-    createInfo.hwnd = hwnd;
-    VK_CHECK(vkCreateWin32SurfaceKHR(instance_, &createInfo, nullptr, &surface_));
-}
-
 QueueFamilyIndices FindQueueFamilies(VkPhysicalDevice device, VkSurfaceKHR surface) {
     QueueFamilyIndices indices;
     uint32_t queueFamilyCount = 0;
@@ -360,7 +379,19 @@ QueueFamilyIndices FindQueueFamilies(VkPhysicalDevice device, VkSurfaceKHR surfa
 
 bool IsDeviceSuitable(VkPhysicalDevice device, VkSurfaceKHR surface) {
     QueueFamilyIndices indices = FindQueueFamilies(device, surface);
-    return indices.is_complete();
+    if (!indices.is_complete()) return false;
+    // Passes render with dynamic rendering and the render graph records its
+    // barriers with synchronization2.
+    VkPhysicalDeviceProperties properties;
+    vkGetPhysicalDeviceProperties(device, &properties);
+    if (properties.apiVersion < VK_API_VERSION_1_3) return false;
+    VkPhysicalDeviceVulkan13Features features13{};
+    features13.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_3_FEATURES;
+    VkPhysicalDeviceFeatures2 features{};
+    features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+    features.pNext = &features13;
+    vkGetPhysicalDeviceFeatures2(device, &features);
+    return features13.synchronization2 == VK_TRUE && features13.dynamicRendering == VK_TRUE;
 }
 
 void VulkanApp::pick_physical_device() {
@@ -391,17 +422,37 @@ void VulkanApp::create_logical_device() {
         queueCreateInfo.pQueuePriorities = &queuePriority;
         queueCreateInfos.push_back(queueCreateInfo);
     }
+    VkPhysicalDeviceFeatures supportedFeatures;
+    vkGetPhysicalDeviceFeatures(physical_device_, &supportedFeatures);
     VkPhysicalDeviceFeatures deviceFeatures{};
+    // Only used by the profiler; harmless to enable when available.
+    deviceFeatures.pipelineStatisticsQuery = supportedFeatures.pipelineStatisticsQuery;
+    pipeline_statistics_supported_ = supportedFeatures.pipelineStatisticsQuery == VK_TRUE;
+    VkPhysicalDeviceVulkan13Features features13{};
+    features13.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_3_FEATURES;
+    features13.synchronization2 = VK_TRUE;
+    features13.dynamicRendering = VK_TRUE;
     VkDeviceCreateInfo createInfo{};
     createInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
+    createInfo.pNext = &features13;
     createInfo.queueCreateInfoCount = static_cast<uint32_t>(queueCreateInfos.size());
     createInfo.pQueueCreateInfos = queueCreateInfos.data();
     createInfo.pEnabledFeatures = &deviceFeatures;
-    createInfo.enabledExtensionCount = 1;
-    const char* extensions[] = { "VK_KHR_swapchain" };
-    createInfo.ppEnabledExtensionNames = extensions;
+    // Budget queries are optional; memory is tracked either way.
+    uint32_t extensionCount = 0;
+    vkEnumerateDeviceExtensionProperties(physical_device_, nullptr, &extensionCount, nullptr);
+    std::vector<VkExtensionProperties> available(extensionCount);
+    vkEnumerateDeviceExtensionProperties(physical_device_, nullptr, &extensionCount, available.data());
+    bool memoryBudget = std::any_of(available.begin(), available.end(), [](const VkExtensionProperties& extension) {
+        return strcmp(extension.extensionName, VK_EXT_MEMORY_BUDGET_EXTENSION_NAME) == 0;
+    });
+    std::vector<const char*> extensions = { "VK_KHR_swapchain" };
+    if (memoryBudget) extensions.push_back(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+    createInfo.enabledExtensionCount = static_cast<uint32_t>(extensions.size());
+    createInfo.ppEnabledExtensionNames = extensions.data();
     createInfo.enabledLayerCount = 0;
     VK_CHECK(vkCreateDevice(physical_device_, &createInfo, nullptr, &device_));
+    GpuMemory::shared().init(physical_device_, memoryBudget);
     vkGetDeviceQueue(device_, indices.graphics_family, 0, &graphics_queue_);
     vkGetDeviceQueue(device_, indices.present_family, 0, &present_queue_);
 }
@@ -432,10 +483,21 @@ VkSurfaceFormatKHR ChooseSwapSurfaceFormat(const std::vector<VkSurfaceFormatKHR>
     return formats[0];
 }
 
-VkPresentModeKHR ChooseSwapPresentMode(const std::vector<VkPresentModeKHR>& presentModes) {
-    for (const auto& availablePresentMode : presentModes) {
-        if (availablePresentMode == VK_PRESENT_MODE_MAILBOX_KHR)
-            return availablePresentMode;
+VkPresentModeKHR ChooseSwapPresentMode(const std::vector<VkPresentModeKHR>& presentModes, PresentPolicy policy) {
+    auto supported = [&](VkPresentModeKHR mode) {
+        return std::find(presentModes.begin(), presentModes.end(), mode) != presentModes.end();
+    };
+    switch (policy) {
+    case PresentPolicy::immediate:
+        if (supported(VK_PRESENT_MODE_IMMEDIATE_KHR)) return VK_PRESENT_MODE_IMMEDIATE_KHR;
+        if (supported(VK_PRESENT_MODE_MAILBOX_KHR)) return VK_PRESENT_MODE_MAILBOX_KHR;
+        break;
+    case PresentPolicy::mailbox:
+        if (supported(VK_PRESENT_MODE_MAILBOX_KHR)) return VK_PRESENT_MODE_MAILBOX_KHR;
+        break;
+    case PresentPolicy::fifo:
+    case PresentPolicy::paced:
+        break;
     }
     return VK_PRESENT_MODE_FIFO_KHR;
 }
@@ -451,10 +513,10 @@ VkExtent2D ChooseSwapExtent(const VkSurfaceCapabilitiesKHR& capabilities, uint32
     }
 }
 
-void VulkanApp::create_swapchain(uint32_t width, uint32_t height) {
+void VulkanApp::create_swapchain(uint32_t width, uint32_t height, VkSwapchainKHR oldSwapchain) {
     SwapChainSupportDetails swapChainSupport = QuerySwapChainSupport(physical_device_, surface_);
     VkSurfaceFormatKHR surfaceFormat = ChooseSwapSurfaceFormat(swapChainSupport.formats);
-    VkPresentModeKHR presentMode = ChooseSwapPresentMode(swapChainSupport.present_modes);
+    VkPresentModeKHR presentMode = ChooseSwapPresentMode(swapChainSupport.present_modes, present_policy_);
     VkExtent2D extent = ChooseSwapExtent(swapChainSupport.capabilities, width, height);
     uint32_t imageCount = swapChainSupport.capabilities.minImageCount + 1;
     if (swapChainSupport.capabilities.maxImageCount > 0 && imageCount > swapChainSupport.capabilities.maxImageCount)
@@ -481,15 +543,70 @@ void VulkanApp::create_swapchain(uint32_t width, uint32_t height) {
     createInfo.compositeAlpha = VK_COMPOSITE_ALPHA_OPAQUE_BIT_KHR;
     createInfo.presentMode = presentMode;
     createInfo.clipped = VK_TRUE;
-    createInfo.oldSwapchain = VK_NULL_HANDLE;
+    // Lets the driver hand over images from the old swapchain instead of
+    // tearing it down first.
+    createInfo.oldSwapchain = oldSwapchain;
     VK_CHECK(vkCreateSwapchainKHR(device_, &createInfo, nullptr, &swapchain_));
     vkGetSwapchainImagesKHR(device_, swapchain_, &imageCount, nullptr);
     swapchain_images_.resize(imageCount);
     vkGetSwapchainImagesKHR(device_, swapchain_, &imageCount, swapchain_images_.data());
+    if (oldSwapchain != VK_NULL_HANDLE && surfaceFormat.format != swapchain_image_format_)
+        throw std::runtime_error("Swapchain format changed; pipelines would need rebuilding");
     swapchain_image_format_ = surfaceFormat.format;
     swapchain_extent_ = extent;
 }
 
+void VulkanApp::create_present_semaphores() {
+    VkSemaphoreCreateInfo semaphoreInfo{};
+    semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+    render_finished_semaphores_.resize(swapchain_images_.size());
+    for (auto& semaphore : render_finished_semaphores_)
+        VK_CHECK(vkCreateSemaphore(device_, &semaphoreInfo, nullptr, &semaphore));
+}
+
+bool VulkanApp::recreate_swapchain() {
+    SwapChainSupportDetails support = QuerySwapChainSupport(physical_device_, surface_);
+    VkExtent2D extent = ChooseSwapExtent(support.capabilities, window_width_, window_height_);
+    if (extent.width == 0 || extent.height == 0) return false; // minimized, try again next frame
+    // The old swapchain's presents may still be pending, so it is retired
+    // instead of waiting for the device to go idle; see RetiredSwapchain.
+    // Swapchains waiting on a present of the one being replaced wait for the
+    // next swapchain's instead, since that image may never be acquired again.
+    VkSwapchainKHR oldSwapchain = swapchain_;
+    for (auto& retired : retired_swapchains_)
+        retired.present_image = UINT32_MAX;
+    retired_swapchains_.push_back({oldSwapchain, std::move(swapchain_image_views_), std::move(render_finished_semaphores_)});
+    swapchain_image_views_.clear();
+    render_finished_semaphores_.clear();
+
+    create_swapchain(window_width_, window_height_, oldSwapchain);
+    create_image_views();
+    create_present_semaphores();
+    swapchain_dirty_ = false;
+    // LOD selection depends on the viewport height.
+    record_draw_commands();
+    return true;
+}
+
+void VulkanApp::release_retired_swapchains(uint32_t acquiredImage) {
+    // The acquire semaphore is signaled once the presentation engine is done
+    // with the image, and the frame about to be submitted waits on it, so the
+    // deletion queue may destroy the swapchain once that frame retires.
+    for (const auto& retired : retired_swapchains_) {
+        if (retired.present_image == acquiredImage)
+            deletion_queue_.destroy([device = device_, retired] { retired.destroy(device); });
+    }
+    std::erase_if(retired_swapchains_, [&](const RetiredSwapchain& retired) { return retired.present_image == acquiredImage; });
+}
+
+void VulkanApp::RetiredSwapchain::destroy(VkDevice device) const {
+    for (auto view : image_views)
+        vkDestroyImageView(device, view, nullptr);
+    for (auto semaphore : semaphores)
+        vkDestroySemaphore(device, semaphore, nullptr);
+    vkDestroySwapchainKHR(device, swapchain, nullptr);
+}
+
 void VulkanApp::create_image_views() {
     swapchain_image_views_.resize(swapchain_images_.size());
     for (size_t i = 0; i < swapchain_images_.size(); i++) {
@@ -511,50 +628,15 @@ void VulkanApp::create_image_views() {
     }
 }
 
-void VulkanApp::create_render_pass() {
-    VkAttachmentDescription colorAttachment{};
-    colorAttachment.format = swapchain_image_format_;
-    colorAttachment.samples = VK_SAMPLE_COUNT_1_BIT;
-    colorAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
-    colorAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
-    colorAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
-    colorAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
-    colorAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-    colorAttachment.finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
-
-    VkAttachmentReference colorAttachmentRef{};
-    colorAttachmentRef.attachment = 0;
-    colorAttachmentRef.layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
-
-    VkSubpassDescription subpass{};
-    subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
-    subpass.colorAttachmentCount = 1;
-    subpass.pColorAttachments = &colorAttachmentRef;
-
-    VkRenderPassCreateInfo renderPassInfo{};
-    renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
-    renderPassInfo.attachmentCount = 1;
-    renderPassInfo.pAttachments = &colorAttachment;
-    renderPassInfo.subpassCount = 1;
-    renderPassInfo.pSubpasses = &subpass;
-
-    VK_CHECK(vkCreateRenderPass(device_, &renderPassInfo, nullptr, &render_pass_));
-}
-
-void VulkanApp::create_framebuffers() {
-    swapchain_framebuffers_.resize(swapchain_image_views_.size());
-    for (size_t i = 0; i < swapchain_image_views_.size(); i++) {
-        VkImageView attachments[] = { swapchain_image_views_[i] };
-        VkFramebufferCreateInfo framebufferInfo{};
-        framebufferInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
-        framebufferInfo.renderPass = render_pass_;
-        framebufferInfo.attachmentCount = 1;
-        framebufferInfo.pAttachments = attachments;
-        framebufferInfo.width = swapchain_extent_.width;
-        framebufferInfo.height = swapchain_extent_.height;
-        framebufferInfo.layers = 1;
-        VK_CHECK(vkCreateFramebuffer(device_, &framebufferInfo, nullptr, &swapchain_framebuffers_[i]));
+VkFormat VulkanApp::find_depth_format() const {
+    const VkFormat candidates[] = { VK_FORMAT_D32_SFLOAT, VK_FORMAT_D32_SFLOAT_S8_UINT, VK_FORMAT_D24_UNORM_S8_UINT };
+    for (VkFormat format : candidates) {
+        VkFormatProperties props;
+        vkGetPhysicalDeviceFormatProperties(physical_device_, format, &props);
+        if (props.optimalTilingFeatures & VK_FORMAT_FEATURE_DEPTH_STENCIL_ATTACHMENT_BIT)
+            return format;
     }
+    throw std::runtime_error("No supported depth format");
 }
 
 void VulkanApp::create_command_pool() {
@@ -567,96 +649,196 @@ void VulkanApp::create_command_pool() {
 }
 
 void VulkanApp::create_command_buffers() {
-    command_buffers_.resize(swapchain_framebuffers_.size());
+    command_buffers_.resize(frames_in_flight_);
     VkCommandBufferAllocateInfo allocInfo{};
     allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
     allocInfo.commandPool = command_pool_;
     allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
     allocInfo.commandBufferCount = (uint32_t)command_buffers_.size();
     VK_CHECK(vkAllocateCommandBuffers(device_, &allocInfo, command_buffers_.data()));
-    for (size_t i = 0; i < command_buffers_.size(); i++) {
-        VkCommandBufferBeginInfo beginInfo{};
-        beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
-        VK_CHECK(vkBeginCommandBuffer(command_buffers_[i], &beginInfo));
-        VkRenderPassBeginInfo renderPassInfo{};
-        renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
-        renderPassInfo.renderPass = render_pass_;
-        renderPassInfo.framebuffer = swapchain_framebuffers_[i];
-        renderPassInfo.renderArea.offset = { 0, 0 };
-        renderPassInfo.renderArea.extent = swapchain_extent_;
-        VkClearValue clearColor = { {0.1f, 0.2f, 0.3f, 1.0f} };
-        renderPassInfo.clearValueCount = 1;
-        renderPassInfo.pClearValues = &clearColor;
-        vkCmdBeginRenderPass(command_buffers_[i], &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
-        vkCmdBindPipeline(command_buffers_[i], VK_PIPELINE_BIND_POINT_GRAPHICS, graphics_pipeline_);
-        vkCmdBindDescriptorSets(command_buffers_[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline_layout_, 0, 1, &descriptor_set_, 0, nullptr);
-        // Only draw quad if buffer is valid
-        if (vertex_buffer_ != VK_NULL_HANDLE && !quad_vertices_.empty()) {
-            VkBuffer vertexBuffers[] = { vertex_buffer_ };
-            VkDeviceSize offsets[] = { 0 };
-            vkCmdBindVertexBuffers(command_buffers_[i], 0, 1, vertexBuffers, offsets);
-            vkCmdDraw(command_buffers_[i], static_cast<uint32_t>(quad_vertices_.size()), 1, 0, 0);
-        }
-        // Render the scene (meshes) inside the render pass
-        if (scene_) {
-            scene_->render(command_buffers_[i]);
-        }
-        vkCmdEndRenderPass(command_buffers_[i]);
-        VK_CHECK(vkEndCommandBuffer(command_buffers_[i]));
-    }
 }
 
 void VulkanApp::create_sync_objects() {
-    image_available_semaphores_.resize(max_frames_in_flight_);
-    render_finished_semaphores_.resize(max_frames_in_flight_);
-    in_flight_fences_.resize(max_frames_in_flight_);
+    image_available_semaphores_.resize(frames_in_flight_);
+    in_flight_fences_.resize(frames_in_flight_);
+    frame_serials_.assign(frames_in_flight_, 0);
+    frame_input_times_.assign(frames_in_flight_, {});
     VkSemaphoreCreateInfo semaphoreInfo{};
     semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
     VkFenceCreateInfo fenceInfo{};
     fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
     fenceInfo.flags = VK_FENCE_CREATE_SIGNALED_BIT;
-    for (size_t i = 0; i < max_frames_in_flight_; i++) {
+    for (size_t i = 0; i < frames_in_flight_; i++) {
         VK_CHECK(vkCreateSemaphore(device_, &semaphoreInfo, nullptr, &image_available_semaphores_[i]));
-        VK_CHECK(vkCreateSemaphore(device_, &semaphoreInfo, nullptr, &render_finished_semaphores_[i]));
         VK_CHECK(vkCreateFence(device_, &fenceInfo, nullptr, &in_flight_fences_[i]));
     }
 }
 
+void VulkanApp::destroy_frame_resources() {
+    for (auto semaphore : image_available_semaphores_)
+        vkDestroySemaphore(device_, semaphore, nullptr);
+    for (auto fence : in_flight_fences_)
+        vkDestroyFence(device_, fence, nullptr);
+    if (!command_buffers_.empty())
+        vkFreeCommandBuffers(device_, command_pool_, static_cast<uint32_t>(command_buffers_.size()), command_buffers_.data());
+    image_available_semaphores_.clear();
+    in_flight_fences_.clear();
+    command_buffers_.clear();
+    frame_serials_.clear();
+    frame_input_times_.clear();
+}
+
+void VulkanApp::set_frames_in_flight(uint32_t count) {
+    count = std::clamp(count, 1u, max_frames_in_flight);
+    if (count == frames_in_flight_) return;
+    // Waits for the frames in flight only, not for the whole device.
+    VK_CHECK(vkWaitForFences(device_, static_cast<uint32_t>(in_flight_fences_.size()), in_flight_fences_.data(), VK_TRUE, UINT64_MAX));
+    completed_serial_ = submit_serial_;
+    deletion_queue_.collect(completed_serial_);
+    profiler_.destroy();
+    destroy_frame_resources();
+    frames_in_flight_ = count;
+    current_frame_ = 0;
+    create_command_buffers();
+    create_sync_objects();
+    init_profiler();
+}
+
+void VulkanApp::set_present_policy(PresentPolicy policy) {
+    if (policy == present_policy_) return;
+    present_policy_ = policy;
+    swapchain_dirty_ = true;
+}
+
+void VulkanApp::on_window_resized(uint32_t width, uint32_t height) {
+    window_width_ = width;
+    window_height_ = height;
+    swapchain_dirty_ = true;
+}
+
 void VulkanApp::draw_frame() {
-    vkWaitForFences(device_, 1, &in_flight_fences_[current_frame_], VK_TRUE, UINT64_MAX);
+    if (present_policy_ == PresentPolicy::paced) {
+        // Start frames on a fixed cadence instead of as early as the fences
+        // allow, so input is sampled close to when the frame is displayed.
+        auto now = std::chrono::steady_clock::now();
+        if (now < next_frame_time_) {
+            std::this_thread::sleep_until(next_frame_time_);
+            now = next_frame_time_;
+        }
+        bool late = now - next_frame_time_ > pacing_interval_;
+        next_frame_time_ = (late ? now : next_frame_time_) + pacing_interval_;
+    }
+#if ENGINE_PROFILER
+    profiler_.begin_frame();
+#endif
+    PROFILE_CPU_SCOPE(profiler_, "frame");
+    frame_arena_.reset();
+    {
+        PROFILE_CPU_SCOPE(profiler_, "wait_fence");
+        vkWaitForFences(device_, 1, &in_flight_fences_[current_frame_], VK_TRUE, UINT64_MAX);
+    }
+    completed_serial_ = std::max(completed_serial_, frame_serials_[current_frame_]);
+    deletion_queue_.collect(completed_serial_);
+    view_atlas_.retire(completed_serial_);
+    measure_latency();
+#if ENGINE_PROFILER
+    profiler_.on_frame_retired(static_cast<uint32_t>(current_frame_));
+#endif
+    if (swapchain_dirty_ && !recreate_swapchain()) return;
     uint32_t imageIndex;
-    VkResult result = vkAcquireNextImageKHR(device_, swapchain_, UINT64_MAX, image_available_semaphores_[current_frame_], VK_NULL_HANDLE, &imageIndex);
-    if (result == VK_ERROR_OUT_OF_DATE_KHR) return; // No resize support yet
+    VkResult result;
+    {
+        PROFILE_CPU_SCOPE(profiler_, "acquire");
+        result = vkAcquireNextImageKHR(device_, swapchain_, UINT64_MAX, image_available_semaphores_[current_frame_], VK_NULL_HANDLE, &imageIndex);
+    }
+    if (result == VK_ERROR_OUT_OF_DATE_KHR) {
+        // The semaphore was not signaled and the fence is untouched, so the
+        // frame slot can simply be reused after the rebuild.
+        swapchain_dirty_ = true;
+        return;
+    }
     if (result != VK_SUCCESS && result != VK_SUBOPTIMAL_KHR) throw std::runtime_error("Failed to acquire swapchain image!");
-    VkSubmitInfo submitInfo{};
-    submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
-    VkSemaphore waitSemaphores[] = { image_available_semaphores_[current_frame_] };
-    VkPipelineStageFlags waitStages[] = { VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT };
-    submitInfo.waitSemaphoreCount = 1;
-    submitInfo.pWaitSemaphores = waitSemaphores;
-    submitInfo.pWaitDstStageMask = waitStages;
-    submitInfo.commandBufferCount = 1;
-    submitInfo.pCommandBuffers = &command_buffers_[imageIndex];
-    VkSemaphore signalSemaphores[] = { render_finished_semaphores_[current_frame_] };
-    submitInfo.signalSemaphoreCount = 1;
-    submitInfo.pSignalSemaphores = signalSemaphores;
+    release_retired_swapchains(imageIndex);
+    {
+        PROFILE_CPU_SCOPE(profiler_, "record");
+        record_frame(command_buffers_[current_frame_], imageIndex);
+    }
+    // Only color output waits for the acquired image; the present semaphore
+    // is signaled once color output, which includes the transition to
+    // PRESENT_SRC, is done.
+    VkSemaphoreSubmitInfo waitInfo{};
+    waitInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_SUBMIT_INFO;
+    waitInfo.semaphore = image_available_semaphores_[current_frame_];
+    waitInfo.stageMask = VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT;
+    VkSemaphoreSubmitInfo signalInfo{};
+    signalInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_SUBMIT_INFO;
+    signalInfo.semaphore = render_finished_semaphores_[imageIndex];
+    signalInfo.stageMask = VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT;
+    VkCommandBufferSubmitInfo commandBufferInfo{};
+    commandBufferInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_SUBMIT_INFO;
+    commandBufferInfo.commandBuffer = command_buffers_[current_frame_];
+    VkSubmitInfo2 submitInfo{};
+    submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO_2;
+    submitInfo.waitSemaphoreInfoCount = 1;
+    submitInfo.pWaitSemaphoreInfos = &waitInfo;
+    submitInfo.commandBufferInfoCount = 1;
+    submitInfo.pCommandBufferInfos = &commandBufferInfo;
+    submitInfo.signalSemaphoreInfoCount = 1;
+    submitInfo.pSignalSemaphoreInfos = &signalInfo;
     vkResetFences(device_, 1, &in_flight_fences_[current_frame_]);
-    VK_CHECK(vkQueueSubmit(graphics_queue_, 1, &submitInfo, in_flight_fences_[current_frame_]));
+    {
+        PROFILE_CPU_SCOPE(profiler_, "submit");
+        VK_CHECK(vkQueueSubmit2(graphics_queue_, 1, &submitInfo, in_flight_fences_[current_frame_]));
+    }
+    frame_serials_[current_frame_] = ++submit_serial_;
+    frame_input_times_[current_frame_] = next_input_time_;
+    next_input_time_ = {};
+    // Releases from here on may still be drawn by the next frame.
+    deletion_queue_.set_serial(submit_serial_ + 1);
+#if ENGINE_PROFILER
+    profiler_.on_submit(static_cast<uint32_t>(current_frame_), static_cast<uint32_t>(current_frame_));
+#endif
     VkPresentInfoKHR presentInfo{};
     presentInfo.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
     presentInfo.waitSemaphoreCount = 1;
-    presentInfo.pWaitSemaphores = signalSemaphores;
+    presentInfo.pWaitSemaphores = &render_finished_semaphores_[imageIndex];
     presentInfo.swapchainCount = 1;
     presentInfo.pSwapchains = &swapchain_;
     presentInfo.pImageIndices = &imageIndex;
     presentInfo.pResults = nullptr;
-    result = vkQueuePresentKHR(present_queue_, &presentInfo);
+    {
+        PROFILE_CPU_SCOPE(profiler_, "present");
+        result = vkQueuePresentKHR(present_queue_, &presentInfo);
+    }
+    if (result == VK_SUCCESS || result == VK_SUBOPTIMAL_KHR) {
+        // Older swapchains are done once this present is.
+        for (auto& retired : retired_swapchains_) {
+            if (retired.present_image == UINT32_MAX) retired.present_image = imageIndex;
+        }
+    }
     if (result == VK_ERROR_OUT_OF_DATE_KHR || result == VK_SUBOPTIMAL_KHR) {
-        // No resize support yet
+        swapchain_dirty_ = true;
     } else if (result != VK_SUCCESS) {
         throw std::runtime_error("Failed to present swapchain image!");
     }
-    current_frame_ = (current_frame_ + 1) % max_frames_in_flight_;
+    current_frame_ = (current_frame_ + 1) % frames_in_flight_;
+}
+
+void VulkanApp::measure_latency() {
+    // The current slot's fence was just waited on; the others are polled, so
+    // a frame is measured at the first draw_frame() after it completes.
+    // Slots are visited oldest submission first.
+    const auto now = std::chrono::steady_clock::now();
+    for (size_t k = 0; k < frame_input_times_.size(); ++k) {
+        size_t i = (current_frame_ + k) % frame_input_times_.size();
+        if (frame_input_times_[i] == std::chrono::steady_clock::time_point{}) continue;
+        if (i != current_frame_ && vkGetFenceStatus(device_, in_flight_fences_[i]) != VK_SUCCESS) continue;
+        latency_.last_ms = std::chrono::duration<float, std::milli>(now - frame_input_times_[i]).count();
+        latency_.average_ms = latency_.frames == 0 ? latency_.last_ms
+                                                   : latency_.average_ms + (latency_.last_ms - latency_.average_ms) / 32.0f;
+        ++latency_.frames;
+        frame_input_times_[i] = {};
+    }
 }
 
 void VulkanApp::wait_device_idle() {
@@ -678,6 +860,13 @@ void VulkanApp::create_graphics_pipeline() {
     fragCreateInfo.pCode = reinterpret_cast<const uint32_t*>(fragShaderCode.data());
     VkShaderModule fragShaderModule;
     VK_CHECK(vkCreateShaderModule(device_, &fragCreateInfo, nullptr, &fragShaderModule));
+    auto depthVertShaderCode = ReadFile("assets/depth_prepass.vert.spv");
+    VkShaderModuleCreateInfo depthVertCreateInfo{};
+    depthVertCreateInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+    depthVertCreateInfo.codeSize = depthVertShaderCode.size();
+    depthVertCreateInfo.pCode = reinterpret_cast<const uint32_t*>(depthVertShaderCode.data());
+    VkShaderModule depthVertShaderModule;
+    VK_CHECK(vkCreateShaderModule(device_, &depthVertCreateInfo, nullptr, &depthVertShaderModule));
     VkPipelineShaderStageCreateInfo vertShaderStageInfo{};
     vertShaderStageInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
     vertShaderStageInfo.stage = VK_SHADER_STAGE_VERTEX_BIT;
@@ -695,7 +884,7 @@ void VulkanApp::create_graphics_pipeline() {
     bindingDesc.stride = sizeof(Vertex);
     bindingDesc.inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
     std::array<VkVertexInputAttributeDescription, 3> attrDescs{};
-    attrDescs[0].binding = 0; attrDescs[0].location = 0; attrDescs[0].format = VK_FORMAT_R32G32_SFLOAT; attrDescs[0].offset = offsetof(Vertex, pos);
+    attrDescs[0].binding = 0; attrDescs[0].location = 0; attrDescs[0].format = VK_FORMAT_R32G32B32_SFLOAT; attrDescs[0].offset = offsetof(Vertex, pos);
     attrDescs[1].binding = 0; attrDescs[1].location = 1; attrDescs[1].format = VK_FORMAT_R32G32B32_SFLOAT; attrDescs[1].offset = offsetof(Vertex, color);
     attrDescs[2].binding = 0; attrDescs[2].location = 2; attrDescs[2].format = VK_FORMAT_R32G32_SFLOAT; attrDescs[2].offset = offsetof(Vertex, uv);
     VkPipelineVertexInputStateCreateInfo vertexInputInfo{};
@@ -709,23 +898,16 @@ void VulkanApp::create_graphics_pipeline() {
     inputAssembly.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
     inputAssembly.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
     inputAssembly.primitiveRestartEnable = VK_FALSE;
-    // Viewport and scissor
-    VkViewport viewport{};
-    viewport.x = 0.0f;
-    viewport.y = 0.0f;
-    viewport.width = (float)swapchain_extent_.width;
-    viewport.height = (float)swapchain_extent_.height;
-    viewport.minDepth = 0.0f;
-    viewport.maxDepth = 1.0f;
-    VkRect2D scissor{};
-    scissor.offset = {0, 0};
-    scissor.extent = swapchain_extent_;
+    // Viewport and scissor are dynamic so pipelines survive swapchain resizes
     VkPipelineViewportStateCreateInfo viewportState{};
     viewportState.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
     viewportState.viewportCount = 1;
-    viewportState.pViewports = &viewport;
     viewportState.scissorCount = 1;
-    viewportState.pScissors = &scissor;
+    std::array<VkDynamicState, 2> dynamicStates = { VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR };
+    VkPipelineDynamicStateCreateInfo dynamicState{};
+    dynamicState.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
+    dynamicState.dynamicStateCount = static_cast<uint32_t>(dynamicStates.size());
+    dynamicState.pDynamicStates = dynamicStates.data();
     // Rasterizer
     VkPipelineRasterizationStateCreateInfo rasterizer{};
     rasterizer.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
@@ -750,15 +932,37 @@ void VulkanApp::create_graphics_pipeline() {
     colorBlending.logicOpEnable = VK_FALSE;
     colorBlending.attachmentCount = 1;
     colorBlending.pAttachments = &colorBlendAttachment;
+    // Depth: LESS with writes when the main pass resolves visibility itself
+    VkPipelineDepthStencilStateCreateInfo depthStencil{};
+    depthStencil.sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
+    depthStencil.depthTestEnable = VK_TRUE;
+    depthStencil.depthWriteEnable = VK_TRUE;
+    depthStencil.depthCompareOp = VK_COMPARE_OP_LESS;
+    depthStencil.depthBoundsTestEnable = VK_FALSE;
+    depthStencil.stencilTestEnable = VK_FALSE;
     // Pipeline layout
     VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
     pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
-    pipelineLayoutInfo.setLayoutCount = 1;
-    pipelineLayoutInfo.pSetLayouts = &descriptor_set_layout_;
+    // Set 0 holds the material, set 1 the light grid, set 2 the shadow cascades.
+    std::array<VkDescriptorSetLayout, 3> setLayouts = { descriptor_set_layout_, light_grid_.set_layout(), shadows_.set_layout() };
+    pipelineLayoutInfo.setLayoutCount = static_cast<uint32_t>(setLayouts.size());
+    pipelineLayoutInfo.pSetLayouts = setLayouts.data();
+    // Each draw's model matrix, pushed by the render queue.
+    VkPushConstantRange pushRange{};
+    pushRange.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+    pushRange.size = RenderQueue::model_push_size;
+    pipelineLayoutInfo.pushConstantRangeCount = 1;
+    pipelineLayoutInfo.pPushConstantRanges = &pushRange;
     VK_CHECK(vkCreatePipelineLayout(device_, &pipelineLayoutInfo, nullptr, &pipeline_layout_));
-    // Pipeline
+    // Pipeline, for dynamic rendering into the swapchain image and depth
+    VkPipelineRenderingCreateInfo renderingInfo{};
+    renderingInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_RENDERING_CREATE_INFO;
+    renderingInfo.colorAttachmentCount = 1;
+    renderingInfo.pColorAttachmentFormats = &swapchain_image_format_;
+    renderingInfo.depthAttachmentFormat = depth_format_;
     VkGraphicsPipelineCreateInfo pipelineInfo{};
     pipelineInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+    pipelineInfo.pNext = &renderingInfo;
     pipelineInfo.stageCount = 2;
     pipelineInfo.pStages = shaderStages;
     pipelineInfo.pVertexInputState = &vertexInputInfo;
@@ -767,67 +971,232 @@ void VulkanApp::create_graphics_pipeline() {
     pipelineInfo.pRasterizationState = &rasterizer;
     pipelineInfo.pMultisampleState = &multisampling;
     pipelineInfo.pColorBlendState = &colorBlending;
+    pipelineInfo.pDepthStencilState = &depthStencil;
+    pipelineInfo.pDynamicState = &dynamicState;
     pipelineInfo.layout = pipeline_layout_;
-    pipelineInfo.renderPass = render_pass_;
-    pipelineInfo.subpass = 0;
     pipelineInfo.basePipelineHandle = VK_NULL_HANDLE;
     VK_CHECK(vkCreateGraphicsPipelines(device_, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &graphics_pipeline_));
+    // Main pass variant after a depth pre-pass: only the front-most fragment
+    // passes, so the fragment shader runs once per pixel.
+    depthStencil.depthWriteEnable = VK_FALSE;
+    depthStencil.depthCompareOp = VK_COMPARE_OP_EQUAL;
+    VK_CHECK(vkCreateGraphicsPipelines(device_, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &graphics_pipeline_equal_));
+    // Depth-only pre-pass: position stream, no fragment shader, no color
+    VkVertexInputBindingDescription positionBindingDesc{};
+    positionBindingDesc.binding = 0;
+    positionBindingDesc.stride = sizeof(float) * 3;
+    positionBindingDesc.inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
+    VkVertexInputAttributeDescription positionAttrDesc{};
+    positionAttrDesc.binding = 0;
+    positionAttrDesc.location = 0;
+    positionAttrDesc.format = VK_FORMAT_R32G32B32_SFLOAT;
+    positionAttrDesc.offset = 0;
+    VkPipelineVertexInputStateCreateInfo positionInputInfo{};
+    positionInputInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
+    positionInputInfo.vertexBindingDescriptionCount = 1;
+    positionInputInfo.pVertexBindingDescriptions = &positionBindingDesc;
+    positionInputInfo.vertexAttributeDescriptionCount = 1;
+    positionInputInfo.pVertexAttributeDescriptions = &positionAttrDesc;
+    VkPipelineShaderStageCreateInfo depthVertShaderStageInfo = vertShaderStageInfo;
+    depthVertShaderStageInfo.module = depthVertShaderModule;
+    VkPipelineColorBlendStateCreateInfo noColorBlending{};
+    noColorBlending.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
+    noColorBlending.attachmentCount = 0;
+    depthStencil.depthWriteEnable = VK_TRUE;
+    depthStencil.depthCompareOp = VK_COMPARE_OP_LESS;
+    VkPipelineRenderingCreateInfo depthRenderingInfo{};
+    depthRenderingInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_RENDERING_CREATE_INFO;
+    depthRenderingInfo.depthAttachmentFormat = depth_format_;
+    VkGraphicsPipelineCreateInfo depthPipelineInfo = pipelineInfo;
+    depthPipelineInfo.pNext = &depthRenderingInfo;
+    depthPipelineInfo.stageCount = 1;
+    depthPipelineInfo.pStages = &depthVertShaderStageInfo;
+    depthPipelineInfo.pVertexInputState = &positionInputInfo;
+    depthPipelineInfo.pColorBlendState = &noColorBlending;
+    VK_CHECK(vkCreateGraphicsPipelines(device_, VK_NULL_HANDLE, 1, &depthPipelineInfo, nullptr, &depth_prepass_pipeline_));
     vkDestroyShaderModule(device_, vertShaderModule, nullptr);
     vkDestroyShaderModule(device_, fragShaderModule, nullptr);
+    vkDestroyShaderModule(device_, depthVertShaderModule, nullptr);
+}
+
+void VulkanApp::init_view_atlas(const ViewAtlasLayout& layout) {
+    if (view_atlas_.initialized()) {
+        vkDeviceWaitIdle(device_);
+        view_atlas_.destroy();
+    }
+    view_atlas_.init(device_, physical_device_, descriptor_set_layout_, depth_format_, layout);
 }
 
 void VulkanApp::draw_quad(float x, float y, float width, float height, const float color[3]) {
-    // NDC coordinates for a quad with UVs
-    float l = x;
-    float r = x + width;
-    float t = y;
-    float b = y + height;
-    quad_vertices_ = {
-        {{l, t}, {color[0], color[1], color[2]}, {0.0f, 0.0f}},
-        {{r, t}, {color[0], color[1], color[2]}, {1.0f, 0.0f}},
-        {{r, b}, {color[0], color[1], color[2]}, {1.0f, 1.0f}},
-        {{l, t}, {color[0], color[1], color[2]}, {0.0f, 0.0f}},
-        {{r, b}, {color[0], color[1], color[2]}, {1.0f, 1.0f}},
-        {{l, b}, {color[0], color[1], color[2]}, {0.0f, 1.0f}}
-    };
-    // Upload quad_vertices_ to vertex_buffer_
-    VkDeviceSize bufferSize = sizeof(Vertex) * quad_vertices_.size();
-    CreateBuffer(device_, physical_device_, bufferSize, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, vertex_buffer_, vertex_buffer_memory_);
-    void* data;
-    vkMapMemory(device_, vertex_buffer_memory_, 0, bufferSize, 0, &data);
-    memcpy(data, quad_vertices_.data(), (size_t)bufferSize);
-    vkUnmapMemory(device_, vertex_buffer_memory_);
+    sprites_.draw(x, y, width, height, debug_sprite_, SpriteBatch::pack_color(color[0], color[1], color[2]));
 }
 
 void VulkanApp::record_draw_commands() {
-    vkDeviceWaitIdle(device_); // Ensure all command buffers are idle before re-recording
-    for (size_t i = 0; i < command_buffers_.size(); i++) {
-        VkCommandBufferBeginInfo beginInfo{};
-        beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
-        VK_CHECK(vkBeginCommandBuffer(command_buffers_[i], &beginInfo));
-        VkRenderPassBeginInfo renderPassInfo{};
-        renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
-        renderPassInfo.renderPass = render_pass_;
-        renderPassInfo.framebuffer = swapchain_framebuffers_[i];
-        renderPassInfo.renderArea.offset = { 0, 0 };
-        renderPassInfo.renderArea.extent = swapchain_extent_;
-        VkClearValue clearColor = { {0.1f, 0.2f, 0.3f, 1.0f} };
-        renderPassInfo.clearValueCount = 1;
-        renderPassInfo.pClearValues = &clearColor;
-        vkCmdBeginRenderPass(command_buffers_[i], &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
-        vkCmdBindPipeline(command_buffers_[i], VK_PIPELINE_BIND_POINT_GRAPHICS, graphics_pipeline_);
-        vkCmdBindDescriptorSets(command_buffers_[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline_layout_, 0, 1, &descriptor_set_, 0, nullptr);
-        VkBuffer vertexBuffers[] = { vertex_buffer_ };
-        VkDeviceSize offsets[] = { 0 };
-        vkCmdBindVertexBuffers(command_buffers_[i], 0, 1, vertexBuffers, offsets);
-        vkCmdDraw(command_buffers_[i], static_cast<uint32_t>(quad_vertices_.size()), 1, 0, 0);
-        // Render the scene (meshes) inside the render pass
-        if (scene_) {
-            scene_->render(command_buffers_[i]);
-        }
-        vkCmdEndRenderPass(command_buffers_[i]);
-        VK_CHECK(vkEndCommandBuffer(command_buffers_[i]));
+    camera_dirty_ = false;
+    render_queue_.clear();
+    CullContext cull{};
+    cull.view_proj = camera_.get_view_projection_matrix();
+    if (lod_error_pixels_ > 0.0f) {
+        cull.lod_pixel_scale = 0.5f * static_cast<float>(swapchain_extent_.height) * glm::abs(camera_.get_projection_matrix()[1][1]);
+        cull.lod_error_pixels = lod_error_pixels_;
+    }
+    if (scene_) {
+        scene_->collect(render_queue_, cull, occlusion_culling_enabled_ ? &occlusion_culler_ : nullptr);
     }
+    render_queue_.sort(&frame_arena_);
+    frustum_culled_ = cull.frustum_culled;
+    occlusion_culled_ = cull.occlusion_culled;
+    LOG_DEBUG("VulkanApp: {} draws queued, culled {} by frustum, {} by occlusion",
+              render_queue_.size(), frustum_culled_, occlusion_culled_);
+}
+
+void VulkanApp::record_frame(VkCommandBuffer cmd, uint32_t imageIndex) {
+    const uint32_t slot = static_cast<uint32_t>(current_frame_);
+    if (camera_dirty_) record_draw_commands();
+    // The slot's previous frame has retired, so its MVP range is free to write.
+    const glm::mat4 mvp = camera_.get_view_projection_matrix();
+    memcpy(mvp_mapped_ + slot * mvp_stride_, &mvp, sizeof(mvp));
+    const VkDescriptorSet& materialSet = descriptor_sets_[slot];
+    RenderQueueBindings bindings{};
+    bindings.pipelines = depth_prepass_enabled_ ? &graphics_pipeline_equal_ : &graphics_pipeline_;
+    bindings.pipeline_count = 1;
+    bindings.descriptor_sets = &materialSet;
+    bindings.descriptor_set_count = 1;
+    bindings.pipeline_layout = pipeline_layout_;
+    bindings.meshes = &meshes_;
+    VkCommandBufferBeginInfo beginInfo{};
+    beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+    VK_CHECK(vkBeginCommandBuffer(cmd, &beginInfo));
+#if ENGINE_PROFILER
+    profiler_.begin_recording(cmd, slot);
+    profiler_.begin_statistics(cmd, slot);
+#endif
+    PROFILE_GPU_BEGIN(profiler_, cmd, slot, "frame");
+    {
+        PROFILE_CPU_SCOPE(profiler_, "light_grid");
+        light_grid_.update(camera_, swapchain_extent_, slot, &frame_arena_);
+    }
+    {
+        PROFILE_CPU_SCOPE(profiler_, "shadows");
+        shadows_.update(camera_, scene_, slot, &frame_arena_);
+    }
+    VkDescriptorSet lightSet = light_grid_.descriptor_set(slot);
+    VkDescriptorSet shadowSet = shadows_.descriptor_set(slot);
+    render_graph_.begin_frame(frame_arena_);
+    RenderGraph::Resource shadowMap = shadows_.add_passes(render_graph_, meshes_);
+    {
+        PROFILE_CPU_SCOPE(profiler_, "view_atlas");
+        view_atlas_.collect(scene_, &frame_arena_);
+    }
+    // Submitted right after recording, as the next serial.
+    view_atlas_.add_passes(render_graph_, meshes_, &materialSet, 1, submit_serial_ + 1);
+    // The acquire semaphore is waited on at color output, so the backbuffer
+    // transition must not start earlier. It is cleared, which lets its old
+    // contents be discarded.
+    RenderGraph::Resource backbuffer = render_graph_.import_image("backbuffer", swapchain_images_[imageIndex],
+        swapchain_image_views_[imageIndex], VK_IMAGE_ASPECT_COLOR_BIT,
+        { VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT, VK_ACCESS_2_NONE, VK_IMAGE_LAYOUT_UNDEFINED });
+    render_graph_.export_image(backbuffer, ImageAccess::present());
+    TransientImageDesc depthDesc{};
+    depthDesc.width = swapchain_extent_.width;
+    depthDesc.height = swapchain_extent_.height;
+    depthDesc.format = depth_format_;
+    depthDesc.usage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT;
+    depthDesc.aspect = depth_format_ == VK_FORMAT_D32_SFLOAT
+        ? VK_IMAGE_ASPECT_DEPTH_BIT : VK_IMAGE_ASPECT_DEPTH_BIT | VK_IMAGE_ASPECT_STENCIL_BIT;
+    RenderGraph::Resource depth = render_graph_.create_image("depth", depthDesc);
+
+    VkRect2D renderArea{};
+    renderArea.extent = swapchain_extent_;
+    VkViewport viewport{};
+    viewport.width = static_cast<float>(swapchain_extent_.width);
+    viewport.height = static_cast<float>(swapchain_extent_.height);
+    viewport.minDepth = 0.0f;
+    viewport.maxDepth = 1.0f;
+    RenderStats& stats = render_stats_;
+    stats = {};
+    if (depth_prepass_enabled_) {
+        RenderGraph::Pass prepass = render_graph_.add_pass("depth_prepass", [&](VkCommandBuffer cmd) {
+            VkRenderingAttachmentInfo depthAttachment{};
+            depthAttachment.sType = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO;
+            depthAttachment.imageView = render_graph_.view(depth);
+            depthAttachment.imageLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+            depthAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+            depthAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+            depthAttachment.clearValue.depthStencil = { 1.0f, 0 };
+            VkRenderingInfo renderingInfo{};
+            renderingInfo.sType = VK_STRUCTURE_TYPE_RENDERING_INFO;
+            renderingInfo.renderArea = renderArea;
+            renderingInfo.layerCount = 1;
+            renderingInfo.pDepthAttachment = &depthAttachment;
+            PROFILE_GPU_BEGIN(profiler_, cmd, slot, "depth_prepass");
+            vkCmdBeginRendering(cmd, &renderingInfo);
+            vkCmdSetViewport(cmd, 0, 1, &viewport);
+            vkCmdSetScissor(cmd, 0, 1, &renderArea);
+            vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline_layout_, 0, 1, &materialSet, 0, nullptr);
+            render_queue_.record_depth(cmd, depth_prepass_pipeline_, pipeline_layout_, meshes_, stats);
+            vkCmdEndRendering(cmd);
+            PROFILE_GPU_END(profiler_, cmd, slot);
+        });
+        render_graph_.write(prepass, depth, ImageAccess::depth_attachment());
+    }
+    RenderGraph::Pass mainPass = render_graph_.add_pass("main_pass", [&](VkCommandBuffer cmd) {
+        VkRenderingAttachmentInfo colorAttachment{};
+        colorAttachment.sType = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO;
+        colorAttachment.imageView = render_graph_.view(backbuffer);
+        colorAttachment.imageLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+        colorAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+        colorAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+        colorAttachment.clearValue.color = { {0.1f, 0.2f, 0.3f, 1.0f} };
+        // Depth is only needed within the frame, so it is never stored.
+        VkRenderingAttachmentInfo depthAttachment{};
+        depthAttachment.sType = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO;
+        depthAttachment.imageView = render_graph_.view(depth);
+        depthAttachment.imageLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+        depthAttachment.loadOp = depth_prepass_enabled_ ? VK_ATTACHMENT_LOAD_OP_LOAD : VK_ATTACHMENT_LOAD_OP_CLEAR;
+        depthAttachment.storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+        depthAttachment.clearValue.depthStencil = { 1.0f, 0 };
+        VkRenderingInfo renderingInfo{};
+        renderingInfo.sType = VK_STRUCTURE_TYPE_RENDERING_INFO;
+        renderingInfo.renderArea = renderArea;
+        renderingInfo.layerCount = 1;
+        renderingInfo.colorAttachmentCount = 1;
+        renderingInfo.pColorAttachments = &colorAttachment;
+        renderingInfo.pDepthAttachment = &depthAttachment;
+        vkCmdBeginRendering(cmd, &renderingInfo);
+        vkCmdSetViewport(cmd, 0, 1, &viewport);
+        vkCmdSetScissor(cmd, 0, 1, &renderArea);
+        vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline_layout_, 0, 1, &materialSet, 0, nullptr);
+        vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline_layout_, 1, 1, &lightSet, 0, nullptr);
+        vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline_layout_, 2, 1, &shadowSet, 0, nullptr);
+        PROFILE_GPU_BEGIN(profiler_, cmd, slot, "main_pass");
+        // Render the scene (meshes), sorted by state
+        render_queue_.record(cmd, bindings, stats);
+        stats.frustum_culled = frustum_culled_;
+        stats.occlusion_culled = occlusion_culled_;
+        PROFILE_GPU_END(profiler_, cmd, slot);
+        // Overlays go on top of the finished scene.
+        PROFILE_GPU_BEGIN(profiler_, cmd, slot, "sprites");
+        sprites_.record(cmd, slot, swapchain_extent_);
+        PROFILE_GPU_END(profiler_, cmd, slot);
+        stats.draws += sprites_.stats().draws;
+        stats.descriptor_binds += sprites_.stats().texture_binds;
+        stats.pipeline_binds += sprites_.stats().draws > 0 ? 1 : 0;
+        stats.vertex_buffer_binds += sprites_.stats().draws > 0 ? 1 : 0;
+        vkCmdEndRendering(cmd);
+    });
+    render_graph_.write(mainPass, backbuffer, ImageAccess::color_attachment());
+    if (depth_prepass_enabled_) render_graph_.read(mainPass, depth, ImageAccess::depth_attachment());
+    render_graph_.write(mainPass, depth, ImageAccess::depth_attachment());
+    render_graph_.read(mainPass, shadowMap, ImageAccess::fragment_sampled());
+    render_graph_.compile();
+    render_graph_.execute(cmd);
+    PROFILE_GPU_END(profiler_, cmd, slot);
+#if ENGINE_PROFILER
+    profiler_.end_statistics(cmd, slot);
+#endif
+    VK_CHECK(vkEndCommandBuffer(cmd));
 }
 
 void VulkanApp::create_descriptor_set_layout() {
@@ -860,18 +1229,18 @@ void VulkanApp::create_texture_image() {
     if (!pixels) throw std::runtime_error("Failed to load texture image!");
     VkBuffer stagingBuffer;
     VkDeviceMemory stagingBufferMemory;
-    CreateBuffer(device_, physical_device_, imageSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, stagingBuffer, stagingBufferMemory);
+    CreateBuffer(device_, physical_device_, imageSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, GpuMemoryCategory::staging, stagingBuffer, stagingBufferMemory);
     void* data;
     vkMapMemory(device_, stagingBufferMemory, 0, imageSize, 0, &data);
     memcpy(data, pixels, static_cast<size_t>(imageSize));
     vkUnmapMemory(device_, stagingBufferMemory);
     stbi_image_free(pixels);
-    CreateImage(device_, physical_device_, texWidth, texHeight, VK_FORMAT_R8G8B8A8_SRGB, VK_IMAGE_TILING_OPTIMAL, VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, texture_image_, texture_image_memory_);
+    CreateImage(device_, physical_device_, texWidth, texHeight, VK_FORMAT_R8G8B8A8_SRGB, VK_IMAGE_TILING_OPTIMAL, VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, GpuMemoryCategory::texture, texture_image_, texture_image_memory_);
     TransitionImageLayout(device_, command_pool_, graphics_queue_, texture_image_, VK_FORMAT_R8G8B8A8_SRGB, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
     CopyBufferToImage(device_, command_pool_, graphics_queue_, stagingBuffer, texture_image_, texWidth, texHeight);
     TransitionImageLayout(device_, command_pool_, graphics_queue_, texture_image_, VK_FORMAT_R8G8B8A8_SRGB, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
     vkDestroyBuffer(device_, stagingBuffer, nullptr);
-    vkFreeMemory(device_, stagingBufferMemory, nullptr);
+    GpuMemory::shared().free(device_, stagingBufferMemory);
 }
 
 void VulkanApp::create_texture_image_view() {
@@ -907,67 +1276,88 @@ void VulkanApp::create_texture_sampler() {
 }
 
 void VulkanApp::create_descriptor_pool() {
-    VkDescriptorPoolSize poolSize{};
-    poolSize.type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-    poolSize.descriptorCount = 1;
+    // One material set per frame slot: the texture and the slot's MVP range.
+    std::array<VkDescriptorPoolSize, 2> poolSizes{};
+    poolSizes[0].type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    poolSizes[0].descriptorCount = max_frames_in_flight;
+    poolSizes[1].type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+    poolSizes[1].descriptorCount = max_frames_in_flight;
     VkDescriptorPoolCreateInfo poolInfo{};
     poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
-    poolInfo.poolSizeCount = 1;
-    poolInfo.pPoolSizes = &poolSize;
-    poolInfo.maxSets = 1;
+    poolInfo.poolSizeCount = static_cast<uint32_t>(poolSizes.size());
+    poolInfo.pPoolSizes = poolSizes.data();
+    poolInfo.maxSets = max_frames_in_flight;
     VK_CHECK(vkCreateDescriptorPool(device_, &poolInfo, nullptr, &descriptor_pool_));
 }
 
 void VulkanApp::create_descriptor_set() {
+    std::array<VkDescriptorSetLayout, max_frames_in_flight> layouts;
+    layouts.fill(descriptor_set_layout_);
     VkDescriptorSetAllocateInfo allocInfo{};
     allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
     allocInfo.descriptorPool = descriptor_pool_;
-    allocInfo.descriptorSetCount = 1;
-    allocInfo.pSetLayouts = &descriptor_set_layout_;
-    VK_CHECK(vkAllocateDescriptorSets(device_, &allocInfo, &descriptor_set_));
+    allocInfo.descriptorSetCount = max_frames_in_flight;
+    allocInfo.pSetLayouts = layouts.data();
+    VK_CHECK(vkAllocateDescriptorSets(device_, &allocInfo, descriptor_sets_.data()));
     VkDescriptorImageInfo imageInfo{};
     imageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
     imageInfo.imageView = texture_image_view_;
     imageInfo.sampler = texture_sampler_;
-    VkWriteDescriptorSet imageWrite{};
-    imageWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-    imageWrite.dstSet = descriptor_set_;
-    imageWrite.dstBinding = 0;
-    imageWrite.dstArrayElement = 0;
-    imageWrite.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-    imageWrite.descriptorCount = 1;
-    imageWrite.pImageInfo = &imageInfo;
-    // MVP buffer
-    VkDescriptorBufferInfo mvpBufferInfo{};
-    mvpBufferInfo.buffer = mvp_buffer_;
-    mvpBufferInfo.offset = 0;
-    mvpBufferInfo.range = sizeof(glm::mat4);
-    VkWriteDescriptorSet mvpWrite{};
-    mvpWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-    mvpWrite.dstSet = descriptor_set_;
-    mvpWrite.dstBinding = 1;
-    mvpWrite.dstArrayElement = 0;
-    mvpWrite.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-    mvpWrite.descriptorCount = 1;
-    mvpWrite.pBufferInfo = &mvpBufferInfo;
-    std::array<VkWriteDescriptorSet, 2> writes = {imageWrite, mvpWrite};
-    vkUpdateDescriptorSets(device_, static_cast<uint32_t>(writes.size()), writes.data(), 0, nullptr);
+    for (uint32_t slot = 0; slot < max_frames_in_flight; ++slot) {
+        VkWriteDescriptorSet imageWrite{};
+        imageWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        imageWrite.dstSet = descriptor_sets_[slot];
+        imageWrite.dstBinding = 0;
+        imageWrite.dstArrayElement = 0;
+        imageWrite.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+        imageWrite.descriptorCount = 1;
+        imageWrite.pImageInfo = &imageInfo;
+        // The slot's MVP range
+        VkDescriptorBufferInfo mvpBufferInfo{};
+        mvpBufferInfo.buffer = mvp_buffer_;
+        mvpBufferInfo.offset = slot * mvp_stride_;
+        mvpBufferInfo.range = sizeof(glm::mat4);
+        VkWriteDescriptorSet mvpWrite{};
+        mvpWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        mvpWrite.dstSet = descriptor_sets_[slot];
+        mvpWrite.dstBinding = 1;
+        mvpWrite.dstArrayElement = 0;
+        mvpWrite.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+        mvpWrite.descriptorCount = 1;
+        mvpWrite.pBufferInfo = &mvpBufferInfo;
+        std::array<VkWriteDescriptorSet, 2> writes = {imageWrite, mvpWrite};
+        vkUpdateDescriptorSets(device_, static_cast<uint32_t>(writes.size()), writes.data(), 0, nullptr);
+    }
 }
 
 void VulkanApp::set_camera(const Camera& camera) {
     camera_ = camera;
-    // Update MVP buffer with new matrix
-    glm::mat4 mvp = camera_.get_view_projection_matrix();
-    void* data;
-    vkMapMemory(device_, mvp_buffer_memory_, 0, sizeof(glm::mat4), 0, &data);
-    memcpy(data, &mvp, sizeof(glm::mat4));
-    vkUnmapMemory(device_, mvp_buffer_memory_);
-    // Re-record command buffers only when camera changes
+    // Frames in flight still read their own MVP ranges; the next recorded
+    // slot gets the new matrix, and the draw list is culled once for it.
+    camera_dirty_ = true;
+}
+
+void VulkanApp::set_depth_prepass(bool enabled) {
+    if (depth_prepass_enabled_ == enabled) return;
+    depth_prepass_enabled_ = enabled;
+    record_draw_commands();
+}
+
+void VulkanApp::set_occlusion_culling(bool enabled) {
+    if (occlusion_culling_enabled_ == enabled) return;
+    occlusion_culling_enabled_ = enabled;
+    record_draw_commands();
+}
+
+void VulkanApp::set_lod_error_pixels(float pixels) {
+    if (lod_error_pixels_ == pixels) return;
+    lod_error_pixels_ = pixels;
     record_draw_commands();
 }
 
 void VulkanApp::set_scene(Scene* scene) {
     scene_ = scene;
+    shadows_.invalidate_static();
     // Re-record command buffers only when scene changes
     record_draw_commands();
 }
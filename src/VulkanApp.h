@@ -1,45 +1,142 @@
 #pragma once
 
 #include <vulkan/vulkan.h>
-#include <windows.h>
+#include <array>
+#include <cstddef>
 #include <vector>
 #include <memory>
 #include "Camera.h"
 #include <string>
 #include "Mesh.h"
 #include "Scene.h"
+#include "RenderQueue.h"
+#include "RenderGraph.h"
+#include "DeletionQueue.h"
+#include "FrameArena.h"
+#include "LightGrid.h"
+#include "OcclusionCuller.h"
+#include "Profiler.h"
+#include "ShadowCascades.h"
+#include "SpriteBatch.h"
+#include "ViewAtlas.h"
+#include "Window.h"
+#include <chrono>
+
+// How finished frames are handed to the display. Modes the surface does not
+// support fall back toward FIFO, which is always available.
+enum class PresentPolicy {
+    fifo,       // vsync; the CPU may run frames_in_flight frames ahead
+    mailbox,    // vsync; a newer frame replaces the queued one, no blocking
+    immediate,  // no vsync, may tear; lowest latency
+    paced,      // FIFO plus CPU-side pacing so frames start just once per interval
+};
+
+// Input-to-photon latency of frames tagged with set_frame_input_time(): from
+// the input sample until the CPU sees the frame's GPU work complete. Scan-out
+// is not included, and completion is noticed at the next draw_frame() at the
+// latest.
+struct FrameLatencyStats {
+    float last_ms = 0.0f;
+    // Exponential average over roughly the last 32 frames.
+    float average_ms = 0.0f;
+    uint64_t frames = 0;
+};
 
 class VulkanApp {
 public:
-    VulkanApp(HINSTANCE hInstance, HWND hwnd, uint32_t width, uint32_t height);
+    // The window must outlive the app; only its surface is kept.
+    explicit VulkanApp(const Window& window);
     ~VulkanApp();
     void draw_frame();
     void wait_device_idle();
-    // Draw API
+    // Swapchain and latency control. Changes take effect at the next frame;
+    // the swapchain is rebuilt through oldSwapchain without idling the device.
+    void on_window_resized(uint32_t width, uint32_t height);
+    void set_present_policy(PresentPolicy policy);
+    PresentPolicy present_policy() const { return present_policy_; }
+    void set_pacing_interval(std::chrono::microseconds interval) { pacing_interval_ = interval; }
+    // 1..max_frames_in_flight. Waits only for the frames currently in flight.
+    void set_frames_in_flight(uint32_t count);
+    uint32_t frames_in_flight() const { return frames_in_flight_; }
+    // When the state the next draw_frame() shows sampled input.
+    void set_frame_input_time(std::chrono::steady_clock::time_point time) { next_input_time_ = time; }
+    const FrameLatencyStats& latency() const { return latency_; }
+    // Serial of the last submitted frame and of the newest one known to have
+    // retired; resources last used by frame N may be freed once N has retired.
+    uint64_t submit_serial() const { return submit_serial_; }
+    uint64_t completed_serial() const { return completed_serial_; }
+    // Destroys released GPU objects once the frames that may use them retire,
+    // so meshes and other resources can be dropped mid-frame without a stall.
+    DeletionQueue& deletion_queue() { return deletion_queue_; }
+    // GPU meshes, referenced by scenes through MeshHandle. Create them with
+    // &deletion_queue() so removing one never waits on the GPU.
+    MeshPool& meshes() { return meshes_; }
+    // Scratch memory for the frame being recorded, reset at the start of each
+    // draw_frame(). Usable from the main thread between frames too.
+    FrameArena& frame_arena() { return frame_arena_; }
+    static constexpr uint32_t max_frames_in_flight = 4;
+    // Draw API. Immediate mode: 2D quads are queued for the next draw_frame()
+    // only. x, y, width and height are pixels from the top-left corner; the
+    // quad shows the debug texture tinted by color.
     void draw_quad(float x, float y, float width, float height, const float color[3]);
+    // Batched overlay quads with custom textures, atlases and layers.
+    SpriteBatch& sprites() { return sprites_; }
+    // Dynamic point lights, binned into a clustered grid every frame.
+    LightGrid& lights() { return light_grid_; }
+    // Sun light and its cascaded shadow maps.
+    ShadowCascades& shadows() { return shadows_; }
+    // Offscreen tiles showing the scene from many cameras, rendered in the
+    // same submission as the frame. Allocates the atlas; calling it again
+    // idles the device and replaces it.
+    void init_view_atlas(const ViewAtlasLayout& layout);
+    ViewAtlas& view_atlas() { return view_atlas_; }
     // Draws a mesh from vertices and indices
     // void draw_mesh(const std::vector<Vertex>& vertices, const std::vector<uint32_t>& indices);
+    // Takes effect at the next draw_frame(), which re-culls the scene once
+    // for the new view however often the camera changed in between.
     void set_camera(const Camera& camera);
     void set_scene(Scene* scene);
+    // Lays down depth with a position-only pass first, then shades with an
+    // EQUAL depth test so each pixel runs the fragment shader once.
+    void set_depth_prepass(bool enabled);
+    bool depth_prepass() const { return depth_prepass_enabled_; }
+    // Rasterizes SceneNode occluders on the CPU and skips draws hidden behind them.
+    void set_occlusion_culling(bool enabled);
+    // Meshes with LOD chains draw the coarsest level whose simplification
+    // error projects below this many pixels. Zero always draws LOD 0.
+    void set_lod_error_pixels(float pixels);
+    // CPU/GPU frame timeline; inert unless built with ENGINE_ENABLE_PROFILER.
+    Profiler& profiler() { return profiler_; }
+    // Rebuilds the culled, sorted draw list. Command buffers are recorded from
+    // it every frame, so this never waits on the GPU.
     void record_draw_commands();
     VkDevice device() const { return device_; }
     VkPhysicalDevice physical_device() const { return physical_device_; }
     VkCommandBuffer current_command_buffer() const { return command_buffers_[current_frame_]; }
+    // Bind/draw counters from the last recorded frame.
+    const RenderStats& render_stats() const { return render_stats_; }
+    // Passes, barriers and transient memory of the last recorded frame.
+    const RenderGraphStats& render_graph_stats() const { return render_graph_.stats(); }
 
 private:
-    void init_vulkan(HINSTANCE hInstance, HWND hwnd, uint32_t width, uint32_t height);
+    void init_vulkan(const Window& window);
     void cleanup();
-    void create_instance();
-    void create_surface(HINSTANCE hInstance, HWND hwnd);
+    void create_instance(const char* surfaceExtension);
     void pick_physical_device();
     void create_logical_device();
-    void create_swapchain(uint32_t width, uint32_t height);
+    void create_swapchain(uint32_t width, uint32_t height, VkSwapchainKHR oldSwapchain = VK_NULL_HANDLE);
+    void create_present_semaphores();
+    bool recreate_swapchain();
+    void release_retired_swapchains(uint32_t acquiredImage);
     void create_image_views();
-    void create_render_pass();
-    void create_framebuffers();
+    VkFormat find_depth_format() const;
     void create_command_pool();
     void create_command_buffers();
     void create_sync_objects();
+    void destroy_frame_resources();
+    void init_profiler();
+    void record_frame(VkCommandBuffer cmd, uint32_t imageIndex);
+    void measure_latency();
     // New for drawing
     void create_graphics_pipeline();
     // Validation layers
@@ -68,22 +165,61 @@ private:
     std::vector<VkImageView> swapchain_image_views_;
     VkFormat swapchain_image_format_;
     VkExtent2D swapchain_extent_;
-    VkRenderPass render_pass_ = VK_NULL_HANDLE;
-    std::vector<VkFramebuffer> swapchain_framebuffers_;
+    // Signaled by the submit, waited on by present; one per swapchain image so
+    // a semaphore is never reused while its present is still pending.
+    std::vector<VkSemaphore> render_finished_semaphores_;
+    // Swapchains replaced by recreate_swapchain(). Frame fences don't cover
+    // presentation, so each one waits for a present from a later swapchain:
+    // presents complete in queue order, and that one has completed once its
+    // image is acquired again.
+    struct RetiredSwapchain {
+        VkSwapchainKHR swapchain = VK_NULL_HANDLE;
+        std::vector<VkImageView> image_views;
+        std::vector<VkSemaphore> semaphores;
+        // Image of the current swapchain whose next acquire releases it;
+        // none until a present has been queued.
+        uint32_t present_image = UINT32_MAX;
+
+        void destroy(VkDevice device) const;
+    };
+    std::vector<RetiredSwapchain> retired_swapchains_;
+    uint32_t window_width_ = 0;
+    uint32_t window_height_ = 0;
+    bool swapchain_dirty_ = false;
+    PresentPolicy present_policy_ = PresentPolicy::mailbox;
+    std::chrono::microseconds pacing_interval_{ 16667 };
+    std::chrono::steady_clock::time_point next_frame_time_{};
     VkCommandPool command_pool_ = VK_NULL_HANDLE;
+    // Per frame in flight
     std::vector<VkCommandBuffer> command_buffers_;
     std::vector<VkSemaphore> image_available_semaphores_;
-    std::vector<VkSemaphore> render_finished_semaphores_;
     std::vector<VkFence> in_flight_fences_;
+    std::vector<uint64_t> frame_serials_;
+    // Input time of the frame in each slot, or zero once it was measured.
+    std::vector<std::chrono::steady_clock::time_point> frame_input_times_;
+    std::chrono::steady_clock::time_point next_input_time_{};
+    FrameLatencyStats latency_;
     size_t current_frame_ = 0;
-    const int max_frames_in_flight_ = 2;
-    bool framebuffer_resized_ = false;
+    uint32_t frames_in_flight_ = 2;
+    // Submission counter; serial N retiring implies all earlier ones did.
+    uint64_t submit_serial_ = 0;
+    uint64_t completed_serial_ = 0;
+    DeletionQueue deletion_queue_;
+    MeshPool meshes_;
     // Drawing resources
     VkPipelineLayout pipeline_layout_ = VK_NULL_HANDLE;
     VkPipeline graphics_pipeline_ = VK_NULL_HANDLE;
-    VkBuffer vertex_buffer_ = VK_NULL_HANDLE;
-    VkDeviceMemory vertex_buffer_memory_ = VK_NULL_HANDLE;
-    std::vector<Vertex> quad_vertices_;
+    VkPipeline graphics_pipeline_equal_ = VK_NULL_HANDLE;
+    VkPipeline depth_prepass_pipeline_ = VK_NULL_HANDLE;
+    bool depth_prepass_enabled_ = false;
+    // The depth buffer itself is a render graph transient sized to the swapchain.
+    VkFormat depth_format_ = VK_FORMAT_UNDEFINED;
+    // 2D overlay, drawn after the scene in the main pass
+    SpriteBatch sprites_;
+    LightGrid light_grid_;
+    ShadowCascades shadows_;
+    ViewAtlas view_atlas_;
+    SpriteRegion debug_sprite_;
     // Texture resources
     VkImage texture_image_ = VK_NULL_HANDLE;
     VkDeviceMemory texture_image_memory_ = VK_NULL_HANDLE;
@@ -91,11 +227,27 @@ private:
     VkSampler texture_sampler_ = VK_NULL_HANDLE;
     VkDescriptorSetLayout descriptor_set_layout_ = VK_NULL_HANDLE;
     VkDescriptorPool descriptor_pool_ = VK_NULL_HANDLE;
-    VkDescriptorSet descriptor_set_ = VK_NULL_HANDLE;
+    // One material set per frame slot, each pointing at that slot's MVP range.
+    std::array<VkDescriptorSet, max_frames_in_flight> descriptor_sets_{};
     Camera camera_;
-    // MVP uniform buffer
+    // The draw list was culled for an older camera; re-culled at the next frame.
+    bool camera_dirty_ = false;
+    // MVP uniform buffer, one range per frame slot, written when the slot is recorded
     VkBuffer mvp_buffer_ = VK_NULL_HANDLE;
     VkDeviceMemory mvp_buffer_memory_ = VK_NULL_HANDLE;
-    VkDescriptorBufferInfo mvp_buffer_info_{};
+    std::byte* mvp_mapped_ = nullptr;
+    VkDeviceSize mvp_stride_ = 0;
     Scene* scene_ = nullptr;
+    RenderQueue render_queue_;
+    FrameArena frame_arena_;
+    // Rebuilt every frame; owns the barriers around the passes.
+    RenderGraph render_graph_;
+    RenderStats render_stats_;
+    uint32_t frustum_culled_ = 0;
+    uint32_t occlusion_culled_ = 0;
+    OcclusionCuller occlusion_culler_;
+    bool occlusion_culling_enabled_ = false;
+    float lod_error_pixels_ = 1.0f;
+    Profiler profiler_;
+    bool pipeline_statistics_supported_ = false;
 }; 
\ No newline at end of file
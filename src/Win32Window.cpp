@@ -1,7 +1,17 @@
+#define VK_USE_PLATFORM_WIN32_KHR
 #include "Win32Window.h"
+#include <stdexcept>
 
 LRESULT CALLBACK Win32Window::wnd_proc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam) {
+    if (msg == WM_NCCREATE) {
+        auto* create = reinterpret_cast<CREATESTRUCTW*>(lParam);
+        SetWindowLongPtrW(hwnd, GWLP_USERDATA, reinterpret_cast<LONG_PTR>(create->lpCreateParams));
+    }
+    auto* self = reinterpret_cast<Win32Window*>(GetWindowLongPtrW(hwnd, GWLP_USERDATA));
     switch (msg) {
+    case WM_SIZE:
+        if (self) self->set_size(LOWORD(lParam), HIWORD(lParam));
+        return 0;
     case WM_DESTROY:
         PostQuitMessage(0);
         return 0;
@@ -10,7 +20,9 @@ LRESULT CALLBACK Win32Window::wnd_proc(HWND hwnd, UINT msg, WPARAM wParam, LPARA
     }
 }
 
-Win32Window::Win32Window(HINSTANCE hInstance, int nCmdShow) : hInstance_(hInstance) {
+Win32Window::Win32Window(HINSTANCE hInstance, int nCmdShow, uint32_t width, uint32_t height) : hInstance_(hInstance) {
+    width_ = width;
+    height_ = height;
     const wchar_t CLASS_NAME[] = L"SampleWin32WindowClass";
 
     WNDCLASSEXW wc = {};
@@ -28,11 +40,11 @@ Win32Window::Win32Window(HINSTANCE hInstance, int nCmdShow) : hInstance_(hInstan
         CLASS_NAME,
         L"Win32 Window",
         WS_OVERLAPPEDWINDOW,
-        CW_USEDEFAULT, CW_USEDEFAULT, 800, 600,
+        CW_USEDEFAULT, CW_USEDEFAULT, static_cast<int>(width), static_cast<int>(height),
         nullptr,
         nullptr,
         hInstance_,
-        nullptr
+        this
     );
 
     if (hwnd_) {
@@ -56,4 +68,19 @@ bool Win32Window::process_messages() {
         DispatchMessageW(&msg);
     }
     return true;
-} 
\ No newline at end of file
+}
+
+const char* Win32Window::surface_extension() const {
+    return VK_KHR_WIN32_SURFACE_EXTENSION_NAME;
+}
+
+VkSurfaceKHR Win32Window::create_surface(VkInstance instance) const {
+    VkWin32SurfaceCreateInfoKHR createInfo{};
+    createInfo.sType = VK_STRUCTURE_TYPE_WIN32_SURFACE_CREATE_INFO_KHR;
+    createInfo.hinstance = hInstance_;
+    createInfo.hwnd = hwnd_;
+    VkSurfaceKHR surface = VK_NULL_HANDLE;
+    if (vkCreateWin32SurfaceKHR(instance, &createInfo, nullptr, &surface) != VK_SUCCESS)
+        throw std::runtime_error("Failed to create Win32 surface");
+    return surface;
+}
@@ -1,16 +1,22 @@
 #pragma once
 
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
 #include <windows.h>
+#include "Window.h"
 
-class Win32Window {
+class Win32Window : public Window {
 public:
-    Win32Window(HINSTANCE hInstance, int nCmdShow);
+    Win32Window(HINSTANCE hInstance, int nCmdShow, uint32_t width = 800, uint32_t height = 600);
     ~Win32Window();
-    bool process_messages();
+    bool process_messages() override;
+    const char* surface_extension() const override;
+    VkSurfaceKHR create_surface(VkInstance instance) const override;
     HWND get_hwnd() const { return hwnd_; }
 
 private:
     static LRESULT CALLBACK wnd_proc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam);
     HWND hwnd_ = nullptr;
     HINSTANCE hInstance_ = nullptr;
-}; 
\ No newline at end of file
+};
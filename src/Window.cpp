@@ -0,0 +1,18 @@
+#include "Window.h"
+#include "NullWindow.h"
+#if ENGINE_PLATFORM_WIN32
+#include "Win32Window.h"
+#elif ENGINE_PLATFORM_XCB
+#include "XcbWindow.h"
+#endif
+
+std::unique_ptr<Window> create_window(uint32_t width, uint32_t height, bool headless) {
+    if (headless) return std::make_unique<NullWindow>(width, height);
+#if ENGINE_PLATFORM_WIN32
+    return std::make_unique<Win32Window>(GetModuleHandleW(nullptr), SW_SHOWDEFAULT, width, height);
+#elif ENGINE_PLATFORM_XCB
+    return std::make_unique<XcbWindow>(width, height);
+#else
+    return std::make_unique<NullWindow>(width, height);
+#endif
+}
@@ -0,0 +1,45 @@
+#pragma once
+#include <vulkan/vulkan.h>
+#include <cstdint>
+#include <memory>
+
+// Platform window: event pump, size tracking and Vulkan surface creation.
+// Implementations own the platform headers and VK_USE_PLATFORM_* defines, so
+// nothing else in the engine depends on the windowing system.
+class Window {
+public:
+    virtual ~Window() = default;
+
+    // Handles pending events. Returns false once the window was closed.
+    virtual bool process_messages() = 0;
+    // Instance extension needed by create_surface, next to VK_KHR_surface.
+    virtual const char* surface_extension() const = 0;
+    virtual VkSurfaceKHR create_surface(VkInstance instance) const = 0;
+
+    uint32_t width() const { return width_; }
+    uint32_t height() const { return height_; }
+    // True once after the drawable area changed size; width/height receive the new size.
+    bool consume_resize(uint32_t& width, uint32_t& height) {
+        if (!resized_) return false;
+        resized_ = false;
+        width = width_;
+        height = height_;
+        return true;
+    }
+
+protected:
+    void set_size(uint32_t width, uint32_t height) {
+        if (width == width_ && height == height_) return;
+        width_ = width;
+        height_ = height;
+        resized_ = true;
+    }
+
+    uint32_t width_ = 0;
+    uint32_t height_ = 0;
+    bool resized_ = false;
+};
+
+// Opens the platform's native window, or a NullWindow when headless is set
+// or no native backend was built in.
+std::unique_ptr<Window> create_window(uint32_t width, uint32_t height, bool headless);
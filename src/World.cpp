@@ -0,0 +1,211 @@
+#include "World.h"
+#include <algorithm>
+#include <cstring>
+#include <new>
+#include <stdexcept>
+#include <type_traits>
+
+namespace {
+struct ComponentInfo {
+    uint32_t size;
+    uint32_t align;
+    void (*construct)(void*);
+};
+
+template<typename T, ComponentType expected>
+constexpr ComponentInfo component_info() {
+    static_assert(T::type == expected, "component table out of order");
+    static_assert(std::is_trivially_copyable_v<T>, "components are moved with memcpy");
+    return {sizeof(T), alignof(T), [](void* p) { new (p) T(); }};
+}
+
+// Indexed by ComponentType.
+constexpr ComponentInfo component_infos[component_type_count] = {
+    component_info<LocalTransform, ComponentType::local_transform>(),
+    component_info<Parent, ComponentType::parent>(),
+    component_info<WorldTransform, ComponentType::world_transform>(),
+    component_info<MeshRef, ComponentType::mesh_ref>(),
+    component_info<WorldBounds, ComponentType::world_bounds>(),
+    component_info<MaterialRef, ComponentType::material>(),
+    component_info<OccluderRef, ComponentType::occluder>(),
+    component_info<LodState, ComponentType::lod_state>(),
+};
+
+// Columns start on 16 bytes so SIMD loops can use aligned loads.
+constexpr uint32_t column_alignment = 16;
+
+uint32_t align_up(uint32_t value, uint32_t alignment) {
+    return (value + alignment - 1) / alignment * alignment;
+}
+}
+
+World::Archetype& World::archetype(ComponentMask mask) {
+    auto it = archetype_lookup_.find(mask);
+    if (it != archetype_lookup_.end()) return *it->second;
+
+    auto created = std::make_unique<Archetype>();
+    created->mask = mask;
+    created->offsets.fill(UINT32_MAX);
+    uint32_t rowBytes = sizeof(Entity);
+    for (uint32_t t = 0; t < component_type_count; ++t) {
+        if (mask & (1u << t)) rowBytes += component_infos[t].size;
+    }
+    // Largest capacity whose aligned columns still fit in a chunk.
+    auto layout = [&](uint32_t capacity) {
+        uint32_t offset = sizeof(Entity) * capacity;
+        for (uint32_t t = 0; t < component_type_count; ++t) {
+            if (!(mask & (1u << t))) continue;
+            offset = align_up(offset, std::max(column_alignment, component_infos[t].align));
+            created->offsets[t] = offset;
+            offset += component_infos[t].size * capacity;
+        }
+        return offset;
+    };
+    uint32_t capacity = static_cast<uint32_t>(chunk_bytes / rowBytes);
+    while (capacity > 0 && layout(capacity) > chunk_bytes) --capacity;
+    if (capacity == 0) throw std::runtime_error("Archetype row does not fit in a chunk");
+    created->capacity = capacity;
+    created->entity_offset = 0;
+
+    Archetype* result = created.get();
+    archetypes_.push_back(std::move(created));
+    archetype_lookup_.emplace(mask, result);
+    return *result;
+}
+
+void World::allocate_row(Archetype& archetype, uint32_t& chunk, uint32_t& row) {
+    if (archetype.chunks.empty() || archetype.chunks.back().count == archetype.capacity) {
+        Chunk fresh;
+        fresh.storage = take_chunk();
+        archetype.chunks.push_back(std::move(fresh));
+    }
+    chunk = static_cast<uint32_t>(archetype.chunks.size() - 1);
+    row = archetype.chunks.back().count++;
+    ++archetype.size;
+}
+
+void World::remove_row(Archetype& archetype, uint32_t chunk, uint32_t row) {
+    uint32_t lastChunk = static_cast<uint32_t>(archetype.chunks.size() - 1);
+    uint32_t lastRow = archetype.chunks[lastChunk].count - 1;
+    if (chunk != lastChunk || row != lastRow) {
+        std::byte* dst = archetype.chunks[chunk].storage->bytes;
+        std::byte* src = archetype.chunks[lastChunk].storage->bytes;
+        for (uint32_t t = 0; t < component_type_count; ++t) {
+            if (!(archetype.mask & (1u << t))) continue;
+            uint32_t size = component_infos[t].size;
+            memcpy(dst + archetype.offsets[t] + size * row, src + archetype.offsets[t] + size * lastRow, size);
+        }
+        Entity moved = entity_column(archetype, lastChunk)[lastRow];
+        entity_column(archetype, chunk)[row] = moved;
+        records_[moved.index].chunk = chunk;
+        records_[moved.index].row = row;
+    }
+    --archetype.size;
+    // Keep one empty chunk around so an entity flickering in and out of an
+    // archetype doesn't reallocate.
+    if (--archetype.chunks[lastChunk].count == 0 && lastChunk > 0) {
+        spare_chunks_.push_back(std::move(archetype.chunks.back().storage));
+        archetype.chunks.pop_back();
+    }
+}
+
+std::unique_ptr<World::ChunkStorage> World::take_chunk() {
+    if (spare_chunks_.empty()) return std::make_unique<ChunkStorage>();
+    std::unique_ptr<ChunkStorage> storage = std::move(spare_chunks_.back());
+    spare_chunks_.pop_back();
+    return storage;
+}
+
+Entity World::create(ComponentMask mask) {
+    uint32_t index;
+    if (!free_.empty()) {
+        index = free_.back();
+        free_.pop_back();
+    } else {
+        index = static_cast<uint32_t>(records_.size());
+        records_.emplace_back();
+    }
+    Archetype& target = archetype(mask);
+    EntityRecord& record = records_[index];
+    record.archetype = &target;
+    allocate_row(target, record.chunk, record.row);
+    Entity entity{index, record.generation};
+    entity_column(target, record.chunk)[record.row] = entity;
+    std::byte* bytes = target.chunks[record.chunk].storage->bytes;
+    for (uint32_t t = 0; t < component_type_count; ++t) {
+        if (mask & (1u << t)) component_infos[t].construct(bytes + target.offsets[t] + component_infos[t].size * record.row);
+    }
+    ++live_count_;
+    return entity;
+}
+
+void World::destroy(Entity entity) {
+    if (!alive(entity)) return;
+    EntityRecord& record = records_[entity.index];
+    remove_row(*record.archetype, record.chunk, record.row);
+    record.archetype = nullptr;
+    ++record.generation;
+    free_.push_back(entity.index);
+    --live_count_;
+}
+
+void World::clear() {
+    for (uint32_t i = 0; i < records_.size(); ++i) {
+        if (!records_[i].archetype) continue;
+        records_[i].archetype = nullptr;
+        ++records_[i].generation;
+        free_.push_back(i);
+    }
+    // Archetypes stay, empty, for the next rebuild to find again.
+    for (auto& archetype : archetypes_) {
+        for (Chunk& chunk : archetype->chunks) spare_chunks_.push_back(std::move(chunk.storage));
+        archetype->chunks.clear();
+        archetype->size = 0;
+    }
+    live_count_ = 0;
+}
+
+void World::change_archetype(Entity entity, ComponentMask mask) {
+    EntityRecord& record = records_[entity.index];
+    Archetype& source = *record.archetype;
+    Archetype& target = archetype(mask);
+    uint32_t oldChunk = record.chunk;
+    uint32_t oldRow = record.row;
+    uint32_t chunk, row;
+    allocate_row(target, chunk, row);
+    std::byte* src = source.chunks[oldChunk].storage->bytes;
+    std::byte* dst = target.chunks[chunk].storage->bytes;
+    for (uint32_t t = 0; t < component_type_count; ++t) {
+        if (!(mask & (1u << t))) continue;
+        uint32_t size = component_infos[t].size;
+        void* to = dst + target.offsets[t] + size * row;
+        if (source.mask & (1u << t)) {
+            memcpy(to, src + source.offsets[t] + size * oldRow, size);
+        } else {
+            component_infos[t].construct(to);
+        }
+    }
+    entity_column(target, chunk)[row] = entity;
+    record.archetype = &target;
+    record.chunk = chunk;
+    record.row = row;
+    remove_row(source, oldChunk, oldRow);
+}
+
+void World::gather_chunks(ComponentMask include, ComponentMask exclude, std::pmr::vector<ChunkRef>& out) const {
+    out.clear();
+    size_t total = 0;
+    for (const auto& archetype : archetypes_) {
+        if (matches(*archetype, include, exclude)) total += archetype->chunks.size();
+    }
+    out.reserve(total);
+    size_t first = 0;
+    for (const auto& archetype : archetypes_) {
+        if (!matches(*archetype, include, exclude)) continue;
+        for (uint32_t c = 0; c < archetype->chunks.size(); ++c) {
+            if (archetype->chunks[c].count == 0) continue;
+            out.push_back({archetype.get(), c, first});
+            first += archetype->chunks[c].count;
+        }
+    }
+}
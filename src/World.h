@@ -0,0 +1,198 @@
+#pragma once
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <memory_resource>
+#include <tuple>
+#include <unordered_map>
+#include <vector>
+#include "Components.h"
+#include "JobSystem.h"
+
+using ComponentMask = uint32_t;
+
+template<typename T>
+constexpr ComponentMask component_bit() { return 1u << static_cast<uint32_t>(T::type); }
+template<typename... Ts>
+constexpr ComponentMask component_mask() { return (0u | ... | component_bit<Ts>()); }
+
+// Contiguous component columns of one chunk, handed to query callbacks. first
+// is the chunk's offset in the query's entity order, so parallel queries can
+// write per-entity results into a flat array sized with World::count().
+template<typename... Ts>
+struct ChunkView {
+    uint32_t count = 0;
+    size_t first = 0;
+    const Entity* entities = nullptr;
+    std::tuple<Ts*...> columns;
+
+    template<typename T> T* get() const { return std::get<T*>(columns); }
+};
+
+// Archetype-based entity-component store. Entities with the same component set
+// share an archetype whose rows live in fixed-size chunks holding one array per
+// component, so queries stream through memory instead of chasing pointers.
+// Chunks of an archetype are kept dense (all full except the last): destroying
+// an entity moves the archetype's last row into the hole.
+//
+// Query callbacks must not create, destroy, add or remove components; queries
+// with the same component list and exclude mask visit chunks in the same order.
+class World {
+public:
+    static constexpr size_t chunk_bytes = 16 * 1024;
+
+    World() = default;
+    World(const World&) = delete;
+    World& operator=(const World&) = delete;
+
+    // New entity with default-constructed components for every bit in mask.
+    Entity create(ComponentMask mask);
+    template<typename... Ts>
+    Entity create(const Ts&... components) {
+        Entity entity = create(component_mask<Ts...>());
+        ((*get<Ts>(entity) = components), ...);
+        return entity;
+    }
+    void destroy(Entity entity);
+    // Destroys every entity; outstanding handles become stale.
+    void clear();
+    bool alive(Entity entity) const {
+        return entity.index < records_.size() && records_[entity.index].archetype &&
+               records_[entity.index].generation == entity.generation;
+    }
+    size_t size() const { return live_count_; }
+
+    // Null if the entity is dead or lacks the component. Pointers stay valid
+    // until the next structural change.
+    template<typename T> T* get(Entity entity) const {
+        if (!alive(entity)) return nullptr;
+        const EntityRecord& record = records_[entity.index];
+        if (!(record.archetype->mask & component_bit<T>())) return nullptr;
+        return column<T>(*record.archetype, record.chunk) + record.row;
+    }
+    template<typename T> bool has(Entity entity) const { return get<T>(entity) != nullptr; }
+    template<typename T> T& add(Entity entity, const T& value = T{}) {
+        if (!has<T>(entity)) change_archetype(entity, records_[entity.index].archetype->mask | component_bit<T>());
+        return *get<T>(entity) = value;
+    }
+    template<typename T> void remove(Entity entity) {
+        if (has<T>(entity)) change_archetype(entity, records_[entity.index].archetype->mask & ~component_bit<T>());
+    }
+
+    // fn(const ChunkView<Ts...>&) for every non-empty chunk whose archetype has
+    // all of Ts and none of the exclude bits.
+    template<typename... Ts, typename Fn>
+    void each_chunk(Fn&& fn, ComponentMask exclude = 0) const {
+        constexpr ComponentMask include = component_mask<Ts...>();
+        size_t first = 0;
+        for (const auto& archetype : archetypes_) {
+            if (!matches(*archetype, include, exclude)) continue;
+            for (uint32_t c = 0; c < archetype->chunks.size(); ++c) {
+                if (archetype->chunks[c].count == 0) continue;
+                fn(view<Ts...>(*archetype, c, first));
+                first += archetype->chunks[c].count;
+            }
+        }
+    }
+    // Same chunks as each_chunk, spread over the shared JobSystem.
+    template<typename... Ts, typename Fn>
+    void parallel_each_chunk(Fn&& fn, ComponentMask exclude = 0) const {
+        // The chunk list of a typical query fits on the stack; only very large
+        // worlds spill to the heap.
+        std::array<std::byte, 4096> buffer;
+        std::pmr::monotonic_buffer_resource scratch(buffer.data(), buffer.size());
+        std::pmr::vector<ChunkRef> chunks(&scratch);
+        gather_chunks(component_mask<Ts...>(), exclude, chunks);
+        JobSystem::shared().parallel_for(chunks.size(), 1, [&](size_t begin, size_t end) {
+            for (size_t i = begin; i < end; ++i) {
+                fn(view<Ts...>(*chunks[i].archetype, chunks[i].chunk, chunks[i].first));
+            }
+        });
+    }
+    // fn(Ts&...) for every matching entity.
+    template<typename... Ts, typename Fn>
+    void each(Fn&& fn, ComponentMask exclude = 0) const {
+        each_chunk<Ts...>([&](const ChunkView<Ts...>& chunk) {
+            for (uint32_t i = 0; i < chunk.count; ++i) fn(chunk.template get<Ts>()[i]...);
+        }, exclude);
+    }
+    // Number of entities a query with the same arguments visits.
+    template<typename... Ts>
+    size_t count(ComponentMask exclude = 0) const {
+        constexpr ComponentMask include = component_mask<Ts...>();
+        size_t total = 0;
+        for (const auto& archetype : archetypes_) {
+            if (matches(*archetype, include, exclude)) total += archetype->size;
+        }
+        return total;
+    }
+
+private:
+    struct alignas(64) ChunkStorage {
+        std::byte bytes[chunk_bytes];
+    };
+    struct Chunk {
+        std::unique_ptr<ChunkStorage> storage;
+        uint32_t count = 0;
+    };
+    struct Archetype {
+        ComponentMask mask = 0;
+        uint32_t capacity = 0;
+        // Byte offsets of the entity column and of each component column.
+        uint32_t entity_offset = 0;
+        std::array<uint32_t, component_type_count> offsets{};
+        std::vector<Chunk> chunks;
+        size_t size = 0;
+    };
+    struct EntityRecord {
+        Archetype* archetype = nullptr;
+        uint32_t chunk = 0;
+        uint32_t row = 0;
+        uint32_t generation = 0;
+    };
+    struct ChunkRef {
+        Archetype* archetype;
+        uint32_t chunk;
+        size_t first;
+    };
+
+    static bool matches(const Archetype& archetype, ComponentMask include, ComponentMask exclude) {
+        return (archetype.mask & include) == include && !(archetype.mask & exclude);
+    }
+    template<typename T>
+    static T* column(const Archetype& archetype, uint32_t chunk) {
+        std::byte* bytes = archetype.chunks[chunk].storage->bytes;
+        return reinterpret_cast<T*>(bytes + archetype.offsets[static_cast<uint32_t>(T::type)]);
+    }
+    static Entity* entity_column(const Archetype& archetype, uint32_t chunk) {
+        return reinterpret_cast<Entity*>(archetype.chunks[chunk].storage->bytes + archetype.entity_offset);
+    }
+    template<typename... Ts>
+    static ChunkView<Ts...> view(const Archetype& archetype, uint32_t chunk, size_t first) {
+        ChunkView<Ts...> out;
+        out.count = archetype.chunks[chunk].count;
+        out.first = first;
+        out.entities = entity_column(archetype, chunk);
+        out.columns = std::tuple<Ts*...>(column<Ts>(archetype, chunk)...);
+        return out;
+    }
+
+    Archetype& archetype(ComponentMask mask);
+    // Appends an uninitialized row and returns its location.
+    void allocate_row(Archetype& archetype, uint32_t& chunk, uint32_t& row);
+    // Fills the hole with the archetype's last row and fixes up its record.
+    void remove_row(Archetype& archetype, uint32_t chunk, uint32_t row);
+    void change_archetype(Entity entity, ComponentMask mask);
+    void gather_chunks(ComponentMask include, ComponentMask exclude, std::pmr::vector<ChunkRef>& out) const;
+    std::unique_ptr<ChunkStorage> take_chunk();
+
+    std::vector<std::unique_ptr<Archetype>> archetypes_;
+    std::unordered_map<ComponentMask, Archetype*> archetype_lookup_;
+    std::vector<EntityRecord> records_;
+    std::vector<uint32_t> free_;
+    // Storage of chunks emptied by destroy() or clear(), reused before
+    // allocating, so rebuilding a world of similar size stays off the heap.
+    std::vector<std::unique_ptr<ChunkStorage>> spare_chunks_;
+    size_t live_count_ = 0;
+};
@@ -0,0 +1,306 @@
+#include "WorldStreamer.h"
+#include <algorithm>
+#include <cmath>
+#include <filesystem>
+#include "Log.h"
+#include "Mesh.h"
+
+namespace {
+// Weight of the newest sample in the smoothed camera velocity.
+constexpr float velocity_smoothing = 0.2f;
+}
+
+WorldStreamer::WorldStreamer(VkDevice device, VkPhysicalDevice physicalDevice, DeletionQueue& deletionQueue,
+                             MeshPool& meshes, Scene& scene, std::string directory, const StreamingSettings& settings)
+    : device_(device), physical_device_(physicalDevice), deletion_queue_(deletionQueue), meshes_(meshes), scene_(scene),
+      directory_(std::move(directory)), settings_(settings) {
+    loader_ = std::thread([this] { loader_loop(); });
+}
+
+WorldStreamer::~WorldStreamer() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stop_ = true;
+    }
+    wake_.notify_all();
+    loader_.join();
+    if (scene_.root) {
+        std::erase_if(scene_.root->children, [&](const std::unique_ptr<SceneNode>& child) {
+            return std::any_of(cells_.begin(), cells_.end(), [&](const auto& entry) { return entry.second.root == child.get(); });
+        });
+    }
+    for (const auto& entry : cells_) {
+        for (MeshHandle mesh : entry.second.meshes) meshes_.remove(mesh);
+    }
+    scene_.mark_dirty();
+}
+
+std::string WorldStreamer::cell_file_name(CellCoord cell) {
+    return "cell_" + std::to_string(cell.x) + "_" + std::to_string(cell.z) + ".cell";
+}
+
+CellCoord WorldStreamer::cell_at(const glm::vec3& position) const {
+    return {static_cast<int32_t>(std::floor(position.x / settings_.cell_size)),
+            static_cast<int32_t>(std::floor(position.z / settings_.cell_size))};
+}
+
+const std::vector<CellTexture>* WorldStreamer::textures(CellCoord cell) const {
+    auto it = cells_.find(cell);
+    return it != cells_.end() && it->second.state == CellState::resident ? &it->second.data.archive.textures : nullptr;
+}
+
+void WorldStreamer::loader_loop() {
+    for (;;) {
+        CellCoord coord;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            wake_.wait(lock, [this] { return stop_ || !requests_.empty(); });
+            if (stop_) return;
+            coord = requests_.front();
+            requests_.pop_front();
+        }
+        std::string path = directory_ + "/" + cell_file_name(coord);
+        auto loaded = std::make_unique<LoadedCell>();
+        if (loaded->archive.load(path)) {
+            for (const CookedMesh& mesh : loaded->archive.meshes) {
+                const MeshLod& lod = mesh.lods[0];
+                loaded->bvhs.emplace_back(mesh.vertices, mesh.indices.data() + lod.first_index, lod.index_count);
+            }
+        } else {
+            // Cells without a file are simply empty.
+            std::error_code error;
+            if (std::filesystem::exists(path, error)) LOG_WARN("WorldStreamer: cannot read cell {}", path);
+            loaded.reset();
+        }
+        std::lock_guard<std::mutex> lock(mutex_);
+        results_.emplace_back(coord, std::move(loaded));
+    }
+}
+
+WorldStreamer::Cost WorldStreamer::cost_of(const LoadedCell& data) {
+    // What a resident cell keeps: its textures, BVHs and the GPU copies of
+    // its meshes (vertex, index and position buffers).
+    Cost cost;
+    cost.cpu = data.archive.nodes.size() * sizeof(CellNode);
+    for (const CellTexture& texture : data.archive.textures) cost.cpu += texture.pixels.size();
+    for (const TriangleBvh& bvh : data.bvhs) cost.cpu += bvh.byte_size();
+    for (const CookedMesh& mesh : data.archive.meshes) {
+        cost.gpu += mesh.vertices.size() * (sizeof(Vertex) + 3 * sizeof(float)) + mesh.indices.size() * sizeof(uint32_t);
+    }
+    return cost;
+}
+
+void WorldStreamer::gather_wanted(const glm::vec3& position) {
+    wanted_.clear();
+    const float size = settings_.cell_size;
+    const float radius = settings_.load_radius;
+    auto add_around = [&](const glm::vec3& center, float basePriority, bool prefetch) {
+        int32_t x0 = static_cast<int32_t>(std::floor((center.x - radius) / size));
+        int32_t x1 = static_cast<int32_t>(std::floor((center.x + radius) / size));
+        int32_t z0 = static_cast<int32_t>(std::floor((center.z - radius) / size));
+        int32_t z1 = static_cast<int32_t>(std::floor((center.z + radius) / size));
+        for (int32_t z = z0; z <= z1; ++z) {
+            for (int32_t x = x0; x <= x1; ++x) {
+                // Distance from center to the cell's square.
+                float dx = std::max({x * size - center.x, 0.0f, center.x - (x + 1) * size});
+                float dz = std::max({z * size - center.z, 0.0f, center.z - (z + 1) * size});
+                float distance = std::sqrt(dx * dx + dz * dz);
+                if (distance > radius) continue;
+                float priority = basePriority + distance;
+                auto it = std::find_if(wanted_.begin(), wanted_.end(), [&](const Request& r) { return r.coord == CellCoord{x, z}; });
+                if (it == wanted_.end()) {
+                    wanted_.push_back({{x, z}, priority, prefetch});
+                } else if (priority < it->priority) {
+                    it->priority = priority;
+                    it->prefetch = prefetch;
+                }
+            }
+        }
+    };
+    add_around(position, 0.0f, false);
+    // Cells ahead rank behind every cell around the camera.
+    glm::vec3 ahead = position + velocity_ * settings_.prefetch_seconds;
+    if (glm::length(glm::vec2(ahead.x - position.x, ahead.z - position.z)) > size * 0.5f) add_around(ahead, radius, true);
+    std::sort(wanted_.begin(), wanted_.end(), [](const Request& a, const Request& b) { return a.priority < b.priority; });
+}
+
+bool WorldStreamer::make_room(const Cost& cost) {
+    for (;;) {
+        size_t cpu = used_.cpu + pending_.cpu + cost.cpu;
+        size_t gpu = used_.gpu + pending_.gpu + cost.gpu;
+        if (cpu <= settings_.cpu_budget && gpu <= settings_.gpu_budget) return true;
+        // Least recently wanted resident cell that is not wanted now.
+        const CellCoord* victim = nullptr;
+        uint64_t oldest = update_count_;
+        for (const auto& [coord, cell] : cells_) {
+            if (cell.root && cell.last_wanted < oldest) {
+                oldest = cell.last_wanted;
+                victim = &coord;
+            }
+        }
+        if (!victim) return false;
+        evict(*victim);
+    }
+}
+
+void WorldStreamer::evict(CellCoord coord) {
+    auto it = cells_.find(coord);
+    Cell& cell = it->second;
+    if (cell.root) {
+        std::erase_if(scene_.root->children, [&](const std::unique_ptr<SceneNode>& child) { return child.get() == cell.root; });
+        scene_changed_ = true;
+    }
+    // The buffers go through the deletion queue; frames in flight still draw them.
+    for (MeshHandle mesh : cell.meshes) meshes_.remove(mesh);
+    used_.cpu -= cell.cost.cpu;
+    used_.gpu -= cell.cost.gpu;
+    ++stats_.evictions;
+    cells_.erase(it);
+}
+
+void WorldStreamer::collect_loads() {
+    std::vector<std::pair<CellCoord, std::unique_ptr<LoadedCell>>> results;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        results.swap(results_);
+    }
+    for (auto& [coord, loaded] : results) {
+        auto it = cells_.find(coord);
+        Cell& cell = it->second;
+        pending_.cpu -= cell.cost.cpu;
+        pending_.gpu -= cell.cost.gpu;
+        if (!loaded || loaded->archive.empty()) {
+            // Empty cells stay resident at no cost, so they are not read again
+            // while the camera stays near.
+            cell.state = CellState::resident;
+            cell.cost = {};
+            known_costs_[coord] = {};
+            continue;
+        }
+        cell.data = std::move(*loaded);
+        cell.cost = cost_of(cell.data);
+        cell.state = CellState::loaded;
+        known_costs_[coord] = cell.cost;
+        used_.cpu += cell.cost.cpu;
+        used_.gpu += cell.cost.gpu;
+        // The estimate it was loaded under was low (first load) or the
+        // budgets shrank meanwhile.
+        if (!make_room({})) {
+            used_.cpu -= cell.cost.cpu;
+            used_.gpu -= cell.cost.gpu;
+            cells_.erase(it);
+            ++stats_.budget_stalls;
+        }
+    }
+}
+
+void WorldStreamer::upload(CellCoord coord, Cell& cell) {
+    if (!scene_.root) scene_.root = std::make_unique<SceneNode>();
+    CellArchive& archive = cell.data.archive;
+    cell.meshes.reserve(archive.meshes.size());
+    for (size_t m = 0; m < archive.meshes.size(); ++m) {
+        MeshHandle mesh = meshes_.create(device_, physical_device_, archive.meshes[m], &deletion_queue_);
+        meshes_.get(mesh)->set_bvh(std::move(cell.data.bvhs[m]));
+        cell.meshes.push_back(mesh);
+    }
+    auto cellRoot = std::make_unique<SceneNode>();
+    std::vector<SceneNode*> nodes;
+    nodes.reserve(archive.nodes.size());
+    for (const CellNode& source : archive.nodes) {
+        auto node = std::make_unique<SceneNode>();
+        node->position = source.position;
+        node->rotation = source.rotation;
+        node->scale = source.scale;
+        if (source.mesh >= 0) node->mesh = cell.meshes[source.mesh];
+        node->pipeline = source.pipeline;
+        node->material = source.material;
+        nodes.push_back(node.get());
+        SceneNode* parent = source.parent >= 0 ? nodes[source.parent] : cellRoot.get();
+        parent->add_child(std::move(node));
+    }
+    cell.root = cellRoot.get();
+    scene_.root->add_child(std::move(cellRoot));
+    // The GPU buffers replace the cooked meshes; textures stay for textures().
+    archive.meshes.clear();
+    archive.meshes.shrink_to_fit();
+    cell.data.bvhs.clear();
+    cell.state = CellState::resident;
+    scene_changed_ = true;
+    LOG_DEBUG("WorldStreamer: cell {},{} resident, {} meshes, {} nodes", coord.x, coord.z, cell.meshes.size(), nodes.size());
+}
+
+bool WorldStreamer::update(const glm::vec3& cameraPosition, float dt) {
+    ++update_count_;
+    scene_changed_ = false;
+
+    if (has_position_ && dt > 0.0f) {
+        velocity_ = glm::mix(velocity_, (cameraPosition - last_position_) / dt, velocity_smoothing);
+    }
+    last_position_ = cameraPosition;
+    has_position_ = true;
+
+    gather_wanted(cameraPosition);
+    for (const Request& request : wanted_) {
+        auto it = cells_.find(request.coord);
+        if (it != cells_.end()) it->second.last_wanted = update_count_;
+    }
+    collect_loads();
+
+    uint32_t uploads = 0;
+    for (const Request& request : wanted_) {
+        if (uploads == settings_.max_uploads_per_update) break;
+        auto it = cells_.find(request.coord);
+        if (it == cells_.end() || it->second.state != CellState::loaded) continue;
+        upload(request.coord, it->second);
+        ++uploads;
+    }
+    // Loads that finished after the camera moved on are dropped, as are
+    // empty cells; neither has anything in the scene.
+    std::erase_if(cells_, [&](const auto& entry) {
+        const Cell& cell = entry.second;
+        if (cell.last_wanted == update_count_) return false;
+        if (cell.state == CellState::loaded) {
+            used_.cpu -= cell.cost.cpu;
+            used_.gpu -= cell.cost.gpu;
+            return true;
+        }
+        return cell.state == CellState::resident && !cell.root;
+    });
+
+    uint32_t loading = 0;
+    for (const auto& entry : cells_) loading += entry.second.state == CellState::loading;
+    bool requested = false;
+    for (const Request& request : wanted_) {
+        if (loading >= settings_.max_loads_in_flight) break;
+        if (cells_.contains(request.coord)) continue;
+        auto known = known_costs_.find(request.coord);
+        Cost estimate = known != known_costs_.end() ? known->second : Cost{};
+        if (!make_room(estimate)) {
+            ++stats_.budget_stalls;
+            break;
+        }
+        Cell& cell = cells_[request.coord];
+        cell.cost = estimate;
+        cell.last_wanted = update_count_;
+        pending_.cpu += estimate.cpu;
+        pending_.gpu += estimate.gpu;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            requests_.push_back(request.coord);
+        }
+        requested = true;
+        ++loading;
+        ++stats_.loads;
+        if (request.prefetch) ++stats_.prefetches;
+    }
+    if (requested) wake_.notify_one();
+
+    stats_.wanted = static_cast<uint32_t>(wanted_.size());
+    stats_.loading = loading;
+    stats_.resident = 0;
+    for (const auto& entry : cells_) stats_.resident += entry.second.root != nullptr;
+    stats_.cpu_bytes = used_.cpu;
+    stats_.gpu_bytes = used_.gpu;
+    if (scene_changed_) scene_.mark_dirty();
+    return scene_changed_;
+}
@@ -0,0 +1,161 @@
+#pragma once
+#include <vulkan/vulkan.h>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include <glm/glm.hpp>
+#include "CellArchive.h"
+#include "Scene.h"
+
+class DeletionQueue;
+
+// Square cell of the XZ plane.
+struct CellCoord {
+    int32_t x = 0;
+    int32_t z = 0;
+
+    bool operator==(const CellCoord&) const = default;
+};
+
+struct CellCoordHash {
+    size_t operator()(const CellCoord& c) const {
+        return std::hash<uint64_t>()((static_cast<uint64_t>(static_cast<uint32_t>(c.x)) << 32) | static_cast<uint32_t>(c.z));
+    }
+};
+
+struct StreamingSettings {
+    float cell_size = 32.0f;
+    // Cells whose square comes this close to the camera are wanted.
+    float load_radius = 64.0f;
+    // Cells around where the camera will be after this long at its current
+    // velocity are requested too, after the ones around it.
+    float prefetch_seconds = 1.5f;
+    // Resident cells are evicted least recently wanted first to stay within
+    // these; cells that would not fit wait.
+    size_t cpu_budget = size_t(256) << 20;
+    size_t gpu_budget = size_t(512) << 20;
+    uint32_t max_loads_in_flight = 2;
+    // Cells turned into meshes and nodes per update(); each one uploads buffers.
+    uint32_t max_uploads_per_update = 1;
+};
+
+struct StreamingStats {
+    uint32_t wanted = 0;
+    uint32_t resident = 0;
+    uint32_t loading = 0;
+    size_t cpu_bytes = 0;
+    size_t gpu_bytes = 0;
+    uint64_t loads = 0;
+    uint64_t prefetches = 0;
+    uint64_t evictions = 0;
+    // Loads or uploads held back because the budgets were full of wanted cells.
+    uint64_t budget_stalls = 0;
+};
+
+// Keeps the cells of a large world around the camera resident in a Scene.
+//
+// Each cell is a CellArchive file named cell_file_name() in one directory; a
+// missing file is an empty cell. Archives are read, and their meshes' BVHs
+// built, on a loader thread. update() turns finished loads into Meshes and a
+// SceneNode subtree under scene.root, and evicts cells that are no longer
+// wanted when the budgets need room. Evicted meshes release their buffers
+// through the renderer's deletion queue, so frames in flight can still draw them.
+class WorldStreamer {
+public:
+    // The scene must outlive the streamer. Streamed subtrees are children of
+    // scene.root (created if null); keep other content under root as well.
+    // Streamed meshes are created in meshes and removed again on eviction.
+    WorldStreamer(VkDevice device, VkPhysicalDevice physicalDevice, DeletionQueue& deletionQueue, MeshPool& meshes,
+                  Scene& scene, std::string directory, const StreamingSettings& settings = {});
+    // Removes the streamed nodes and releases their meshes.
+    ~WorldStreamer();
+
+    WorldStreamer(const WorldStreamer&) = delete;
+    WorldStreamer& operator=(const WorldStreamer&) = delete;
+
+    // Once per frame before drawing. Returns true when the scene tree changed,
+    // so draws must be re-recorded before the next frame.
+    bool update(const glm::vec3& cameraPosition, float dt);
+
+    CellCoord cell_at(const glm::vec3& position) const;
+    static std::string cell_file_name(CellCoord cell);
+    // Textures of a resident cell, for the caller to upload and bind; null
+    // if the cell is not resident.
+    const std::vector<CellTexture>* textures(CellCoord cell) const;
+    const StreamingStats& stats() const { return stats_; }
+    const StreamingSettings& settings() const { return settings_; }
+    // Changes the GPU budget, e.g. to follow what the device's memory budget
+    // leaves (see GpuMemoryStats). Loads from then on respect it; resident
+    // cells are evicted only when a load needs their room.
+    void set_gpu_budget(size_t bytes) { settings_.gpu_budget = bytes; }
+
+private:
+    enum class CellState { loading, loaded, resident };
+
+    struct Cost {
+        size_t cpu = 0;
+        size_t gpu = 0;
+    };
+    // Archive contents plus the BVHs built from them on the loader thread.
+    struct LoadedCell {
+        CellArchive archive;
+        std::vector<TriangleBvh> bvhs;
+    };
+    struct Cell {
+        CellState state = CellState::loading;
+        LoadedCell data;
+        std::vector<MeshHandle> meshes;
+        // Owned by scene.root.
+        SceneNode* root = nullptr;
+        Cost cost;
+        uint64_t last_wanted = 0;
+    };
+    struct Request {
+        CellCoord coord;
+        float priority;
+        bool prefetch;
+    };
+
+    void loader_loop();
+    void collect_loads();
+    void gather_wanted(const glm::vec3& position);
+    bool make_room(const Cost& cost);
+    void upload(CellCoord coord, Cell& cell);
+    void evict(CellCoord coord);
+    static Cost cost_of(const LoadedCell& data);
+
+    VkDevice device_;
+    VkPhysicalDevice physical_device_;
+    DeletionQueue& deletion_queue_;
+    MeshPool& meshes_;
+    Scene& scene_;
+    std::string directory_;
+    StreamingSettings settings_;
+    StreamingStats stats_;
+
+    std::unordered_map<CellCoord, Cell, CellCoordHash> cells_;
+    // Costs seen on earlier loads, used to budget before loading again.
+    std::unordered_map<CellCoord, Cost, CellCoordHash> known_costs_;
+    std::vector<Request> wanted_;
+    Cost used_;
+    Cost pending_;
+    uint64_t update_count_ = 0;
+    glm::vec3 last_position_{0.0f};
+    glm::vec3 velocity_{0.0f};
+    bool has_position_ = false;
+    bool scene_changed_ = false;
+
+    std::thread loader_;
+    std::mutex mutex_;
+    std::condition_variable wake_;
+    std::deque<CellCoord> requests_;
+    std::vector<std::pair<CellCoord, std::unique_ptr<LoadedCell>>> results_;
+    bool stop_ = false;
+};
@@ -0,0 +1,91 @@
+#include <xcb/xcb.h>
+#define VK_USE_PLATFORM_XCB_KHR
+#include "XcbWindow.h"
+#include <cstdlib>
+#include <cstring>
+#include <stdexcept>
+
+namespace {
+xcb_atom_t intern_atom(xcb_connection_t* connection, const char* name) {
+    xcb_intern_atom_cookie_t cookie = xcb_intern_atom(connection, 0, static_cast<uint16_t>(strlen(name)), name);
+    xcb_intern_atom_reply_t* reply = xcb_intern_atom_reply(connection, cookie, nullptr);
+    xcb_atom_t atom = reply ? reply->atom : static_cast<xcb_atom_t>(XCB_ATOM_NONE);
+    free(reply);
+    return atom;
+}
+}
+
+XcbWindow::XcbWindow(uint32_t width, uint32_t height, const std::string& title) {
+    width_ = width;
+    height_ = height;
+    int screenIndex = 0;
+    connection_ = xcb_connect(nullptr, &screenIndex);
+    if (xcb_connection_has_error(connection_)) {
+        xcb_disconnect(connection_);
+        throw std::runtime_error("Failed to connect to the X server");
+    }
+    xcb_screen_iterator_t it = xcb_setup_roots_iterator(xcb_get_setup(connection_));
+    for (int i = 0; i < screenIndex; ++i) xcb_screen_next(&it);
+    xcb_screen_t* screen = it.data;
+
+    window_ = xcb_generate_id(connection_);
+    uint32_t valueMask = XCB_CW_BACK_PIXEL | XCB_CW_EVENT_MASK;
+    uint32_t values[] = { screen->black_pixel, XCB_EVENT_MASK_STRUCTURE_NOTIFY | XCB_EVENT_MASK_KEY_PRESS };
+    xcb_create_window(connection_, XCB_COPY_FROM_PARENT, window_, screen->root, 0, 0,
+                      static_cast<uint16_t>(width), static_cast<uint16_t>(height), 0,
+                      XCB_WINDOW_CLASS_INPUT_OUTPUT, screen->root_visual, valueMask, values);
+    xcb_change_property(connection_, XCB_PROP_MODE_REPLACE, window_, XCB_ATOM_WM_NAME, XCB_ATOM_STRING, 8,
+                        static_cast<uint32_t>(title.size()), title.c_str());
+    // Ask the window manager to send a client message instead of killing the
+    // connection when the window is closed.
+    xcb_atom_t protocols = intern_atom(connection_, "WM_PROTOCOLS");
+    delete_atom_ = intern_atom(connection_, "WM_DELETE_WINDOW");
+    xcb_change_property(connection_, XCB_PROP_MODE_REPLACE, window_, protocols, XCB_ATOM_ATOM, 32, 1, &delete_atom_);
+    xcb_map_window(connection_, window_);
+    xcb_flush(connection_);
+}
+
+XcbWindow::~XcbWindow() {
+    if (connection_) {
+        xcb_destroy_window(connection_, window_);
+        xcb_disconnect(connection_);
+    }
+}
+
+bool XcbWindow::process_messages() {
+    bool open = true;
+    while (xcb_generic_event_t* event = xcb_poll_for_event(connection_)) {
+        switch (event->response_type & 0x7f) {
+        case XCB_CONFIGURE_NOTIFY: {
+            auto* configure = reinterpret_cast<xcb_configure_notify_event_t*>(event);
+            set_size(configure->width, configure->height);
+            break;
+        }
+        case XCB_CLIENT_MESSAGE: {
+            auto* message = reinterpret_cast<xcb_client_message_event_t*>(event);
+            if (message->data.data32[0] == delete_atom_) open = false;
+            break;
+        }
+        default:
+            break;
+        }
+        free(event);
+    }
+    if (xcb_connection_has_error(connection_)) open = false;
+    return open;
+}
+
+const char* XcbWindow::surface_extension() const {
+    return VK_KHR_XCB_SURFACE_EXTENSION_NAME;
+}
+
+VkSurfaceKHR XcbWindow::create_surface(VkInstance instance) const {
+    VkXcbSurfaceCreateInfoKHR createInfo{};
+    createInfo.sType = VK_STRUCTURE_TYPE_XCB_SURFACE_CREATE_INFO_KHR;
+    createInfo.connection = connection_;
+    createInfo.window = window_;
+    VkSurfaceKHR surface = VK_NULL_HANDLE;
+    if (vkCreateXcbSurfaceKHR(instance, &createInfo, nullptr, &surface) != VK_SUCCESS)
+        throw std::runtime_error("Failed to create XCB surface");
+    return surface;
+}
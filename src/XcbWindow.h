@@ -0,0 +1,24 @@
+#pragma once
+#include "Window.h"
+#include <string>
+
+struct xcb_connection_t;
+
+// X11 window through XCB, for Linux hosts.
+class XcbWindow : public Window {
+public:
+    XcbWindow(uint32_t width, uint32_t height, const std::string& title = "engine");
+    ~XcbWindow();
+
+    XcbWindow(const XcbWindow&) = delete;
+    XcbWindow& operator=(const XcbWindow&) = delete;
+
+    bool process_messages() override;
+    const char* surface_extension() const override;
+    VkSurfaceKHR create_surface(VkInstance instance) const override;
+
+private:
+    xcb_connection_t* connection_ = nullptr;
+    uint32_t window_ = 0;
+    uint32_t delete_atom_ = 0;
+};
@@ -1,18 +1,83 @@
 #include <iostream>
-#include "Win32Window.h"
+#include "Window.h"
+#include "NullWindow.h"
 #include "VulkanApp.h"
 #include "ImageLoader.h"
 #include "GLTFImporter.h"
 #include "Camera.h"
 #include "Mesh.h"
+#include "MeshCooker.h"
 #include "SceneNode.h"
 #include "Scene.h"
+#include "CellArchive.h"
+#include "WorldStreamer.h"
+#include "Simulation.h"
+#include "GpuMemory.h"
+#include "Log.h"
+#include "AllocationCounter.h"
+#include <algorithm>
 #include <thread>
+#include <charconv>
 #include <chrono>
+#include <cmath>
+#include <filesystem>
+#include <optional>
+#include <sstream>
+#include <string>
+#include <vector>
+#ifdef _WIN32
+#include "Win32Window.h"
+#endif
 
-int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE, LPSTR, int nCmdShow) {
-    Win32Window window(hInstance, nCmdShow);
-    VulkanApp vkApp(hInstance, window.get_hwnd(), 800, 600);
+// Cooks the demo mesh into a grid of world cells on first run, one copy at
+// the origin of each cell. Real worlds cook their cells offline.
+static bool cook_demo_cells(const std::string& directory, float cellSize) {
+    if (std::filesystem::exists(directory + "/" + WorldStreamer::cell_file_name({0, 0}))) return true;
+    std::vector<Vertex> meshVertices;
+    std::vector<uint32_t> meshIndices;
+    if (!GLTFImporter::load_mesh("assets/test.glb", meshVertices, meshIndices)) return false;
+    CellArchive cell;
+    cell.meshes.push_back(MeshCooker::cook(meshVertices, meshIndices));
+    cell.nodes.emplace_back().mesh = 0;
+    std::error_code error;
+    std::filesystem::create_directories(directory, error);
+    for (int32_t z = -4; z <= 4; ++z) {
+        for (int32_t x = -4; x <= 4; ++x) {
+            cell.nodes[0].position = glm::vec3(x * cellSize, 0.0f, z * cellSize);
+            if (!cell.save(directory + "/" + WorldStreamer::cell_file_name({x, z}))) return false;
+        }
+    }
+    return true;
+}
+
+// Moves a grid of small colored lights in circles over the demo cells.
+static void animate_demo_lights(std::vector<PointLight>& lights, float time) {
+    constexpr uint32_t side = 16;
+    constexpr float spacing = 4.0f;
+    lights.resize(side * side);
+    for (uint32_t i = 0; i < lights.size(); ++i) {
+        float x = (static_cast<float>(i % side) - side * 0.5f) * spacing;
+        float z = (static_cast<float>(i / side) - side * 0.5f) * spacing;
+        float phase = time + static_cast<float>(i) * 0.37f;
+        lights[i].position = glm::vec3(x + std::cos(phase) * 1.5f, 1.0f, z + std::sin(phase) * 1.5f);
+        lights[i].radius = 3.0f;
+        lights[i].color = glm::vec3(0.5f + 0.5f * std::cos(i * 0.9f), 0.5f + 0.5f * std::cos(i * 0.9f + 2.1f),
+                                    0.5f + 0.5f * std::cos(i * 0.9f + 4.2f));
+        lights[i].intensity = 3.0f;
+    }
+}
+
+// Points camera i of count at the origin from a ring that rises with i.
+static void orbit_camera(Camera& camera, uint32_t i, uint32_t count, float time) {
+    float angle = time * 0.2f + 6.2831853f * static_cast<float>(i) / static_cast<float>(count);
+    float height = 1.0f + 6.0f * static_cast<float>(i) / static_cast<float>(count);
+    camera.set_position(glm::vec3(std::cos(angle) * 12.0f, height, std::sin(angle) * 12.0f));
+    camera.set_look_at(glm::vec3(0.0f));
+}
+
+// maxFrames ends the main loop after that many frames (0 = never).
+static int run(Window& window, uint32_t previewViews = 0, uint64_t maxFrames = 0) {
+    VulkanApp vkApp(window);
 
     // Setup camera
     Camera camera;
@@ -22,23 +87,44 @@ int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE, LPSTR, int nCmdShow) {
     camera.set_up(glm::vec3(0, 1, 0));
     vkApp.set_camera(camera);
 
-    // Load mesh
-    std::vector<Vertex> meshVertices;
-    std::vector<uint32_t> meshIndices;
-    if (!GLTFImporter::load_mesh("assets/test.glb", meshVertices, meshIndices)) {
-        std::cerr << "Failed to load mesh from test.glb" << std::endl;
+    // Stream the world in cells around the camera
+    const std::string cellDirectory = "cells";
+    StreamingSettings streaming;
+    streaming.cell_size = 8.0f;
+    streaming.load_radius = 16.0f;
+    if (!cook_demo_cells(cellDirectory, streaming.cell_size)) {
+        std::cerr << "Failed to cook demo cells from test.glb" << std::endl;
         return 1;
     }
-    // Create mesh and scene node
-    auto mesh = std::make_shared<Mesh>(vkApp.device(), vkApp.physical_device(), meshVertices, meshIndices);
-    auto node = std::make_unique<SceneNode>();
-    node->mesh = mesh;
-    // Optionally set node transform here
-    // Create scene
-    Scene scene;
-    scene.root = std::move(node);
+    Scene scene(vkApp.meshes());
+    WorldStreamer streamer(vkApp.device(), vkApp.physical_device(), vkApp.deletion_queue(), vkApp.meshes(), scene,
+                           cellDirectory, streaming);
     vkApp.set_scene(&scene);
-    vkApp.record_draw_commands();
+    vkApp.lights().set_ambient(glm::vec3(0.15f));
+    DirectionalLight sun;
+    sun.intensity = 1.0f;
+    vkApp.shadows().set_light(sun);
+
+    // The demo's lights move on the simulation thread at a fixed 60 Hz; each
+    // frame shows them interpolated, one step behind the newest tick.
+    Simulation simulation(std::chrono::microseconds(16667), [](SimulationState& state, float) {
+        animate_demo_lights(state.lights, static_cast<float>(state.time));
+    });
+    SimulationState initial;
+    initial.camera_position = camera.get_position();
+    initial.camera_target = camera.get_look_at();
+    animate_demo_lights(initial.lights, 0.0f);
+    SimulationState view = initial;
+
+    // Preview views of the scene, rendered into the atlas alongside every frame.
+    Camera previewCamera;
+    if (previewViews > 0) {
+        ViewAtlasLayout atlasLayout;
+        atlasLayout.rows = (std::min(previewViews, 128u) + atlasLayout.columns - 1) / atlasLayout.columns;
+        vkApp.init_view_atlas(atlasLayout);
+        previewCamera.set_perspective(glm::radians(50.0f), 1.0f, 0.1f, 100.0f);
+        previewCamera.set_up(glm::vec3(0, 1, 0));
+    }
 
     // Give RenderDoc a chance to attach before Vulkan instance creation
     if constexpr (true) { // Set to true if you want to always allow attaching
@@ -46,9 +132,133 @@ int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE, LPSTR, int nCmdShow) {
     }
 
     // Main loop
-    while (window.process_messages()) {
+    auto lastFrame = std::chrono::steady_clock::now();
+    // Frames before this one may still be warming up caches and arenas.
+    constexpr uint64_t steady_frame = 120;
+    uint64_t frame = 0;
+    // Memory is checked against the device budget every second and dumped to
+    // the log every 30.
+    auto nextMemoryCheck = lastFrame;
+    uint32_t memoryChecks = 0;
+    simulation.start(initial);
+    while ((maxFrames == 0 || frame < maxFrames) && window.process_messages()) {
+        uint64_t allocationsBefore = heap_allocation_count();
+        uint32_t width, height;
+        bool resized = window.consume_resize(width, height);
+        if (resized) vkApp.on_window_resized(width, height);
+        auto now = std::chrono::steady_clock::now();
+        float dt = std::chrono::duration<float>(now - lastFrame).count();
+        lastFrame = now;
+        simulation.interpolate(now, view);
+        if (view.camera_position != camera.get_position() || view.camera_target != camera.get_look_at()) {
+            camera.set_position(view.camera_position);
+            camera.set_look_at(view.camera_target);
+            vkApp.set_camera(camera);
+        }
+        vkApp.lights().lights() = view.lights;
+        vkApp.set_frame_input_time(view.input_time);
+        for (uint32_t i = 0; i < previewViews; ++i) {
+            orbit_camera(previewCamera, i, previewViews, static_cast<float>(view.time));
+            if (vkApp.view_atlas().add_view(previewCamera) == UINT32_MAX) break;
+        }
+        if (now >= nextMemoryCheck) {
+            nextMemoryCheck = now + std::chrono::seconds(1);
+            GpuMemoryStats memory = GpuMemory::shared().stats();
+            // Streamed cells may grow into most of what the device-local
+            // heaps have left, never past the configured budget.
+            VkDeviceSize headroom = memory.device_local_headroom();
+            streamer.set_gpu_budget(static_cast<size_t>(std::min<VkDeviceSize>(streaming.gpu_budget,
+                streamer.stats().gpu_bytes + headroom - headroom / 8)));
+            if (memoryChecks++ % 30 == 0) GpuMemory::shared().log_stats();
+        }
+        bool sceneChanged = streamer.update(camera.get_position(), dt);
+        if (sceneChanged) {
+            vkApp.shadows().invalidate_static();
+            vkApp.record_draw_commands();
+        }
         vkApp.draw_frame();
+        ++frame;
+        // A frame that neither streamed nor resized should not touch the heap.
+        if constexpr (heap_allocations_counted) {
+            uint64_t allocations = heap_allocation_count() - allocationsBefore;
+            if (frame > steady_frame && allocations > 0 && !sceneChanged && !resized)
+                LOG_RATE_LIMITED(LogLevel::warn, 1, "main: steady-state frame made {} heap allocations", allocations);
+        }
+    }
+    simulation.stop();
+    GpuMemory::shared().log_stats();
+    LOG_INFO("main: input-to-photon latency {} ms average over {} frames, {} simulation ticks",
+             vkApp.latency().average_ms, vkApp.latency().frames, simulation.stats().ticks);
+    if (previewViews > 0) {
+        const ViewAtlasStats& atlas = vkApp.view_atlas().stats();
+        LOG_INFO("main: {} preview views rendered, {} views/s, last frame {} draws, culling {} ms",
+                 atlas.completed_views, atlas.views_per_second, atlas.draws, atlas.cull_ms);
     }
     vkApp.wait_device_idle();
+#if ENGINE_PROFILER
+    // Open in chrome://tracing or ui.perfetto.dev
+    vkApp.profiler().write_chrome_trace("profile.json");
+#endif
+    Logger::flush();
     return 0;
-} 
\ No newline at end of file
+}
+
+// --headless renders through VK_EXT_headless_surface; --frames N exits after
+// N frames, which keeps perf/valgrind/sanitizer runs bounded. --views N also
+// renders N preview views of the scene into the view atlas every frame.
+struct LaunchOptions {
+    bool headless = false;
+    uint64_t frames = 0;
+    uint32_t views = 0;
+};
+
+constexpr const char* usage = "usage: engine_app [--headless] [--frames N] [--views N]";
+
+// The whole argument has to be a number that fits in value.
+template <typename T>
+static bool parse_count(const std::string& text, T& value) {
+    const char* end = text.data() + text.size();
+    auto [last, error] = std::from_chars(text.data(), end, value);
+    return error == std::errc{} && last == end;
+}
+
+// Prints the usage and returns nothing for unknown options or bad counts.
+static std::optional<LaunchOptions> parse_options(const std::vector<std::string>& args) {
+    LaunchOptions options;
+    for (size_t i = 0; i < args.size(); ++i) {
+        bool valid = true;
+        if (args[i] == "--headless") options.headless = true;
+        else if (args[i] == "--frames") valid = i + 1 < args.size() && parse_count(args[++i], options.frames);
+        else if (args[i] == "--views") valid = i + 1 < args.size() && parse_count(args[++i], options.views);
+        else valid = false;
+        if (!valid) {
+            std::cerr << "engine_app: bad argument '" << args[i] << "'\n" << usage << std::endl;
+            return std::nullopt;
+        }
+    }
+    return options;
+}
+
+#ifdef _WIN32
+int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE, LPSTR lpCmdLine, int nCmdShow) {
+    std::vector<std::string> args;
+    std::istringstream cmdLine(lpCmdLine);
+    for (std::string arg; cmdLine >> arg;) args.push_back(std::move(arg));
+    const std::optional<LaunchOptions> options = parse_options(args);
+    if (!options) return 2;
+    if (options->headless) {
+        NullWindow window(800, 600);
+        return run(window, options->views, options->frames);
+    }
+    Win32Window window(hInstance, nCmdShow);
+    return run(window, options->views, options->frames);
+}
+#else
+int main(int argc, char** argv) {
+    const std::optional<LaunchOptions> options = parse_options(std::vector<std::string>(argv + 1, argv + argc));
+    if (!options) return 2;
+    std::unique_ptr<Window> window =
+        options->headless ? std::make_unique<NullWindow>(800, 600) : create_window(800, 600, false);
+    return run(*window, options->views, options->frames);
+}
+#endif
@@ -0,0 +1,73 @@
+// Steady-state frames must not touch the heap. Runs frames of per-frame
+// containers on a FrameArena, with profiler scopes recorded around them, and
+// checks that global operator new is not called once the arena and the
+// profiler have warmed up. Allocation counting is compiled into this test
+// whatever ENGINE_COUNT_ALLOCATIONS and ENGINE_ENABLE_PROFILER are set to.
+#include <algorithm>
+#include <cstdio>
+#include <memory_resource>
+#include <vector>
+#include "AllocationCounter.h"
+#include "FrameArena.h"
+#include "Profiler.h"
+
+namespace {
+// Frame sizes cycle through this many frames, so the arena sees its largest
+// frame within the warm-up.
+constexpr uint32_t size_period = 16;
+
+// Sorts draw keys into buckets, the kind of work RenderQueue and LightGrid do
+// on the arena every frame. Returns a checksum so nothing is optimized out.
+uint64_t run_frame(FrameArena& arena, Profiler& profiler, uint32_t frame) {
+    profiler.begin_frame();
+    Profiler::CpuScope frameScope(profiler, "frame");
+    arena.reset();
+    const uint32_t count = 1000 + 700 * (frame % size_period);
+
+    std::pmr::vector<uint64_t> keys(&arena);
+    {
+        Profiler::CpuScope scope(profiler, "collect");
+        for (uint32_t i = 0; i < count; ++i) keys.push_back((uint64_t(i) * 2654435761u) ^ frame);
+    }
+    {
+        Profiler::CpuScope scope(profiler, "sort");
+        std::sort(keys.begin(), keys.end());
+    }
+    std::pmr::vector<std::pmr::vector<uint32_t>> buckets(&arena);
+    {
+        Profiler::CpuScope scope(profiler, "bucket");
+        buckets.resize(64);
+        for (uint32_t i = 0; i < count; ++i) buckets[keys[i] % buckets.size()].push_back(i);
+    }
+    uint64_t checksum = 0;
+    for (const auto& bucket : buckets) checksum += bucket.size() * bucket.size();
+    return checksum + keys.front();
+}
+}
+
+int main() {
+    if (!heap_allocations_counted) {
+        std::fprintf(stderr, "frame_allocation_test: built without ENGINE_COUNT_ALLOCATIONS\n");
+        return 1;
+    }
+    FrameArena arena(size_t(16) << 10);
+    Profiler profiler;
+    uint64_t checksum = 0;
+    uint32_t frame = 0;
+    for (; frame < 2 * size_period; ++frame) checksum += run_frame(arena, profiler, frame);
+
+    constexpr uint32_t steady_frames = 1000;
+    const uint64_t before = heap_allocation_count();
+    for (uint32_t end = frame + steady_frames; frame < end; ++frame) checksum += run_frame(arena, profiler, frame);
+    const uint64_t allocations = heap_allocation_count() - before;
+
+    std::printf("%u steady frames, %llu heap allocations, arena peak %zu bytes in %llu heap blocks (checksum %llu)\n",
+                steady_frames, static_cast<unsigned long long>(allocations), arena.stats().peak,
+                static_cast<unsigned long long>(arena.stats().heap_blocks), static_cast<unsigned long long>(checksum));
+    if (allocations != 0) {
+        std::fprintf(stderr, "frame_allocation_test: steady-state frames made %llu heap allocations\n",
+                     static_cast<unsigned long long>(allocations));
+        return 1;
+    }
+    return 0;
+}